@@ -57,6 +57,7 @@ TARGET_BOARD_PLATFORM_GPU := fimg
 BOARD_EGL_CFG := device/samsung/apollo/prebuilt/graphics/egl.cfg
 TARGET_LIBAGL_USE_GRALLOC_COPYBITS := true
 #BOARD_EGL_NEEDS_LEGACY_FB := true
+#BOARD_FIMG_SOFTWARE_BACKEND := true
 BOARD_NEEDS_MEMORYHEAPPMEM := true
 
 # Camera
@@ -32,7 +32,8 @@ PRODUCT_LOCALES += mdpi ldpi
 
 PRODUCT_COPY_FILES += \
         device/samsung/apollo/etc/gps.conf:system/etc/gps.conf \
-        device/samsung/apollo/etc/secgps.conf:system/etc/secgps.conf
+        device/samsung/apollo/etc/secgps.conf:system/etc/secgps.conf \
+        device/samsung/apollo/etc/init.d/90fimg:system/etc/init.d/90fimg
 
 PRODUCT_PACKAGES += \
     brcm_patchram_plus \
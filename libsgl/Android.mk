@@ -27,7 +27,8 @@ LOCAL_SRC_FILES:= \
 	glesTex.cpp \
 	fglmatrix.cpp \
 	fglframebuffer.cpp \
-	fglsurface.cpp
+	fglsurface.cpp \
+	fgltrace.cpp
 
 LOCAL_C_INCLUDES := \
 	$(LOCAL_PATH)/../include
@@ -67,8 +68,32 @@ LOCAL_CFLAGS += -DANDROID_FAST_TLS
 # Debug GL errors
 LOCAL_CFLAGS += -DGLES_ERR_DEBUG
 
+# Emulate the hardware on CPU (see libfimg/Android.mk)
+ifeq ($(BOARD_FIMG_SOFTWARE_BACKEND),true)
+LOCAL_CFLAGS += -DFIMG_SOFTWARE_BACKEND
+LOCAL_LDLIBS += -lm
+endif
+
 LOCAL_MODULE_TAGS := optional
 LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/egl
 LOCAL_MODULE:= libGLES_fimg
 
 include $(BUILD_SHARED_LIBRARY)
+
+#
+# Build the GL call trace replay tool
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := fglreplay.cpp
+
+LOCAL_CFLAGS += -DGL_GLEXT_PROTOTYPES -DEGL_EGLEXT_PROTOTYPES
+LOCAL_CFLAGS += -O2 -Wall -Wno-unused-parameter
+
+LOCAL_SHARED_LIBRARIES := libEGL libGLESv1_CM
+
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE := fglreplay
+
+include $(BUILD_EXECUTABLE)
@@ -31,7 +31,7 @@
 #define FGL_MAX_RENDERBUFFER_OBJECTS	1024
 #define FGL_MAX_MIPMAP_LEVEL		11
 #define FGL_MAX_LIGHTS			8
-#define FGL_MAX_CLIP_PLANES		1
+#define FGL_MAX_CLIP_PLANES		4
 #define FGL_MAX_MODELVIEW_STACK_DEPTH	16
 #define FGL_MAX_PROJECTION_STACK_DEPTH	2
 #define FGL_MAX_TEXTURE_STACK_DEPTH	2
@@ -42,6 +42,26 @@
 #define FGL_MAX_POINT_SIZE		(2048.0f)
 #define FGL_MIN_LINE_WIDTH		(1.0f)
 #define FGL_MAX_LINE_WIDTH		(128.0f)
+#define FGL_DEFERRED_DRAW_VERTICES	256
+#define FGL_DEFERRED_DRAW_MAX_COUNT	64
+
+#define FGL_OPTIMIZED_INDEX_RANGES	4
+
+/* Transcode ETC1 textures to DXT1 (4 bpp) instead of RGB565 (16 bpp) */
+#define FGL_ETC1_TO_DXT1
+
+/* Copy framebuffer contents to textures using G2D engine */
+#define FGL_G2D_TEXTURE_COPY
+
+/* Render mipmap levels down to this size by GPU, smaller ones by CPU */
+#define FGL_GPU_MIPMAP_MIN_SIZE		16
+
+/* Time slice of hardware lease in microseconds (0 to lock for every draw) */
+#define FGL_HW_LEASE_SLICE		4000
+
+/* Build GL call tracing support (see fgltrace.cpp) */
+//#define FGL_TRACE
+#define FGL_TRACE_RING_SIZE		(4 << 20)
 
 #define likely(x)       __builtin_expect((x),1)
 #define unlikely(x)     __builtin_expect((x),0)
@@ -123,4 +143,8 @@ static int binarySearch(const T sortedArray[], int first, int last, EGLint key)
 	return -1;
 }
 
+#ifdef FGL_TRACE
+#include "fgltrace.h"
+#endif
+
 #endif // _LIBSGL_COMMON_H_
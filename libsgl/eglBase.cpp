@@ -23,6 +23,9 @@
 # include <config.h>
 #endif
 
+/* eglGetProcAddress() must return traced entry points */
+#define FGL_TRACE_NO_RENAME
+
 #include <assert.h>
 #include <errno.h>
 #include <stdlib.h>
@@ -35,6 +38,10 @@
 #include <sys/mman.h>
 #include <sys/types.h>
 
+#ifdef FGL_PLATFORM_ANDROID
+#include <cutils/properties.h>
+#endif
+
 #include "platform.h"
 
 #include <EGL/egl.h>
@@ -57,7 +64,10 @@
 static const char *const gVendorString     = "OpenFIMG";
 static const char *const gVersionString    = "1.4 pre-alpha";
 static const char *const gClientApisString = "OpenGL_ES";
-static const char *const gExtensionsString = "" PLATFORM_EXTENSIONS_STRING;
+static const char *const gExtensionsString =
+	"EGL_KHR_fence_sync "
+	"EGL_KHR_wait_sync "
+	PLATFORM_EXTENSIONS_STRING;
 
 #ifndef PLATFORM_HAS_FAST_TLS
 pthread_key_t eglContextKey = -1;
@@ -103,8 +113,8 @@ EGLAPI EGLint EGLAPIENTRY eglGetError(void)
 	if(unlikely(eglErrorKey == (pthread_key_t)-1))
 		return EGL_SUCCESS;
 
-	EGLint error = (EGLint)pthread_getspecific(eglErrorKey);
-	pthread_setspecific(eglErrorKey, (void *)EGL_SUCCESS);
+	EGLint error = (EGLint)(intptr_t)pthread_getspecific(eglErrorKey);
+	pthread_setspecific(eglErrorKey, (void *)(intptr_t)EGL_SUCCESS);
 	return error;
 }
 
@@ -117,7 +127,7 @@ void fglEGLSetError(EGLint error)
 		pthread_mutex_unlock(&eglErrorKeyMutex);
 	}
 
-	pthread_setspecific(eglErrorKey, (void *)error);
+	pthread_setspecific(eglErrorKey, (void *)(intptr_t)error);
 }
 
 /*
@@ -129,7 +139,7 @@ EGLAPI EGLDisplay EGLAPIENTRY eglGetDisplay(EGLNativeDisplayType display_id)
 	if(display_id != EGL_DEFAULT_DISPLAY)
 		return EGL_NO_DISPLAY;
 
-	return (EGLDisplay)FGL_DISPLAY_MAGIC;
+	return (EGLDisplay)(uintptr_t)FGL_DISPLAY_MAGIC;
 }
 
 EGLAPI EGLBoolean EGLAPIENTRY eglInitialize(EGLDisplay dpy,
@@ -489,7 +499,7 @@ EGLAPI EGLBoolean EGLAPIENTRY eglGetConfigs(EGLDisplay dpy, EGLConfig *configs,
 
 	EGLint num = min(gPlatformConfigsNum, config_size);
 	for(EGLint i = 0; i < num; ++i)
-		*(configs++) = (EGLConfig)i;
+		*(configs++) = (EGLConfig)(uintptr_t)i;
 
 	*num_config = num;
 	return EGL_TRUE;
@@ -594,7 +604,7 @@ EGLAPI EGLBoolean EGLAPIENTRY eglChooseConfig(EGLDisplay dpy,
 		if (!(possibleMatch & BIT_VAL(i)))
 			continue;
 
-		*(configs++) = (EGLConfig)i;
+		*(configs++) = (EGLConfig)(uintptr_t)i;
 		--config_size;
 		++n;
 	}
@@ -611,7 +621,7 @@ EGLAPI EGLBoolean EGLAPIENTRY eglGetConfigAttrib(EGLDisplay dpy,
 		return EGL_FALSE;
 	}
 
-	if (!fglGetConfigAttrib((uint32_t)config, attribute, value))
+	if (!fglGetConfigAttrib((uintptr_t)config, attribute, value))
 		return EGL_FALSE;
 
 	return EGL_TRUE;
@@ -669,7 +679,7 @@ public:
 EGLAPI EGLSurface EGLAPIENTRY eglCreateWindowSurface(EGLDisplay dpy,
 	EGLConfig config, EGLNativeWindowType win, const EGLint *attrib_list)
 {
-	uint32_t configID = (uint32_t)config;
+	uint32_t configID = (uintptr_t)config;
 
 	if (!fglEGLValidateDisplay(dpy)) {
 		setError(EGL_BAD_DISPLAY);
@@ -713,7 +723,7 @@ EGLAPI EGLSurface EGLAPIENTRY eglCreateWindowSurface(EGLDisplay dpy,
 EGLAPI EGLSurface EGLAPIENTRY eglCreatePbufferSurface(EGLDisplay dpy,
 				EGLConfig config, const EGLint *attrib_list)
 {
-	uint32_t configID = (uint32_t)config;
+	uint32_t configID = (uintptr_t)config;
 
 	if (!fglEGLValidateDisplay(dpy)) {
 		setError(EGL_BAD_DISPLAY);
@@ -960,6 +970,297 @@ EGLAPI EGLBoolean EGLAPIENTRY eglSwapInterval(EGLDisplay dpy, EGLint interval)
 	return EGL_FALSE;
 }
 
+/*
+ * Sync objects
+ */
+
+#ifndef EGL_KHR_wait_sync
+#define EGL_KHR_wait_sync 1
+EGLAPI EGLint EGLAPIENTRY eglWaitSyncKHR(EGLDisplay dpy,
+					EGLSyncKHR sync, EGLint flags);
+#endif
+
+extern void fglFlushDeferredDraws(FGLContext *ctx);
+
+struct FGLSync {
+	EGLDisplay dpy;
+	FGLContext *ctx;
+	uint32_t fence;
+	bool signaled;
+	FGLSync *next;
+};
+
+/* Protects the list and signaling state of sync objects */
+static pthread_mutex_t fglSyncMutex = PTHREAD_MUTEX_INITIALIZER;
+static FGLSync *fglSyncList;
+
+static FGLSync *fglValidateSync(EGLDisplay dpy, EGLSyncKHR sync)
+{
+	FGLSync *s;
+
+	if (!fglEGLValidateDisplay(dpy)) {
+		setError(EGL_BAD_DISPLAY);
+		return 0;
+	}
+
+	for (s = fglSyncList; s; s = s->next)
+		if (s == (FGLSync *)sync && s->dpy == dpy)
+			return s;
+
+	setError(EGL_BAD_PARAMETER);
+	return 0;
+}
+
+/* Completes fences for threads without current context */
+static fimgContext *fglSyncFimg;
+
+/*
+ * Fences are shared by all contexts, so a fence can be completed with
+ * the hardware locked through any context. Threads without current
+ * context use a context of their own, created on first use.
+ * Must be called with fglSyncMutex held.
+ */
+static bool fglSyncSignaled(FGLSync *s, bool wait)
+{
+	FGLContext *ctx = getGlThreadSpecific();
+	fimgContext *fimg;
+
+	if (s->signaled)
+		return true;
+
+	if (ctx) {
+		fimg = ctx->fimg;
+	} else {
+		if (!fglSyncFimg)
+			fglSyncFimg = fimgCreateContext();
+		fimg = fglSyncFimg;
+	}
+
+	if (!fimg) {
+		if (!fimgFenceSignaled(0, s->fence))
+			return false;
+	} else {
+		bool done = true;
+
+		if (wait)
+			fimgWaitFence(fimg, s->fence);
+		else
+			done = fimgPollFence(fimg, s->fence);
+
+		/* Do not keep the hardware leased between polls */
+		fimgEndHardwareLease(fimg);
+
+		if (!done)
+			return false;
+	}
+
+	s->signaled = true;
+	return true;
+}
+
+/* Work of destroyed context has been finished when it was unbound */
+static void fglSignalContextSyncs(FGLContext *ctx)
+{
+	FGLSync *s;
+
+	pthread_mutex_lock(&fglSyncMutex);
+
+	for (s = fglSyncList; s; s = s->next) {
+		if (s->ctx != ctx)
+			continue;
+
+		s->signaled = true;
+		s->ctx = 0;
+	}
+
+	pthread_mutex_unlock(&fglSyncMutex);
+}
+
+EGLAPI EGLSyncKHR EGLAPIENTRY eglCreateSyncKHR(EGLDisplay dpy,
+				EGLenum type, const EGLint *attrib_list)
+{
+	FGLContext *ctx = getGlThreadSpecific();
+	FGLSync *s;
+
+	if (!fglEGLValidateDisplay(dpy)) {
+		setError(EGL_BAD_DISPLAY);
+		return EGL_NO_SYNC_KHR;
+	}
+
+	if (type != EGL_SYNC_FENCE_KHR
+	    || (attrib_list && attrib_list[0] != EGL_NONE)) {
+		setError(EGL_BAD_ATTRIBUTE);
+		return EGL_NO_SYNC_KHR;
+	}
+
+	if (!ctx || ctx->egl.dpy != dpy) {
+		setError(EGL_BAD_MATCH);
+		return EGL_NO_SYNC_KHR;
+	}
+
+	s = new FGLSync;
+	if (!s) {
+		setError(EGL_BAD_ALLOC);
+		return EGL_NO_SYNC_KHR;
+	}
+
+	/* The fence must cover queued draws as well */
+	fglFlushDeferredDraws(ctx);
+
+	s->dpy = dpy;
+	s->ctx = ctx;
+	s->fence = fimgGetFence(ctx->fimg);
+	s->signaled = false;
+
+	/* Other threads may wait for the fence, do not keep them waiting */
+	fimgEndHardwareLease(ctx->fimg);
+
+	pthread_mutex_lock(&fglSyncMutex);
+	s->next = fglSyncList;
+	fglSyncList = s;
+	pthread_mutex_unlock(&fglSyncMutex);
+
+	return (EGLSyncKHR)s;
+}
+
+EGLAPI EGLBoolean EGLAPIENTRY eglDestroySyncKHR(EGLDisplay dpy,
+							EGLSyncKHR sync)
+{
+	FGLSync **p;
+	FGLSync *s;
+
+	pthread_mutex_lock(&fglSyncMutex);
+
+	s = fglValidateSync(dpy, sync);
+	if (!s) {
+		pthread_mutex_unlock(&fglSyncMutex);
+		return EGL_FALSE;
+	}
+
+	for (p = &fglSyncList; *p != s; p = &(*p)->next)
+		continue;
+	*p = s->next;
+
+	pthread_mutex_unlock(&fglSyncMutex);
+
+	delete s;
+
+	return EGL_TRUE;
+}
+
+EGLAPI EGLint EGLAPIENTRY eglClientWaitSyncKHR(EGLDisplay dpy,
+			EGLSyncKHR sync, EGLint flags, EGLTimeKHR timeout)
+{
+	uint64_t waited = 0;
+	FGLSync *s;
+
+	pthread_mutex_lock(&fglSyncMutex);
+
+	s = fglValidateSync(dpy, sync);
+	if (!s) {
+		pthread_mutex_unlock(&fglSyncMutex);
+		return EGL_FALSE;
+	}
+
+	/* Finite timeouts are handled by polling */
+	while (!fglSyncSignaled(s, timeout == EGL_FOREVER_KHR)) {
+		if (waited >= timeout) {
+			pthread_mutex_unlock(&fglSyncMutex);
+			return EGL_TIMEOUT_EXPIRED_KHR;
+		}
+
+		pthread_mutex_unlock(&fglSyncMutex);
+		usleep(1000);
+		waited += 1000000;
+		pthread_mutex_lock(&fglSyncMutex);
+
+		/* Could have been destroyed in the meantime */
+		s = fglValidateSync(dpy, sync);
+		if (!s) {
+			pthread_mutex_unlock(&fglSyncMutex);
+			return EGL_FALSE;
+		}
+	}
+
+	pthread_mutex_unlock(&fglSyncMutex);
+
+	return EGL_CONDITION_SATISFIED_KHR;
+}
+
+EGLAPI EGLBoolean EGLAPIENTRY eglGetSyncAttribKHR(EGLDisplay dpy,
+			EGLSyncKHR sync, EGLint attribute, EGLint *value)
+{
+	EGLBoolean ret = EGL_TRUE;
+	FGLSync *s;
+
+	pthread_mutex_lock(&fglSyncMutex);
+
+	s = fglValidateSync(dpy, sync);
+	if (!s) {
+		pthread_mutex_unlock(&fglSyncMutex);
+		return EGL_FALSE;
+	}
+
+	switch (attribute) {
+	case EGL_SYNC_TYPE_KHR:
+		*value = EGL_SYNC_FENCE_KHR;
+		break;
+	case EGL_SYNC_STATUS_KHR:
+		*value = fglSyncSignaled(s, false) ?
+					EGL_SIGNALED_KHR : EGL_UNSIGNALED_KHR;
+		break;
+	case EGL_SYNC_CONDITION_KHR:
+		*value = EGL_SYNC_PRIOR_COMMANDS_COMPLETE_KHR;
+		break;
+	default:
+		setError(EGL_BAD_ATTRIBUTE);
+		ret = EGL_FALSE;
+	}
+
+	pthread_mutex_unlock(&fglSyncMutex);
+
+	return ret;
+}
+
+EGLAPI EGLint EGLAPIENTRY eglWaitSyncKHR(EGLDisplay dpy,
+					EGLSyncKHR sync, EGLint flags)
+{
+	FGLContext *ctx = getGlThreadSpecific();
+	FGLContext *owner;
+	FGLSync *s;
+
+	pthread_mutex_lock(&fglSyncMutex);
+
+	s = fglValidateSync(dpy, sync);
+	if (!s) {
+		pthread_mutex_unlock(&fglSyncMutex);
+		return EGL_FALSE;
+	}
+	owner = s->ctx;
+
+	pthread_mutex_unlock(&fglSyncMutex);
+
+	if (flags) {
+		setError(EGL_BAD_PARAMETER);
+		return EGL_FALSE;
+	}
+
+	if (!ctx) {
+		setError(EGL_BAD_MATCH);
+		return EGL_FALSE;
+	}
+
+	/*
+	 * The hardware executes work of one context in order, so only fences
+	 * of other contexts need to be waited for, which has to be done
+	 * on the CPU.
+	 */
+	if (owner != ctx)
+		eglClientWaitSyncKHR(dpy, sync, 0, EGL_FOREVER_KHR);
+
+	return EGL_TRUE;
+}
+
 /*
  * Context management
  */
@@ -967,6 +1268,45 @@ EGLAPI EGLBoolean EGLAPIENTRY eglSwapInterval(EGLDisplay dpy, EGLint interval)
 extern FGLContext *fglCreateContext(void);
 extern void fglDestroyContext(FGLContext *ctx);
 
+/*
+ * Setting debug.fimg.lease property (or FGL_LEASE environment variable)
+ * overrides the time slice (in microseconds) for which a context may keep
+ * the hardware between the end of a draw and the end of the frame.
+ */
+static unsigned int fglLeaseSlice(void)
+{
+	const char *slice = getenv("FGL_LEASE");
+#ifdef FGL_PLATFORM_ANDROID
+	char prop[PROPERTY_VALUE_MAX];
+
+	if (!slice && property_get("debug.fimg.lease", prop, NULL) > 0)
+		slice = prop;
+#endif
+	if (!slice)
+		return FGL_HW_LEASE_SLICE;
+
+	return strtoul(slice, NULL, 0);
+}
+
+/*
+ * Setting debug.fimg.stats property (or FGL_STATS environment variable)
+ * to N makes hardware statistics of the context logged every N frames.
+ */
+static unsigned int fglStatsInterval(void)
+{
+	const char *interval = getenv("FGL_STATS");
+#ifdef FGL_PLATFORM_ANDROID
+	char prop[PROPERTY_VALUE_MAX];
+
+	if (!interval && property_get("debug.fimg.stats", prop, NULL) > 0)
+		interval = prop;
+#endif
+	if (!interval)
+		return 0;
+
+	return strtoul(interval, NULL, 0);
+}
+
 EGLAPI EGLContext EGLAPIENTRY eglCreateContext(EGLDisplay dpy,
 				EGLConfig config, EGLContext share_context,
 				const EGLint *attrib_list)
@@ -985,6 +1325,9 @@ EGLAPI EGLContext EGLAPIENTRY eglCreateContext(EGLDisplay dpy,
 	gl->egl.flags	= FGL_NEVER_CURRENT;
 	gl->egl.dpy	= dpy;
 	gl->egl.config	= config;
+	gl->egl.statsInterval = fglStatsInterval();
+
+	fimgSetHardwareLease(gl->fimg, fglLeaseSlice());
 
 	return (EGLContext)gl;
 }
@@ -1010,6 +1353,7 @@ EGLAPI EGLBoolean EGLAPIENTRY eglDestroyContext(EGLDisplay dpy, EGLContext ctx)
 		return EGL_TRUE;
 	}
 
+	fglSignalContextSyncs(c);
 	fglDestroyContext(c);
 	return EGL_TRUE;
 }
@@ -1033,8 +1377,10 @@ static void fglUnbindContext(FGLContext *c)
 		delete d;
 
 	/* Delete the context if it's terminated */
-	if (c->egl.flags & FGL_TERMINATE)
+	if (c->egl.flags & FGL_TERMINATE) {
+		fglSignalContextSyncs(c);
 		fglDestroyContext(c);
+	}
 }
 
 static EGLBoolean fglMakeCurrent(FGLContext *gl, FGLRenderSurface *d)
@@ -1196,7 +1542,7 @@ EGLAPI EGLBoolean EGLAPIENTRY eglQueryContext(EGLDisplay dpy, EGLContext ctx,
 		 * Returns the ID of the EGL frame buffer configuration with
 		 * respect to which the context was created.
 		 */
-		*value = (EGLint)c->egl.config;
+		*value = (EGLint)(uintptr_t)c->egl.config;
 		break;
 	default:
 		setError(EGL_BAD_ATTRIBUTE);
@@ -1222,6 +1568,23 @@ EGLAPI EGLBoolean EGLAPIENTRY eglWaitNative(EGLint engine)
 	return EGL_TRUE;
 }
 
+static void fglDumpStats(FGLContext *ctx)
+{
+	char prefix[32];
+
+	if (!ctx->egl.statsInterval)
+		return;
+
+	if (++ctx->egl.statsFrames < ctx->egl.statsInterval)
+		return;
+
+	snprintf(prefix, sizeof(prefix), "stats %p/%u", ctx,
+						ctx->egl.statsFrames);
+	fimgDumpStats(ctx->fimg, prefix);
+	fimgResetStats(ctx->fimg);
+	ctx->egl.statsFrames = 0;
+}
+
 EGLAPI EGLBoolean EGLAPIENTRY eglSwapBuffers(EGLDisplay dpy, EGLSurface surface)
 {
 	if (!fglEGLValidateDisplay(dpy)) {
@@ -1238,8 +1601,18 @@ EGLAPI EGLBoolean EGLAPIENTRY eglSwapBuffers(EGLDisplay dpy, EGLSurface surface)
 
 	/* Flush the context attached to the surface if it's current */
 	FGLContext *ctx = getGlThreadSpecific();
-	if ((FGLContext *)d->ctx == ctx)
-		glFinish();
+	if ((FGLContext *)d->ctx == ctx) {
+		/* Wait only for the work still using the color buffer */
+		fglFlushDeferredDraws(ctx);
+		if (d->getColorSurface())
+			d->getColorSurface()->waitFence(ctx->fimg);
+		fimgEndHardwareLease(ctx->fimg);
+		fglDumpStats(ctx);
+	}
+
+#ifdef FGL_TRACE
+	fglTraceSwapBuffers();
+#endif
 
 	/* post the surface */
 	if (!d->swapBuffers())
@@ -1297,6 +1670,20 @@ static const FGLExtensionMap gExtensionMap[] = {
 		(EGLFunc)&glGenBuffers },
 	{ "glEGLImageTargetTexture2DOES",
 		(EGLFunc)&glEGLImageTargetTexture2DOES },
+	{ "eglCreateSyncKHR",
+		(EGLFunc)&eglCreateSyncKHR },
+	{ "eglDestroySyncKHR",
+		(EGLFunc)&eglDestroySyncKHR },
+	{ "eglClientWaitSyncKHR",
+		(EGLFunc)&eglClientWaitSyncKHR },
+	{ "eglGetSyncAttribKHR",
+		(EGLFunc)&eglGetSyncAttribKHR },
+	{ "eglWaitSyncKHR",
+		(EGLFunc)&eglWaitSyncKHR },
+#ifdef FGL_TRACE
+	{ "glTraceImageTargetTexture2DFIMG",
+		(EGLFunc)&glTraceImageTargetTexture2DFIMG },
+#endif
 	{ NULL, NULL }
 };
 
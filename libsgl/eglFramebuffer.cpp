@@ -210,10 +210,20 @@ const int gPlatformConfigsNum = NELEM(gPlatformConfigs);
 
 class FGLFramebufferSurface : public FGLSurface {
 public:
+#ifdef FIMG_SOFTWARE_BACKEND
+	FGLFramebufferSurface(unsigned long paddr,
+					void *vaddr, unsigned long length) :
+		FGLSurface(fimgSoftMap(vaddr, length), vaddr, length) {}
+	virtual ~FGLFramebufferSurface()
+	{
+		fimgSoftUnmap(vaddr);
+	}
+#else
 	FGLFramebufferSurface(unsigned long paddr,
 					void *vaddr, unsigned long length) :
 		FGLSurface(paddr, vaddr, length) {}
 	virtual ~FGLFramebufferSurface() {}
+#endif
 
 	virtual void flush(void) {}
 
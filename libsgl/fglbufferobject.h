@@ -23,8 +23,11 @@
 #define _LIBSGL_FGLBUFFEROBJECT_
 
 #include <cstdlib>
+#include <cstring>
 #include <GLES/gl.h>
+#include "common.h"
 #include "fglobject.h"
+#include "libfimg/fimg.h"
 
 struct FGLBuffer;
 
@@ -51,27 +54,105 @@ public:
 	}
 };
 
+struct FGLOptimizedIndices {
+	const GLvoid *offset;
+	GLsizei count;
+	GLenum type;
+	void *data;
+};
+
 struct FGLBuffer {
 	void *memory;
 	int size;
 	GLenum usage;
 	unsigned int name;
 	FGLObject<FGLBuffer, FGLBufferObjectBinding> object;
+	fimgVertexCache *vertexCache;
+	FGLOptimizedIndices optimized[FGL_OPTIMIZED_INDEX_RANGES];
+	unsigned int nextOptimized;
 
 	FGLBuffer(unsigned int name) :
 		memory(0),
 		size(0),
 		usage(GL_STATIC_DRAW),
 		name(name),
-		object(this) {};
+		object(this),
+		vertexCache(0),
+		nextOptimized(0)
+	{
+		memset(optimized, 0, sizeof(optimized));
+	}
 
 	~FGLBuffer()
 	{
 		destroy();
+		fimgDestroyVertexCache(vertexCache);
+	}
+
+	inline void invalidate(void)
+	{
+		fimgInvalidateVertexCache(vertexCache);
+
+		for (int i = 0; i < FGL_OPTIMIZED_INDEX_RANGES; ++i) {
+			free(optimized[i].data);
+			optimized[i].data = 0;
+		}
+	}
+
+	/*
+	 * Returns a copy of given triangle list reordered for better vertex
+	 * reuse, optimizing it on first use. Falls back to original indices
+	 * if the copy could not be created.
+	 */
+	const GLvoid *getOptimizedIndices(const GLvoid *offset,
+						GLsizei count, GLenum type)
+	{
+		const GLvoid *indices = getAddress(offset);
+		FGLOptimizedIndices *o;
+		size_t len;
+
+		for (int i = 0; i < FGL_OPTIMIZED_INDEX_RANGES; ++i) {
+			o = &optimized[i];
+			if (o->data && o->offset == offset
+			    && o->count == count && o->type == type)
+				return o->data;
+		}
+
+		len = (type == GL_UNSIGNED_BYTE) ? count : 2*count;
+		if ((uintptr_t)offset + len > (size_t)size)
+			return indices;
+
+		o = &optimized[nextOptimized];
+		nextOptimized = (nextOptimized + 1) % FGL_OPTIMIZED_INDEX_RANGES;
+
+		free(o->data);
+		o->data = malloc(len);
+		if (!o->data)
+			return indices;
+
+		memcpy(o->data, indices, len);
+		if (type == GL_UNSIGNED_BYTE)
+			fimgOptimizeTrianglesUByteIdx((uint8_t *)o->data, count);
+		else
+			fimgOptimizeTrianglesUShortIdx((uint16_t *)o->data, count);
+
+		o->offset = offset;
+		o->count = count;
+		o->type = type;
+		return o->data;
+	}
+
+	inline fimgVertexCache *getVertexCache(void)
+	{
+		if (!vertexCache)
+			vertexCache = fimgCreateVertexCache();
+		return vertexCache;
 	}
 
 	int create(int s)
 	{
+		invalidate();
+
 		if (size == s)
 			return 0;
 
@@ -96,6 +177,7 @@ struct FGLBuffer {
 		if (unlikely(!isValid()))
 			return;
 
+		invalidate();
 		free(memory);
 		memory = 0;
 		size = 0;
@@ -106,10 +188,10 @@ struct FGLBuffer {
 		if (unlikely(!isValid()))
 			return 0;
 
-		if (unlikely((int)offset >= size))
+		if (unlikely((uintptr_t)offset >= (size_t)size))
 			return 0;
 
-		return (const GLvoid *)((uint8_t *)memory + (int)offset);
+		return (const GLvoid *)((uint8_t *)memory + (uintptr_t)offset);
 	}
 
 	inline const GLvoid *getOffset(const GLvoid *address)
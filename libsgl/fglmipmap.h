@@ -0,0 +1,194 @@
+/*
+ * libsgl/fglmipmap.h
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2013 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FGLMIPMAP_H_
+#define _FGLMIPMAP_H_
+
+#include <stdint.h>
+
+/*
+ * Box filters used to generate mipmaps by the CPU. There is no NEON on
+ * ARM11, so they average several color components at once, in fields of
+ * a 32-bit word wide enough to hold a sum of four of them. Texels of
+ * 16-bit formats in the same row are loaded in pairs.
+ */
+
+struct FGLAverageRGB565 {
+	/* Averages RGB565 texels given as pairs from two rows */
+	static inline uint32_t average(uint32_t row0, uint32_t row1)
+	{
+		const uint32_t mask = 0x07e0f81f;
+		uint32_t sum;
+
+		/* R and B of first texel with G of second and vice versa */
+		sum = (row0 & mask) + (((row0 >> 16) | (row0 << 16)) & mask)
+			+ (row1 & mask) + (((row1 >> 16) | (row1 << 16)) & mask);
+		sum = ((sum + 0x00401002) >> 2) & mask;
+
+		return (sum | (sum >> 16)) & 0xffff;
+	}
+};
+
+struct FGLAverageRGBA5551 {
+	/* Averages RGBA5551 texels given as pairs from two rows */
+	static inline uint32_t average(uint32_t row0, uint32_t row1)
+	{
+		const uint32_t mask = 0x07c0f83e;
+		uint32_t sum, alpha;
+
+		sum = (row0 & mask) + (((row0 >> 16) | (row0 << 16)) & mask)
+			+ (row1 & mask) + (((row1 >> 16) | (row1 << 16)) & mask);
+		sum = ((sum + 0x00801004) >> 2) & mask;
+
+		alpha = (row0 & 0x00010001) + (row1 & 0x00010001);
+		alpha = (((alpha + (alpha >> 16)) & 0x7) + 2) >> 2;
+
+		return ((sum | (sum >> 16)) & 0xfffe) | alpha;
+	}
+};
+
+struct FGLAverageRGBA4444 {
+	/* Averages RGBA4444 texels given as pairs from two rows */
+	static inline uint32_t average(uint32_t row0, uint32_t row1)
+	{
+		uint32_t ga, rb;
+
+		ga = (row0 & 0x0f0f0f0f) + (row1 & 0x0f0f0f0f);
+		rb = ((row0 >> 4) & 0x0f0f0f0f) + ((row1 >> 4) & 0x0f0f0f0f);
+		ga = ((ga + (ga >> 16) + 0x0202) >> 2) & 0x0f0f;
+		rb = ((rb + (rb >> 16) + 0x0202) >> 2) & 0x0f0f;
+
+		return ga | (rb << 4);
+	}
+};
+
+struct FGLAverageAL88 {
+	/* Averages AL88 texels given as pairs from two rows */
+	static inline uint32_t average(uint32_t row0, uint32_t row1)
+	{
+		uint32_t l, a;
+
+		l = (row0 & 0x00ff00ff) + (row1 & 0x00ff00ff);
+		a = ((row0 >> 8) & 0x00ff00ff) + ((row1 >> 8) & 0x00ff00ff);
+		l = ((l + (l >> 16) + 2) >> 2) & 0xff;
+		a = ((a + (a >> 16) + 2) >> 2) & 0xff;
+
+		return l | (a << 8);
+	}
+};
+
+/* Averages 8888 texels, in any order of components */
+static inline uint32_t fglAverage8888(uint32_t p00, uint32_t p01,
+						uint32_t p10, uint32_t p11)
+{
+	const uint32_t mask = 0x00ff00ff;
+	uint32_t rb, ga;
+
+	rb = (p00 & mask) + (p01 & mask) + (p10 & mask) + (p11 & mask);
+	ga = ((p00 >> 8) & mask) + ((p01 >> 8) & mask)
+		+ ((p10 >> 8) & mask) + ((p11 >> 8) & mask);
+	rb = ((rb + 0x00020002) >> 2) & mask;
+	ga = ((ga + 0x00020002) << 6) & ~mask;
+
+	return rb | ga;
+}
+
+/*
+ * Box filters level of 16-bit texels into next level. Dimensions of one
+ * texel are not halved, so such rows and columns are sampled twice.
+ */
+template<typename T>
+static void fglDownsample16(const uint16_t *src, uint16_t *dst,
+					unsigned width, unsigned height)
+{
+	unsigned dstW = (width >> 1) ? : 1;
+	unsigned dstH = (height >> 1) ? : 1;
+	unsigned dx = (width > 1);
+	unsigned dy = (height > 1) ? width : 0;
+
+	/* Whole pairs can be loaded at once if aligned */
+	bool aligned = dx && !(width & 1) && !((uintptr_t)src & 3);
+
+	for (unsigned y = 0; y < dstH; ++y) {
+		const uint16_t *row0 = src + 2 * y * width;
+		const uint16_t *row1 = row0 + dy;
+
+		if (aligned) {
+			const uint32_t *pair0 = (const uint32_t *)row0;
+			const uint32_t *pair1 = (const uint32_t *)row1;
+
+			for (unsigned x = 0; x < dstW; ++x)
+				*(dst++) = T::average(pair0[x], pair1[x]);
+			continue;
+		}
+
+		for (unsigned x = 0; x < dstW; ++x) {
+			*(dst++) = T::average(row0[0] | (row0[dx] << 16),
+					row1[0] | (row1[dx] << 16));
+			row0 += 2;
+			row1 += 2;
+		}
+	}
+}
+
+static void fglDownsample8888(const uint32_t *src, uint32_t *dst,
+					unsigned width, unsigned height)
+{
+	unsigned dstW = (width >> 1) ? : 1;
+	unsigned dstH = (height >> 1) ? : 1;
+	unsigned dx = (width > 1);
+	unsigned dy = (height > 1) ? width : 0;
+
+	for (unsigned y = 0; y < dstH; ++y) {
+		const uint32_t *row0 = src + 2 * y * width;
+		const uint32_t *row1 = row0 + dy;
+
+		for (unsigned x = 0; x < dstW; ++x) {
+			*(dst++) = fglAverage8888(row0[0], row0[dx],
+							row1[0], row1[dx]);
+			row0 += 2;
+			row1 += 2;
+		}
+	}
+}
+
+static void fglDownsample8(const uint8_t *src, uint8_t *dst,
+					unsigned width, unsigned height)
+{
+	unsigned dstW = (width >> 1) ? : 1;
+	unsigned dstH = (height >> 1) ? : 1;
+	unsigned dx = (width > 1);
+	unsigned dy = (height > 1) ? width : 0;
+
+	for (unsigned y = 0; y < dstH; ++y) {
+		const uint8_t *row0 = src + 2 * y * width;
+		const uint8_t *row1 = row0 + dy;
+
+		for (unsigned x = 0; x < dstW; ++x) {
+			*(dst++) = (row0[0] + row0[dx]
+					+ row1[0] + row1[dx] + 2) >> 2;
+			row0 += 2;
+			row1 += 2;
+		}
+	}
+}
+
+#endif /* _FGLMIPMAP_H_ */
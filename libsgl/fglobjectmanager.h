@@ -63,7 +63,7 @@ public:
 		write = size;
 
 		for(unsigned i = 0; i < size; i++) {
-			pool[i] = (T *)i;
+			pool[i] = (T *)(uintptr_t)i;
 			owners[i] = 0;
 			unused[i] = i + 1;
 		}
@@ -116,11 +116,11 @@ public:
 			return -1;
 		}
 
-		unsigned pos = (unsigned)pool[name - 1];
+		unsigned pos = (unsigned)(uintptr_t)pool[name - 1];
 
 		--write;
 		unused[pos] = unused[write];
-		pool[unused[write] - 1] = (T *)pos;
+		pool[unused[write] - 1] = (T *)(uintptr_t)pos;
 		pool[name - 1] = NULL;
 		owners[name - 1] = owner;
 
@@ -134,7 +134,7 @@ public:
 		pthread_mutex_lock(&mutex);
 
 		owners[name - 1] = 0;
-		pool[name - 1] = (T *)write;
+		pool[name - 1] = (T *)(uintptr_t)write;
 		unused[write] = name;
 		++write;
 
@@ -151,7 +151,7 @@ public:
 			if (pool[i])
 				delete pool[i];
 			owners[i] = 0;
-			pool[i] = (T *)write;
+			pool[i] = (T *)(uintptr_t)write;
 			unused[write] = i + 1;
 			++write;
 		}
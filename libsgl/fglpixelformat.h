@@ -26,6 +26,11 @@
 #include <GLES/gl.h>
 #include <GLES/glext.h>
 
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT3_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT	0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT	0x83F3
+#endif
+
 enum {
 	FGL_COMP_RED = 0,
 	FGL_COMP_GREEN,
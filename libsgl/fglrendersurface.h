@@ -128,6 +128,7 @@ public:
 	uint32_t getColorFormat() const { return colorFormat; }
 	uint32_t getWidth() const { return width; }
 	uint32_t getHeight() const { return height; }
+	FGLSurface *getColorSurface() const { return color; }
 };
 
 #endif /* _FGLRENDERSURFACE_H_ */
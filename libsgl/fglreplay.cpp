@@ -0,0 +1,936 @@
+/*
+ * libsgl/fglreplay.cpp
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2013 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * GL call trace replay
+ *
+ * Feeds a trace recorded by fgltrace.cpp back into the GL implementation,
+ * rendering into pbuffer surfaces of recorded sizes, and reports time spent
+ * in every GL function and in every frame (from one eglSwapBuffers() to the
+ * next one).
+ *
+ * Contents of every frame can be saved and compared with frames saved by
+ * another run, e.g. on real hardware and with software backend, to find
+ * rendering differences together with changes of frame times.
+ *
+ * Usage: fglreplay [-n loops] [-f] [-s] [-o frames] [-c frames [-t tol]]
+ *							<trace file>
+ *	-n	replay the trace given number of times
+ *	-f	print time of every frame
+ *	-s	call glFinish() after every call, so that time of hardware
+ *		processing is accounted to the call which caused it
+ *	-o	save contents of every frame to given file
+ *	-c	compare contents of every frame with given file saved by -o
+ *	-t	maximum difference of color components not reported by -c
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES/gl.h>
+#include <GLES/glext.h>
+
+/* Calls must go through the exported entry points */
+#define FGL_TRACE_NO_RENAME
+#include "fgltrace.h"
+
+#define FGL_REPLAY_MAX_CONTEXTS		16
+/* Matches FGL_ARRAY_* in state.h */
+#define FGL_REPLAY_NUM_ARRAYS		6
+#define FGL_REPLAY_ARRAY_TEXTURE	4
+
+#define FGL_REPLAY_FRAMES_MAGIC		0x46524746	/* FGRF */
+
+/* Frames file consists of frames, each preceded by this header */
+struct FGLReplayFrameHeader {
+	uint32_t magic;
+	uint32_t width;
+	uint32_t height;
+	uint32_t reserved;
+};
+
+struct FGLReplayRecord {
+	const FGLTraceRecordHeader *header;
+	const uint32_t *arg;
+	const uint8_t *data;
+};
+
+struct FGLReplayContext {
+	uint64_t handle;
+	EGLContext context;
+	EGLSurface surface;
+	uint32_t width;
+	uint32_t height;
+	/* Client state needed to restore client array pointers */
+	const FGLTraceRecordHeader *pointer[FGL_REPLAY_NUM_ARRAYS];
+	GLuint arrayBuffer;
+	GLenum clientActiveTexture;
+};
+
+struct FGLReplayStats {
+	unsigned id;
+	uint64_t count;
+	uint64_t total;
+	uint64_t max;
+};
+
+struct FGLReplay {
+	EGLDisplay dpy;
+	FGLReplayContext contexts[FGL_REPLAY_MAX_CONTEXTS];
+	unsigned numContexts;
+	FGLReplayContext *current;
+	PFNGLTRACEIMAGETARGETTEXTURE2DFIMGPROC imageTarget;
+
+	bool sync;
+	bool printFrames;
+
+	uint8_t *scratch;
+	size_t scratchSize;
+
+	FILE *output;
+	FILE *reference;
+	unsigned tolerance;
+	uint8_t *pixels;
+	uint8_t *refPixels;
+	size_t pixelsSize;
+	unsigned badFrames;
+
+	FGLReplayStats calls[FGL_TRACE_ID_COUNT];
+	uint64_t *frames;
+	unsigned numFrames;
+	unsigned maxFrames;
+	uint64_t frameStart;
+	uint64_t captureFirst;
+	uint64_t captureLast;
+	unsigned captureFrames;
+	unsigned fixups;
+	unsigned skipped;
+};
+
+static FGLReplay replay;
+
+static inline uint64_t fglReplayTime(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Argument decoding
+ */
+
+template<typename T>
+static inline T fglReplayGetVal(FGLReplayRecord &rec)
+{
+	return (T)*(rec.arg++);
+}
+
+template<>
+inline GLfloat fglReplayGetVal<GLfloat>(FGLReplayRecord &rec)
+{
+	GLfloat val;
+
+	memcpy(&val, rec.arg++, sizeof(val));
+	return val;
+}
+
+template<typename T>
+static inline T fglReplayGetLong(FGLReplayRecord &rec)
+{
+	uint64_t val;
+
+	memcpy(&val, rec.arg, sizeof(val));
+	rec.arg += 2;
+	return (T)val;
+}
+
+template<typename T>
+static inline T fglReplayGetPtr(FGLReplayRecord &rec)
+{
+	return (T)(uintptr_t)fglReplayGetLong<uint64_t>(rec);
+}
+
+template<typename T>
+static inline T fglReplayGetData(FGLReplayRecord &rec)
+{
+	uint32_t size = *(rec.arg++);
+
+	if (size == FGL_TRACE_DATA_BY_VALUE)
+		return fglReplayGetPtr<T>(rec);
+
+	const uint8_t *data = rec.data;
+	rec.data += (size + 3) & ~3;
+	return (T)data;
+}
+
+template<typename T>
+static inline T fglReplayGetOut(FGLReplayRecord &rec)
+{
+	uint32_t size = *(rec.arg++);
+
+	if (size < FGL_TRACE_GET_SIZE)
+		size = FGL_TRACE_GET_SIZE;
+
+	if (size > replay.scratchSize) {
+		free(replay.scratch);
+		replay.scratch = (uint8_t *)malloc(size);
+		if (!replay.scratch) {
+			fprintf(stderr, "Out of memory.\n");
+			exit(ENOMEM);
+		}
+		replay.scratchSize = size;
+	}
+
+	return (T)(void *)replay.scratch;
+}
+
+static void fglReplayInitRecord(FGLReplayRecord &rec,
+					const FGLTraceRecordHeader *header)
+{
+	rec.header = header;
+	rec.arg = (const uint32_t *)(header + 1);
+	rec.data = (const uint8_t *)rec.arg + header->argSize;
+}
+
+/*
+ * Call dispatch
+ */
+
+#define FGL_TRACE_ARG(kind, type, name, size) \
+	type name = fglReplayGet ## kind<type>(rec);
+
+#define FGL_TRACE_FUNC(ret, name, decl, names, args) \
+	case FGL_TRACE_ID_ ## name: { \
+		args \
+		start = fglReplayTime(); \
+		name names; \
+		break; \
+	}
+
+#define FGL_TRACE_DRAW_FUNC	FGL_TRACE_FUNC
+
+/* Returns time spent in the call in nanoseconds */
+static uint64_t fglReplayCall(FGLReplayRecord &rec)
+{
+	uint64_t start;
+
+	switch (rec.header->id) {
+#include "fgltracecalls.h"
+	default:
+		++replay.skipped;
+		return 0;
+	}
+
+	if (replay.sync)
+		glFinish();
+
+	return fglReplayTime() - start;
+}
+
+#undef FGL_TRACE_FUNC
+#undef FGL_TRACE_ARG
+
+#define FGL_TRACE_ARG(kind, type, name, size)
+#define FGL_TRACE_FUNC(ret, name, decl, names, args) \
+	case FGL_TRACE_ID_ ## name: \
+		return #name;
+
+static const char *fglReplayName(unsigned id)
+{
+	switch (id) {
+	case FGL_TRACE_ID_MAKE_CURRENT:
+		return "eglMakeCurrent";
+	case FGL_TRACE_ID_SWAP_BUFFERS:
+		return "eglSwapBuffers";
+	case FGL_TRACE_ID_EGL_IMAGE:
+		return "glEGLImageTargetTexture2DOES";
+#include "fgltracecalls.h"
+	default:
+		return "?";
+	}
+}
+
+#undef FGL_TRACE_FUNC
+#undef FGL_TRACE_DRAW_FUNC
+#undef FGL_TRACE_ARG
+
+/*
+ * Special records
+ */
+
+static EGLConfig fglReplayChooseConfig(EGLint id)
+{
+	EGLint fallback[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RED_SIZE, 5,
+		EGL_GREEN_SIZE, 6,
+		EGL_BLUE_SIZE, 5,
+		EGL_DEPTH_SIZE, 16,
+		EGL_NONE
+	};
+	EGLConfig configs[64];
+	EGLConfig config;
+	EGLint num, type, val;
+
+	/* Configs are looked up directly, to get exactly the recorded one */
+	if (!eglGetConfigs(replay.dpy, configs, 64, &num))
+		num = 0;
+
+	for (EGLint i = 0; i < num; ++i) {
+		if (eglGetConfigAttrib(replay.dpy, configs[i],
+						EGL_CONFIG_ID, &val)
+		    && val == id
+		    && eglGetConfigAttrib(replay.dpy, configs[i],
+						EGL_SURFACE_TYPE, &type)
+		    && (type & EGL_PBUFFER_BIT))
+			return configs[i];
+	}
+
+	fprintf(stderr, "Config %d not usable, using fallback.\n", id);
+
+	if (eglChooseConfig(replay.dpy, fallback, &config, 1, &num) && num)
+		return config;
+
+	fprintf(stderr, "No usable EGL config.\n");
+	exit(EINVAL);
+}
+
+static void fglReplayMakeCurrent(FGLReplayRecord &rec)
+{
+	uint64_t handle = fglReplayGetLong<uint64_t>(rec);
+	EGLint configId = fglReplayGetVal<EGLint>(rec);
+	uint32_t width = fglReplayGetVal<uint32_t>(rec);
+	uint32_t height = fglReplayGetVal<uint32_t>(rec);
+	FGLReplayContext *c = 0;
+	EGLConfig config;
+
+	if (!handle || !width || !height) {
+		eglMakeCurrent(replay.dpy, EGL_NO_SURFACE,
+					EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		replay.current = 0;
+		return;
+	}
+
+	for (unsigned i = 0; i < replay.numContexts; ++i) {
+		if (replay.contexts[i].handle == handle) {
+			c = &replay.contexts[i];
+			break;
+		}
+	}
+
+	config = fglReplayChooseConfig(configId);
+
+	if (!c) {
+		if (replay.numContexts == FGL_REPLAY_MAX_CONTEXTS) {
+			fprintf(stderr, "Too many contexts in trace.\n");
+			exit(EINVAL);
+		}
+
+		c = &replay.contexts[replay.numContexts++];
+		memset(c, 0, sizeof(*c));
+		c->handle = handle;
+		c->clientActiveTexture = GL_TEXTURE0;
+		c->context = eglCreateContext(replay.dpy, config,
+							EGL_NO_CONTEXT, NULL);
+		if (c->context == EGL_NO_CONTEXT) {
+			fprintf(stderr, "Failed to create context (%#x).\n",
+								eglGetError());
+			exit(EINVAL);
+		}
+	}
+
+	if (c->width != width || c->height != height) {
+		EGLint attribs[] = {
+			EGL_WIDTH, (EGLint)width,
+			EGL_HEIGHT, (EGLint)height,
+			EGL_NONE
+		};
+
+		if (replay.current == c)
+			eglMakeCurrent(replay.dpy, EGL_NO_SURFACE,
+					EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (c->surface != EGL_NO_SURFACE)
+			eglDestroySurface(replay.dpy, c->surface);
+
+		c->surface = eglCreatePbufferSurface(replay.dpy,
+							config, attribs);
+		if (c->surface == EGL_NO_SURFACE) {
+			fprintf(stderr, "Failed to create %ux%u surface (%#x).\n",
+					width, height, eglGetError());
+			exit(EINVAL);
+		}
+
+		c->width = width;
+		c->height = height;
+		replay.current = 0;
+	}
+
+	if (replay.current != c) {
+		eglMakeCurrent(replay.dpy, c->surface, c->surface, c->context);
+		replay.current = c;
+	}
+}
+
+/*
+ * Frame contents
+ */
+
+static void fglReplayComparePixels(uint32_t width, uint32_t height)
+{
+	FGLReplayFrameHeader header;
+	size_t size = 4 * width * height;
+	unsigned bad = 0, maxDiff = 0;
+
+	if (fread(&header, sizeof(header), 1, replay.reference) != 1
+	    || header.magic != FGL_REPLAY_FRAMES_MAGIC) {
+		fprintf(stderr, "frame %u: missing in reference.\n",
+							replay.numFrames + 1);
+		++replay.badFrames;
+		fclose(replay.reference);
+		replay.reference = 0;
+		return;
+	}
+
+	if (header.width != width || header.height != height) {
+		printf("frame %u: size %ux%u, reference %ux%u\n",
+			replay.numFrames + 1, width, height,
+			header.width, header.height);
+		++replay.badFrames;
+		fseek(replay.reference,
+			4L * header.width * header.height, SEEK_CUR);
+		return;
+	}
+
+	if (fread(replay.refPixels, size, 1, replay.reference) != 1) {
+		fprintf(stderr, "frame %u: truncated reference.\n",
+							replay.numFrames + 1);
+		++replay.badFrames;
+		fclose(replay.reference);
+		replay.reference = 0;
+		return;
+	}
+
+	for (size_t i = 0; i < size; i += 4) {
+		unsigned diff = 0;
+
+		for (unsigned c = 0; c < 4; ++c) {
+			unsigned d = abs(replay.pixels[i + c]
+						- replay.refPixels[i + c]);
+			if (d > diff)
+				diff = d;
+		}
+
+		if (diff > maxDiff)
+			maxDiff = diff;
+		if (diff > replay.tolerance)
+			++bad;
+	}
+
+	if (bad) {
+		printf("frame %u: %u of %u pixels differ, max difference %u\n",
+			replay.numFrames + 1, bad, width * height, maxDiff);
+		++replay.badFrames;
+	}
+}
+
+/* Saves or compares contents of current surface */
+static void fglReplayCheckFrame(void)
+{
+	FGLReplayContext *c = replay.current;
+	size_t size;
+
+	if (!c)
+		return;
+
+	size = 4 * c->width * c->height;
+	if (size > replay.pixelsSize) {
+		free(replay.pixels);
+		free(replay.refPixels);
+		replay.pixels = (uint8_t *)malloc(size);
+		replay.refPixels = (uint8_t *)malloc(size);
+		if (!replay.pixels || !replay.refPixels) {
+			fprintf(stderr, "Out of memory.\n");
+			exit(ENOMEM);
+		}
+		replay.pixelsSize = size;
+	}
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, c->width, c->height, GL_RGBA,
+					GL_UNSIGNED_BYTE, replay.pixels);
+
+	if (replay.output) {
+		FGLReplayFrameHeader header;
+
+		header.magic = FGL_REPLAY_FRAMES_MAGIC;
+		header.width = c->width;
+		header.height = c->height;
+		header.reserved = 0;
+
+		if (fwrite(&header, sizeof(header), 1, replay.output) != 1
+		    || fwrite(replay.pixels, size, 1, replay.output) != 1) {
+			fprintf(stderr, "Failed to write frame (%s).\n",
+							strerror(errno));
+			exit(errno);
+		}
+	}
+
+	if (replay.reference)
+		fglReplayComparePixels(c->width, c->height);
+}
+
+static void fglReplaySwapBuffers(FGLReplayRecord &rec)
+{
+	uint64_t timestamp = fglReplayGetLong<uint64_t>(rec);
+	uint64_t now;
+
+	if (!replay.captureFrames++)
+		replay.captureFirst = timestamp;
+	replay.captureLast = timestamp;
+
+	if (replay.output || replay.reference)
+		fglReplayCheckFrame();
+
+	if (replay.current)
+		eglSwapBuffers(replay.dpy, replay.current->surface);
+
+	now = fglReplayTime();
+
+	if (replay.numFrames == replay.maxFrames) {
+		replay.maxFrames = replay.maxFrames ? 2 * replay.maxFrames : 256;
+		replay.frames = (uint64_t *)realloc(replay.frames,
+				replay.maxFrames * sizeof(*replay.frames));
+		if (!replay.frames) {
+			fprintf(stderr, "Out of memory.\n");
+			exit(ENOMEM);
+		}
+	}
+
+	replay.frames[replay.numFrames++] = now - replay.frameStart;
+	if (replay.printFrames)
+		printf("frame %u: %.3f ms\n", replay.numFrames,
+					(now - replay.frameStart) / 1e6);
+
+	replay.frameStart = now;
+}
+
+/* Points the array at data stored in the trace, keeping other state intact */
+static void fglReplayClientArray(FGLReplayRecord &rec)
+{
+	FGLReplayContext *c = replay.current;
+	uint32_t index = fglReplayGetVal<uint32_t>(rec);
+	uint32_t start = fglReplayGetVal<uint32_t>(rec);
+	const uint8_t *data = fglReplayGetData<const uint8_t *>(rec);
+	FGLReplayRecord ptr;
+
+	if (!c || index >= FGL_REPLAY_NUM_ARRAYS || !c->pointer[index]) {
+		++replay.skipped;
+		return;
+	}
+
+	fglReplayInitRecord(ptr, c->pointer[index]);
+	data -= start;
+
+	if (c->arrayBuffer)
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	switch (ptr.header->id) {
+	case FGL_TRACE_ID_glVertexPointer:
+	case FGL_TRACE_ID_glColorPointer:
+	case FGL_TRACE_ID_glTexCoordPointer: {
+		GLint size = fglReplayGetVal<GLint>(ptr);
+		GLenum type = fglReplayGetVal<GLenum>(ptr);
+		GLsizei stride = fglReplayGetVal<GLsizei>(ptr);
+
+		if (ptr.header->id == FGL_TRACE_ID_glVertexPointer) {
+			glVertexPointer(size, type, stride, data);
+		} else if (ptr.header->id == FGL_TRACE_ID_glColorPointer) {
+			glColorPointer(size, type, stride, data);
+		} else {
+			GLenum unit = GL_TEXTURE0 + index
+						- FGL_REPLAY_ARRAY_TEXTURE;
+
+			if (unit != c->clientActiveTexture)
+				glClientActiveTexture(unit);
+			glTexCoordPointer(size, type, stride, data);
+			if (unit != c->clientActiveTexture)
+				glClientActiveTexture(c->clientActiveTexture);
+		}
+		break;
+	}
+	case FGL_TRACE_ID_glNormalPointer:
+	case FGL_TRACE_ID_glPointSizePointerOES: {
+		GLenum type = fglReplayGetVal<GLenum>(ptr);
+		GLsizei stride = fglReplayGetVal<GLsizei>(ptr);
+
+		if (ptr.header->id == FGL_TRACE_ID_glNormalPointer)
+			glNormalPointer(type, stride, data);
+		else
+			glPointSizePointerOES(type, stride, data);
+		break;
+	}
+	}
+
+	if (c->arrayBuffer)
+		glBindBuffer(GL_ARRAY_BUFFER, c->arrayBuffer);
+
+	++replay.fixups;
+}
+
+static void fglReplayEGLImage(FGLReplayRecord &rec)
+{
+	GLenum target = fglReplayGetVal<GLenum>(rec);
+	GLint format = fglReplayGetVal<GLint>(rec);
+	GLsizei width = fglReplayGetVal<GLsizei>(rec);
+	GLsizei height = fglReplayGetVal<GLsizei>(rec);
+	uint64_t start;
+
+	if (!replay.imageTarget) {
+		++replay.skipped;
+		return;
+	}
+
+	start = fglReplayTime();
+	replay.imageTarget(target, format, width, height);
+	if (replay.sync)
+		glFinish();
+	replay.calls[FGL_TRACE_ID_EGL_IMAGE].total += fglReplayTime() - start;
+	++replay.calls[FGL_TRACE_ID_EGL_IMAGE].count;
+}
+
+/* Tracks client state which client array records depend on */
+static void fglReplayTrackState(FGLReplayRecord &rec)
+{
+	FGLReplayContext *c = replay.current;
+	unsigned index;
+
+	if (!c)
+		return;
+
+	switch (rec.header->id) {
+	case FGL_TRACE_ID_glVertexPointer:
+		index = 0;
+		break;
+	case FGL_TRACE_ID_glNormalPointer:
+		index = 1;
+		break;
+	case FGL_TRACE_ID_glColorPointer:
+		index = 2;
+		break;
+	case FGL_TRACE_ID_glPointSizePointerOES:
+		index = 3;
+		break;
+	case FGL_TRACE_ID_glTexCoordPointer:
+		index = FGL_REPLAY_ARRAY_TEXTURE
+				+ c->clientActiveTexture - GL_TEXTURE0;
+		if (index >= FGL_REPLAY_NUM_ARRAYS)
+			return;
+		break;
+	case FGL_TRACE_ID_glClientActiveTexture:
+		c->clientActiveTexture = rec.arg[0];
+		return;
+	case FGL_TRACE_ID_glBindBuffer:
+		if (rec.arg[0] == GL_ARRAY_BUFFER)
+			c->arrayBuffer = rec.arg[1];
+		return;
+	default:
+		return;
+	}
+
+	c->pointer[index] = rec.header;
+}
+
+/*
+ * Main loop
+ */
+
+static void fglReplayTrace(const uint8_t *trace, size_t size)
+{
+	const uint8_t *end = trace + size;
+	const uint8_t *pos = trace + sizeof(FGLTraceHeader);
+
+	replay.frameStart = fglReplayTime();
+
+	while (pos + sizeof(FGLTraceRecordHeader) <= end) {
+		const FGLTraceRecordHeader *header =
+				(const FGLTraceRecordHeader *)pos;
+		FGLReplayRecord rec;
+
+		if (header->size < sizeof(*header) || header->size & 3
+		    || header->size > (size_t)(end - pos)) {
+			fprintf(stderr, "Truncated trace at offset %lu.\n",
+						(unsigned long)(pos - trace));
+			break;
+		}
+
+		fglReplayInitRecord(rec, header);
+		pos += header->size;
+
+		switch (header->id) {
+		case FGL_TRACE_ID_MAKE_CURRENT:
+			fglReplayMakeCurrent(rec);
+			continue;
+		case FGL_TRACE_ID_SWAP_BUFFERS:
+			fglReplaySwapBuffers(rec);
+			continue;
+		case FGL_TRACE_ID_CLIENT_ARRAY:
+			fglReplayClientArray(rec);
+			continue;
+		case FGL_TRACE_ID_EGL_IMAGE:
+			fglReplayEGLImage(rec);
+			continue;
+		}
+
+		if (header->id >= FGL_TRACE_ID_COUNT) {
+			++replay.skipped;
+			continue;
+		}
+
+		fglReplayTrackState(rec);
+
+		uint64_t time = fglReplayCall(rec);
+		FGLReplayStats *stats = &replay.calls[header->id];
+
+		++stats->count;
+		stats->total += time;
+		if (time > stats->max)
+			stats->max = time;
+	}
+}
+
+static void fglReplayReset(void)
+{
+	eglMakeCurrent(replay.dpy, EGL_NO_SURFACE,
+				EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+	for (unsigned i = 0; i < replay.numContexts; ++i) {
+		eglDestroySurface(replay.dpy, replay.contexts[i].surface);
+		eglDestroyContext(replay.dpy, replay.contexts[i].context);
+	}
+
+	replay.numContexts = 0;
+	replay.current = 0;
+}
+
+/*
+ * Report
+ */
+
+static int fglReplayCompareTime(const void *a, const void *b)
+{
+	uint64_t ta = *(const uint64_t *)a;
+	uint64_t tb = *(const uint64_t *)b;
+
+	return (ta > tb) - (ta < tb);
+}
+
+static int fglReplayCompareStats(const void *a, const void *b)
+{
+	const FGLReplayStats *sa = (const FGLReplayStats *)a;
+	const FGLReplayStats *sb = (const FGLReplayStats *)b;
+
+	return (sa->total < sb->total) - (sa->total > sb->total);
+}
+
+static void fglReplayReport(void)
+{
+	uint64_t total = 0;
+
+	if (replay.numFrames) {
+		uint64_t *f = replay.frames;
+		unsigned n = replay.numFrames;
+
+		for (unsigned i = 0; i < n; ++i)
+			total += f[i];
+
+		qsort(f, n, sizeof(*f), fglReplayCompareTime);
+
+		printf("Frames: %u, %.3f ms total, %.3f ms average (%.2f fps)\n",
+			n, total / 1e6, total / 1e6 / n, 1e9 * n / total);
+		printf("  min %.3f ms, median %.3f ms, 90%% %.3f ms, "
+			"99%% %.3f ms, max %.3f ms\n", f[0] / 1e6,
+			f[n / 2] / 1e6, f[n * 90 / 100] / 1e6,
+			f[n * 99 / 100] / 1e6, f[n - 1] / 1e6);
+	}
+
+	if (replay.captureFrames > 1) {
+		double captured = (replay.captureLast - replay.captureFirst)
+					/ 1e6 / (replay.captureFrames - 1);
+
+		printf("Captured: %.3f ms average (%.2f fps)\n",
+						captured, 1e3 / captured);
+	}
+
+	printf("Client array fixups: %u, skipped records: %u\n",
+					replay.fixups, replay.skipped);
+
+	if (replay.reference || replay.badFrames)
+		printf("Frames differing from reference: %u\n",
+							replay.badFrames);
+
+	printf("\n");
+
+	total = 0;
+	for (unsigned i = 0; i < FGL_TRACE_ID_COUNT; ++i) {
+		replay.calls[i].id = i;
+		total += replay.calls[i].total;
+	}
+
+	qsort(replay.calls, FGL_TRACE_ID_COUNT, sizeof(*replay.calls),
+						fglReplayCompareStats);
+
+	printf("%-40s %10s %12s %10s %10s %6s\n", "Call", "Count",
+			"Total [ms]", "Avg [us]", "Max [us]", "%");
+
+	for (unsigned i = 0; i < FGL_TRACE_ID_COUNT; ++i) {
+		FGLReplayStats *s = &replay.calls[i];
+		if (!s->count)
+			continue;
+
+		printf("%-40s %10llu %12.3f %10.2f %10.2f %6.2f\n",
+			fglReplayName(s->id), (unsigned long long)s->count,
+			s->total / 1e6, s->total / 1e3 / s->count,
+			s->max / 1e3, total ? 100.0 * s->total / total : 0);
+	}
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-n loops] [-f] [-s] [-o frames] "
+			"[-c frames [-t tol]] <trace file>\n", name);
+	exit(EINVAL);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned loops = 1;
+	struct stat st;
+	uint8_t *trace;
+	int opt, fd;
+
+	while ((opt = getopt(argc, argv, "n:fso:c:t:")) != -1) {
+		switch (opt) {
+		case 'n':
+			loops = atoi(optarg);
+			break;
+		case 'f':
+			replay.printFrames = true;
+			break;
+		case 's':
+			replay.sync = true;
+			break;
+		case 'o':
+			replay.output = fopen(optarg, "wb");
+			if (!replay.output) {
+				fprintf(stderr, "Failed to create %s (%s).\n",
+						optarg, strerror(errno));
+				return errno;
+			}
+			break;
+		case 'c':
+			replay.reference = fopen(optarg, "rb");
+			if (!replay.reference) {
+				fprintf(stderr, "Failed to open %s (%s).\n",
+						optarg, strerror(errno));
+				return errno;
+			}
+			break;
+		case 't':
+			replay.tolerance = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind >= argc)
+		usage(argv[0]);
+
+	fd = open(argv[optind], O_RDONLY);
+	if (fd < 0 || fstat(fd, &st)) {
+		fprintf(stderr, "Failed to open %s (%s).\n",
+					argv[optind], strerror(errno));
+		return errno;
+	}
+
+	trace = (uint8_t *)mmap(NULL, st.st_size, PROT_READ,
+						MAP_PRIVATE, fd, 0);
+	if (trace == MAP_FAILED) {
+		fprintf(stderr, "Failed to map %s (%s).\n",
+					argv[optind], strerror(errno));
+		return errno;
+	}
+
+	const FGLTraceHeader *header = (const FGLTraceHeader *)trace;
+	if ((size_t)st.st_size < sizeof(*header)
+	    || header->magic != FGL_TRACE_MAGIC
+	    || header->version != FGL_TRACE_VERSION) {
+		fprintf(stderr, "%s is not a supported trace file.\n",
+							argv[optind]);
+		return EINVAL;
+	}
+
+	replay.dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (!eglInitialize(replay.dpy, NULL, NULL)) {
+		fprintf(stderr, "Failed to initialize EGL (%#x).\n",
+							eglGetError());
+		return EINVAL;
+	}
+
+	replay.imageTarget = (PFNGLTRACEIMAGETARGETTEXTURE2DFIMGPROC)
+		eglGetProcAddress("glTraceImageTargetTexture2DFIMG");
+	if (!replay.imageTarget)
+		fprintf(stderr, "EGL images will be skipped, "
+				"GL library built without FGL_TRACE.\n");
+
+	while (loops--) {
+		fglReplayTrace(trace, st.st_size);
+		fglReplayReset();
+	}
+
+	fglReplayReport();
+
+	if (replay.output)
+		fclose(replay.output);
+	if (replay.reference)
+		fclose(replay.reference);
+
+	eglTerminate(replay.dpy);
+	munmap(trace, st.st_size);
+	close(fd);
+
+	return replay.badFrames ? 1 : 0;
+}
@@ -30,7 +30,9 @@
 #include <errno.h>
 #include <unistd.h>
 
+#ifndef FIMG_SOFTWARE_BACKEND
 #include <linux/android_pmem.h>
+#endif
 
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
@@ -47,6 +49,66 @@
  * Surfaces
  */
 
+#ifdef FIMG_SOFTWARE_BACKEND
+/* Memory of emulated hardware */
+FGLLocalSurface::FGLLocalSurface(unsigned long req_size)
+	: fd(-1)
+{
+	unsigned long page_size = getpagesize();
+	unsigned long phys;
+
+	/* Round up to page size */
+	size = (req_size + page_size - 1) & ~(page_size - 1);
+
+	vaddr = fimgSoftAlloc(size, &phys);
+	if (!vaddr) {
+		ALOGE("EGL: Emulated buffer allocation failed");
+		return;
+	}
+	this->paddr = phys;
+
+	/* Allocation succeeded */
+	fd = 0;
+}
+
+FGLLocalSurface::~FGLLocalSurface()
+{
+	if (!isValid())
+		return;
+
+	fimgSoftFree(vaddr);
+}
+
+int FGLLocalSurface::lock(int usage)
+{
+	return 0;
+}
+
+int FGLLocalSurface::unlock(void)
+{
+	return 0;
+}
+
+void FGLLocalSurface::flush(void)
+{
+}
+
+void FGLLocalSurface::flushRange(size_t offset, size_t len)
+{
+}
+
+FGLExternalSurface::FGLExternalSurface(void *v, intptr_t p, size_t s)
+{
+	vaddr = v;
+	paddr = fimgSoftMap(v, s);
+	size = s;
+}
+
+FGLExternalSurface::~FGLExternalSurface()
+{
+	fimgSoftUnmap(vaddr);
+}
+#else
 FGLLocalSurface::FGLLocalSurface(unsigned long req_size)
 	: fd(-1)
 {
@@ -118,6 +180,20 @@ void FGLLocalSurface::flush(void)
 		ALOGW("Could not flush PMEM surface %d", fd);
 }
 
+void FGLLocalSurface::flushRange(size_t offset, size_t len)
+{
+	struct pmem_region region;
+
+	if (offset >= size)
+		return;
+
+	region.offset = offset;
+	region.len = (len < size - offset) ? len : size - offset;
+
+	if (ioctl(fd, PMEM_CACHE_FLUSH, &region) != 0)
+		ALOGW("Could not flush PMEM surface %d", fd);
+}
+
 FGLExternalSurface::FGLExternalSurface(void *v, intptr_t p, size_t s)
 {
 	vaddr = v;
@@ -129,6 +205,7 @@ FGLExternalSurface::~FGLExternalSurface()
 {
 
 }
+#endif /* FIMG_SOFTWARE_BACKEND */
 
 int FGLExternalSurface::lock(int usage)
 {
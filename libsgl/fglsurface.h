@@ -31,19 +31,39 @@
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 #include "types.h"
+#include "libfimg/fimg.h"
 
 class FGLSurface {
 public:
 	intptr_t	paddr;
 	void		*vaddr;
 	size_t		size;
+	/* Last work using the surface */
+	fimgContext	*fenceCtx;
+	uint32_t	fence;
 
-			FGLSurface() : paddr(0), vaddr(0), size(0) {};
+			FGLSurface() : paddr(0), vaddr(0), size(0),
+				fenceCtx(0), fence(0) {};
 			FGLSurface(unsigned long p, void *v, unsigned long s) :
-				paddr(p), vaddr(v), size(s) {};
+				paddr(p), vaddr(v), size(s),
+				fenceCtx(0), fence(0) {};
 	virtual		~FGLSurface() {};
 
+	void		setFence(fimgContext *ctx, uint32_t f)
+	{
+		fenceCtx = ctx;
+		fence = f;
+	}
+
+	/* Waits for work of given context using the surface */
+	void		waitFence(fimgContext *ctx)
+	{
+		if (fenceCtx == ctx)
+			fimgWaitFence(ctx, fence);
+	}
+
 	virtual void	flush(void) = 0;
+	virtual void	flushRange(size_t offset, size_t len) { flush(); };
 	virtual int	lock(int usage = 0) = 0;
 	virtual int	unlock(void) = 0;
 
@@ -57,6 +77,7 @@ public:
 	virtual		~FGLLocalSurface();
 
 	virtual void	flush(void);
+	virtual void	flushRange(size_t offset, size_t len);
 	virtual int	lock(int usage = 0);
 	virtual int	unlock(void);
 
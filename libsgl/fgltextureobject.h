@@ -62,6 +62,9 @@ struct FGLTexture : public FGLFramebufferAttachable {
 	bool		convert;
 	bool		valid;
 	bool		dirty;
+	/* Byte range of the surface written since last flush */
+	size_t		dirtyStart;
+	size_t		dirtyEnd;
 
 	FGLTexture(unsigned int name = 0) :
 		object(this),
@@ -78,7 +81,9 @@ struct FGLTexture : public FGLFramebufferAttachable {
 		invReady(false),
 		fimg(NULL),
 		valid(false),
-		dirty(false)
+		dirty(false),
+		dirtyStart(0),
+		dirtyEnd(0)
 	{
 		fimg = fimgCreateTexture();
 		if(fimg == NULL)
@@ -110,6 +115,20 @@ struct FGLTexture : public FGLFramebufferAttachable {
 		return (surface != 0);
 	}
 
+	/* Marks part of the surface as written by CPU */
+	inline void markDirty(size_t start, size_t end)
+	{
+		if (dirtyEnd) {
+			if (start > dirtyStart)
+				start = dirtyStart;
+			if (end < dirtyEnd)
+				end = dirtyEnd;
+		}
+
+		dirtyStart = start;
+		dirtyEnd = end;
+	}
+
 	virtual GLenum getType(void) const
 	{
 		return GL_TEXTURE;
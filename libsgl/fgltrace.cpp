@@ -0,0 +1,676 @@
+/*
+ * libsgl/fgltrace.cpp
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2013 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * GL call trace capture
+ *
+ * When built with FGL_TRACE, exported GL entry points are the wrappers
+ * defined here. Tracing is enabled at runtime by pointing the FGL_TRACE_FILE
+ * environment variable (or debug.fimg.trace property on Android) to a file
+ * name prefix; each process writes to <prefix>.<pid>.
+ *
+ * Records are serialized into an anonymous mmap()ed ring, which is drained
+ * to the file by a background thread, so the calling thread only pays for
+ * the copy. Client array data is captured at draw time for the range of
+ * vertices actually used. The trace is replayed by fglreplay.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+/* This file defines the exported entry points */
+#define FGL_TRACE_NO_RENAME
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <GLES/gl.h>
+#include <GLES/glext.h>
+
+#include "glesCommon.h"
+#include "fglrendersurface.h"
+#include "fglimage.h"
+#include "fgltrace.h"
+
+#ifdef FGL_TRACE
+
+#ifdef FGL_PLATFORM_ANDROID
+#include <cutils/properties.h>
+#endif
+
+/*
+ * Ring buffer
+ */
+
+#define FGL_TRACE_RING_MASK		(FGL_TRACE_RING_SIZE - 1)
+/* Amount of pending data that wakes up the writer thread */
+#define FGL_TRACE_RING_KICK		(FGL_TRACE_RING_SIZE / 4)
+
+struct FGLTraceState {
+	int fd;
+	uint8_t *ring;
+	/* Free running offsets, published under ringLock */
+	uint32_t head;
+	uint32_t tail;
+	bool exiting;
+	pthread_mutex_t ringLock;
+	pthread_cond_t ringData;
+	pthread_cond_t ringSpace;
+	pthread_t writer;
+
+	/* Producer state, protected by callLock */
+	pthread_mutex_t callLock;
+	uint32_t writeHead;
+	uint32_t writeFree;
+	FGLContext *ctx;
+	EGLSurface draw;
+	uint32_t width;
+	uint32_t height;
+};
+
+static FGLTraceState fglTrace = {
+	-1, NULL, 0, 0, false,
+	PTHREAD_MUTEX_INITIALIZER,
+	PTHREAD_COND_INITIALIZER,
+	PTHREAD_COND_INITIALIZER,
+	0,
+	PTHREAD_MUTEX_INITIALIZER,
+	0, 0, NULL, 0, 0, 0
+};
+
+static pthread_once_t fglTraceOnce = PTHREAD_ONCE_INIT;
+
+static void *fglTraceWriter(void *arg)
+{
+	FGLTraceState *t = (FGLTraceState *)arg;
+
+	pthread_mutex_lock(&t->ringLock);
+
+	for (;;) {
+		while (t->head == t->tail && !t->exiting)
+			pthread_cond_wait(&t->ringData, &t->ringLock);
+
+		if (t->head == t->tail)
+			break;
+
+		uint32_t offset = t->tail & FGL_TRACE_RING_MASK;
+		uint32_t len = t->head - t->tail;
+
+		pthread_mutex_unlock(&t->ringLock);
+
+		if (len > FGL_TRACE_RING_SIZE - offset)
+			len = FGL_TRACE_RING_SIZE - offset;
+
+		uint32_t done = 0;
+		while (done < len) {
+			ssize_t ret = write(t->fd, t->ring + offset + done,
+								len - done);
+			if (ret < 0) {
+				if (errno == EINTR)
+					continue;
+				ALOGE("Trace write failed (%s), "
+					"dropping data.", strerror(errno));
+				break;
+			}
+			done += ret;
+		}
+
+		pthread_mutex_lock(&t->ringLock);
+		t->tail += len;
+		pthread_cond_broadcast(&t->ringSpace);
+	}
+
+	pthread_mutex_unlock(&t->ringLock);
+
+	return NULL;
+}
+
+static void fglTraceExit(void)
+{
+	FGLTraceState *t = &fglTrace;
+
+	pthread_mutex_lock(&t->callLock);
+
+	pthread_mutex_lock(&t->ringLock);
+	t->head = t->writeHead;
+	t->exiting = true;
+	pthread_cond_signal(&t->ringData);
+	pthread_mutex_unlock(&t->ringLock);
+
+	pthread_join(t->writer, NULL);
+
+	close(t->fd);
+	t->fd = -1;
+
+	pthread_mutex_unlock(&t->callLock);
+}
+
+static void fglTraceInit(void)
+{
+	FGLTraceState *t = &fglTrace;
+	const char *prefix = getenv("FGL_TRACE_FILE");
+	char path[256];
+#ifdef FGL_PLATFORM_ANDROID
+	char prop[PROPERTY_VALUE_MAX];
+
+	if (!prefix && property_get("debug.fimg.trace", prop, NULL) > 0)
+		prefix = prop;
+#endif
+	if (!prefix || !prefix[0])
+		return;
+
+	snprintf(path, sizeof(path), "%s.%d", prefix, getpid());
+
+	t->ring = (uint8_t *)mmap(NULL, FGL_TRACE_RING_SIZE,
+				PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (t->ring == MAP_FAILED) {
+		ALOGE("Failed to allocate trace ring (%s).", strerror(errno));
+		t->ring = NULL;
+		return;
+	}
+
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		ALOGE("Failed to open trace file %s (%s).",
+						path, strerror(errno));
+		munmap(t->ring, FGL_TRACE_RING_SIZE);
+		return;
+	}
+
+	FGLTraceHeader header = { FGL_TRACE_MAGIC, FGL_TRACE_VERSION };
+	if (write(fd, &header, sizeof(header)) != sizeof(header)) {
+		ALOGE("Failed to write trace file %s.", path);
+		close(fd);
+		munmap(t->ring, FGL_TRACE_RING_SIZE);
+		return;
+	}
+
+	t->fd = fd;
+	t->writeFree = FGL_TRACE_RING_SIZE;
+
+	if (pthread_create(&t->writer, NULL, fglTraceWriter, t)) {
+		ALOGE("Failed to start trace writer thread.");
+		close(fd);
+		t->fd = -1;
+		munmap(t->ring, FGL_TRACE_RING_SIZE);
+		return;
+	}
+
+	atexit(fglTraceExit);
+
+	ALOGI("Tracing GL calls to %s.", path);
+}
+
+static inline bool fglTraceEnabled(void)
+{
+	pthread_once(&fglTraceOnce, fglTraceInit);
+	return fglTrace.fd >= 0;
+}
+
+/* Makes data written so far visible to the writer thread */
+static void fglTracePublish(FGLTraceState *t, bool kick)
+{
+	pthread_mutex_lock(&t->ringLock);
+	t->head = t->writeHead;
+	if (kick || t->head - t->tail >= FGL_TRACE_RING_KICK)
+		pthread_cond_signal(&t->ringData);
+	t->writeFree = FGL_TRACE_RING_SIZE - (t->head - t->tail);
+	pthread_mutex_unlock(&t->ringLock);
+}
+
+static void fglTraceCopy(FGLTraceState *t, const void *data, uint32_t len)
+{
+	const uint8_t *src = (const uint8_t *)data;
+
+	while (len) {
+		if (!t->writeFree) {
+			pthread_mutex_lock(&t->ringLock);
+			t->head = t->writeHead;
+			while (t->head - t->tail == FGL_TRACE_RING_SIZE) {
+				pthread_cond_signal(&t->ringData);
+				pthread_cond_wait(&t->ringSpace, &t->ringLock);
+			}
+			t->writeFree = FGL_TRACE_RING_SIZE
+						- (t->head - t->tail);
+			pthread_mutex_unlock(&t->ringLock);
+		}
+
+		uint32_t offset = t->writeHead & FGL_TRACE_RING_MASK;
+		uint32_t chunk = min(len, t->writeFree);
+		chunk = min(chunk, FGL_TRACE_RING_SIZE - offset);
+
+		memcpy(t->ring + offset, src, chunk);
+
+		t->writeHead += chunk;
+		t->writeFree -= chunk;
+		src += chunk;
+		len -= chunk;
+	}
+}
+
+/*
+ * Record encoding
+ */
+
+#define FGL_TRACE_MAX_ARG_WORDS		32
+#define FGL_TRACE_MAX_DATA		2
+
+struct FGLTraceRecord {
+	FGLTraceRecordHeader header;
+	uint32_t args[FGL_TRACE_MAX_ARG_WORDS];
+	unsigned numArgs;
+	const void *data[FGL_TRACE_MAX_DATA];
+	uint32_t dataSize[FGL_TRACE_MAX_DATA];
+	unsigned numData;
+
+	FGLTraceRecord(unsigned id) :
+		numArgs(0),
+		numData(0)
+	{
+		header.id = id;
+	}
+};
+
+template<typename T>
+static inline void fglTracePutVal(FGLTraceRecord &rec, T val, size_t)
+{
+	rec.args[rec.numArgs++] = (uint32_t)val;
+}
+
+static inline void fglTracePutVal(FGLTraceRecord &rec, GLfloat val, size_t)
+{
+	memcpy(&rec.args[rec.numArgs++], &val, sizeof(val));
+}
+
+static inline void fglTracePutLong(FGLTraceRecord &rec, uint64_t val, size_t)
+{
+	memcpy(&rec.args[rec.numArgs], &val, sizeof(val));
+	rec.numArgs += 2;
+}
+
+static inline void fglTracePutPtr(FGLTraceRecord &rec,
+					const void *ptr, size_t)
+{
+	fglTracePutLong(rec, (uintptr_t)ptr, 0);
+}
+
+static inline void fglTracePutData(FGLTraceRecord &rec,
+					const void *ptr, size_t size)
+{
+	if (!ptr || !size || size > UINT32_MAX / 2) {
+		rec.args[rec.numArgs++] = FGL_TRACE_DATA_BY_VALUE;
+		fglTracePutPtr(rec, ptr, 0);
+		return;
+	}
+
+	rec.args[rec.numArgs++] = size;
+	rec.data[rec.numData] = ptr;
+	rec.dataSize[rec.numData++] = size;
+}
+
+static inline void fglTracePutOut(FGLTraceRecord &rec,
+					const void *ptr, size_t size)
+{
+	rec.args[rec.numArgs++] = size;
+}
+
+static void fglTraceCurrent(FGLTraceState *t, FGLContext *ctx)
+{
+	EGLSurface draw = ctx ? ctx->egl.draw : 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+
+	if (draw) {
+		FGLRenderSurface *surface = (FGLRenderSurface *)draw;
+		width = surface->getWidth();
+		height = surface->getHeight();
+	}
+
+	if (ctx == t->ctx && draw == t->draw
+	    && width == t->width && height == t->height)
+		return;
+
+	t->ctx = ctx;
+	t->draw = draw;
+	t->width = width;
+	t->height = height;
+
+	FGLTraceRecord rec(FGL_TRACE_ID_MAKE_CURRENT);
+	fglTracePutPtr(rec, ctx, 0);
+	fglTracePutVal(rec, ctx ? (uintptr_t)ctx->egl.config : 0, 0);
+	fglTracePutVal(rec, width, 0);
+	fglTracePutVal(rec, height, 0);
+
+	rec.header.argSize = rec.numArgs * sizeof(uint32_t);
+	rec.header.size = sizeof(rec.header) + rec.header.argSize;
+
+	fglTraceCopy(t, &rec.header, rec.header.size);
+}
+
+static void fglTraceCommit(FGLTraceRecord &rec, bool kick = false)
+{
+	static const uint32_t padding = 0;
+	FGLTraceState *t = &fglTrace;
+	uint32_t size;
+
+	rec.header.argSize = rec.numArgs * sizeof(uint32_t);
+	size = sizeof(rec.header) + rec.header.argSize;
+	for (unsigned i = 0; i < rec.numData; ++i)
+		size += (rec.dataSize[i] + 3) & ~3;
+	rec.header.size = size;
+
+	pthread_mutex_lock(&t->callLock);
+
+	if (t->fd < 0) {
+		/* Tracing stopped at exit */
+		pthread_mutex_unlock(&t->callLock);
+		return;
+	}
+
+	fglTraceCurrent(t, getGlThreadSpecific());
+
+	/* Header and arguments are contiguous in FGLTraceRecord */
+	fglTraceCopy(t, &rec.header,
+			sizeof(rec.header) + rec.header.argSize);
+
+	for (unsigned i = 0; i < rec.numData; ++i) {
+		fglTraceCopy(t, rec.data[i], rec.dataSize[i]);
+		fglTraceCopy(t, &padding, -rec.dataSize[i] & 3);
+	}
+
+	fglTracePublish(t, kick);
+
+	pthread_mutex_unlock(&t->callLock);
+}
+
+/*
+ * Sizes of data passed by pointer
+ */
+
+static size_t fglTraceIndexSize(GLsizei count, GLenum type)
+{
+	FGLContext *ctx = getGlThreadSpecific();
+
+	/* Indices in a buffer object are stored as an offset */
+	if (!ctx || ctx->elementArrayBuffer.isBound() || count <= 0)
+		return 0;
+
+	switch (type) {
+	case GL_UNSIGNED_BYTE:
+		return count;
+	case GL_UNSIGNED_SHORT:
+		return 2 * count;
+	default:
+		return 0;
+	}
+}
+
+static size_t fglTraceImageSize(GLsizei width, GLsizei height,
+					GLenum format, GLenum type)
+{
+	FGLContext *ctx = getGlThreadSpecific();
+	size_t pixelSize;
+
+	if (!ctx || width <= 0 || height <= 0)
+		return 0;
+
+	switch (type) {
+	case GL_UNSIGNED_SHORT_5_6_5:
+	case GL_UNSIGNED_SHORT_4_4_4_4:
+	case GL_UNSIGNED_SHORT_5_5_5_1:
+		pixelSize = 2;
+		break;
+	case GL_UNSIGNED_BYTE:
+		switch (format) {
+		case GL_ALPHA:
+		case GL_LUMINANCE:
+			pixelSize = 1;
+			break;
+		case GL_LUMINANCE_ALPHA:
+			pixelSize = 2;
+			break;
+		case GL_RGB:
+			pixelSize = 3;
+			break;
+		case GL_RGBA:
+		case GL_BGRA_EXT:
+			pixelSize = 4;
+			break;
+		default:
+			return 0;
+		}
+		break;
+	default:
+		return 0;
+	}
+
+	/* Enough for both pack and unpack, as their alignments can differ */
+	size_t align = max(ctx->unpackAlignment, ctx->packAlignment);
+	size_t stride = (width * pixelSize + align - 1) & ~(align - 1);
+
+	return (height - 1) * stride + width * pixelSize;
+}
+
+static size_t fglTraceParamCount(GLenum pname)
+{
+	switch (pname) {
+	case GL_FOG_COLOR:
+	case GL_LIGHT_MODEL_AMBIENT:
+	case GL_AMBIENT:
+	case GL_DIFFUSE:
+	case GL_SPECULAR:
+	case GL_EMISSION:
+	case GL_POSITION:
+	case GL_AMBIENT_AND_DIFFUSE:
+	case GL_TEXTURE_ENV_COLOR:
+	case GL_TEXTURE_CROP_RECT_OES:
+		return 4;
+	case GL_SPOT_DIRECTION:
+	case GL_POINT_DISTANCE_ATTENUATION:
+		return 3;
+	default:
+		return 1;
+	}
+}
+
+/*
+ * Client vertex arrays
+ */
+
+static void fglTraceClientArrays(FGLContext *ctx, uint32_t first, uint32_t last)
+{
+	for (int i = 0; i < 4 + FGL_MAX_TEXTURE_UNITS; ++i) {
+		FGLArrayState *array = &ctx->array[i];
+
+		if (!array->enabled || array->buffer || !array->pointer)
+			continue;
+
+		uint32_t start = first * array->stride;
+		uint32_t size = (last - first) * array->stride + array->width;
+
+		FGLTraceRecord rec(FGL_TRACE_ID_CLIENT_ARRAY);
+		fglTracePutVal(rec, i, 0);
+		fglTracePutVal(rec, start, 0);
+		fglTracePutData(rec,
+			(const uint8_t *)array->pointer + start, size);
+		fglTraceCommit(rec);
+	}
+}
+
+static bool fglTraceHasClientArrays(FGLContext *ctx)
+{
+	for (int i = 0; i < 4 + FGL_MAX_TEXTURE_UNITS; ++i)
+		if (ctx->array[i].enabled && !ctx->array[i].buffer)
+			return true;
+
+	return false;
+}
+
+static void fglTraceVertexData_glDrawArrays(GLenum mode,
+						GLint first, GLsizei count)
+{
+	FGLContext *ctx = getGlThreadSpecific();
+
+	if (!ctx || first < 0 || count <= 0 || !fglTraceHasClientArrays(ctx))
+		return;
+
+	fglTraceClientArrays(ctx, first, first + count - 1);
+}
+
+template<typename T>
+static void fglTraceIndexRange(const T *indices, GLsizei count,
+						uint32_t *first, uint32_t *last)
+{
+	uint32_t min = indices[0];
+	uint32_t max = indices[0];
+
+	while (--count) {
+		uint32_t index = *(++indices);
+
+		if (index < min)
+			min = index;
+		if (index > max)
+			max = index;
+	}
+
+	*first = min;
+	*last = max;
+}
+
+static void fglTraceVertexData_glDrawElements(GLenum mode, GLsizei count,
+					GLenum type, const GLvoid *indices)
+{
+	FGLContext *ctx = getGlThreadSpecific();
+	uint32_t first, last;
+
+	if (!ctx || count <= 0 || !fglTraceHasClientArrays(ctx))
+		return;
+
+	if (ctx->elementArrayBuffer.isBound()) {
+		FGLBuffer *buf = ctx->elementArrayBuffer.get();
+		indices = buf->getAddress(indices);
+	}
+
+	if (!indices)
+		return;
+
+	switch (type) {
+	case GL_UNSIGNED_BYTE:
+		fglTraceIndexRange((const uint8_t *)indices,
+							count, &first, &last);
+		break;
+	case GL_UNSIGNED_SHORT:
+		fglTraceIndexRange((const uint16_t *)indices,
+							count, &first, &last);
+		break;
+	default:
+		return;
+	}
+
+	fglTraceClientArrays(ctx, first, last);
+}
+
+/*
+ * Entry point wrappers
+ */
+
+#define FGL_TRACE_ARG(kind, type, name, size) \
+	fglTracePut ## kind(rec, name, size);
+
+#define FGL_TRACE_FUNC(ret, name, decl, names, args) \
+GL_API ret GL_APIENTRY fglImpl_ ## name decl; \
+ \
+GL_API ret GL_APIENTRY name decl \
+{ \
+	if (unlikely(fglTraceEnabled())) { \
+		FGLTraceRecord rec(FGL_TRACE_ID_ ## name); \
+		args \
+		fglTraceCommit(rec); \
+	} \
+ \
+	return fglImpl_ ## name names; \
+}
+
+#define FGL_TRACE_DRAW_FUNC(ret, name, decl, names, args) \
+GL_API ret GL_APIENTRY fglImpl_ ## name decl; \
+ \
+GL_API ret GL_APIENTRY name decl \
+{ \
+	if (unlikely(fglTraceEnabled())) { \
+		FGLTraceRecord rec(FGL_TRACE_ID_ ## name); \
+		fglTraceVertexData_ ## name names; \
+		args \
+		fglTraceCommit(rec); \
+	} \
+ \
+	return fglImpl_ ## name names; \
+}
+
+#include "fgltracecalls.h"
+
+#undef FGL_TRACE_FUNC
+#undef FGL_TRACE_DRAW_FUNC
+#undef FGL_TRACE_ARG
+
+GL_API void GL_APIENTRY fglImpl_glEGLImageTargetTexture2DOES(GLenum target,
+							GLeglImageOES img);
+
+GL_API void GL_APIENTRY glEGLImageTargetTexture2DOES(GLenum target,
+							GLeglImageOES img)
+{
+	FGLImage *image = (FGLImage *)img;
+
+	if (unlikely(fglTraceEnabled()) && image && image->isValid()) {
+		FGLTraceRecord rec(FGL_TRACE_ID_EGL_IMAGE);
+		fglTracePutVal(rec, target, 0);
+		fglTracePutVal(rec, image->pixelFormat, 0);
+		fglTracePutVal(rec, image->width, 0);
+		fglTracePutVal(rec, image->height, 0);
+		fglTraceCommit(rec);
+	}
+
+	fglImpl_glEGLImageTargetTexture2DOES(target, img);
+}
+
+void fglTraceSwapBuffers(void)
+{
+	struct timespec ts;
+
+	if (likely(!fglTraceEnabled()))
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	FGLTraceRecord rec(FGL_TRACE_ID_SWAP_BUFFERS);
+	fglTracePutLong(rec, ts.tv_sec * 1000000000ULL + ts.tv_nsec, 0);
+	fglTraceCommit(rec, true);
+}
+
+#endif /* FGL_TRACE */
@@ -0,0 +1,414 @@
+/*
+ * libsgl/fgltrace.h
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2013 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LIBSGL_FGLTRACE_H_
+#define _LIBSGL_FGLTRACE_H_
+
+#include <stdint.h>
+#include <GLES/gl.h>
+#include <GLES/glext.h>
+
+/*
+ * Trace file format
+ *
+ * The file starts with FGLTraceHeader, followed by a stream of records.
+ * Every record starts with FGLTraceRecordHeader, followed by argSize bytes
+ * of encoded arguments and then by the data blobs referenced by Data
+ * arguments, each padded to 4 bytes. All fields are little endian.
+ */
+
+#define FGL_TRACE_MAGIC		0x544c4746	/* "FGLT" */
+#define FGL_TRACE_VERSION	1
+
+/* Size of output scratch space for glGet* calls */
+#define FGL_TRACE_GET_SIZE	64
+
+struct FGLTraceHeader {
+	uint32_t magic;
+	uint32_t version;
+};
+
+struct FGLTraceRecordHeader {
+	uint16_t id;
+	uint16_t argSize;
+	uint32_t size;		/* whole record, including header */
+};
+
+/* Data argument size marking a pointer stored by value */
+#define FGL_TRACE_DATA_BY_VALUE	0xffffffff
+
+/*
+ * Argument list helpers used to expand the call table. Each argument
+ * tuple is passed to a helper macro m(kind, type, name, size).
+ */
+
+#define FGL_TRACE_LIST0(m)
+#define FGL_TRACE_LIST1(m, a)	m a
+#define FGL_TRACE_LIST2(m, a, b) \
+	m a, m b
+#define FGL_TRACE_LIST3(m, a, b, c) \
+	m a, m b, m c
+#define FGL_TRACE_LIST4(m, a, b, c, d) \
+	m a, m b, m c, m d
+#define FGL_TRACE_LIST5(m, a, b, c, d, e) \
+	m a, m b, m c, m d, m e
+#define FGL_TRACE_LIST6(m, a, b, c, d, e, f) \
+	m a, m b, m c, m d, m e, m f
+#define FGL_TRACE_LIST7(m, a, b, c, d, e, f, g) \
+	m a, m b, m c, m d, m e, m f, m g
+#define FGL_TRACE_LIST8(m, a, b, c, d, e, f, g, h) \
+	m a, m b, m c, m d, m e, m f, m g, m h
+#define FGL_TRACE_LIST9(m, a, b, c, d, e, f, g, h, i) \
+	m a, m b, m c, m d, m e, m f, m g, m h, m i
+
+#define FGL_TRACE_EACH0(m)
+#define FGL_TRACE_EACH1(m, a)	m a
+#define FGL_TRACE_EACH2(m, a, b) \
+	m a m b
+#define FGL_TRACE_EACH3(m, a, b, c) \
+	m a m b m c
+#define FGL_TRACE_EACH4(m, a, b, c, d) \
+	m a m b m c m d
+#define FGL_TRACE_EACH5(m, a, b, c, d, e) \
+	m a m b m c m d m e
+#define FGL_TRACE_EACH6(m, a, b, c, d, e, f) \
+	m a m b m c m d m e m f
+#define FGL_TRACE_EACH7(m, a, b, c, d, e, f, g) \
+	m a m b m c m d m e m f m g
+#define FGL_TRACE_EACH8(m, a, b, c, d, e, f, g, h) \
+	m a m b m c m d m e m f m g m h
+#define FGL_TRACE_EACH9(m, a, b, c, d, e, f, g, h, i) \
+	m a m b m c m d m e m f m g m h m i
+
+#define FGL_TRACE_ARG_DECL(kind, type, name, size)	type name
+#define FGL_TRACE_ARG_NAME(kind, type, name, size)	name
+
+/*
+ * Table entries expand to
+ *	FGL_TRACE_FUNC(ret, name, (declarations), (names), arguments)
+ * or FGL_TRACE_DRAW_FUNC() with the same arguments for draw calls, where
+ * arguments is FGL_TRACE_ARG(kind, type, name, size) repeated for every
+ * argument. Users define these three macros before including the table.
+ */
+
+#define FGL_TRACE_CALL0(ret, name) \
+	FGL_TRACE_FUNC(ret, name, \
+		(FGL_TRACE_LIST0(FGL_TRACE_ARG_DECL)), \
+		(FGL_TRACE_LIST0(FGL_TRACE_ARG_NAME)), \
+		FGL_TRACE_EACH0(FGL_TRACE_ARG))
+#define FGL_TRACE_CALL1(ret, name, a) \
+	FGL_TRACE_FUNC(ret, name, \
+		(FGL_TRACE_LIST1(FGL_TRACE_ARG_DECL, a)), \
+		(FGL_TRACE_LIST1(FGL_TRACE_ARG_NAME, a)), \
+		FGL_TRACE_EACH1(FGL_TRACE_ARG, a))
+#define FGL_TRACE_CALL2(ret, name, a, b) \
+	FGL_TRACE_FUNC(ret, name, \
+		(FGL_TRACE_LIST2(FGL_TRACE_ARG_DECL, a, b)), \
+		(FGL_TRACE_LIST2(FGL_TRACE_ARG_NAME, a, b)), \
+		FGL_TRACE_EACH2(FGL_TRACE_ARG, a, b))
+#define FGL_TRACE_CALL3(ret, name, a, b, c) \
+	FGL_TRACE_FUNC(ret, name, \
+		(FGL_TRACE_LIST3(FGL_TRACE_ARG_DECL, a, b, c)), \
+		(FGL_TRACE_LIST3(FGL_TRACE_ARG_NAME, a, b, c)), \
+		FGL_TRACE_EACH3(FGL_TRACE_ARG, a, b, c))
+#define FGL_TRACE_CALL4(ret, name, a, b, c, d) \
+	FGL_TRACE_FUNC(ret, name, \
+		(FGL_TRACE_LIST4(FGL_TRACE_ARG_DECL, a, b, c, d)), \
+		(FGL_TRACE_LIST4(FGL_TRACE_ARG_NAME, a, b, c, d)), \
+		FGL_TRACE_EACH4(FGL_TRACE_ARG, a, b, c, d))
+#define FGL_TRACE_CALL5(ret, name, a, b, c, d, e) \
+	FGL_TRACE_FUNC(ret, name, \
+		(FGL_TRACE_LIST5(FGL_TRACE_ARG_DECL, a, b, c, d, e)), \
+		(FGL_TRACE_LIST5(FGL_TRACE_ARG_NAME, a, b, c, d, e)), \
+		FGL_TRACE_EACH5(FGL_TRACE_ARG, a, b, c, d, e))
+#define FGL_TRACE_CALL6(ret, name, a, b, c, d, e, f) \
+	FGL_TRACE_FUNC(ret, name, \
+		(FGL_TRACE_LIST6(FGL_TRACE_ARG_DECL, a, b, c, d, e, f)), \
+		(FGL_TRACE_LIST6(FGL_TRACE_ARG_NAME, a, b, c, d, e, f)), \
+		FGL_TRACE_EACH6(FGL_TRACE_ARG, a, b, c, d, e, f))
+#define FGL_TRACE_CALL7(ret, name, a, b, c, d, e, f, g) \
+	FGL_TRACE_FUNC(ret, name, \
+		(FGL_TRACE_LIST7(FGL_TRACE_ARG_DECL, a, b, c, d, e, f, g)), \
+		(FGL_TRACE_LIST7(FGL_TRACE_ARG_NAME, a, b, c, d, e, f, g)), \
+		FGL_TRACE_EACH7(FGL_TRACE_ARG, a, b, c, d, e, f, g))
+#define FGL_TRACE_CALL8(ret, name, a, b, c, d, e, f, g, h) \
+	FGL_TRACE_FUNC(ret, name, \
+		(FGL_TRACE_LIST8(FGL_TRACE_ARG_DECL, a, b, c, d, e, f, g, h)), \
+		(FGL_TRACE_LIST8(FGL_TRACE_ARG_NAME, a, b, c, d, e, f, g, h)), \
+		FGL_TRACE_EACH8(FGL_TRACE_ARG, a, b, c, d, e, f, g, h))
+#define FGL_TRACE_CALL9(ret, name, a, b, c, d, e, f, g, h, i) \
+	FGL_TRACE_FUNC(ret, name, \
+		(FGL_TRACE_LIST9(FGL_TRACE_ARG_DECL, a, b, c, d, e, f, g, h, i)), \
+		(FGL_TRACE_LIST9(FGL_TRACE_ARG_NAME, a, b, c, d, e, f, g, h, i)), \
+		FGL_TRACE_EACH9(FGL_TRACE_ARG, a, b, c, d, e, f, g, h, i))
+
+#define FGL_TRACE_DRAW3(ret, name, a, b, c) \
+	FGL_TRACE_DRAW_FUNC(ret, name, \
+		(FGL_TRACE_LIST3(FGL_TRACE_ARG_DECL, a, b, c)), \
+		(FGL_TRACE_LIST3(FGL_TRACE_ARG_NAME, a, b, c)), \
+		FGL_TRACE_EACH3(FGL_TRACE_ARG, a, b, c))
+#define FGL_TRACE_DRAW4(ret, name, a, b, c, d) \
+	FGL_TRACE_DRAW_FUNC(ret, name, \
+		(FGL_TRACE_LIST4(FGL_TRACE_ARG_DECL, a, b, c, d)), \
+		(FGL_TRACE_LIST4(FGL_TRACE_ARG_NAME, a, b, c, d)), \
+		FGL_TRACE_EACH4(FGL_TRACE_ARG, a, b, c, d))
+
+/*
+ * Record IDs
+ */
+
+#define FGL_TRACE_FUNC(ret, name, decl, names, args) \
+	FGL_TRACE_ID_ ## name,
+#define FGL_TRACE_DRAW_FUNC	FGL_TRACE_FUNC
+#define FGL_TRACE_ARG(kind, type, name, size)
+
+enum {
+	FGL_TRACE_ID_INVALID = 0,
+	/* Current context or its surface changed */
+	FGL_TRACE_ID_MAKE_CURRENT,
+	/* eglSwapBuffers(), ends a frame */
+	FGL_TRACE_ID_SWAP_BUFFERS,
+	/* Client vertex array contents used by the following draw call */
+	FGL_TRACE_ID_CLIENT_ARRAY,
+	/* glEGLImageTargetTexture2DOES() with image description */
+	FGL_TRACE_ID_EGL_IMAGE,
+
+	/* Further IDs up to this one are reserved for special records */
+	FGL_TRACE_ID_RECORD_MAX = 15,
+#include "fgltracecalls.h"
+	FGL_TRACE_ID_COUNT
+};
+
+#define FGL_TRACE_ID_FIRST_CALL	(FGL_TRACE_ID_RECORD_MAX + 1)
+
+#undef FGL_TRACE_FUNC
+#undef FGL_TRACE_DRAW_FUNC
+#undef FGL_TRACE_ARG
+
+/*
+ * Stand-in for EGL images during replay, returned by eglGetProcAddress()
+ * of traced builds. Backs the texture with a surface of given pixel format.
+ */
+typedef void (GL_APIENTRYP PFNGLTRACEIMAGETARGETTEXTURE2DFIMGPROC)
+		(GLenum target, GLint format, GLsizei width, GLsizei height);
+
+/*
+ * Capture interface
+ */
+
+#ifdef FGL_TRACE
+
+extern void fglTraceSwapBuffers(void);
+
+GL_API void GL_APIENTRY glTraceImageTargetTexture2DFIMG(GLenum target,
+			GLint format, GLsizei width, GLsizei height);
+
+#if !defined(FGL_TRACE_NO_RENAME)
+/*
+ * Entry points are implemented under internal names, while the exported
+ * symbols are the recording wrappers from fgltrace.cpp. Calls made inside
+ * the library use the internal names and so are not recorded.
+ */
+#define FGL_TRACE_FUNC(ret, name, decl, names, args) \
+	GL_API ret GL_APIENTRY fglImpl_ ## name decl;
+#define FGL_TRACE_DRAW_FUNC	FGL_TRACE_FUNC
+#define FGL_TRACE_ARG(kind, type, name, size)
+
+#include "fgltracecalls.h"
+
+#undef FGL_TRACE_FUNC
+#undef FGL_TRACE_DRAW_FUNC
+#undef FGL_TRACE_ARG
+
+GL_API void GL_APIENTRY fglImpl_glEGLImageTargetTexture2DOES(GLenum target,
+							GLeglImageOES image);
+
+#define glGetError	fglImpl_glGetError
+#define glColor4f	fglImpl_glColor4f
+#define glColor4ub	fglImpl_glColor4ub
+#define glColor4x	fglImpl_glColor4x
+#define glNormal3f	fglImpl_glNormal3f
+#define glNormal3x	fglImpl_glNormal3x
+#define glMultiTexCoord4f	fglImpl_glMultiTexCoord4f
+#define glMultiTexCoord4x	fglImpl_glMultiTexCoord4x
+#define glGenBuffers	fglImpl_glGenBuffers
+#define glDeleteBuffers	fglImpl_glDeleteBuffers
+#define glBindBuffer	fglImpl_glBindBuffer
+#define glBufferData	fglImpl_glBufferData
+#define glBufferSubData	fglImpl_glBufferSubData
+#define glIsBuffer	fglImpl_glIsBuffer
+#define glVertexPointer	fglImpl_glVertexPointer
+#define glNormalPointer	fglImpl_glNormalPointer
+#define glColorPointer	fglImpl_glColorPointer
+#define glPointSizePointerOES	fglImpl_glPointSizePointerOES
+#define glTexCoordPointer	fglImpl_glTexCoordPointer
+#define glEnableClientState	fglImpl_glEnableClientState
+#define glDisableClientState	fglImpl_glDisableClientState
+#define glClientActiveTexture	fglImpl_glClientActiveTexture
+#define glShadeModel	fglImpl_glShadeModel
+#define glDrawArrays	fglImpl_glDrawArrays
+#define glDrawElements	fglImpl_glDrawElements
+#define glDrawTexfOES	fglImpl_glDrawTexfOES
+#define glDrawTexsOES	fglImpl_glDrawTexsOES
+#define glDrawTexiOES	fglImpl_glDrawTexiOES
+#define glDrawTexxOES	fglImpl_glDrawTexxOES
+#define glDrawTexsvOES	fglImpl_glDrawTexsvOES
+#define glDrawTexivOES	fglImpl_glDrawTexivOES
+#define glDrawTexxvOES	fglImpl_glDrawTexxvOES
+#define glDrawTexfvOES	fglImpl_glDrawTexfvOES
+#define glDepthRangef	fglImpl_glDepthRangef
+#define glDepthRangex	fglImpl_glDepthRangex
+#define glViewport	fglImpl_glViewport
+#define glCullFace	fglImpl_glCullFace
+#define glFrontFace	fglImpl_glFrontFace
+#define glLineWidth	fglImpl_glLineWidth
+#define glLineWidthx	fglImpl_glLineWidthx
+#define glPointSize	fglImpl_glPointSize
+#define glPointSizex	fglImpl_glPointSizex
+#define glPolygonOffset	fglImpl_glPolygonOffset
+#define glPolygonOffsetx	fglImpl_glPolygonOffsetx
+#define glScissor	fglImpl_glScissor
+#define glAlphaFunc	fglImpl_glAlphaFunc
+#define glAlphaFuncx	fglImpl_glAlphaFuncx
+#define glStencilFunc	fglImpl_glStencilFunc
+#define glStencilOp	fglImpl_glStencilOp
+#define glDepthFunc	fglImpl_glDepthFunc
+#define glBlendFunc	fglImpl_glBlendFunc
+#define glLogicOp	fglImpl_glLogicOp
+#define glColorMask	fglImpl_glColorMask
+#define glDepthMask	fglImpl_glDepthMask
+#define glStencilMask	fglImpl_glStencilMask
+#define glEnable	fglImpl_glEnable
+#define glDisable	fglImpl_glDisable
+#define glFlush	fglImpl_glFlush
+#define glFinish	fglImpl_glFinish
+#define glClipPlanef	fglImpl_glClipPlanef
+#define glClipPlanex	fglImpl_glClipPlanex
+#define glFogf	fglImpl_glFogf
+#define glFogfv	fglImpl_glFogfv
+#define glFogx	fglImpl_glFogx
+#define glFogxv	fglImpl_glFogxv
+#define glHint	fglImpl_glHint
+#define glLightModelf	fglImpl_glLightModelf
+#define glLightModelfv	fglImpl_glLightModelfv
+#define glLightModelx	fglImpl_glLightModelx
+#define glLightModelxv	fglImpl_glLightModelxv
+#define glLightf	fglImpl_glLightf
+#define glLightfv	fglImpl_glLightfv
+#define glLightx	fglImpl_glLightx
+#define glLightxv	fglImpl_glLightxv
+#define glMaterialf	fglImpl_glMaterialf
+#define glMaterialfv	fglImpl_glMaterialfv
+#define glMaterialx	fglImpl_glMaterialx
+#define glMaterialxv	fglImpl_glMaterialxv
+#define glPointParameterf	fglImpl_glPointParameterf
+#define glPointParameterfv	fglImpl_glPointParameterfv
+#define glPointParameterx	fglImpl_glPointParameterx
+#define glPointParameterxv	fglImpl_glPointParameterxv
+#define glMatrixMode	fglImpl_glMatrixMode
+#define glLoadMatrixf	fglImpl_glLoadMatrixf
+#define glLoadMatrixx	fglImpl_glLoadMatrixx
+#define glMultMatrixf	fglImpl_glMultMatrixf
+#define glMultMatrixx	fglImpl_glMultMatrixx
+#define glLoadIdentity	fglImpl_glLoadIdentity
+#define glRotatef	fglImpl_glRotatef
+#define glRotatex	fglImpl_glRotatex
+#define glTranslatef	fglImpl_glTranslatef
+#define glTranslatex	fglImpl_glTranslatex
+#define glScalef	fglImpl_glScalef
+#define glScalex	fglImpl_glScalex
+#define glFrustumf	fglImpl_glFrustumf
+#define glFrustumx	fglImpl_glFrustumx
+#define glOrthof	fglImpl_glOrthof
+#define glOrthox	fglImpl_glOrthox
+#define glPopMatrix	fglImpl_glPopMatrix
+#define glPushMatrix	fglImpl_glPushMatrix
+#define glGenTextures	fglImpl_glGenTextures
+#define glDeleteTextures	fglImpl_glDeleteTextures
+#define glBindTexture	fglImpl_glBindTexture
+#define glTexImage2D	fglImpl_glTexImage2D
+#define glTexSubImage2D	fglImpl_glTexSubImage2D
+#define glCompressedTexImage2D	fglImpl_glCompressedTexImage2D
+#define glCompressedTexSubImage2D	fglImpl_glCompressedTexSubImage2D
+#define glCopyTexImage2D	fglImpl_glCopyTexImage2D
+#define glCopyTexSubImage2D	fglImpl_glCopyTexSubImage2D
+#define glActiveTexture	fglImpl_glActiveTexture
+#define glTexParameteri	fglImpl_glTexParameteri
+#define glTexParameteriv	fglImpl_glTexParameteriv
+#define glTexParameterf	fglImpl_glTexParameterf
+#define glTexParameterfv	fglImpl_glTexParameterfv
+#define glTexParameterx	fglImpl_glTexParameterx
+#define glTexParameterxv	fglImpl_glTexParameterxv
+#define glTexEnvi	fglImpl_glTexEnvi
+#define glTexEnvfv	fglImpl_glTexEnvfv
+#define glTexEnvf	fglImpl_glTexEnvf
+#define glTexEnvx	fglImpl_glTexEnvx
+#define glTexEnviv	fglImpl_glTexEnviv
+#define glTexEnvxv	fglImpl_glTexEnvxv
+#define glGetTexEnvfv	fglImpl_glGetTexEnvfv
+#define glGetTexEnviv	fglImpl_glGetTexEnviv
+#define glGetTexEnvxv	fglImpl_glGetTexEnvxv
+#define glGetTexParameterfv	fglImpl_glGetTexParameterfv
+#define glGetTexParameteriv	fglImpl_glGetTexParameteriv
+#define glGetTexParameterxv	fglImpl_glGetTexParameterxv
+#define glIsTexture	fglImpl_glIsTexture
+#define glPixelStorei	fglImpl_glPixelStorei
+#define glReadPixels	fglImpl_glReadPixels
+#define glClear	fglImpl_glClear
+#define glClearColor	fglImpl_glClearColor
+#define glClearColorx	fglImpl_glClearColorx
+#define glClearDepthf	fglImpl_glClearDepthf
+#define glClearDepthx	fglImpl_glClearDepthx
+#define glClearStencil	fglImpl_glClearStencil
+#define glGetString	fglImpl_glGetString
+#define glGetIntegerv	fglImpl_glGetIntegerv
+#define glGetBooleanv	fglImpl_glGetBooleanv
+#define glGetFixedv	fglImpl_glGetFixedv
+#define glGetFloatv	fglImpl_glGetFloatv
+#define glGetPointerv	fglImpl_glGetPointerv
+#define glIsEnabled	fglImpl_glIsEnabled
+#define glGetBufferParameteriv	fglImpl_glGetBufferParameteriv
+#define glGetClipPlanef	fglImpl_glGetClipPlanef
+#define glGetClipPlanex	fglImpl_glGetClipPlanex
+#define glGetLightfv	fglImpl_glGetLightfv
+#define glGetLightxv	fglImpl_glGetLightxv
+#define glGetMaterialfv	fglImpl_glGetMaterialfv
+#define glGetMaterialxv	fglImpl_glGetMaterialxv
+#define glGenRenderbuffersOES	fglImpl_glGenRenderbuffersOES
+#define glDeleteRenderbuffersOES	fglImpl_glDeleteRenderbuffersOES
+#define glBindRenderbufferOES	fglImpl_glBindRenderbufferOES
+#define glIsRenderbufferOES	fglImpl_glIsRenderbufferOES
+#define glRenderbufferStorageOES	fglImpl_glRenderbufferStorageOES
+#define glGetRenderbufferParameterivOES	fglImpl_glGetRenderbufferParameterivOES
+#define glGenFramebuffersOES	fglImpl_glGenFramebuffersOES
+#define glDeleteFramebuffersOES	fglImpl_glDeleteFramebuffersOES
+#define glBindFramebufferOES	fglImpl_glBindFramebufferOES
+#define glIsFramebufferOES	fglImpl_glIsFramebufferOES
+#define glCheckFramebufferStatusOES	fglImpl_glCheckFramebufferStatusOES
+#define glFramebufferRenderbufferOES	fglImpl_glFramebufferRenderbufferOES
+#define glFramebufferTexture2DOES	fglImpl_glFramebufferTexture2DOES
+#define glGetFramebufferAttachmentParameterivOES	fglImpl_glGetFramebufferAttachmentParameterivOES
+#define glEGLImageTargetTexture2DOES	fglImpl_glEGLImageTargetTexture2DOES
+#endif /* FGL_TRACE_NO_RENAME */
+
+#endif /* FGL_TRACE */
+
+#endif /* _LIBSGL_FGLTRACE_H_ */
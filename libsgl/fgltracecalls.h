@@ -0,0 +1,809 @@
+/*
+ * libsgl/fgltracecalls.h
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2013 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Table of traced GL entry points, included by fgltrace.h, fgltrace.cpp
+ * and fglreplay.cpp with different definitions of FGL_TRACE_CALLn
+ * and FGL_TRACE_DRAWn. Each argument is described as a tuple of
+ *	(kind, type, name, size)
+ * where kind is one of:
+ *	Val	- 32-bit scalar,
+ *	Long	- pointer sized integer, stored as 64 bits,
+ *	Ptr	- pointer stored by value (buffer offsets, client arrays),
+ *	Data	- pointer to size bytes of input data stored in the trace,
+ *	Out	- pointer to size bytes of output data, not stored.
+ *
+ * Call IDs are assigned in table order, so new entries must be appended
+ * at the end to keep old traces readable.
+ */
+
+FGL_TRACE_CALL0(GLenum, glGetError)
+
+FGL_TRACE_CALL4(void, glColor4f,
+	(Val, GLfloat, red, 0),
+	(Val, GLfloat, green, 0),
+	(Val, GLfloat, blue, 0),
+	(Val, GLfloat, alpha, 0))
+
+FGL_TRACE_CALL4(void, glColor4ub,
+	(Val, GLubyte, red, 0),
+	(Val, GLubyte, green, 0),
+	(Val, GLubyte, blue, 0),
+	(Val, GLubyte, alpha, 0))
+
+FGL_TRACE_CALL4(void, glColor4x,
+	(Val, GLfixed, red, 0),
+	(Val, GLfixed, green, 0),
+	(Val, GLfixed, blue, 0),
+	(Val, GLfixed, alpha, 0))
+
+FGL_TRACE_CALL3(void, glNormal3f,
+	(Val, GLfloat, nx, 0),
+	(Val, GLfloat, ny, 0),
+	(Val, GLfloat, nz, 0))
+
+FGL_TRACE_CALL3(void, glNormal3x,
+	(Val, GLfixed, nx, 0),
+	(Val, GLfixed, ny, 0),
+	(Val, GLfixed, nz, 0))
+
+FGL_TRACE_CALL5(void, glMultiTexCoord4f,
+	(Val, GLenum, target, 0),
+	(Val, GLfloat, s, 0),
+	(Val, GLfloat, t, 0),
+	(Val, GLfloat, r, 0),
+	(Val, GLfloat, q, 0))
+
+FGL_TRACE_CALL5(void, glMultiTexCoord4x,
+	(Val, GLenum, target, 0),
+	(Val, GLfixed, s, 0),
+	(Val, GLfixed, t, 0),
+	(Val, GLfixed, r, 0),
+	(Val, GLfixed, q, 0))
+
+FGL_TRACE_CALL2(void, glGenBuffers,
+	(Val, GLsizei, n, 0),
+	(Out, GLuint *, buffers, n * sizeof(GLuint)))
+
+FGL_TRACE_CALL2(void, glDeleteBuffers,
+	(Val, GLsizei, n, 0),
+	(Data, const GLuint *, buffers, n * sizeof(GLuint)))
+
+FGL_TRACE_CALL2(void, glBindBuffer,
+	(Val, GLenum, target, 0),
+	(Val, GLuint, buffer, 0))
+
+FGL_TRACE_CALL4(void, glBufferData,
+	(Val, GLenum, target, 0),
+	(Long, GLsizeiptr, size, 0),
+	(Data, const GLvoid *, data, size),
+	(Val, GLenum, usage, 0))
+
+FGL_TRACE_CALL4(void, glBufferSubData,
+	(Val, GLenum, target, 0),
+	(Long, GLintptr, offset, 0),
+	(Long, GLsizeiptr, size, 0),
+	(Data, const GLvoid *, data, size))
+
+FGL_TRACE_CALL1(GLboolean, glIsBuffer,
+	(Val, GLuint, buffer, 0))
+
+FGL_TRACE_CALL4(void, glVertexPointer,
+	(Val, GLint, size, 0),
+	(Val, GLenum, type, 0),
+	(Val, GLsizei, stride, 0),
+	(Ptr, const GLvoid *, pointer, 0))
+
+FGL_TRACE_CALL3(void, glNormalPointer,
+	(Val, GLenum, type, 0),
+	(Val, GLsizei, stride, 0),
+	(Ptr, const GLvoid *, pointer, 0))
+
+FGL_TRACE_CALL4(void, glColorPointer,
+	(Val, GLint, size, 0),
+	(Val, GLenum, type, 0),
+	(Val, GLsizei, stride, 0),
+	(Ptr, const GLvoid *, pointer, 0))
+
+FGL_TRACE_CALL3(void, glPointSizePointerOES,
+	(Val, GLenum, type, 0),
+	(Val, GLsizei, stride, 0),
+	(Ptr, const GLvoid *, pointer, 0))
+
+FGL_TRACE_CALL4(void, glTexCoordPointer,
+	(Val, GLint, size, 0),
+	(Val, GLenum, type, 0),
+	(Val, GLsizei, stride, 0),
+	(Ptr, const GLvoid *, pointer, 0))
+
+FGL_TRACE_CALL1(void, glEnableClientState,
+	(Val, GLenum, array, 0))
+
+FGL_TRACE_CALL1(void, glDisableClientState,
+	(Val, GLenum, array, 0))
+
+FGL_TRACE_CALL1(void, glClientActiveTexture,
+	(Val, GLenum, texture, 0))
+
+FGL_TRACE_CALL1(void, glShadeModel,
+	(Val, GLenum, mode, 0))
+
+FGL_TRACE_DRAW3(void, glDrawArrays,
+	(Val, GLenum, mode, 0),
+	(Val, GLint, first, 0),
+	(Val, GLsizei, count, 0))
+
+FGL_TRACE_DRAW4(void, glDrawElements,
+	(Val, GLenum, mode, 0),
+	(Val, GLsizei, count, 0),
+	(Val, GLenum, type, 0),
+	(Data, const GLvoid *, indices, fglTraceIndexSize(count, type)))
+
+FGL_TRACE_CALL5(void, glDrawTexfOES,
+	(Val, GLfloat, x, 0),
+	(Val, GLfloat, y, 0),
+	(Val, GLfloat, z, 0),
+	(Val, GLfloat, width, 0),
+	(Val, GLfloat, height, 0))
+
+FGL_TRACE_CALL5(void, glDrawTexsOES,
+	(Val, GLshort, x, 0),
+	(Val, GLshort, y, 0),
+	(Val, GLshort, z, 0),
+	(Val, GLshort, width, 0),
+	(Val, GLshort, height, 0))
+
+FGL_TRACE_CALL5(void, glDrawTexiOES,
+	(Val, GLint, x, 0),
+	(Val, GLint, y, 0),
+	(Val, GLint, z, 0),
+	(Val, GLint, width, 0),
+	(Val, GLint, height, 0))
+
+FGL_TRACE_CALL5(void, glDrawTexxOES,
+	(Val, GLfixed, x, 0),
+	(Val, GLfixed, y, 0),
+	(Val, GLfixed, z, 0),
+	(Val, GLfixed, width, 0),
+	(Val, GLfixed, height, 0))
+
+FGL_TRACE_CALL1(void, glDrawTexsvOES,
+	(Data, const GLshort *, coords, 5 * sizeof(*coords)))
+
+FGL_TRACE_CALL1(void, glDrawTexivOES,
+	(Data, const GLint *, coords, 5 * sizeof(*coords)))
+
+FGL_TRACE_CALL1(void, glDrawTexxvOES,
+	(Data, const GLfixed *, coords, 5 * sizeof(*coords)))
+
+FGL_TRACE_CALL1(void, glDrawTexfvOES,
+	(Data, const GLfloat *, coords, 5 * sizeof(*coords)))
+
+FGL_TRACE_CALL2(void, glDepthRangef,
+	(Val, GLclampf, zNear, 0),
+	(Val, GLclampf, zFar, 0))
+
+FGL_TRACE_CALL2(void, glDepthRangex,
+	(Val, GLclampx, zNear, 0),
+	(Val, GLclampx, zFar, 0))
+
+FGL_TRACE_CALL4(void, glViewport,
+	(Val, GLint, x, 0),
+	(Val, GLint, y, 0),
+	(Val, GLsizei, width, 0),
+	(Val, GLsizei, height, 0))
+
+FGL_TRACE_CALL1(void, glCullFace,
+	(Val, GLenum, mode, 0))
+
+FGL_TRACE_CALL1(void, glFrontFace,
+	(Val, GLenum, mode, 0))
+
+FGL_TRACE_CALL1(void, glLineWidth,
+	(Val, GLfloat, width, 0))
+
+FGL_TRACE_CALL1(void, glLineWidthx,
+	(Val, GLfixed, width, 0))
+
+FGL_TRACE_CALL1(void, glPointSize,
+	(Val, GLfloat, size, 0))
+
+FGL_TRACE_CALL1(void, glPointSizex,
+	(Val, GLfixed, size, 0))
+
+FGL_TRACE_CALL2(void, glPolygonOffset,
+	(Val, GLfloat, factor, 0),
+	(Val, GLfloat, units, 0))
+
+FGL_TRACE_CALL2(void, glPolygonOffsetx,
+	(Val, GLfixed, factor, 0),
+	(Val, GLfixed, units, 0))
+
+FGL_TRACE_CALL4(void, glScissor,
+	(Val, GLint, x, 0),
+	(Val, GLint, y, 0),
+	(Val, GLsizei, width, 0),
+	(Val, GLsizei, height, 0))
+
+FGL_TRACE_CALL2(void, glAlphaFunc,
+	(Val, GLenum, func, 0),
+	(Val, GLclampf, ref, 0))
+
+FGL_TRACE_CALL2(void, glAlphaFuncx,
+	(Val, GLenum, func, 0),
+	(Val, GLclampx, ref, 0))
+
+FGL_TRACE_CALL3(void, glStencilFunc,
+	(Val, GLenum, func, 0),
+	(Val, GLint, ref, 0),
+	(Val, GLuint, mask, 0))
+
+FGL_TRACE_CALL3(void, glStencilOp,
+	(Val, GLenum, fail, 0),
+	(Val, GLenum, zfail, 0),
+	(Val, GLenum, zpass, 0))
+
+FGL_TRACE_CALL1(void, glDepthFunc,
+	(Val, GLenum, func, 0))
+
+FGL_TRACE_CALL2(void, glBlendFunc,
+	(Val, GLenum, sfactor, 0),
+	(Val, GLenum, dfactor, 0))
+
+FGL_TRACE_CALL1(void, glLogicOp,
+	(Val, GLenum, opcode, 0))
+
+FGL_TRACE_CALL4(void, glColorMask,
+	(Val, GLboolean, red, 0),
+	(Val, GLboolean, green, 0),
+	(Val, GLboolean, blue, 0),
+	(Val, GLboolean, alpha, 0))
+
+FGL_TRACE_CALL1(void, glDepthMask,
+	(Val, GLboolean, flag, 0))
+
+FGL_TRACE_CALL1(void, glStencilMask,
+	(Val, GLuint, mask, 0))
+
+FGL_TRACE_CALL1(void, glEnable,
+	(Val, GLenum, cap, 0))
+
+FGL_TRACE_CALL1(void, glDisable,
+	(Val, GLenum, cap, 0))
+
+FGL_TRACE_CALL0(void, glFlush)
+
+FGL_TRACE_CALL0(void, glFinish)
+
+FGL_TRACE_CALL2(void, glClipPlanef,
+	(Val, GLenum, plane, 0),
+	(Data, const GLfloat *, equation, 4 * sizeof(*equation)))
+
+FGL_TRACE_CALL2(void, glClipPlanex,
+	(Val, GLenum, plane, 0),
+	(Data, const GLfixed *, equation, 4 * sizeof(*equation)))
+
+FGL_TRACE_CALL2(void, glFogf,
+	(Val, GLenum, pname, 0),
+	(Val, GLfloat, param, 0))
+
+FGL_TRACE_CALL2(void, glFogfv,
+	(Val, GLenum, pname, 0),
+	(Data, const GLfloat *, params, fglTraceParamCount(pname) * sizeof(*params)))
+
+FGL_TRACE_CALL2(void, glFogx,
+	(Val, GLenum, pname, 0),
+	(Val, GLfixed, param, 0))
+
+FGL_TRACE_CALL2(void, glFogxv,
+	(Val, GLenum, pname, 0),
+	(Data, const GLfixed *, params, fglTraceParamCount(pname) * sizeof(*params)))
+
+FGL_TRACE_CALL2(void, glHint,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, mode, 0))
+
+FGL_TRACE_CALL2(void, glLightModelf,
+	(Val, GLenum, pname, 0),
+	(Val, GLfloat, param, 0))
+
+FGL_TRACE_CALL2(void, glLightModelfv,
+	(Val, GLenum, pname, 0),
+	(Data, const GLfloat *, params, fglTraceParamCount(pname) * sizeof(*params)))
+
+FGL_TRACE_CALL2(void, glLightModelx,
+	(Val, GLenum, pname, 0),
+	(Val, GLfixed, param, 0))
+
+FGL_TRACE_CALL2(void, glLightModelxv,
+	(Val, GLenum, pname, 0),
+	(Data, const GLfixed *, params, fglTraceParamCount(pname) * sizeof(*params)))
+
+FGL_TRACE_CALL3(void, glLightf,
+	(Val, GLenum, light, 0),
+	(Val, GLenum, pname, 0),
+	(Val, GLfloat, param, 0))
+
+FGL_TRACE_CALL3(void, glLightfv,
+	(Val, GLenum, light, 0),
+	(Val, GLenum, pname, 0),
+	(Data, const GLfloat *, params, fglTraceParamCount(pname) * sizeof(*params)))
+
+FGL_TRACE_CALL3(void, glLightx,
+	(Val, GLenum, light, 0),
+	(Val, GLenum, pname, 0),
+	(Val, GLfixed, param, 0))
+
+FGL_TRACE_CALL3(void, glLightxv,
+	(Val, GLenum, light, 0),
+	(Val, GLenum, pname, 0),
+	(Data, const GLfixed *, params, fglTraceParamCount(pname) * sizeof(*params)))
+
+FGL_TRACE_CALL3(void, glMaterialf,
+	(Val, GLenum, face, 0),
+	(Val, GLenum, pname, 0),
+	(Val, GLfloat, param, 0))
+
+FGL_TRACE_CALL3(void, glMaterialfv,
+	(Val, GLenum, face, 0),
+	(Val, GLenum, pname, 0),
+	(Data, const GLfloat *, params, fglTraceParamCount(pname) * sizeof(*params)))
+
+FGL_TRACE_CALL3(void, glMaterialx,
+	(Val, GLenum, face, 0),
+	(Val, GLenum, pname, 0),
+	(Val, GLfixed, param, 0))
+
+FGL_TRACE_CALL3(void, glMaterialxv,
+	(Val, GLenum, face, 0),
+	(Val, GLenum, pname, 0),
+	(Data, const GLfixed *, params, fglTraceParamCount(pname) * sizeof(*params)))
+
+FGL_TRACE_CALL2(void, glPointParameterf,
+	(Val, GLenum, pname, 0),
+	(Val, GLfloat, param, 0))
+
+FGL_TRACE_CALL2(void, glPointParameterfv,
+	(Val, GLenum, pname, 0),
+	(Data, const GLfloat *, params, fglTraceParamCount(pname) * sizeof(*params)))
+
+FGL_TRACE_CALL2(void, glPointParameterx,
+	(Val, GLenum, pname, 0),
+	(Val, GLfixed, param, 0))
+
+FGL_TRACE_CALL2(void, glPointParameterxv,
+	(Val, GLenum, pname, 0),
+	(Data, const GLfixed *, params, fglTraceParamCount(pname) * sizeof(*params)))
+
+FGL_TRACE_CALL1(void, glMatrixMode,
+	(Val, GLenum, mode, 0))
+
+FGL_TRACE_CALL1(void, glLoadMatrixf,
+	(Data, const GLfloat *, m, 16 * sizeof(*m)))
+
+FGL_TRACE_CALL1(void, glLoadMatrixx,
+	(Data, const GLfixed *, m, 16 * sizeof(*m)))
+
+FGL_TRACE_CALL1(void, glMultMatrixf,
+	(Data, const GLfloat *, m, 16 * sizeof(*m)))
+
+FGL_TRACE_CALL1(void, glMultMatrixx,
+	(Data, const GLfixed *, m, 16 * sizeof(*m)))
+
+FGL_TRACE_CALL0(void, glLoadIdentity)
+
+FGL_TRACE_CALL4(void, glRotatef,
+	(Val, GLfloat, angle, 0),
+	(Val, GLfloat, x, 0),
+	(Val, GLfloat, y, 0),
+	(Val, GLfloat, z, 0))
+
+FGL_TRACE_CALL4(void, glRotatex,
+	(Val, GLfixed, angle, 0),
+	(Val, GLfixed, x, 0),
+	(Val, GLfixed, y, 0),
+	(Val, GLfixed, z, 0))
+
+FGL_TRACE_CALL3(void, glTranslatef,
+	(Val, GLfloat, x, 0),
+	(Val, GLfloat, y, 0),
+	(Val, GLfloat, z, 0))
+
+FGL_TRACE_CALL3(void, glTranslatex,
+	(Val, GLfixed, x, 0),
+	(Val, GLfixed, y, 0),
+	(Val, GLfixed, z, 0))
+
+FGL_TRACE_CALL3(void, glScalef,
+	(Val, GLfloat, x, 0),
+	(Val, GLfloat, y, 0),
+	(Val, GLfloat, z, 0))
+
+FGL_TRACE_CALL3(void, glScalex,
+	(Val, GLfixed, x, 0),
+	(Val, GLfixed, y, 0),
+	(Val, GLfixed, z, 0))
+
+FGL_TRACE_CALL6(void, glFrustumf,
+	(Val, GLfloat, left, 0),
+	(Val, GLfloat, right, 0),
+	(Val, GLfloat, bottom, 0),
+	(Val, GLfloat, top, 0),
+	(Val, GLfloat, zNear, 0),
+	(Val, GLfloat, zFar, 0))
+
+FGL_TRACE_CALL6(void, glFrustumx,
+	(Val, GLfixed, left, 0),
+	(Val, GLfixed, right, 0),
+	(Val, GLfixed, bottom, 0),
+	(Val, GLfixed, top, 0),
+	(Val, GLfixed, zNear, 0),
+	(Val, GLfixed, zFar, 0))
+
+FGL_TRACE_CALL6(void, glOrthof,
+	(Val, GLfloat, left, 0),
+	(Val, GLfloat, right, 0),
+	(Val, GLfloat, bottom, 0),
+	(Val, GLfloat, top, 0),
+	(Val, GLfloat, zNear, 0),
+	(Val, GLfloat, zFar, 0))
+
+FGL_TRACE_CALL6(void, glOrthox,
+	(Val, GLfixed, left, 0),
+	(Val, GLfixed, right, 0),
+	(Val, GLfixed, bottom, 0),
+	(Val, GLfixed, top, 0),
+	(Val, GLfixed, zNear, 0),
+	(Val, GLfixed, zFar, 0))
+
+FGL_TRACE_CALL0(void, glPopMatrix)
+
+FGL_TRACE_CALL0(void, glPushMatrix)
+
+FGL_TRACE_CALL2(void, glGenTextures,
+	(Val, GLsizei, n, 0),
+	(Out, GLuint *, textures, n * sizeof(GLuint)))
+
+FGL_TRACE_CALL2(void, glDeleteTextures,
+	(Val, GLsizei, n, 0),
+	(Data, const GLuint *, textures, n * sizeof(GLuint)))
+
+FGL_TRACE_CALL2(void, glBindTexture,
+	(Val, GLenum, target, 0),
+	(Val, GLuint, texture, 0))
+
+FGL_TRACE_CALL9(void, glTexImage2D,
+	(Val, GLenum, target, 0),
+	(Val, GLint, level, 0),
+	(Val, GLint, internalformat, 0),
+	(Val, GLsizei, width, 0),
+	(Val, GLsizei, height, 0),
+	(Val, GLint, border, 0),
+	(Val, GLenum, format, 0),
+	(Val, GLenum, type, 0),
+	(Data, const GLvoid *, pixels, fglTraceImageSize(width, height, format, type)))
+
+FGL_TRACE_CALL9(void, glTexSubImage2D,
+	(Val, GLenum, target, 0),
+	(Val, GLint, level, 0),
+	(Val, GLint, xoffset, 0),
+	(Val, GLint, yoffset, 0),
+	(Val, GLsizei, width, 0),
+	(Val, GLsizei, height, 0),
+	(Val, GLenum, format, 0),
+	(Val, GLenum, type, 0),
+	(Data, const GLvoid *, pixels, fglTraceImageSize(width, height, format, type)))
+
+FGL_TRACE_CALL8(void, glCompressedTexImage2D,
+	(Val, GLenum, target, 0),
+	(Val, GLint, level, 0),
+	(Val, GLenum, internalformat, 0),
+	(Val, GLsizei, width, 0),
+	(Val, GLsizei, height, 0),
+	(Val, GLint, border, 0),
+	(Val, GLsizei, imageSize, 0),
+	(Data, const GLvoid *, data, imageSize))
+
+FGL_TRACE_CALL9(void, glCompressedTexSubImage2D,
+	(Val, GLenum, target, 0),
+	(Val, GLint, level, 0),
+	(Val, GLint, xoffset, 0),
+	(Val, GLint, yoffset, 0),
+	(Val, GLsizei, width, 0),
+	(Val, GLsizei, height, 0),
+	(Val, GLenum, format, 0),
+	(Val, GLsizei, imageSize, 0),
+	(Data, const GLvoid *, data, imageSize))
+
+FGL_TRACE_CALL8(void, glCopyTexImage2D,
+	(Val, GLenum, target, 0),
+	(Val, GLint, level, 0),
+	(Val, GLenum, internalformat, 0),
+	(Val, GLint, x, 0),
+	(Val, GLint, y, 0),
+	(Val, GLsizei, width, 0),
+	(Val, GLsizei, height, 0),
+	(Val, GLint, border, 0))
+
+FGL_TRACE_CALL8(void, glCopyTexSubImage2D,
+	(Val, GLenum, target, 0),
+	(Val, GLint, level, 0),
+	(Val, GLint, xoffset, 0),
+	(Val, GLint, yoffset, 0),
+	(Val, GLint, x, 0),
+	(Val, GLint, y, 0),
+	(Val, GLsizei, width, 0),
+	(Val, GLsizei, height, 0))
+
+FGL_TRACE_CALL1(void, glActiveTexture,
+	(Val, GLenum, texture, 0))
+
+FGL_TRACE_CALL3(void, glTexParameteri,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, pname, 0),
+	(Val, GLint, param, 0))
+
+FGL_TRACE_CALL3(void, glTexParameteriv,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, pname, 0),
+	(Data, const GLint *, params, fglTraceParamCount(pname) * sizeof(*params)))
+
+FGL_TRACE_CALL3(void, glTexParameterf,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, pname, 0),
+	(Val, GLfloat, param, 0))
+
+FGL_TRACE_CALL3(void, glTexParameterfv,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, pname, 0),
+	(Data, const GLfloat *, params, fglTraceParamCount(pname) * sizeof(*params)))
+
+FGL_TRACE_CALL3(void, glTexParameterx,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, pname, 0),
+	(Val, GLfixed, param, 0))
+
+FGL_TRACE_CALL3(void, glTexParameterxv,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, pname, 0),
+	(Data, const GLfixed *, params, fglTraceParamCount(pname) * sizeof(*params)))
+
+FGL_TRACE_CALL3(void, glTexEnvi,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, pname, 0),
+	(Val, GLint, param, 0))
+
+FGL_TRACE_CALL3(void, glTexEnvfv,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, pname, 0),
+	(Data, const GLfloat *, params, fglTraceParamCount(pname) * sizeof(*params)))
+
+FGL_TRACE_CALL3(void, glTexEnvf,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, pname, 0),
+	(Val, GLfloat, param, 0))
+
+FGL_TRACE_CALL3(void, glTexEnvx,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, pname, 0),
+	(Val, GLfixed, param, 0))
+
+FGL_TRACE_CALL3(void, glTexEnviv,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, pname, 0),
+	(Data, const GLint *, params, fglTraceParamCount(pname) * sizeof(*params)))
+
+FGL_TRACE_CALL3(void, glTexEnvxv,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, pname, 0),
+	(Data, const GLfixed *, params, fglTraceParamCount(pname) * sizeof(*params)))
+
+FGL_TRACE_CALL3(void, glGetTexEnvfv,
+	(Val, GLenum, env, 0),
+	(Val, GLenum, pname, 0),
+	(Out, GLfloat *, params, FGL_TRACE_GET_SIZE))
+
+FGL_TRACE_CALL3(void, glGetTexEnviv,
+	(Val, GLenum, env, 0),
+	(Val, GLenum, pname, 0),
+	(Out, GLint *, params, FGL_TRACE_GET_SIZE))
+
+FGL_TRACE_CALL3(void, glGetTexEnvxv,
+	(Val, GLenum, env, 0),
+	(Val, GLenum, pname, 0),
+	(Out, GLfixed *, params, FGL_TRACE_GET_SIZE))
+
+FGL_TRACE_CALL3(void, glGetTexParameterfv,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, pname, 0),
+	(Out, GLfloat *, params, FGL_TRACE_GET_SIZE))
+
+FGL_TRACE_CALL3(void, glGetTexParameteriv,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, pname, 0),
+	(Out, GLint *, params, FGL_TRACE_GET_SIZE))
+
+FGL_TRACE_CALL3(void, glGetTexParameterxv,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, pname, 0),
+	(Out, GLfixed *, params, FGL_TRACE_GET_SIZE))
+
+FGL_TRACE_CALL1(GLboolean, glIsTexture,
+	(Val, GLuint, texture, 0))
+
+FGL_TRACE_CALL2(void, glPixelStorei,
+	(Val, GLenum, pname, 0),
+	(Val, GLint, param, 0))
+
+FGL_TRACE_CALL7(void, glReadPixels,
+	(Val, GLint, x, 0),
+	(Val, GLint, y, 0),
+	(Val, GLsizei, width, 0),
+	(Val, GLsizei, height, 0),
+	(Val, GLenum, format, 0),
+	(Val, GLenum, type, 0),
+	(Out, GLvoid *, pixels, fglTraceImageSize(width, height, format, type)))
+
+FGL_TRACE_CALL1(void, glClear,
+	(Val, GLbitfield, mask, 0))
+
+FGL_TRACE_CALL4(void, glClearColor,
+	(Val, GLclampf, red, 0),
+	(Val, GLclampf, green, 0),
+	(Val, GLclampf, blue, 0),
+	(Val, GLclampf, alpha, 0))
+
+FGL_TRACE_CALL4(void, glClearColorx,
+	(Val, GLclampx, red, 0),
+	(Val, GLclampx, green, 0),
+	(Val, GLclampx, blue, 0),
+	(Val, GLclampx, alpha, 0))
+
+FGL_TRACE_CALL1(void, glClearDepthf,
+	(Val, GLclampf, depth, 0))
+
+FGL_TRACE_CALL1(void, glClearDepthx,
+	(Val, GLclampx, depth, 0))
+
+FGL_TRACE_CALL1(void, glClearStencil,
+	(Val, GLint, s, 0))
+
+FGL_TRACE_CALL1(const GLubyte *, glGetString,
+	(Val, GLenum, name, 0))
+
+FGL_TRACE_CALL2(void, glGetIntegerv,
+	(Val, GLenum, pname, 0),
+	(Out, GLint *, params, FGL_TRACE_GET_SIZE))
+
+FGL_TRACE_CALL2(void, glGetBooleanv,
+	(Val, GLenum, pname, 0),
+	(Out, GLboolean *, params, FGL_TRACE_GET_SIZE))
+
+FGL_TRACE_CALL2(void, glGetFixedv,
+	(Val, GLenum, pname, 0),
+	(Out, GLfixed *, params, FGL_TRACE_GET_SIZE))
+
+FGL_TRACE_CALL2(void, glGetFloatv,
+	(Val, GLenum, pname, 0),
+	(Out, GLfloat *, params, FGL_TRACE_GET_SIZE))
+
+FGL_TRACE_CALL2(void, glGetPointerv,
+	(Val, GLenum, pname, 0),
+	(Out, void * *, params, FGL_TRACE_GET_SIZE))
+
+FGL_TRACE_CALL1(GLboolean, glIsEnabled,
+	(Val, GLenum, cap, 0))
+
+FGL_TRACE_CALL3(void, glGetBufferParameteriv,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, pname, 0),
+	(Out, GLint *, params, FGL_TRACE_GET_SIZE))
+
+FGL_TRACE_CALL2(void, glGetClipPlanef,
+	(Val, GLenum, pname, 0),
+	(Out, GLfloat *, eqn, FGL_TRACE_GET_SIZE))
+
+FGL_TRACE_CALL2(void, glGetClipPlanex,
+	(Val, GLenum, pname, 0),
+	(Out, GLfixed *, eqn, FGL_TRACE_GET_SIZE))
+
+FGL_TRACE_CALL3(void, glGetLightfv,
+	(Val, GLenum, light, 0),
+	(Val, GLenum, pname, 0),
+	(Out, GLfloat *, params, FGL_TRACE_GET_SIZE))
+
+FGL_TRACE_CALL3(void, glGetLightxv,
+	(Val, GLenum, light, 0),
+	(Val, GLenum, pname, 0),
+	(Out, GLfixed *, params, FGL_TRACE_GET_SIZE))
+
+FGL_TRACE_CALL3(void, glGetMaterialfv,
+	(Val, GLenum, face, 0),
+	(Val, GLenum, pname, 0),
+	(Out, GLfloat *, params, FGL_TRACE_GET_SIZE))
+
+FGL_TRACE_CALL3(void, glGetMaterialxv,
+	(Val, GLenum, face, 0),
+	(Val, GLenum, pname, 0),
+	(Out, GLfixed *, params, FGL_TRACE_GET_SIZE))
+
+FGL_TRACE_CALL2(void, glGenRenderbuffersOES,
+	(Val, GLsizei, n, 0),
+	(Out, GLuint *, renderbuffers, n * sizeof(GLuint)))
+
+FGL_TRACE_CALL2(void, glDeleteRenderbuffersOES,
+	(Val, GLsizei, n, 0),
+	(Data, const GLuint *, renderbuffers, n * sizeof(GLuint)))
+
+FGL_TRACE_CALL2(void, glBindRenderbufferOES,
+	(Val, GLenum, target, 0),
+	(Val, GLuint, renderbuffer, 0))
+
+FGL_TRACE_CALL1(GLboolean, glIsRenderbufferOES,
+	(Val, GLuint, renderbuffer, 0))
+
+FGL_TRACE_CALL4(void, glRenderbufferStorageOES,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, internalformat, 0),
+	(Val, GLsizei, width, 0),
+	(Val, GLsizei, height, 0))
+
+FGL_TRACE_CALL3(void, glGetRenderbufferParameterivOES,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, pname, 0),
+	(Out, GLint *, params, FGL_TRACE_GET_SIZE))
+
+FGL_TRACE_CALL2(void, glGenFramebuffersOES,
+	(Val, GLsizei, n, 0),
+	(Out, GLuint *, framebuffers, n * sizeof(GLuint)))
+
+FGL_TRACE_CALL2(void, glDeleteFramebuffersOES,
+	(Val, GLsizei, n, 0),
+	(Data, const GLuint *, framebuffers, n * sizeof(GLuint)))
+
+FGL_TRACE_CALL2(void, glBindFramebufferOES,
+	(Val, GLenum, target, 0),
+	(Val, GLuint, framebuffer, 0))
+
+FGL_TRACE_CALL1(GLboolean, glIsFramebufferOES,
+	(Val, GLuint, framebuffer, 0))
+
+FGL_TRACE_CALL1(GLenum, glCheckFramebufferStatusOES,
+	(Val, GLenum, target, 0))
+
+FGL_TRACE_CALL4(void, glFramebufferRenderbufferOES,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, attachment, 0),
+	(Val, GLenum, renderbuffertarget, 0),
+	(Val, GLuint, renderbuffer, 0))
+
+FGL_TRACE_CALL5(void, glFramebufferTexture2DOES,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, attachment, 0),
+	(Val, GLenum, textarget, 0),
+	(Val, GLuint, texture, 0),
+	(Val, GLint, level, 0))
+
+FGL_TRACE_CALL4(void, glGetFramebufferAttachmentParameterivOES,
+	(Val, GLenum, target, 0),
+	(Val, GLenum, attachment, 0),
+	(Val, GLenum, pname, 0),
+	(Out, GLint *, params, FGL_TRACE_GET_SIZE))
@@ -49,8 +49,8 @@ GL_API GLenum GL_APIENTRY glGetError (void)
 	if(unlikely(glErrorKey == (pthread_key_t)-1))
 		return GL_NO_ERROR;
 
-	GLenum error = (GLenum)pthread_getspecific(glErrorKey);
-	pthread_setspecific(glErrorKey, (void *)GL_NO_ERROR);
+	GLenum error = (GLenum)(uintptr_t)pthread_getspecific(glErrorKey);
+	pthread_setspecific(glErrorKey, (void *)(uintptr_t)GL_NO_ERROR);
 	return error;
 }
 
@@ -306,6 +306,7 @@ GL_API void GL_APIENTRY glBufferSubData (GLenum target, GLintptr offset,
 	}
 
 	memcpy((uint8_t *)buf->memory + offset, data, size);
+	buf->invalidate();
 }
 
 GL_API GLboolean GL_APIENTRY glIsBuffer (GLuint buffer)
@@ -382,7 +383,7 @@ GL_API void GL_APIENTRY glVertexPointer (GLint size, GLenum type,
 		return;
 	}
 
-	FGLContext *ctx = getContext();
+	FGLContext *ctx = getContextNoFlush();
 
 	fglSetupAttribute(ctx, FGL_ARRAY_VERTEX, size, fglType, stride,
 							fglStride, pointer);
@@ -420,7 +421,7 @@ GL_API void GL_APIENTRY glNormalPointer (GLenum type, GLsizei stride,
 		return;
 	}
 
-	FGLContext *ctx = getContext();
+	FGLContext *ctx = getContextNoFlush();
 
 	fglSetupAttribute(ctx, FGL_ARRAY_NORMAL, 3, fglType, stride,
 							fglStride, pointer);
@@ -462,7 +463,7 @@ GL_API void GL_APIENTRY glColorPointer (GLint size, GLenum type,
 		return;
 	}
 
-	FGLContext *ctx = getContext();
+	FGLContext *ctx = getContextNoFlush();
 
 	fglSetupAttribute(ctx, FGL_ARRAY_COLOR, 4, fglType, stride,
 							fglStride, pointer);
@@ -491,7 +492,7 @@ GL_API void GL_APIENTRY glPointSizePointerOES (GLenum type, GLsizei stride,
 		return;
 	}
 
-	FGLContext *ctx = getContext();
+	FGLContext *ctx = getContextNoFlush();
 
 	fglSetupAttribute(ctx, FGL_ARRAY_POINT_SIZE, 1, fglType, stride,
 							fglStride, pointer);
@@ -539,7 +540,7 @@ GL_API void GL_APIENTRY glTexCoordPointer (GLint size, GLenum type,
 		return;
 	}
 
-	FGLContext *ctx = getContext();
+	FGLContext *ctx = getContextNoFlush();
 
 	fglSetupAttribute(ctx, FGL_ARRAY_TEXTURE(ctx->clientActiveTexture),
 				size, fglType, stride, fglStride, pointer);
@@ -553,7 +554,7 @@ static void fglEnableClientState(FGLContext *ctx, GLint idx)
 
 GL_API void GL_APIENTRY glEnableClientState (GLenum array)
 {
-	FGLContext *ctx = getContext();
+	FGLContext *ctx = getContextNoFlush();
 	GLint idx;
 
 	switch (array) {
@@ -593,7 +594,7 @@ static void fglDisableClientState(FGLContext *ctx, GLint idx)
 
 GL_API void GL_APIENTRY glDisableClientState (GLenum array)
 {
-	FGLContext *ctx = getContext();
+	FGLContext *ctx = getContextNoFlush();
 	GLint idx;
 
 	switch (array) {
@@ -630,7 +631,7 @@ GL_API void GL_APIENTRY glClientActiveTexture (GLenum texture)
 		return;
 	}
 
-	FGLContext *ctx = getContext();
+	FGLContext *ctx = getContextNoFlush();
 
 	ctx->clientActiveTexture = unit;
 }
@@ -658,6 +659,27 @@ GL_API void GL_APIENTRY glShadeModel (GLenum mode)
 	ctx->rasterizer.shadeModel = mode;
 }
 
+static void fglSetFogMode(FGLContext *ctx)
+{
+	fimgFogMode mode = FGFP_FOG_NONE;
+
+	if (ctx->enable.fog) {
+		switch (ctx->fog.mode) {
+		case GL_LINEAR:
+			mode = FGFP_FOG_LINEAR;
+			break;
+		case GL_EXP:
+			mode = FGFP_FOG_EXP;
+			break;
+		case GL_EXP2:
+			mode = FGFP_FOG_EXP2;
+			break;
+		}
+	}
+
+	fimgCompatSetFogMode(ctx->fimg, mode);
+}
+
 static inline void fglSetupMatrices(FGLContext *ctx)
 {
 	if (ctx->matrix.dirty[FGL_MATRIX_MODELVIEW]
@@ -672,6 +694,7 @@ static inline void fglSetupMatrices(FGLContext *ctx)
 		transform->multiply(*proj, *modview);
 
 		fimgLoadMatrix(ctx->fimg, FGFP_MATRIX_TRANSFORM, transform->data);
+		fimgLoadMatrix(ctx->fimg, FGFP_MATRIX_MODELVIEW, modview->data);
 
 		/* Load lighting matrix */
 		FGLmatrix *light;
@@ -706,6 +729,8 @@ static inline void fglSetupTextures(FGLContext *ctx)
 	do {
 		FGLTexture *tex = 0;
 
+		ctx->busyTexture[i] = 0;
+
 		if (ctx->textureExternal[i].enabled)
 			tex = ctx->textureExternal[i].getTexture();
 
@@ -723,6 +748,12 @@ static inline void fglSetupTextures(FGLContext *ctx)
 		if (tex->dirty) {
 			tex->surface->flush();
 			tex->dirty = false;
+			tex->dirtyEnd = 0;
+			flush = true;
+		} else if (tex->dirtyEnd) {
+			tex->surface->flushRange(tex->dirtyStart,
+					tex->dirtyEnd - tex->dirtyStart);
+			tex->dirtyEnd = 0;
 			flush = true;
 		}
 
@@ -737,6 +768,26 @@ static inline void fglSetupTextures(FGLContext *ctx)
 		fimgInvalidateTextureCache(ctx->fimg);
 }
 
+/* Marks memory used by submitted draws with their fence */
+static void fglFenceResources(FGLContext *ctx)
+{
+	FGLAbstractFramebuffer *fb = ctx->framebuffer.current;
+	uint32_t fence = fimgGetFence(ctx->fimg);
+
+	for (int i = 0; i < FGL_MAX_TEXTURE_UNITS; ++i)
+		if (ctx->busyTexture[i])
+			ctx->busyTexture[i]->surface->setFence(ctx->fimg,
+									fence);
+
+	for (int i = 0; i < FGL_ATTACHMENT_NUM; ++i) {
+		FGLFramebufferAttachable *fba =
+					fb->get((enum FGLAttachmentIndex)i);
+
+		if (fba && fba->surface)
+			fba->surface->setFence(ctx->fimg, fence);
+	}
+}
+
 static void fglSetScissor(FGLContext *ctx, GLint x, GLint y,
 						GLsizei width, GLsizei height);
 static void fglSetBlending(FGLContext *ctx);
@@ -827,6 +878,232 @@ static inline int fglSetupFramebuffer(FGLContext *ctx)
 	return 0;
 }
 
+/*
+	Deferred draws
+
+	Consecutive small draws using the same state are merged into a single
+	hardware submission. Vertex data is copied at the time of the call, so
+	client arrays may be freely modified after it returns. Triangle strips
+	are joined using degenerate triangles, triangle lists are concatenated.
+	Any call which could affect the state (see getContext()) submits
+	the queue.
+*/
+
+void fglFlushDeferredDraws(FGLContext *ctx)
+{
+	FGLDeferredDrawState *d = &ctx->deferred;
+	fimgArray arrays[4 + FGL_MAX_TEXTURE_UNITS];
+
+	if (!d->count)
+		return;
+
+	for (int i = 0; i < 4 + FGL_MAX_TEXTURE_UNITS; ++i) {
+		if (d->width[i]) {
+			arrays[i].pointer	= d->data[i];
+			arrays[i].stride	= d->width[i];
+			arrays[i].width		= d->width[i];
+			fimgSetAttribute(ctx->fimg, i, d->type[i], d->size[i]);
+		} else {
+			arrays[i].pointer	= &ctx->vertex[i];
+			arrays[i].stride	= 0;
+			arrays[i].width		= 16;
+			fimgSetAttribute(ctx->fimg, i, FGHI_ATTRIB_DT_FLOAT,
+							fglDefaultAttribSize[i]);
+		}
+	}
+
+	fimgDrawArrays(ctx->fimg, d->mode, arrays, d->count);
+	fglFenceResources(ctx);
+
+	/* Client arrays might have been changed in the meantime */
+	for (int i = 0; i < 4 + FGL_MAX_TEXTURE_UNITS; ++i) {
+		if (ctx->array[i].enabled)
+			fimgSetAttribute(ctx->fimg, i, ctx->array[i].type,
+							ctx->array[i].size);
+		else
+			fimgSetAttribute(ctx->fimg, i, FGHI_ATTRIB_DT_FLOAT,
+							fglDefaultAttribSize[i]);
+	}
+
+	fimgCountMergedDraws(ctx->fimg, d->draws);
+
+	d->count = 0;
+	d->draws = 0;
+}
+
+static inline bool fglDeferredDrawCompatible(FGLContext *ctx, uint32_t mode)
+{
+	FGLDeferredDrawState *d = &ctx->deferred;
+
+	if (d->mode != mode)
+		return false;
+
+	for (int i = 0; i < 4 + FGL_MAX_TEXTURE_UNITS; ++i) {
+		if (!ctx->array[i].enabled) {
+			if (d->width[i])
+				return false;
+			continue;
+		}
+
+		if (d->width[i] != ctx->array[i].width
+		    || d->type[i] != ctx->array[i].type
+		    || d->size[i] != ctx->array[i].size)
+			return false;
+	}
+
+	return true;
+}
+
+static inline void fglDeferredDuplicateLast(FGLDeferredDrawState *d)
+{
+	for (int i = 0; i < 4 + FGL_MAX_TEXTURE_UNITS; ++i) {
+		uint8_t *data = (uint8_t *)d->data[i];
+		GLint width = d->width[i];
+
+		if (!width)
+			continue;
+
+		memcpy(data + d->count*width,
+					data + (d->count - 1)*width, width);
+	}
+
+	++d->count;
+}
+
+static inline void fglDeferredCopy(FGLContext *ctx, GLint first, GLsizei count)
+{
+	FGLDeferredDrawState *d = &ctx->deferred;
+
+	for (int i = 0; i < 4 + FGL_MAX_TEXTURE_UNITS; ++i) {
+		uint8_t *dst = (uint8_t *)d->data[i];
+		const uint8_t *src = (const uint8_t *)ctx->array[i].pointer;
+		GLint stride = ctx->array[i].stride;
+		GLint width = d->width[i];
+
+		if (!width)
+			continue;
+
+		dst += d->count*width;
+		src += first*stride;
+
+		if (stride == width) {
+			memcpy(dst, src, count*width);
+			continue;
+		}
+
+		for (GLsizei v = 0; v < count; ++v) {
+			memcpy(dst, src, width);
+			dst += width;
+			src += stride;
+		}
+	}
+
+	d->count += count;
+}
+
+/* Returns true if the draw has been handled */
+static bool fglDeferDrawArrays(FGLContext *ctx, GLenum mode,
+						GLint first, GLsizei count)
+{
+	FGLDeferredDrawState *d = &ctx->deferred;
+	uint32_t fglMode;
+	uint32_t extra = 0;
+
+	switch (mode) {
+	case GL_TRIANGLE_STRIP:
+		fglMode = FGPE_TRIANGLE_STRIP;
+		break;
+	case GL_TRIANGLES:
+		count -= count % 3;
+		fglMode = FGPE_TRIANGLES;
+		break;
+	default:
+		return false;
+	}
+
+	if (count < 3 || count > FGL_DEFERRED_DRAW_MAX_COUNT)
+		return false;
+
+	if (d->count) {
+		if (fglMode == FGPE_TRIANGLE_STRIP)
+			extra = 2 + (d->count & 1);
+
+		if (!fglDeferredDrawCompatible(ctx, fglMode)
+		    || d->count + extra + count > FGL_DEFERRED_DRAW_VERTICES)
+			fglFlushDeferredDraws(ctx);
+	}
+
+	if (!d->count) {
+		if (fglSetupFramebuffer(ctx)) {
+			setError(GL_INVALID_FRAMEBUFFER_OPERATION_OES);
+			return true;
+		}
+
+		fglSetupMatrices(ctx);
+		fglSetupTextures(ctx);
+
+		fimgSetAttribCount(ctx->fimg, 4 + FGL_MAX_TEXTURE_UNITS);
+
+		for (int i = 0; i < 4 + FGL_MAX_TEXTURE_UNITS; ++i) {
+			if (!ctx->array[i].enabled) {
+				d->width[i] = 0;
+				continue;
+			}
+
+			d->type[i] = ctx->array[i].type;
+			d->size[i] = ctx->array[i].size;
+			d->width[i] = ctx->array[i].width;
+		}
+
+		d->mode = fglMode;
+	} else if (fglMode == FGPE_TRIANGLE_STRIP) {
+		/*
+		 * Join the strips with degenerate triangles. The new strip
+		 * must start at even position to keep its winding.
+		 */
+		bool odd = d->count & 1;
+
+		fglDeferredDuplicateLast(d);
+		if (odd)
+			fglDeferredDuplicateLast(d);
+		fglDeferredCopy(ctx, first, 1);
+	}
+
+	fglDeferredCopy(ctx, first, count);
+	d->draws++;
+
+	ctx->finished = false;
+
+	return true;
+}
+
+/*
+ * Returns buffer object all enabled arrays are sourced from,
+ * if it is marked as static, NULL otherwise.
+ */
+static inline FGLBuffer *fglGetStaticArrayBuffer(FGLContext *ctx)
+{
+	FGLBuffer *buf = 0;
+
+	for (int i = 0; i < 4 + FGL_MAX_TEXTURE_UNITS; ++i) {
+		if (!ctx->array[i].enabled)
+			continue;
+
+		if (!ctx->array[i].buffer)
+			return 0;
+
+		if (buf && buf != ctx->array[i].buffer)
+			return 0;
+
+		buf = ctx->array[i].buffer;
+	}
+
+	if (buf && buf->usage != GL_STATIC_DRAW)
+		return 0;
+
+	return buf;
+}
+
 GL_API void GL_APIENTRY glDrawArrays (GLenum mode, GLint first, GLsizei count)
 {
 	uint32_t fglMode;
@@ -837,7 +1114,12 @@ GL_API void GL_APIENTRY glDrawArrays (GLenum mode, GLint first, GLsizei count)
 	}
 
 	fimgArray arrays[4 + FGL_MAX_TEXTURE_UNITS];
-	FGLContext *ctx = getContext();
+	FGLContext *ctx = getContextNoFlush();
+
+	if (fglDeferDrawArrays(ctx, mode, first, count))
+		return;
+
+	fglFlushDeferredDraws(ctx);
 
 	if (fglSetupFramebuffer(ctx)) {
 		setError(GL_INVALID_FRAMEBUFFER_OPERATION_OES);
@@ -908,7 +1190,12 @@ GL_API void GL_APIENTRY glDrawArrays (GLenum mode, GLint first, GLsizei count)
 
 	ctx->finished = false;
 
-	fimgDrawArrays(ctx->fimg, fglMode, arrays, count);
+	FGLBuffer *buf = fglGetStaticArrayBuffer(ctx);
+	if (buf)
+		fimgDrawArraysCached(ctx->fimg, buf->getVertexCache(),
+						fglMode, arrays, count);
+	else
+		fimgDrawArrays(ctx->fimg, fglMode, arrays, count);
 
 	if (mode == GL_LINE_LOOP) {
 	/*
@@ -920,6 +1207,33 @@ GL_API void GL_APIENTRY glDrawArrays (GLenum mode, GLint first, GLsizei count)
 		fimgDrawElementsUByteIdx(ctx->fimg,
 						fglMode, arrays, 2, indices);
 	}
+
+	fglFenceResources(ctx);
+}
+
+/*
+ * Checks whether the result of drawing does not depend on the order of
+ * primitives. This holds only when every pixel ends with the nearest
+ * fragment, which requires strict depth test with depth writes enabled,
+ * on a framebuffer that really has a depth buffer, while nothing else
+ * combines fragments with previous contents of the framebuffer.
+ */
+static inline bool fglOrderIndependent(FGLContext *ctx)
+{
+	FGLAbstractFramebuffer *fb = ctx->framebuffer.get();
+
+	if (!ctx->enable.depthTest || !ctx->perFragment.mask.depth)
+		return false;
+
+	if (ctx->perFragment.depthFunc != GL_LESS
+	    && ctx->perFragment.depthFunc != GL_GREATER)
+		return false;
+
+	if (!(fb->getDepthFormat() & 0xff))
+		return false;
+
+	return !ctx->enable.blend && !ctx->enable.stencilTest
+				&& !ctx->enable.colorLogicOp;
 }
 
 GL_API void GL_APIENTRY glDrawElements (GLenum mode, GLsizei count, GLenum type,
@@ -928,14 +1242,18 @@ GL_API void GL_APIENTRY glDrawElements (GLenum mode, GLsizei count, GLenum type,
 	uint32_t fglMode;
 	fimgArray arrays[4 + FGL_MAX_TEXTURE_UNITS];
 	FGLContext *ctx = getContext();
+	const GLvoid *offset = indices;
+	FGLBuffer *buf = 0;
 
 	if (fglSetupFramebuffer(ctx)) {
 		setError(GL_INVALID_FRAMEBUFFER_OPERATION_OES);
 		return;
 	}
 
-	if(ctx->elementArrayBuffer.isBound())
-		indices = ctx->elementArrayBuffer.get()->getAddress(indices);
+	if(ctx->elementArrayBuffer.isBound()) {
+		buf = ctx->elementArrayBuffer.get();
+		indices = buf->getAddress(indices);
+	}
 
 	for(int i = 0; i < (4 + FGL_MAX_TEXTURE_UNITS); ++i) {
 		if(ctx->array[i].enabled) {
@@ -997,6 +1315,15 @@ GL_API void GL_APIENTRY glDrawElements (GLenum mode, GLsizei count, GLenum type,
 		return;
 	}
 
+	/*
+	 * Triangles of static element buffers can be reordered for better
+	 * vertex reuse, as long as drawing order does not affect the result.
+	 */
+	if (buf && buf->usage == GL_STATIC_DRAW && mode == GL_TRIANGLES
+	    && (type == GL_UNSIGNED_BYTE || type == GL_UNSIGNED_SHORT)
+	    && fglOrderIndependent(ctx))
+		indices = buf->getOptimizedIndices(offset, count, type);
+
 	ctx->finished = false;
 
 	switch (type) {
@@ -1038,7 +1365,10 @@ GL_API void GL_APIENTRY glDrawElements (GLenum mode, GLsizei count, GLenum type,
 	}
 	default:
 		setError(GL_INVALID_ENUM);
+		return;
 	}
+
+	fglFenceResources(ctx);
 }
 
 /*
@@ -1086,7 +1416,10 @@ GL_API void GL_APIENTRY glDrawTexfOES (GLfloat x, GLfloat y, GLfloat z, GLfloat
 	fimgLoadMatrix(ctx->fimg, FGFP_MATRIX_TEXTURE(1), matrix->data);
 	ctx->matrix.dirty[FGL_MATRIX_TEXTURE(1)] = 1;
 
-	// fimgCompatLightingEnable(ctx->fimg, 0);
+	fimgCompatSetLightingEnable(ctx->fimg, 0);
+	fimgCompatSetFogMode(ctx->fimg, FGFP_FOG_NONE);
+	for (int i = 0; i < FGL_MAX_CLIP_PLANES; i++)
+		fimgCompatSetClipPlaneEnable(ctx->fimg, i, 0);
 	/* End of TODO */
 
 	float zD;
@@ -1171,6 +1504,7 @@ GL_API void GL_APIENTRY glDrawTexfOES (GLfloat x, GLfloat y, GLfloat z, GLfloat
 	ctx->finished = false;
 
 	fimgDrawArrays(ctx->fimg, FGPE_TRIANGLE_STRIP, arrays, 4);
+	fglFenceResources(ctx);
 
 	/* Restore previous state */
 
@@ -1184,6 +1518,11 @@ GL_API void GL_APIENTRY glDrawTexfOES (GLfloat x, GLfloat y, GLfloat z, GLfloat
 	fimgSetDepthRange(ctx->fimg, zNear, zFar);
 	fimgSetViewportParams(ctx->fimg, viewportX, viewportY, viewportW, viewportH);
 	fimgSetFaceCullEnable(ctx->fimg, ctx->enable.cullFace);
+	fimgCompatSetLightingEnable(ctx->fimg, ctx->enable.lighting);
+	fglSetFogMode(ctx);
+	for (int i = 0; i < FGL_MAX_CLIP_PLANES; i++)
+		fimgCompatSetClipPlaneEnable(ctx->fimg, i,
+						ctx->clipPlane[i].enabled);
 }
 
 GL_API void GL_APIENTRY glDrawTexsOES (GLshort x, GLshort y, GLshort z, GLshort width, GLshort height)
@@ -1224,6 +1563,178 @@ GL_API void GL_APIENTRY glDrawTexfvOES (const GLfloat *coords)
 	glDrawTexfOES(coords[0], coords[1], coords[2], coords[3], coords[4]);
 }
 
+#ifdef FGL_GPU_MIPMAP_MIN_SIZE
+/*
+	Mipmap rendering
+*/
+
+/*
+ * Renders mipmap levels of texture, each one as a quad of half size of the
+ * previous level, which is sampled in the middle between 2x2 texels using
+ * bilinear filtering, so it gets box filtered. Returns first level not
+ * rendered, because framebuffer can not use the format or the level is
+ * too small to be worth it, which has to be generated by CPU.
+ */
+int fglRenderMipmaps(FGLContext *ctx, FGLTexture *tex)
+{
+	static const GLfloat vertices[2*4] = {
+		-1.0f, -1.0f,	1.0f, -1.0f,	-1.0f, 1.0f,	1.0f, 1.0f
+	};
+	static const GLfloat texcoords[2*4] = {
+		0.0f, 0.0f,	1.0f, 0.0f,	0.0f, 1.0f,	1.0f, 1.0f
+	};
+	static const GLfloat white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	const FGLPixelFormat *pix = FGLPixelFormat::get(tex->pixFormat);
+	fimgArray arrays[4 + FGL_MAX_TEXTURE_UNITS];
+	fimgTexture *src;
+	int level = 1;
+
+	if (!(tex->mask & BIT_VAL(FGL_ATTACHMENT_COLOR))
+	    || !tex->surface->paddr)
+		return level;
+
+	unsigned width = tex->width;
+	unsigned height = tex->height;
+
+	if ((width >> 1) < FGL_GPU_MIPMAP_MIN_SIZE
+	    || (height >> 1) < FGL_GPU_MIPMAP_MIN_SIZE)
+		return level;
+
+	src = fimgCreateTexture();
+	if (!src)
+		return level;
+
+	fimgInitTexture(src, pix->flags, pix->texFormat, 0);
+	fimgSetTexMipmap(src, FGTU_TSTA_MIPMAP_DISABLED);
+	fimgSetTexMinFilter(src, FGTU_TSTA_FILTER_LINEAR);
+	fimgSetTexMagFilter(src, FGTU_TSTA_FILTER_LINEAR);
+	fimgSetTexUAddrMode(src, FGTU_TSTA_ADDR_MODE_CLAMP);
+	fimgSetTexVAddrMode(src, FGTU_TSTA_ADDR_MODE_CLAMP);
+
+	/* Base level written by CPU must reach memory */
+	tex->surface->flush();
+	fimgInvalidateTextureCache(ctx->fimg);
+
+	/* Prepare to drawing */
+
+	fimgSetFrameBufParams(ctx->fimg, pix->flags, pix->pixFormat);
+	fimgSetZBufBaseAddr(ctx->fimg, 0);
+	fimgSetZBufWriteMask(ctx->fimg, 0);
+	fimgSetDepthEnable(ctx->fimg, 0);
+	fimgSetStencilBufWriteMask(ctx->fimg, 0, 0);
+	fimgSetStencilBufWriteMask(ctx->fimg, 1, 0);
+	fimgSetStencilEnable(ctx->fimg, 0);
+	fimgSetAlphaEnable(ctx->fimg, 0);
+	fimgSetBlendEnable(ctx->fimg, 0);
+	fimgSetDitherEnable(ctx->fimg, 0);
+	fimgSetLogicalOpEnable(ctx->fimg, 0);
+	fimgSetColorBufWriteMask(ctx->fimg, 0);
+	fimgSetFaceCullEnable(ctx->fimg, 0);
+
+	FGLmatrix *matrix = &ctx->matrix.transformMatrix;
+	matrix->identity();
+
+	fimgLoadMatrix(ctx->fimg, FGFP_MATRIX_TRANSFORM, matrix->data);
+	fimgLoadMatrix(ctx->fimg, FGFP_MATRIX_LIGHTING, matrix->data);
+	ctx->matrix.dirty[FGL_MATRIX_MODELVIEW] = 1;
+	fimgLoadMatrix(ctx->fimg, FGFP_MATRIX_TEXTURE(0), matrix->data);
+	ctx->matrix.dirty[FGL_MATRIX_TEXTURE(0)] = 1;
+
+	fimgCompatSetLightingEnable(ctx->fimg, 0);
+	fimgCompatSetFogMode(ctx->fimg, FGFP_FOG_NONE);
+	for (int i = 0; i < FGL_MAX_CLIP_PLANES; i++)
+		fimgCompatSetClipPlaneEnable(ctx->fimg, i, 0);
+
+	fimgCompatSetupTexture(ctx->fimg, src, 0);
+	fimgCompatSetTextureFunc(ctx->fimg, 0, FGFP_TEXFUNC_REPLACE);
+	for (int i = 1; i < FGL_MAX_TEXTURE_UNITS; i++)
+		fimgCompatSetTextureFunc(ctx->fimg, i, FGFP_TEXFUNC_NONE);
+
+	for (int i = 0; i < 4 + FGL_MAX_TEXTURE_UNITS; i++) {
+		arrays[i].pointer	= white;
+		arrays[i].stride	= 0;
+		arrays[i].width		= 16;
+		fimgSetAttribute(ctx->fimg, i, FGHI_ATTRIB_DT_FLOAT,
+						fglDefaultAttribSize[i]);
+	}
+
+	arrays[FGL_ARRAY_VERTEX].pointer	= vertices;
+	arrays[FGL_ARRAY_VERTEX].stride		= 8;
+	arrays[FGL_ARRAY_VERTEX].width		= 8;
+	fimgSetAttribute(ctx->fimg, FGL_ARRAY_VERTEX, FGHI_ATTRIB_DT_FLOAT, 2);
+
+	arrays[FGL_ARRAY_TEXTURE(0)].pointer	= texcoords;
+	arrays[FGL_ARRAY_TEXTURE(0)].stride	= 8;
+	arrays[FGL_ARRAY_TEXTURE(0)].width	= 8;
+	fimgSetAttribute(ctx->fimg, FGL_ARRAY_TEXTURE(0),
+						FGHI_ATTRIB_DT_FLOAT, 2);
+
+	fimgSetAttribCount(ctx->fimg, 4 + FGL_MAX_TEXTURE_UNITS);
+
+	/* Proceed with drawing */
+
+	do {
+		unsigned srcOffset = fimgGetTexMipmapOffset(tex->fimg, level - 1);
+		unsigned dstOffset = fimgGetTexMipmapOffset(tex->fimg, level);
+
+		fimgSetTexBaseAddr(src, tex->surface->paddr
+						+ pix->pixelSize*srcOffset);
+		fimgSetTex2DSize(src, width, height, 0);
+
+		width >>= 1;
+		height >>= 1;
+
+		fimgSetFrameBufSize(ctx->fimg, width, height, 0);
+		fimgSetColorBufBaseAddr(ctx->fimg, tex->surface->paddr
+						+ pix->pixelSize*dstOffset);
+		fimgSetXClip(ctx->fimg, 0, width);
+		fimgSetYClip(ctx->fimg, 0, height);
+		fimgSetViewportParams(ctx->fimg, 0, 0, width, height);
+
+		ctx->finished = false;
+
+		fimgDrawArrays(ctx->fimg, FGPE_TRIANGLE_STRIP, arrays, 4);
+
+		/* Next level is sampled from this one */
+		fimgWaitFence(ctx->fimg, fimgGetFence(ctx->fimg));
+		fimgInvalidateTextureCache(ctx->fimg);
+	} while (++level <= tex->maxLevel
+	    && (width >> 1) >= FGL_GPU_MIPMAP_MIN_SIZE
+	    && (height >> 1) >= FGL_GPU_MIPMAP_MIN_SIZE);
+
+	/* Restore previous state */
+
+	fimgCompatSetupTexture(ctx->fimg, 0, 0);
+	fimgDestroyTexture(src);
+
+	for (int i = 0; i < 4 + FGL_MAX_TEXTURE_UNITS; i++) {
+		if (ctx->array[i].enabled)
+			fimgSetAttribute(ctx->fimg, i, ctx->array[i].type,
+							ctx->array[i].size);
+		else
+			fimgSetAttribute(ctx->fimg, i, FGHI_ATTRIB_DT_FLOAT,
+							fglDefaultAttribSize[i]);
+	}
+
+	fimgSetAlphaEnable(ctx->fimg, ctx->enable.alphaTest);
+	fimgSetDitherEnable(ctx->fimg, ctx->enable.dither);
+	fimgSetLogicalOpEnable(ctx->fimg, ctx->enable.colorLogicOp);
+	fimgSetFaceCullEnable(ctx->fimg, ctx->enable.cullFace);
+	fimgCompatSetLightingEnable(ctx->fimg, ctx->enable.lighting);
+	fglSetFogMode(ctx);
+	for (int i = 0; i < FGL_MAX_CLIP_PLANES; i++)
+		fimgCompatSetClipPlaneEnable(ctx->fimg, i,
+						ctx->clipPlane[i].enabled);
+
+	/* Framebuffer, scissor, viewport, blending and masks */
+	ctx->framebuffer.current = 0;
+	ctx->framebuffer.curWidth = 0;
+	ctx->framebuffer.curColorFormat = FGL_PIXFMT_NONE;
+
+	return level;
+}
+#endif
+
 /*
 	Transformations
 */
@@ -1871,11 +2382,11 @@ static inline void fglSet(GLenum cap, bool state)
 		break;
 	case GL_CULL_FACE:
 		fimgSetFaceCullEnable(ctx->fimg, state);
-		ctx->enable.cullFace = 1;
+		ctx->enable.cullFace = state;
 		break;
 	case GL_POLYGON_OFFSET_FILL:
 		fimgEnableDepthOffset(ctx->fimg, state);
-		ctx->enable.polyOffFill = 1;
+		ctx->enable.polyOffFill = state;
 		break;
 	case GL_SCISSOR_TEST: {
 		FGLAbstractFramebuffer *fb = ctx->framebuffer.get();
@@ -1917,6 +2428,9 @@ static inline void fglSet(GLenum cap, bool state)
 		ctx->enable.colorLogicOp = state;
 		break;
 	case GL_LIGHTING:
+		fimgCompatSetLightingEnable(ctx->fimg, state);
+		ctx->enable.lighting = state;
+		break;
 	case GL_LIGHT0:
 	case GL_LIGHT1:
 	case GL_LIGHT2:
@@ -1925,9 +2439,36 @@ static inline void fglSet(GLenum cap, bool state)
 	case GL_LIGHT5:
 	case GL_LIGHT6:
 	case GL_LIGHT7:
+		fimgCompatSetLightEnable(ctx->fimg, cap - GL_LIGHT0, state);
+		ctx->lighting.light[cap - GL_LIGHT0].enabled = state;
+		break;
 	case GL_NORMALIZE:
+		ctx->enable.normalize = state;
+		fimgCompatSetNormalizeEnable(ctx->fimg,
+			ctx->enable.normalize || ctx->enable.rescaleNormal);
+		break;
+	case GL_RESCALE_NORMAL:
+		/* Normalizing gives the same result for uniform scaling */
+		ctx->enable.rescaleNormal = state;
+		fimgCompatSetNormalizeEnable(ctx->fimg,
+			ctx->enable.normalize || ctx->enable.rescaleNormal);
+		break;
 	case GL_COLOR_MATERIAL:
+		fimgCompatSetColorMaterialEnable(ctx->fimg, state);
+		ctx->enable.colorMaterial = state;
+		break;
 	case GL_FOG:
+		ctx->enable.fog = state;
+		fglSetFogMode(ctx);
+		break;
+	case GL_CLIP_PLANE0:
+	case GL_CLIP_PLANE1:
+	case GL_CLIP_PLANE2:
+	case GL_CLIP_PLANE3:
+		fimgCompatSetClipPlaneEnable(ctx->fimg,
+						cap - GL_CLIP_PLANE0, state);
+		ctx->clipPlane[cap - GL_CLIP_PLANE0].enabled = state;
+		break;
 	case GL_POINT_SMOOTH:
 	case GL_LINE_SMOOTH:
 	case GL_MULTISAMPLE:
@@ -1954,123 +2495,432 @@ GL_API void GL_APIENTRY glDisable (GLenum cap)
 
 GL_API void GL_APIENTRY glFlush (void)
 {
-	/* Nothing to do here */
+	FGLContext *ctx = getContext();
+
+	/* Let other processes use the hardware */
+	fimgEndHardwareLease(ctx->fimg);
 }
 
 GL_API void GL_APIENTRY glFinish (void)
 {
 	FGLContext *ctx = getContext();
 
-	if (ctx->finished)
+	if (ctx->finished) {
+		/* Lease could have been taken again after previous finish */
+		fimgEndHardwareLease(ctx->fimg);
 		return;
+	}
 
 	fimgFinish(ctx->fimg);
 
-	for (int i = 0; i < FGL_MAX_TEXTURE_UNITS; ++i)
-		ctx->busyTexture[i] = 0;
-
 	ctx->finished = true;
 }
 
 /*
-	Stubs
+	Lighting
 */
 
-GL_API void GL_APIENTRY glClipPlanef (GLenum plane, const GLfloat *equation)
+static inline bool fglIsLight(GLenum light)
 {
-	FUNC_UNIMPLEMENTED;
+	return light >= GL_LIGHT0 && light < GL_LIGHT0 + FGL_MAX_LIGHTS;
 }
 
-GL_API void GL_APIENTRY glClipPlanex (GLenum plane, const GLfixed *equation)
+static unsigned fglLightParamCount(GLenum pname)
 {
-	FUNC_UNIMPLEMENTED;
+	switch (pname) {
+	case GL_AMBIENT:
+	case GL_DIFFUSE:
+	case GL_SPECULAR:
+	case GL_EMISSION:
+	case GL_POSITION:
+	case GL_AMBIENT_AND_DIFFUSE:
+	case GL_LIGHT_MODEL_AMBIENT:
+		return 4;
+	case GL_SPOT_DIRECTION:
+		return 3;
+	default:
+		return 1;
+	}
 }
 
-GL_API void GL_APIENTRY glFogf (GLenum pname, GLfloat param)
+static void fglSpotLight(FGLContext *ctx, GLint light)
 {
-	FUNC_UNIMPLEMENTED;
+	FGLLightState *l = &ctx->lighting.light[light];
+
+	fimgCompatSetSpotLight(ctx->fimg, light,
+				l->direction, l->exponent, l->cutoff);
 }
 
-GL_API void GL_APIENTRY glFogfv (GLenum pname, const GLfloat *params)
+static void fglLightAttenuation(FGLContext *ctx, GLint light)
 {
-	FUNC_UNIMPLEMENTED;
+	FGLLightState *l = &ctx->lighting.light[light];
+
+	fimgCompatSetLightAttenuation(ctx->fimg, light,
+		l->constantAttenuation, l->linearAttenuation,
+		l->quadraticAttenuation);
 }
 
-GL_API void GL_APIENTRY glFogx (GLenum pname, GLfixed param)
+GL_API void GL_APIENTRY glLightfv (GLenum light, GLenum pname,
+							const GLfloat *params)
 {
-	FUNC_UNIMPLEMENTED;
+	if (!fglIsLight(light)) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	FGLContext *ctx = getContext();
+	GLint id = light - GL_LIGHT0;
+	FGLLightState *l = &ctx->lighting.light[id];
+	const FGLmatrix &mv = ctx->matrix.stack[FGL_MATRIX_MODELVIEW].top();
+
+	switch (pname) {
+	case GL_AMBIENT:
+		memcpy(l->ambient, params, sizeof(l->ambient));
+		fimgCompatSetLightColor(ctx->fimg, id,
+					FGFP_LIGHT_AMBIENT, l->ambient);
+		break;
+	case GL_DIFFUSE:
+		memcpy(l->diffuse, params, sizeof(l->diffuse));
+		fimgCompatSetLightColor(ctx->fimg, id,
+					FGFP_LIGHT_DIFFUSE, l->diffuse);
+		break;
+	case GL_SPECULAR:
+		memcpy(l->specular, params, sizeof(l->specular));
+		fimgCompatSetLightColor(ctx->fimg, id,
+					FGFP_LIGHT_SPECULAR, l->specular);
+		break;
+	case GL_POSITION:
+		/* Transformed by modelview matrix current at the time of call */
+		for (int i = 0; i < 4; ++i)
+			l->position[i] = mv[0][i]*params[0] + mv[1][i]*params[1]
+				+ mv[2][i]*params[2] + mv[3][i]*params[3];
+		fimgCompatSetLightPosition(ctx->fimg, id, l->position);
+		break;
+	case GL_SPOT_DIRECTION:
+		for (int i = 0; i < 3; ++i)
+			l->direction[i] = mv[0][i]*params[0] + mv[1][i]*params[1]
+				+ mv[2][i]*params[2];
+		fglSpotLight(ctx, id);
+		break;
+	case GL_SPOT_EXPONENT:
+		if (params[0] < 0.0f || params[0] > 128.0f) {
+			setError(GL_INVALID_VALUE);
+			return;
+		}
+		l->exponent = params[0];
+		fglSpotLight(ctx, id);
+		break;
+	case GL_SPOT_CUTOFF:
+		if ((params[0] < 0.0f || params[0] > 90.0f)
+		    && params[0] != 180.0f) {
+			setError(GL_INVALID_VALUE);
+			return;
+		}
+		l->cutoff = params[0];
+		fglSpotLight(ctx, id);
+		break;
+	case GL_CONSTANT_ATTENUATION:
+	case GL_LINEAR_ATTENUATION:
+	case GL_QUADRATIC_ATTENUATION:
+		if (params[0] < 0.0f) {
+			setError(GL_INVALID_VALUE);
+			return;
+		}
+		if (pname == GL_CONSTANT_ATTENUATION)
+			l->constantAttenuation = params[0];
+		else if (pname == GL_LINEAR_ATTENUATION)
+			l->linearAttenuation = params[0];
+		else
+			l->quadraticAttenuation = params[0];
+		fglLightAttenuation(ctx, id);
+		break;
+	default:
+		setError(GL_INVALID_ENUM);
+	}
 }
 
-GL_API void GL_APIENTRY glFogxv (GLenum pname, const GLfixed *params)
+GL_API void GL_APIENTRY glLightf (GLenum light, GLenum pname, GLfloat param)
 {
-	FUNC_UNIMPLEMENTED;
+	if (fglLightParamCount(pname) != 1) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	glLightfv(light, pname, &param);
 }
 
-GL_API void GL_APIENTRY glHint (GLenum target, GLenum mode)
+GL_API void GL_APIENTRY glLightxv (GLenum light, GLenum pname,
+							const GLfixed *params)
 {
-	FUNC_UNIMPLEMENTED;
+	GLfloat fparams[4];
+	unsigned count = fglLightParamCount(pname);
+
+	for (unsigned i = 0; i < count; ++i)
+		fparams[i] = floatFromFixed(params[i]);
+
+	glLightfv(light, pname, fparams);
 }
 
-GL_API void GL_APIENTRY glLightModelf (GLenum pname, GLfloat param)
+GL_API void GL_APIENTRY glLightx (GLenum light, GLenum pname, GLfixed param)
 {
-	FUNC_UNIMPLEMENTED;
+	glLightf(light, pname, floatFromFixed(param));
+}
+
+GL_API void GL_APIENTRY glMaterialfv (GLenum face, GLenum pname,
+							const GLfloat *params)
+{
+	if (face != GL_FRONT_AND_BACK) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	FGLContext *ctx = getContext();
+	FGLLightingState *l = &ctx->lighting;
+
+	switch (pname) {
+	case GL_AMBIENT:
+		memcpy(l->ambient, params, sizeof(l->ambient));
+		fimgCompatSetMaterialColor(ctx->fimg,
+					FGFP_LIGHT_AMBIENT, l->ambient);
+		break;
+	case GL_DIFFUSE:
+		memcpy(l->diffuse, params, sizeof(l->diffuse));
+		fimgCompatSetMaterialColor(ctx->fimg,
+					FGFP_LIGHT_DIFFUSE, l->diffuse);
+		break;
+	case GL_AMBIENT_AND_DIFFUSE:
+		memcpy(l->ambient, params, sizeof(l->ambient));
+		memcpy(l->diffuse, params, sizeof(l->diffuse));
+		fimgCompatSetMaterialColor(ctx->fimg,
+					FGFP_LIGHT_AMBIENT, l->ambient);
+		fimgCompatSetMaterialColor(ctx->fimg,
+					FGFP_LIGHT_DIFFUSE, l->diffuse);
+		break;
+	case GL_SPECULAR:
+		memcpy(l->specular, params, sizeof(l->specular));
+		fimgCompatSetMaterialColor(ctx->fimg,
+					FGFP_LIGHT_SPECULAR, l->specular);
+		break;
+	case GL_EMISSION:
+		memcpy(l->emission, params, sizeof(l->emission));
+		fimgCompatSetMaterialColor(ctx->fimg,
+					FGFP_LIGHT_EMISSION, l->emission);
+		break;
+	case GL_SHININESS:
+		if (params[0] < 0.0f || params[0] > 128.0f) {
+			setError(GL_INVALID_VALUE);
+			return;
+		}
+		l->shininess = params[0];
+		fimgCompatSetMaterialShininess(ctx->fimg, l->shininess);
+		break;
+	default:
+		setError(GL_INVALID_ENUM);
+	}
+}
+
+GL_API void GL_APIENTRY glMaterialf (GLenum face, GLenum pname, GLfloat param)
+{
+	if (pname != GL_SHININESS) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	glMaterialfv(face, pname, &param);
+}
+
+GL_API void GL_APIENTRY glMaterialxv (GLenum face, GLenum pname,
+							const GLfixed *params)
+{
+	GLfloat fparams[4];
+	unsigned count = fglLightParamCount(pname);
+
+	for (unsigned i = 0; i < count; ++i)
+		fparams[i] = floatFromFixed(params[i]);
+
+	glMaterialfv(face, pname, fparams);
+}
+
+GL_API void GL_APIENTRY glMaterialx (GLenum face, GLenum pname, GLfixed param)
+{
+	glMaterialf(face, pname, floatFromFixed(param));
 }
 
 GL_API void GL_APIENTRY glLightModelfv (GLenum pname, const GLfloat *params)
 {
-	FUNC_UNIMPLEMENTED;
+	FGLContext *ctx = getContext();
+
+	switch (pname) {
+	case GL_LIGHT_MODEL_AMBIENT:
+		memcpy(ctx->lighting.modelAmbient, params,
+					sizeof(ctx->lighting.modelAmbient));
+		fimgCompatSetLightModelAmbient(ctx->fimg,
+					ctx->lighting.modelAmbient);
+		break;
+	case GL_LIGHT_MODEL_TWO_SIDE:
+		/* Accepted, but only front face lighting is computed */
+		ctx->lighting.twoSide = (params[0] != 0.0f);
+		break;
+	default:
+		setError(GL_INVALID_ENUM);
+	}
 }
 
-GL_API void GL_APIENTRY glLightModelx (GLenum pname, GLfixed param)
+GL_API void GL_APIENTRY glLightModelf (GLenum pname, GLfloat param)
 {
-	FUNC_UNIMPLEMENTED;
+	if (pname != GL_LIGHT_MODEL_TWO_SIDE) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	glLightModelfv(pname, &param);
 }
 
 GL_API void GL_APIENTRY glLightModelxv (GLenum pname, const GLfixed *params)
 {
-	FUNC_UNIMPLEMENTED;
+	GLfloat fparams[4];
+	unsigned count = fglLightParamCount(pname);
+
+	for (unsigned i = 0; i < count; ++i)
+		fparams[i] = floatFromFixed(params[i]);
+
+	glLightModelfv(pname, fparams);
 }
 
-GL_API void GL_APIENTRY glLightf (GLenum light, GLenum pname, GLfloat param)
+GL_API void GL_APIENTRY glLightModelx (GLenum pname, GLfixed param)
 {
-	FUNC_UNIMPLEMENTED;
+	glLightModelf(pname, floatFromFixed(param));
 }
 
-GL_API void GL_APIENTRY glLightfv (GLenum light, GLenum pname,
-							const GLfloat *params)
+/*
+	Fog
+*/
+
+GL_API void GL_APIENTRY glFogfv (GLenum pname, const GLfloat *params)
 {
-	FUNC_UNIMPLEMENTED;
+	FGLContext *ctx = getContext();
+	FGLFogState *fog = &ctx->fog;
+
+	switch (pname) {
+	case GL_FOG_MODE: {
+		GLenum mode = (GLenum)params[0];
+		if (mode != GL_LINEAR && mode != GL_EXP && mode != GL_EXP2) {
+			setError(GL_INVALID_ENUM);
+			return;
+		}
+		fog->mode = mode;
+		fglSetFogMode(ctx);
+		break; }
+	case GL_FOG_DENSITY:
+		if (params[0] < 0.0f) {
+			setError(GL_INVALID_VALUE);
+			return;
+		}
+		fog->density = params[0];
+		fimgCompatSetFogParams(ctx->fimg,
+					fog->density, fog->start, fog->end);
+		break;
+	case GL_FOG_START:
+		fog->start = params[0];
+		fimgCompatSetFogParams(ctx->fimg,
+					fog->density, fog->start, fog->end);
+		break;
+	case GL_FOG_END:
+		fog->end = params[0];
+		fimgCompatSetFogParams(ctx->fimg,
+					fog->density, fog->start, fog->end);
+		break;
+	case GL_FOG_COLOR:
+		for (int i = 0; i < 4; ++i)
+			fog->color[i] = clampFloat(params[i]);
+		fimgCompatSetFogColor(ctx->fimg, fog->color);
+		break;
+	default:
+		setError(GL_INVALID_ENUM);
+	}
 }
 
-GL_API void GL_APIENTRY glLightx (GLenum light, GLenum pname, GLfixed param)
+GL_API void GL_APIENTRY glFogf (GLenum pname, GLfloat param)
 {
-	FUNC_UNIMPLEMENTED;
+	if (pname == GL_FOG_COLOR) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	glFogfv(pname, &param);
 }
 
-GL_API void GL_APIENTRY glLightxv (GLenum light, GLenum pname,
-							const GLfixed *params)
+GL_API void GL_APIENTRY glFogxv (GLenum pname, const GLfixed *params)
 {
-	FUNC_UNIMPLEMENTED;
+	GLfloat fparams[4];
+
+	switch (pname) {
+	case GL_FOG_MODE:
+		/* Passed as enum, not fixed point value */
+		fparams[0] = (GLfloat)params[0];
+		break;
+	case GL_FOG_COLOR:
+		for (int i = 0; i < 4; ++i)
+			fparams[i] = floatFromFixed(params[i]);
+		break;
+	default:
+		fparams[0] = floatFromFixed(params[0]);
+	}
+
+	glFogfv(pname, fparams);
 }
 
-GL_API void GL_APIENTRY glMaterialf (GLenum face, GLenum pname, GLfloat param)
+GL_API void GL_APIENTRY glFogx (GLenum pname, GLfixed param)
 {
-	FUNC_UNIMPLEMENTED;
+	if (pname == GL_FOG_COLOR) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	glFogxv(pname, &param);
 }
 
-GL_API void GL_APIENTRY glMaterialfv (GLenum face, GLenum pname,
-							const GLfloat *params)
+/*
+	User clip planes
+*/
+
+GL_API void GL_APIENTRY glClipPlanef (GLenum plane, const GLfloat *equation)
 {
-	FUNC_UNIMPLEMENTED;
+	if (plane < GL_CLIP_PLANE0
+	    || plane >= GL_CLIP_PLANE0 + FGL_MAX_CLIP_PLANES) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	FGLContext *ctx = getContext();
+	GLint id = plane - GL_CLIP_PLANE0;
+	FGLClipPlaneState *p = &ctx->clipPlane[id];
+	const FGLmatrix &inv =
+		ctx->matrix.stack[FGL_MATRIX_MODELVIEW_INVERSE].top();
+
+	/* Transformed by inverse of modelview matrix current at the time */
+	for (int i = 0; i < 4; ++i)
+		p->equation[i] = equation[0]*inv[i][0] + equation[1]*inv[i][1]
+				+ equation[2]*inv[i][2] + equation[3]*inv[i][3];
+
+	fimgCompatSetClipPlane(ctx->fimg, id, p->equation);
 }
 
-GL_API void GL_APIENTRY glMaterialx (GLenum face, GLenum pname, GLfixed param)
+GL_API void GL_APIENTRY glClipPlanex (GLenum plane, const GLfixed *equation)
 {
-	FUNC_UNIMPLEMENTED;
+	GLfloat fequation[4];
+
+	for (int i = 0; i < 4; ++i)
+		fequation[i] = floatFromFixed(equation[i]);
+
+	glClipPlanef(plane, fequation);
 }
 
-GL_API void GL_APIENTRY glMaterialxv (GLenum face, GLenum pname,
-							const GLfixed *params)
+/*
+	Stubs
+*/
+
+GL_API void GL_APIENTRY glHint (GLenum target, GLenum mode)
 {
 	FUNC_UNIMPLEMENTED;
 }
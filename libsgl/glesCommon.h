@@ -71,6 +71,25 @@ static inline GLint unitFromTextureEnum(GLenum texture)
 	Context management
 */
 
+extern void fglFlushDeferredDraws(FGLContext *ctx);
+extern int fglRenderMipmaps(FGLContext *ctx, FGLTexture *tex);
+
+/*
+ * Returns current context without submitting deferred draw calls.
+ * Only for functions which do not affect the state used by queued draws.
+ */
+static inline FGLContext *getContextNoFlush(void)
+{
+	FGLContext *ctx = getGlThreadSpecific();
+
+	if(!ctx) {
+		ALOGE("GL context is NULL!");
+		exit(EINVAL);
+	}
+
+	return ctx;
+}
+
 #ifdef GLES_DEBUG
 #define getContext() ( \
 	ALOGD("%s called getContext()", __func__), \
@@ -80,12 +99,10 @@ static inline FGLContext *_getContext(void)
 static inline FGLContext *getContext(void)
 #endif
 {
-	FGLContext *ctx = getGlThreadSpecific();
+	FGLContext *ctx = getContextNoFlush();
 
-	if(!ctx) {
-		ALOGE("GL context is NULL!");
-		exit(EINVAL);
-	}
+	if (unlikely(ctx->deferred.count))
+		fglFlushDeferredDraws(ctx);
 
 	return ctx;
 }
@@ -115,10 +132,10 @@ static inline void setError(GLenum error)
 		pthread_mutex_unlock(&glErrorKeyMutex);
 		errorCode = GL_NO_ERROR;
 	} else {
-		errorCode = (GLenum)pthread_getspecific(glErrorKey);
+		errorCode = (GLenum)(uintptr_t)pthread_getspecific(glErrorKey);
 	}
 
-	pthread_setspecific(glErrorKey, (void *)error);
+	pthread_setspecific(glErrorKey, (void *)(uintptr_t)error);
 
 	if(errorCode == GL_NO_ERROR)
 		errorCode = error;
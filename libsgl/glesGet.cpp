@@ -57,13 +57,33 @@ static char const * const gExtensionsString =
 	"GL_OES_texture_npot "
 	"GL_OES_point_size_array "
 	"GL_OES_rgb8_rgba8 "
+	"GL_OES_compressed_paletted_texture "
+	"GL_OES_compressed_ETC1_RGB8_texture "
+	"GL_OES_compressed_ETC1_RGB8_sub_texture "
 	"GL_OES_depth24 "
 	"GL_OES_stencil8 "
 	"GL_EXT_texture_format_BGRA8888 "
+	"GL_EXT_texture_compression_dxt1 "
+	"GL_EXT_texture_compression_s3tc "
 	"GL_ARB_texture_non_power_of_two"
 ;
 
 static const GLint fglCompressedTextureFormats[] = {
+	GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+	GL_COMPRESSED_RGBA_S3TC_DXT1_EXT,
+	GL_COMPRESSED_RGBA_S3TC_DXT3_EXT,
+	GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,
+	GL_ETC1_RGB8_OES,
+	GL_PALETTE4_RGB8_OES,
+	GL_PALETTE4_RGBA8_OES,
+	GL_PALETTE4_R5_G6_B5_OES,
+	GL_PALETTE4_RGBA4_OES,
+	GL_PALETTE4_RGB5_A1_OES,
+	GL_PALETTE8_RGB8_OES,
+	GL_PALETTE8_RGBA8_OES,
+	GL_PALETTE8_R5_G6_B5_OES,
+	GL_PALETTE8_RGBA4_OES,
+	GL_PALETTE8_RGB5_A1_OES,
 };
 
 const FGLPixelFormat FGLPixelFormat::table[] = {
@@ -317,6 +337,8 @@ const FGLPixelFormat FGLPixelFormat::table[] = {
 	 * Compressed formats follow
 	 */
 
+	/* Palettes of indexed formats hold RGBA colors, alpha in LSBs */
+
 	/*
 	 * FGL_PIXFMT_1BPP
 	 * ---------------------------------
@@ -332,7 +354,7 @@ const FGLPixelFormat FGLPixelFormat::table[] = {
 		0,
 		FGTU_TSTA_TEXTURE_FORMAT_1BPP,
 		-1,
-		0
+		FGL_PIX_ALPHA_LSB
 	},
 	/*
 	 * FGL_PIXFMT_2BPP
@@ -349,7 +371,7 @@ const FGLPixelFormat FGLPixelFormat::table[] = {
 		0,
 		FGTU_TSTA_TEXTURE_FORMAT_2BPP,
 		-1,
-		0
+		FGL_PIX_ALPHA_LSB
 	},
 	/*
 	 * FGL_PIXFMT_4BPP
@@ -366,7 +388,7 @@ const FGLPixelFormat FGLPixelFormat::table[] = {
 		0,
 		FGTU_TSTA_TEXTURE_FORMAT_4BPP,
 		-1,
-		0
+		FGL_PIX_ALPHA_LSB
 	},
 	/*
 	 * FGL_PIXFMT_8BPP
@@ -383,7 +405,7 @@ const FGLPixelFormat FGLPixelFormat::table[] = {
 		0,
 		FGTU_TSTA_TEXTURE_FORMAT_8BPP,
 		-1,
-		0
+		FGL_PIX_ALPHA_LSB
 	},
 	/*
 	 * FGL_PIXFMT_S3TC
@@ -883,6 +905,32 @@ void fglGetState(FGLContext *ctx, GLenum pname, FGLStateGetter &state)
 	case GL_MAX_LIGHTS:
 		state.putInteger(FGL_MAX_LIGHTS);
 		break;
+	case GL_LIGHT_MODEL_AMBIENT:
+		for (int i = 0; i < 4; ++i)
+			state.putNormalized(ctx->lighting.modelAmbient[i]);
+		break;
+	case GL_LIGHT_MODEL_TWO_SIDE:
+		state.putBoolean(ctx->lighting.twoSide);
+		break;
+	case GL_MAX_CLIP_PLANES:
+		state.putInteger(FGL_MAX_CLIP_PLANES);
+		break;
+	case GL_FOG_MODE:
+		state.putEnum(ctx->fog.mode);
+		break;
+	case GL_FOG_DENSITY:
+		state.putFloat(ctx->fog.density);
+		break;
+	case GL_FOG_START:
+		state.putFloat(ctx->fog.start);
+		break;
+	case GL_FOG_END:
+		state.putFloat(ctx->fog.end);
+		break;
+	case GL_FOG_COLOR:
+		for (int i = 0; i < 4; ++i)
+			state.putNormalized(ctx->fog.color[i]);
+		break;
 	case GL_SAMPLE_BUFFERS :
 		state.putInteger(0);
 		break;
@@ -1027,6 +1075,23 @@ void fglGetState(FGLContext *ctx, GLenum pname, FGLStateGetter &state)
 	case GL_BLEND:
 	case GL_DITHER:
 	case GL_COLOR_LOGIC_OP:
+	case GL_LIGHTING:
+	case GL_LIGHT0:
+	case GL_LIGHT1:
+	case GL_LIGHT2:
+	case GL_LIGHT3:
+	case GL_LIGHT4:
+	case GL_LIGHT5:
+	case GL_LIGHT6:
+	case GL_LIGHT7:
+	case GL_COLOR_MATERIAL:
+	case GL_NORMALIZE:
+	case GL_RESCALE_NORMAL:
+	case GL_FOG:
+	case GL_CLIP_PLANE0:
+	case GL_CLIP_PLANE1:
+	case GL_CLIP_PLANE2:
+	case GL_CLIP_PLANE3:
 	case GL_VERTEX_ARRAY:
 	case GL_NORMAL_ARRAY:
 	case GL_COLOR_ARRAY:
@@ -1134,6 +1199,30 @@ GL_API GLboolean GL_APIENTRY glIsEnabled (GLenum cap)
 		return ctx->enable.dither;
 	case GL_COLOR_LOGIC_OP:
 		return ctx->enable.colorLogicOp;
+	case GL_LIGHTING:
+		return ctx->enable.lighting;
+	case GL_LIGHT0:
+	case GL_LIGHT1:
+	case GL_LIGHT2:
+	case GL_LIGHT3:
+	case GL_LIGHT4:
+	case GL_LIGHT5:
+	case GL_LIGHT6:
+	case GL_LIGHT7:
+		return ctx->lighting.light[cap - GL_LIGHT0].enabled;
+	case GL_COLOR_MATERIAL:
+		return ctx->enable.colorMaterial;
+	case GL_NORMALIZE:
+		return ctx->enable.normalize;
+	case GL_RESCALE_NORMAL:
+		return ctx->enable.rescaleNormal;
+	case GL_FOG:
+		return ctx->enable.fog;
+	case GL_CLIP_PLANE0:
+	case GL_CLIP_PLANE1:
+	case GL_CLIP_PLANE2:
+	case GL_CLIP_PLANE3:
+		return ctx->clipPlane[cap - GL_CLIP_PLANE0].enabled;
 	case GL_VERTEX_ARRAY:
 		return ctx->array[FGL_ARRAY_VERTEX].enabled;
 	case GL_NORMAL_ARRAY:
@@ -1191,27 +1280,146 @@ GL_API void GL_APIENTRY glGetBufferParameteriv (GLenum target,
 }
 
 /*
- * Stubs
+ * Lighting
  */
 
-GL_API void GL_APIENTRY glGetClipPlanef (GLenum pname, GLfloat eqn[4])
+static void fglGetLight(GLenum light, GLenum pname, FGLStateGetter &state)
 {
-	FUNC_UNIMPLEMENTED;
-}
+	if (light < GL_LIGHT0 || light >= GL_LIGHT0 + FGL_MAX_LIGHTS) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
 
-GL_API void GL_APIENTRY glGetClipPlanex (GLenum pname, GLfixed eqn[4])
-{
-	FUNC_UNIMPLEMENTED;
+	FGLContext *ctx = getContext();
+	FGLLightState *l = &ctx->lighting.light[light - GL_LIGHT0];
+
+	switch (pname) {
+	case GL_AMBIENT:
+		state.putFloats(l->ambient, 4);
+		break;
+	case GL_DIFFUSE:
+		state.putFloats(l->diffuse, 4);
+		break;
+	case GL_SPECULAR:
+		state.putFloats(l->specular, 4);
+		break;
+	case GL_POSITION:
+		state.putFloats(l->position, 4);
+		break;
+	case GL_SPOT_DIRECTION:
+		state.putFloats(l->direction, 3);
+		break;
+	case GL_SPOT_EXPONENT:
+		state.putFloat(l->exponent);
+		break;
+	case GL_SPOT_CUTOFF:
+		state.putFloat(l->cutoff);
+		break;
+	case GL_CONSTANT_ATTENUATION:
+		state.putFloat(l->constantAttenuation);
+		break;
+	case GL_LINEAR_ATTENUATION:
+		state.putFloat(l->linearAttenuation);
+		break;
+	case GL_QUADRATIC_ATTENUATION:
+		state.putFloat(l->quadraticAttenuation);
+		break;
+	default:
+		setError(GL_INVALID_ENUM);
+	}
 }
 
 GL_API void GL_APIENTRY glGetLightfv (GLenum light, GLenum pname,
 							GLfloat *params)
 {
-	FUNC_UNIMPLEMENTED;
+	FGLFloatGetter state(params);
+
+	fglGetLight(light, pname, state);
+}
+
+GL_API void GL_APIENTRY glGetLightxv (GLenum light, GLenum pname,
+							GLfixed *params)
+{
+	FGLFixedGetter state(params);
+
+	fglGetLight(light, pname, state);
+}
+
+static void fglGetMaterial(GLenum face, GLenum pname, FGLStateGetter &state)
+{
+	if (face != GL_FRONT && face != GL_BACK) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	FGLContext *ctx = getContext();
+	FGLLightingState *l = &ctx->lighting;
+
+	switch (pname) {
+	case GL_AMBIENT:
+		state.putFloats(l->ambient, 4);
+		break;
+	case GL_DIFFUSE:
+		state.putFloats(l->diffuse, 4);
+		break;
+	case GL_SPECULAR:
+		state.putFloats(l->specular, 4);
+		break;
+	case GL_EMISSION:
+		state.putFloats(l->emission, 4);
+		break;
+	case GL_SHININESS:
+		state.putFloat(l->shininess);
+		break;
+	default:
+		setError(GL_INVALID_ENUM);
+	}
 }
 
 GL_API void GL_APIENTRY glGetMaterialfv (GLenum face, GLenum pname,
 							GLfloat *params)
 {
-	FUNC_UNIMPLEMENTED;
+	FGLFloatGetter state(params);
+
+	fglGetMaterial(face, pname, state);
+}
+
+GL_API void GL_APIENTRY glGetMaterialxv (GLenum face, GLenum pname,
+							GLfixed *params)
+{
+	FGLFixedGetter state(params);
+
+	fglGetMaterial(face, pname, state);
 }
+
+/*
+ * User clip planes
+ */
+
+static void fglGetClipPlane(GLenum plane, FGLStateGetter &state)
+{
+	if (plane < GL_CLIP_PLANE0
+	    || plane >= GL_CLIP_PLANE0 + FGL_MAX_CLIP_PLANES) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	FGLContext *ctx = getContext();
+
+	state.putFloats(ctx->clipPlane[plane - GL_CLIP_PLANE0].equation, 4);
+}
+
+GL_API void GL_APIENTRY glGetClipPlanef (GLenum pname, GLfloat eqn[4])
+{
+	FGLFloatGetter state(eqn);
+
+	fglGetClipPlane(pname, state);
+}
+
+GL_API void GL_APIENTRY glGetClipPlanex (GLenum pname, GLfixed eqn[4])
+{
+	FGLFixedGetter state(eqn);
+
+	fglGetClipPlane(pname, state);
+}
+
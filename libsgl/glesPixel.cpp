@@ -260,8 +260,8 @@ static void burstCopy16(void *dst, const void *src, unsigned len)
 {
 	const uint8_t *s = (const uint8_t *)src;
 	uint8_t *d = (uint8_t *)dst;
-	unsigned srcAlign = (4 - (unsigned)src % 4) % 4;
-	unsigned dstAlign = (4 - (unsigned)dst % 4) % 4;
+	unsigned srcAlign = (4 - (uintptr_t)src % 4) % 4;
+	unsigned dstAlign = (4 - (uintptr_t)dst % 4) % 4;
 
 	if (srcAlign != dstAlign)
 		return fallbackCopy(d, s, len);
@@ -277,11 +277,17 @@ static void burstCopy16(void *dst, const void *src, unsigned len)
 	}
 
 	while (len >= 16) {
+#ifdef __arm__
 		asm(	"ldmia %0!, {r0-r3}\n"
 			"stmia %1!, {r0-r3}\n"
 			: "=r"(s), "=r"(d)
 			: "0"(s), "1"(d)
 			: "r0", "r1", "r2", "r3");
+#else
+		memcpy(d, s, 16);
+		s += 16;
+		d += 16;
+#endif
 		len -= 16;
 	}
 
@@ -460,25 +466,30 @@ static void *fillSingle32(void *buf, uint32_t val, size_t cnt)
 
 static void *fillBurst32(void *buf, uint32_t val, size_t cnt)
 {
+#ifndef __arm__
+	return fillSingle32(buf, val, 8*cnt);
+#else
 	asm volatile (
-		"mov r0, %1\n\t"
-		"mov r1, %1\n\t"
-		"mov r2, %1\n\t"
-		"mov r3, %1\n\t"
-		"mov r4, %1\n\t"
-		"mov r5, %1\n\t"
-		"mov r6, %1\n\t"
-		"mov r7, %1\n\t"
+		"mov r0, %2\n\t"
+		"mov r1, %2\n\t"
+		"mov r2, %2\n\t"
+		"mov r3, %2\n\t"
+		"mov r4, %2\n\t"
+		"mov r5, %2\n\t"
+		"mov r6, %2\n\t"
+		"mov r7, %2\n\t"
 		"1:\n\t"
 		"stmia %0!, {r0-r7}\n\t"
-		"subs %2, %2, $1\n\t"
+		"subs %1, %1, $1\n\t"
 		"bne 1b\n\t"
-		: "+r"(buf)
-		: "r"(val), "r"(cnt)
-		: "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7"
+		: "+r"(buf), "+r"(cnt)
+		: "r"(val)
+		: "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7",
+		  "cc", "memory"
 	);
 
 	return buf;
+#endif
 }
 
 static void *fillSingle32masked(void *buf, uint32_t val, uint32_t mask, size_t cnt)
@@ -497,34 +508,39 @@ static void *fillSingle32masked(void *buf, uint32_t val, uint32_t mask, size_t c
 
 static void *fillBurst32masked(void *buf, uint32_t val, uint32_t mask, size_t cnt)
 {
+#ifndef __arm__
+	return fillSingle32masked(buf, val, mask, 8*cnt);
+#else
 	asm volatile (
 		"1:\n\t"
 		"ldmia %0, {r0-r7}\n\t"
-		"and r0, r0, %2\n\t"
-		"and r1, r1, %2\n\t"
-		"and r2, r2, %2\n\t"
-		"and r3, r3, %2\n\t"
-		"and r4, r4, %2\n\t"
-		"and r5, r5, %2\n\t"
-		"and r6, r6, %2\n\t"
-		"and r7, r7, %2\n\t"
-		"orr r0, r0, %1\n\t"
-		"orr r1, r1, %1\n\t"
-		"orr r2, r2, %1\n\t"
-		"orr r3, r3, %1\n\t"
-		"orr r4, r4, %1\n\t"
-		"orr r5, r5, %1\n\t"
-		"orr r6, r6, %1\n\t"
-		"orr r7, r7, %1\n\t"
+		"and r0, r0, %3\n\t"
+		"and r1, r1, %3\n\t"
+		"and r2, r2, %3\n\t"
+		"and r3, r3, %3\n\t"
+		"and r4, r4, %3\n\t"
+		"and r5, r5, %3\n\t"
+		"and r6, r6, %3\n\t"
+		"and r7, r7, %3\n\t"
+		"orr r0, r0, %2\n\t"
+		"orr r1, r1, %2\n\t"
+		"orr r2, r2, %2\n\t"
+		"orr r3, r3, %2\n\t"
+		"orr r4, r4, %2\n\t"
+		"orr r5, r5, %2\n\t"
+		"orr r6, r6, %2\n\t"
+		"orr r7, r7, %2\n\t"
 		"stmia %0!, {r0-r7}\n\t"
-		"subs %3, %3, $1\n\t"
+		"subs %1, %1, $1\n\t"
 		"bne 1b\n\t"
-		: "+r"(buf)
-		: "r"(val), "r"(mask), "r"(cnt)
-		: "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7"
+		: "+r"(buf), "+r"(cnt)
+		: "r"(val), "r"(mask)
+		: "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7",
+		  "cc", "memory"
 	);
 
 	return buf;
+#endif
 }
 
 static void fill32(void *buf, uint32_t val, size_t cnt)
@@ -25,15 +25,18 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cmath>
 #include <errno.h>
 #include <pthread.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/ioctl.h>
 #include <GLES/gl.h>
 #include <GLES/glext.h>
 #include "glesCommon.h"
 #include "fglobjectmanager.h"
 #include "fglimage.h"
+#include "fglmipmap.h"
 #include "libfimg/fimg.h"
 #include "s3c_g2d.h"
 
@@ -175,159 +178,71 @@ static int fglGetFormatInfo(GLenum format, GLenum type, bool *conv)
 	}
 }
 
-static void fglGenerateMipmaps(FGLTexture *obj)
-{
-	int level = 0;
-	int skip = 1;
-
-	int w = obj->width;
-	int h = obj->height;
-	if ((w&h) == 1)
-		return;
-
-	w = (w>>1) ? : 1;
-	h = (h>>1) ? : 1;
+/*
+ * Mipmap generation
+ *
+ * Levels the framebuffer can render to are drawn by the GPU, the rest is
+ * box filtered by the CPU, using filters from fglmipmap.h.
+ */
 
+/* Generates mipmaps by CPU, starting from given level */
+static void fglGenerateMipmapsCPU(FGLTexture *obj, int level)
+{
 	const FGLPixelFormat *pix = FGLPixelFormat::get(obj->pixFormat);
-	void *curLevel = obj->surface->vaddr;
-	void *nextLevel = (uint8_t *)obj->surface->vaddr
-			+ pix->pixelSize*fimgGetTexMipmapOffset(obj->fimg, 1);
-
-processNextLevel:
-	++level;
-	int stride = w;
-	int bs = w;
-	switch (obj->pixFormat) {
-	case FGL_PIXFMT_RGB565: {
-		uint16_t const * src = (uint16_t const *)curLevel;
-		uint16_t* dst = (uint16_t*)nextLevel;
-		const uint32_t mask = 0x07E0F81F;
-		for (int y=0 ; y<h ; y++) {
-			size_t offset = (y*2) * bs;
-			for (int x=0 ; x<w ; x++) {
-				uint32_t p00 = src[offset];
-				uint32_t p10 = src[offset+1];
-				uint32_t p01 = src[offset+bs];
-				uint32_t p11 = src[offset+bs+1];
-				p00 = (p00 | (p00 << 16)) & mask;
-				p01 = (p01 | (p01 << 16)) & mask;
-				p10 = (p10 | (p10 << 16)) & mask;
-				p11 = (p11 | (p11 << 16)) & mask;
-				uint32_t grb = ((p00 + p10 + p01 + p11) >> 2) & mask;
-				uint32_t rgb = (grb & 0xFFFF) | (grb >> 16);
-				dst[x + y*stride] = rgb;
-				offset += 2;
-			}
-		}
-		break; }
-	case FGL_PIXFMT_RGBA5551: {
-		uint16_t const * src = (uint16_t const *)curLevel;
-		uint16_t* dst = (uint16_t*)nextLevel;
-		for (int y=0 ; y<h ; y++) {
-			size_t offset = (y*2) * bs;
-			for (int x=0 ; x<w ; x++) {
-				uint32_t p00 = src[offset];
-				uint32_t p10 = src[offset+1];
-				uint32_t p01 = src[offset+bs];
-				uint32_t p11 = src[offset+bs+1];
-				uint32_t r = ((p00>>11)+(p10>>11)+(p01>>11)+(p11>>11)+2)>>2;
-				uint32_t g = (((p00>>6)+(p10>>6)+(p01>>6)+(p11>>6)+2)>>2)&0x3F;
-				uint32_t b = ((p00&0x3E)+(p10&0x3E)+(p01&0x3E)+(p11&0x3E)+4)>>3;
-				uint32_t a = ((p00&1)+(p10&1)+(p01&1)+(p11&1)+2)>>2;
-				dst[x + y*stride] = (r<<11)|(g<<6)|(b<<1)|a;
-				offset += 2;
-			}
-		}
-		break; }
-	case FGL_PIXFMT_XRGB8888:
-	case FGL_PIXFMT_ARGB8888:
-	case FGL_PIXFMT_XBGR8888:
-	case FGL_PIXFMT_ABGR8888: {
-		uint32_t const * src = (uint32_t const *)curLevel;
-		uint32_t* dst = (uint32_t*)nextLevel;
-		for (int y=0 ; y<h ; y++) {
-			size_t offset = (y*2) * bs;
-			for (int x=0 ; x<w ; x++) {
-				uint32_t p00 = src[offset];
-				uint32_t p10 = src[offset+1];
-				uint32_t p01 = src[offset+bs];
-				uint32_t p11 = src[offset+bs+1];
-				uint32_t rb00 = p00 & 0x00FF00FF;
-				uint32_t rb01 = p01 & 0x00FF00FF;
-				uint32_t rb10 = p10 & 0x00FF00FF;
-				uint32_t rb11 = p11 & 0x00FF00FF;
-				uint32_t ga00 = (p00 >> 8) & 0x00FF00FF;
-				uint32_t ga01 = (p01 >> 8) & 0x00FF00FF;
-				uint32_t ga10 = (p10 >> 8) & 0x00FF00FF;
-				uint32_t ga11 = (p11 >> 8) & 0x00FF00FF;
-				uint32_t rb = (rb00 + rb01 + rb10 + rb11)>>2;
-				uint32_t ga = (ga00 + ga01 + ga10 + ga11)>>2;
-				uint32_t rgba = (rb & 0x00FF00FF) | ((ga & 0x00FF00FF)<<8);
-				dst[x + y*stride] = rgba;
-				offset += 2;
-			}
-		}
-		break; }
-	case FGL_PIXFMT_AL88:
-		skip = 2;
-		/* Fall-through */
-	case FGL_PIXFMT_L8: {
-		uint8_t const * src = (uint8_t const *)curLevel;
-		uint8_t* dst = (uint8_t*)nextLevel;
-		bs *= skip;
-		stride *= skip;
-		for (int y=0 ; y<h ; y++) {
-			size_t offset = (y*2) * bs;
-			for (int x=0 ; x<w ; x++) {
-				for (int c=0 ; c<skip ; c++) {
-					uint32_t p00 = src[c+offset];
-					uint32_t p10 = src[c+offset+skip];
-					uint32_t p01 = src[c+offset+bs];
-					uint32_t p11 = src[c+offset+bs+skip];
-					dst[x + y*stride + c] = (p00 + p10 + p01 + p11) >> 2;
-				}
-				offset += 2*skip;
-			}
-		}
-		break; }
-	case FGL_PIXFMT_RGBA4444: {
-		uint16_t const * src = (uint16_t const *)curLevel;
-		uint16_t* dst = (uint16_t*)nextLevel;
-		for (int y=0 ; y<h ; y++) {
-			size_t offset = (y*2) * bs;
-			for (int x=0 ; x<w ; x++) {
-				uint32_t p00 = src[offset];
-				uint32_t p10 = src[offset+1];
-				uint32_t p01 = src[offset+bs];
-				uint32_t p11 = src[offset+bs+1];
-				p00 = ((p00 << 12) & 0x0F0F0000) | (p00 & 0x0F0F);
-				p10 = ((p10 << 12) & 0x0F0F0000) | (p10 & 0x0F0F);
-				p01 = ((p01 << 12) & 0x0F0F0000) | (p01 & 0x0F0F);
-				p11 = ((p11 << 12) & 0x0F0F0000) | (p11 & 0x0F0F);
-				uint32_t rbga = (p00 + p10 + p01 + p11) >> 2;
-				uint32_t rgba = (rbga & 0x0F0F) | ((rbga>>12) & 0xF0F0);
-				dst[x + y*stride] = rgba;
-				offset += 2;
-			}
+	uint8_t *base = (uint8_t *)obj->surface->vaddr;
+
+	for (; level <= obj->maxLevel; ++level) {
+		unsigned width = (obj->width >> (level - 1)) ? : 1;
+		unsigned height = (obj->height >> (level - 1)) ? : 1;
+		void *src = base + pix->pixelSize
+				* fimgGetTexMipmapOffset(obj->fimg, level - 1);
+		void *dst = base + pix->pixelSize
+				* fimgGetTexMipmapOffset(obj->fimg, level);
+
+		switch (obj->pixFormat) {
+		case FGL_PIXFMT_RGB565:
+			fglDownsample16<FGLAverageRGB565>((const uint16_t *)src,
+					(uint16_t *)dst, width, height);
+			break;
+		case FGL_PIXFMT_RGBA5551:
+			fglDownsample16<FGLAverageRGBA5551>((const uint16_t *)src,
+					(uint16_t *)dst, width, height);
+			break;
+		case FGL_PIXFMT_RGBA4444:
+			fglDownsample16<FGLAverageRGBA4444>((const uint16_t *)src,
+					(uint16_t *)dst, width, height);
+			break;
+		case FGL_PIXFMT_AL88:
+			fglDownsample16<FGLAverageAL88>((const uint16_t *)src,
+					(uint16_t *)dst, width, height);
+			break;
+		case FGL_PIXFMT_XRGB8888:
+		case FGL_PIXFMT_ARGB8888:
+		case FGL_PIXFMT_XBGR8888:
+		case FGL_PIXFMT_ABGR8888:
+			fglDownsample8888((const uint32_t *)src,
+					(uint32_t *)dst, width, height);
+			break;
+		case FGL_PIXFMT_L8:
+			fglDownsample8((const uint8_t *)src,
+					(uint8_t *)dst, width, height);
+			break;
+		default:
+			ALOGE("Unsupported format (%d)", obj->pixFormat);
+			return;
 		}
-		break; }
-	default:
-		ALOGE("Unsupported format (%d)", obj->pixFormat);
-		return;
 	}
+}
 
-	// exit condition: we just processed the 1x1 LODs
-	if ((w&h) == 1)
-		return;
-
-	w = (w>>1) ? : 1;
-	h = (h>>1) ? : 1;
-
-	curLevel = nextLevel;
-	nextLevel = (uint8_t *)obj->surface->vaddr
-		+ pix->pixelSize*fimgGetTexMipmapOffset(obj->fimg, level + 1);
+/* Generates all mipmap levels from the base one */
+static void fglGenerateMipmaps(FGLContext *ctx, FGLTexture *obj)
+{
+	int level = 1;
 
-	goto processNextLevel;
+#ifdef FGL_GPU_MIPMAP_MIN_SIZE
+	level = fglRenderMipmaps(ctx, obj);
+#endif
+	fglGenerateMipmapsCPU(obj, level);
 }
 
 static size_t fglCalculateMipmaps(FGLTexture *obj, unsigned int width,
@@ -505,14 +420,39 @@ static void fglConvertTexture(FGLTexture *obj, unsigned level,
 	}
 }
 
-static inline void fglWaitForTexture(FGLContext *ctx, FGLTexture *tex)
+/* (Re)allocates texture memory, unless current one is close in size */
+static bool fglAllocateTexture(FGLTexture *obj, uint32_t size)
 {
-	for (int i = 0; i < FGL_MAX_TEXTURE_UNITS; ++i) {
-		if (ctx->busyTexture[i] == tex) {
-			glFinish();
-			break;
+	if (obj->surface) {
+		int32_t delta = obj->surface->size - size;
+		if (delta < 0 || delta > 16384) {
+			delete obj->surface;
+			obj->surface = 0;
 		}
 	}
+
+	if (obj->surface)
+		return true;
+
+	obj->surface = new FGLLocalSurface(size);
+	if (obj->surface && obj->surface->isValid())
+		return true;
+
+	delete obj->surface;
+	obj->surface = 0;
+	obj->width = 0;
+	obj->height = 0;
+	obj->format = 0;
+	obj->type = 0;
+	obj->pixFormat = 0;
+	return false;
+}
+
+/* Waits only for the draws still reading the texture */
+static inline void fglWaitForTexture(FGLContext *ctx, FGLTexture *tex)
+{
+	if (tex->surface)
+		tex->surface->waitFence(ctx->fimg);
 }
 
 GL_API void GL_APIENTRY glTexImage2D (GLenum target, GLint level,
@@ -632,6 +572,7 @@ GL_API void GL_APIENTRY glTexImage2D (GLenum target, GLint level,
 	obj->format = format;
 	obj->type = type;
 	obj->pixFormat = pixFormat;
+	obj->compressed = GL_FALSE;
 	obj->convert = convert;
 	obj->mask = 0;
 	if (pix->pixFormat != (uint32_t)-1)
@@ -647,28 +588,9 @@ GL_API void GL_APIENTRY glTexImage2D (GLenum target, GLint level,
 	uint32_t size = pix->pixelSize*fglCalculateMipmaps(obj,
 						width, height, pix->pixelSize);
 
-	if (obj->surface) {
-		int32_t delta = obj->surface->size - size;
-		if (delta < 0 || delta > 16384) {
-			delete obj->surface;
-			obj->surface = 0;
-		}
-	}
-
-	/* (Re)allocate the texture if needed */
-	if (!obj->surface) {
-		obj->surface = new FGLLocalSurface(size);
-		if(!obj->surface || !obj->surface->isValid()) {
-			delete obj->surface;
-			obj->surface = 0;
-			obj->width = 0;
-			obj->height = 0;
-			obj->format = 0;
-			obj->type = 0;
-			obj->pixFormat = 0;
-			setError(GL_OUT_OF_MEMORY);
-			return;
-		}
+	if (!fglAllocateTexture(obj, size)) {
+		setError(GL_OUT_OF_MEMORY);
+		return;
 	}
 
 	fimgInitTexture(obj->fimg, pix->flags,
@@ -689,7 +611,7 @@ GL_API void GL_APIENTRY glTexImage2D (GLenum target, GLint level,
 		}
 
 		if (obj->genMipmap)
-			fglGenerateMipmaps(obj);
+			fglGenerateMipmaps(ctx, obj);
 
 		obj->dirty = true;
 	}
@@ -852,7 +774,7 @@ GL_API void GL_APIENTRY glTexSubImage2D (GLenum target, GLint level,
 		return;
 	}
 
-	if (!obj->surface) {
+	if (!obj->surface || obj->compressed) {
 		setError(GL_INVALID_OPERATION);
 		return;
 	}
@@ -908,88 +830,1586 @@ GL_API void GL_APIENTRY glTexSubImage2D (GLenum target, GLint level,
 	obj->dirty = true;
 }
 
-GL_API void GL_APIENTRY glCompressedTexImage2D (GLenum target, GLint level,
-		GLenum internalformat, GLsizei width, GLsizei height,
-		GLint border, GLsizei imageSize, const GLvoid *data)
+/*
+ * Compressed textures
+ *
+ * DXT1 images are sampled by the hardware directly from 64-bit blocks
+ * holding two RGB565 colors and 2-bit selectors of 4x4 texels. Other S3TC
+ * formats are not supported by the texture unit, so they are decoded to
+ * ARGB8888 when uploaded.
+ *
+ * ETC1 blocks are transcoded to DXT1 blocks of the same size, which loses
+ * some quality, or decoded to RGB565 if FGL_ETC1_TO_DXT1 is not defined.
+ *
+ * Indices of paletted textures are sampled directly as well, using colors
+ * from the palette of texture unit, which is loaded when drawing.
+ */
+
+static int fglGetCompressedFormatInfo(GLenum format, bool *conv)
 {
-	FUNC_UNIMPLEMENTED;
+	*conv = 0;
+	switch (format) {
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+		return FGL_PIXFMT_S3TC;
+	case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		/* Needs decoding */
+		*conv = 1;
+		return FGL_PIXFMT_ARGB8888;
+	case GL_ETC1_RGB8_OES:
+		/* Needs transcoding */
+		*conv = 1;
+#ifdef FGL_ETC1_TO_DXT1
+		return FGL_PIXFMT_S3TC;
+#else
+		return FGL_PIXFMT_RGB565;
+#endif
+	case GL_PALETTE4_RGB8_OES:
+	case GL_PALETTE4_RGBA8_OES:
+	case GL_PALETTE4_R5_G6_B5_OES:
+	case GL_PALETTE4_RGBA4_OES:
+	case GL_PALETTE4_RGB5_A1_OES:
+		return FGL_PIXFMT_4BPP;
+	case GL_PALETTE8_RGB8_OES:
+	case GL_PALETTE8_RGBA8_OES:
+	case GL_PALETTE8_R5_G6_B5_OES:
+	case GL_PALETTE8_RGBA4_OES:
+	case GL_PALETTE8_RGB5_A1_OES:
+		return FGL_PIXFMT_8BPP;
+	default:
+		return -1;
+	}
 }
 
-GL_API void GL_APIENTRY glCompressedTexSubImage2D (GLenum target, GLint level,
-		GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
-		GLenum format, GLsizei imageSize, const GLvoid *data)
+static size_t fglGetCompressedImageSize(GLenum format,
+					unsigned width, unsigned height)
 {
-	FUNC_UNIMPLEMENTED;
+	size_t blocks = ((width + 3) / 4) * ((height + 3) / 4);
+
+	if (format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+	    || format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+	    || format == GL_ETC1_RGB8_OES)
+		return 8*blocks;
+
+	return 16*blocks;
 }
 
-GL_API void GL_APIENTRY glCopyTexImage2D (GLenum target, GLint level,
-		GLenum internalformat, GLint x, GLint y, GLsizei width,
-		GLsizei height, GLint border)
+/* Levels of S3TC texture are made of whole 4x4 blocks (16 texels) */
+static size_t fglCalculateMipmapsS3TC(FGLTexture *obj, unsigned int width,
+							unsigned int height)
 {
-	FUNC_UNIMPLEMENTED;
+	size_t offset;
+	unsigned int lvl, check;
+
+	offset = 0;
+	check = max(width, height);
+	lvl = 0;
+
+	do {
+		fimgSetTexMipmapOffset(obj->fimg, lvl, offset);
+		offset += 16 * ((width + 3) / 4) * ((height + 3) / 4);
+
+		if(lvl == FGL_MAX_MIPMAP_LEVEL)
+			break;
+
+		check /= 2;
+		if(check == 0)
+			break;
+
+		++lvl;
+
+		if (width >= 2)
+			width /= 2;
+
+		if (height >= 2)
+			height /= 2;
+	} while (1);
+
+	obj->maxLevel = lvl;
+	return offset;
 }
 
-GL_API void GL_APIENTRY glCopyTexSubImage2D (GLenum target, GLint level,
-		GLint xoffset, GLint yoffset, GLint x, GLint y, GLsizei width,
-		GLsizei height)
+static inline uint32_t fglUnpackRGB565(uint16_t c)
 {
-	FUNC_UNIMPLEMENTED;
+	uint32_t r = (c >> 11) & 0x1f;
+	uint32_t g = (c >> 5) & 0x3f;
+	uint32_t b = c & 0x1f;
+
+	r = (r << 3) | (r >> 2);
+	g = (g << 2) | (g >> 4);
+	b = (b << 3) | (b >> 2);
+
+	return (r << 16) | (g << 8) | b;
 }
 
-GL_API void GL_APIENTRY glEGLImageTargetTexture2DOES (GLenum target,
-							GLeglImageOES img)
+/* Interpolates packed RGB888 colors as (w0*c0 + w1*c1) / 3 */
+static inline uint32_t fglBlendRGB(uint32_t c0, uint32_t c1,
+						unsigned w0, unsigned w1)
 {
-	FGLContext *ctx = getContext();
-	FGLTexture *tex;
+	uint32_t r = (w0*((c0 >> 16) & 0xff) + w1*((c1 >> 16) & 0xff)) / 3;
+	uint32_t g = (w0*((c0 >> 8) & 0xff) + w1*((c1 >> 8) & 0xff)) / 3;
+	uint32_t b = (w0*(c0 & 0xff) + w1*(c1 & 0xff)) / 3;
 
-	switch (target) {
-	case GL_TEXTURE_2D:
-		tex = ctx->texture[ctx->activeTexture].getTexture();
-		break;
-	case GL_TEXTURE_EXTERNAL_OES:
-		tex = ctx->textureExternal[ctx->activeTexture].getTexture();
-		break;
-	default:
-		setError(GL_INVALID_ENUM);
-		return;
+	return (r << 16) | (g << 8) | b;
+}
+
+/* Decodes a DXT3 or DXT5 block into ARGB8888 texels */
+static void fglDecodeDXTBlock(GLenum format, const uint8_t *block,
+				uint32_t *dst, size_t stride,
+				unsigned width, unsigned height)
+{
+	uint8_t alpha[16];
+	uint32_t colors[4];
+	const uint8_t *color = block + 8;
+
+	if (format == GL_COMPRESSED_RGBA_S3TC_DXT3_EXT) {
+		/* Explicit 4-bit alpha */
+		for (unsigned i = 0; i < 16; i += 2) {
+			alpha[i] = (block[i / 2] & 0xf) * 0x11;
+			alpha[i + 1] = (block[i / 2] >> 4) * 0x11;
+		}
+	} else {
+		/* Interpolated alpha with 3-bit selectors */
+		unsigned a0 = block[0];
+		unsigned a1 = block[1];
+		uint8_t values[8];
+		uint64_t bits = 0;
+
+		values[0] = a0;
+		values[1] = a1;
+		if (a0 > a1) {
+			for (unsigned i = 1; i < 7; ++i)
+				values[i + 1] = ((7 - i)*a0 + i*a1) / 7;
+		} else {
+			for (unsigned i = 1; i < 5; ++i)
+				values[i + 1] = ((5 - i)*a0 + i*a1) / 5;
+			values[6] = 0;
+			values[7] = 255;
+		}
+
+		for (unsigned i = 0; i < 6; ++i)
+			bits |= (uint64_t)block[2 + i] << (8*i);
+
+		for (unsigned i = 0; i < 16; ++i)
+			alpha[i] = values[(bits >> (3*i)) & 7];
 	}
 
-	FGLImage *image = (FGLImage *)img;
-	if (!image || !image->isValid()) {
-		setError(GL_INVALID_VALUE);
-		return;
+	/* Color block of DXT3 and DXT5 always uses four colors */
+	colors[0] = fglUnpackRGB565(color[0] | (color[1] << 8));
+	colors[1] = fglUnpackRGB565(color[2] | (color[3] << 8));
+	colors[2] = fglBlendRGB(colors[0], colors[1], 2, 1);
+	colors[3] = fglBlendRGB(colors[0], colors[1], 1, 2);
+
+	for (unsigned y = 0; y < height; ++y) {
+		uint8_t sel = color[4 + y];
+
+		for (unsigned x = 0; x < width; ++x) {
+			dst[x] = ((uint32_t)alpha[4*y + x] << 24)
+					| colors[(sel >> (2*x)) & 3];
+		}
+
+		dst += stride;
 	}
+}
 
-	const FGLPixelFormat *cfg = FGLPixelFormat::get(image->pixelFormat);
+static const int fglETC1Modifiers[8][4] = {
+	{  2,   8,  -2,   -8 },
+	{  5,  17,  -5,  -17 },
+	{  9,  29,  -9,  -29 },
+	{ 13,  42, -13,  -42 },
+	{ 18,  60, -18,  -60 },
+	{ 24,  80, -24,  -80 },
+	{ 33, 106, -33, -106 },
+	{ 47, 183, -47, -183 },
+};
+
+/* Signed 3-bit color differences of differential mode */
+static const int fglETC1Deltas[8] = { 0, 1, 2, 3, -4, -3, -2, -1 };
+
+static inline uint32_t fglClampColor(int c)
+{
+	return (c < 0) ? 0 : ((c > 255) ? 255 : c);
+}
 
-	if (tex->eglImage)
-		tex->eglImage->disconnect();
-	else
-		delete tex->surface;
+/*
+ * Decodes ETC1 block into RGB888 texels in row-major order. Both subblocks
+ * have only four colors, so they are computed first and texels are just
+ * looked up using their 2-bit indices.
+ */
+static void fglDecodeETC1Block(const uint8_t *block, uint32_t *texels)
+{
+	uint32_t colors[2][4];
+	int base[2][3];
 
-	tex->invReady	= false;
-	tex->surface	= image->surface;
-	tex->eglImage	= image;
-	tex->format	= cfg->readFormat;
-	tex->type	= cfg->readType;
-	tex->pixFormat	= image->pixelFormat;
-	tex->convert	= 0;
-	tex->maxLevel	= 0;
-	tex->dirty	= true;
-	tex->width	= image->width;
-	tex->height	= image->height;
+	if (block[3] & 2) {
+		/* Differential mode, 5-bit base color and 3-bit difference */
+		for (unsigned c = 0; c < 3; ++c) {
+			int c0 = block[c] >> 3;
+			int c1 = (c0 + fglETC1Deltas[block[c] & 7]) & 0x1f;
 
-	// Setup fimgTexture
-	fimgInitTexture(tex->fimg,
-			cfg->flags, cfg->texFormat, tex->surface->paddr);
-	fimgSetTex2DSize(tex->fimg, image->width, image->height, tex->maxLevel);
-	fimgSetTexMipmap(tex->fimg, FGTU_TSTA_MIPMAP_DISABLED);
-	if (target == GL_TEXTURE_EXTERNAL_OES)
-		fimgSetTexMinFilter(tex->fimg, FGTU_TSTA_FILTER_LINEAR);
+			base[0][c] = (c0 << 3) | (c0 >> 2);
+			base[1][c] = (c1 << 3) | (c1 >> 2);
+		}
+	} else {
+		/* Individual mode, two 4-bit colors */
+		for (unsigned c = 0; c < 3; ++c) {
+			base[0][c] = (block[c] >> 4) * 0x11;
+			base[1][c] = (block[c] & 0xf) * 0x11;
+		}
+	}
 
-	tex->eglImage->connect();
+	for (unsigned sub = 0; sub < 2; ++sub) {
+		const int *mod = fglETC1Modifiers[(block[3] >> (sub ? 2 : 5)) & 7];
+
+		for (unsigned i = 0; i < 4; ++i)
+			colors[sub][i] = (fglClampColor(base[sub][0] + mod[i]) << 16)
+				| (fglClampColor(base[sub][1] + mod[i]) << 8)
+				| fglClampColor(base[sub][2] + mod[i]);
+	}
+
+	/* Texels are stored in column-major order, MSBs of indices first */
+	uint32_t msb = (block[4] << 8) | block[5];
+	uint32_t lsb = (block[6] << 8) | block[7];
+	/* Subblocks are 2x4 side by side or 4x2 one above another if flipped */
+	unsigned shift = (block[3] & 1) ? 1 : 3;
+
+	for (unsigned i = 0; i < 16; ++i) {
+		unsigned sub = (i >> shift) & 1;
+		unsigned idx = (((msb >> i) & 1) << 1) | ((lsb >> i) & 1);
+
+		texels[4*(i % 4) + i / 4] = colors[sub][idx];
+	}
+}
+
+static inline uint16_t fglPackRGB565(uint32_t rgb)
+{
+	uint32_t r = (((rgb >> 16) & 0xff) * 31 + 127) / 255;
+	uint32_t g = (((rgb >> 8) & 0xff) * 63 + 127) / 255;
+	uint32_t b = ((rgb & 0xff) * 31 + 127) / 255;
+
+	return (r << 11) | (g << 5) | b;
+}
+
+static inline unsigned fglColorDistance(uint32_t c0, uint32_t c1)
+{
+	int dr = (int)((c0 >> 16) & 0xff) - (int)((c1 >> 16) & 0xff);
+	int dg = (int)((c0 >> 8) & 0xff) - (int)((c1 >> 8) & 0xff);
+	int db = (int)(c0 & 0xff) - (int)(c1 & 0xff);
+
+	return dr*dr + dg*dg + db*db;
+}
+
+static inline int fglDotRGB(uint32_t c, const int *dir)
+{
+	return (int)((c >> 16) & 0xff)*dir[0] + (int)((c >> 8) & 0xff)*dir[1]
+						+ (int)(c & 0xff)*dir[2];
+}
+
+/*
+ * Chooses the closest of four interpolated colors for each texel, by
+ * projecting it on the line between endpoints, instead of comparing
+ * distances to all of them. Returns selectors and sum of squared errors.
+ */
+static unsigned fglSelectDXT1Colors(const uint32_t *texels,
+				uint16_t c0, uint16_t c1, uint32_t *selectors)
+{
+	uint32_t colors[4];
+	unsigned error = 0;
+	int dir[3];
+
+	colors[0] = fglUnpackRGB565(c0);
+	colors[1] = fglUnpackRGB565(c1);
+	colors[2] = fglBlendRGB(colors[0], colors[1], 2, 1);
+	colors[3] = fglBlendRGB(colors[0], colors[1], 1, 2);
+
+	for (unsigned k = 0; k < 3; ++k)
+		dir[k] = (int)((colors[0] >> (16 - 8*k)) & 0xff)
+				- (int)((colors[1] >> (16 - 8*k)) & 0xff);
+
+	/* Colors go in order 1, 3, 2, 0 along the line */
+	int stop1 = fglDotRGB(colors[1], dir);
+	int stop3 = fglDotRGB(colors[3], dir);
+	int stop2 = fglDotRGB(colors[2], dir);
+	int stop0 = fglDotRGB(colors[0], dir);
+	int half13 = stop1 + stop3;
+	int half32 = stop3 + stop2;
+	int half20 = stop2 + stop0;
+
+	*selectors = 0;
+	for (unsigned i = 0; i < 16; ++i) {
+		int dot = 2*fglDotRGB(texels[i], dir);
+		unsigned sel;
+
+		if (dot < half13)
+			sel = 1;
+		else if (dot < half32)
+			sel = 3;
+		else if (dot < half20)
+			sel = 2;
+		else
+			sel = 0;
+
+		*selectors |= sel << (2*i);
+		error += fglColorDistance(texels[i], colors[sel]);
+	}
+
+	return error;
+}
+
+/*
+ * Computes least squares endpoints for given selectors, to move them
+ * closer to the texels than the extremes along the principal axis are.
+ */
+static bool fglRefineDXT1Endpoints(const uint32_t *texels,
+				uint32_t selectors, uint32_t *e0, uint32_t *e1)
+{
+	static const float weights[4] = { 1.0f, 0.0f, 2.0f/3, 1.0f/3 };
+	float a = 0, b = 0, c = 0;
+	float x0[3] = { 0, 0, 0 };
+	float x1[3] = { 0, 0, 0 };
+
+	for (unsigned i = 0; i < 16; ++i) {
+		float w = weights[(selectors >> (2*i)) & 3];
+
+		a += w*w;
+		b += (1 - w)*(1 - w);
+		c += w*(1 - w);
+
+		for (unsigned k = 0; k < 3; ++k) {
+			float p = (texels[i] >> (16 - 8*k)) & 0xff;
+			x0[k] += w*p;
+			x1[k] += (1 - w)*p;
+		}
+	}
+
+	float det = a*b - c*c;
+	if (det < 1e-3f)
+		return false;
+
+	*e0 = *e1 = 0;
+	for (unsigned k = 0; k < 3; ++k) {
+		float v0 = (b*x0[k] - c*x1[k]) / det;
+		float v1 = (a*x1[k] - c*x0[k]) / det;
+
+		*e0 |= fglClampColor((int)(v0 + 0.5f)) << (16 - 8*k);
+		*e1 |= fglClampColor((int)(v1 + 0.5f)) << (16 - 8*k);
+	}
+
+	return true;
+}
+
+/* Writes DXT1 block in four color mode */
+static void fglPackDXT1Block(uint8_t *block, uint16_t c0, uint16_t c1,
+							uint32_t selectors)
+{
+	if (c0 < c1) {
+		uint16_t tmp = c0;
+		c0 = c1;
+		c1 = tmp;
+		/* Swap selectors 0 and 1, 2 and 3 */
+		selectors ^= 0x55555555;
+	} else if (c0 == c1) {
+		selectors = 0;
+	}
+
+	block[0] = c0 & 0xff;
+	block[1] = c0 >> 8;
+	block[2] = c1 & 0xff;
+	block[3] = c1 >> 8;
+	block[4] = selectors & 0xff;
+	block[5] = (selectors >> 8) & 0xff;
+	block[6] = (selectors >> 16) & 0xff;
+	block[7] = selectors >> 24;
+}
+
+/*
+ * Encodes RGB888 texels as DXT1 block. Endpoints are the extremes of
+ * texel colors projected on the principal axis of their distribution,
+ * refined once using least squares fit.
+ */
+static void fglEncodeDXT1Block(const uint32_t *texels, uint8_t *block)
+{
+	int mean[3] = { 0, 0, 0 };
+	int cov[6] = { 0, 0, 0, 0, 0, 0 };
+	int p[16][3];
+
+	for (unsigned i = 0; i < 16; ++i)
+		for (unsigned k = 0; k < 3; ++k)
+			mean[k] += (texels[i] >> (16 - 8*k)) & 0xff;
+
+	for (unsigned i = 0; i < 16; ++i) {
+		for (unsigned k = 0; k < 3; ++k)
+			p[i][k] = 16*((texels[i] >> (16 - 8*k)) & 0xff) - mean[k];
+
+		cov[0] += p[i][0]*p[i][0] >> 4;
+		cov[1] += p[i][0]*p[i][1] >> 4;
+		cov[2] += p[i][0]*p[i][2] >> 4;
+		cov[3] += p[i][1]*p[i][1] >> 4;
+		cov[4] += p[i][1]*p[i][2] >> 4;
+		cov[5] += p[i][2]*p[i][2] >> 4;
+	}
+
+	/* Principal axis using power iteration */
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (unsigned iter = 0; iter < 4; ++iter) {
+		float r = cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2];
+		float g = cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2];
+		float b = cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2];
+		float m = max(fabsf(r), max(fabsf(g), fabsf(b)));
+
+		if (m == 0.0f)
+			break;
+
+		axis[0] = r / m;
+		axis[1] = g / m;
+		axis[2] = b / m;
+	}
+
+	unsigned minIdx = 0, maxIdx = 0;
+	float minDot = 0, maxDot = 0;
+	for (unsigned i = 0; i < 16; ++i) {
+		float dot = p[i][0]*axis[0] + p[i][1]*axis[1] + p[i][2]*axis[2];
+
+		if (!i || dot < minDot) {
+			minDot = dot;
+			minIdx = i;
+		}
+		if (!i || dot > maxDot) {
+			maxDot = dot;
+			maxIdx = i;
+		}
+	}
+
+	uint16_t c0 = fglPackRGB565(texels[maxIdx]);
+	uint16_t c1 = fglPackRGB565(texels[minIdx]);
+	uint32_t selectors;
+	unsigned error = fglSelectDXT1Colors(texels, c0, c1, &selectors);
+
+	uint32_t e0, e1;
+	if (error && fglRefineDXT1Endpoints(texels, selectors, &e0, &e1)) {
+		uint16_t r0 = fglPackRGB565(e0);
+		uint16_t r1 = fglPackRGB565(e1);
+		uint32_t refined;
+
+		if (fglSelectDXT1Colors(texels, r0, r1, &refined) < error) {
+			c0 = r0;
+			c1 = r1;
+			selectors = refined;
+		}
+	}
+
+	fglPackDXT1Block(block, c0, c1, selectors);
+}
+
+static inline bool fglIsPalettedFormat(GLenum format)
+{
+	return format >= GL_PALETTE4_RGB8_OES
+				&& format <= GL_PALETTE8_RGB5_A1_OES;
+}
+
+/* 4-bit formats go first, followed by 8-bit ones in the same order */
+static inline unsigned fglGetPaletteIndexBits(GLenum format)
+{
+	return (format <= GL_PALETTE4_RGB5_A1_OES) ? 4 : 8;
+}
+
+static unsigned fglGetPaletteEntrySize(GLenum format)
+{
+	switch (format) {
+	case GL_PALETTE4_RGB8_OES:
+	case GL_PALETTE8_RGB8_OES:
+		return 3;
+	case GL_PALETTE4_RGBA8_OES:
+	case GL_PALETTE8_RGBA8_OES:
+		return 4;
+	default:
+		return 2;
+	}
+}
+
+/* Palette is followed by indices of all levels, each starting at a byte */
+static size_t fglGetPalettedImageSize(GLenum format, unsigned width,
+					unsigned height, unsigned levels)
+{
+	unsigned bits = fglGetPaletteIndexBits(format);
+	size_t size = (1 << bits)*fglGetPaletteEntrySize(format);
+
+	while (levels--) {
+		size += (width*height*bits + 7) / 8;
+
+		if (width >= 2)
+			width /= 2;
+
+		if (height >= 2)
+			height /= 2;
+	}
+
+	return size;
 }
 
+/*
+ * Converts palette to hardware format with alpha in LSBs, which for 16-bit
+ * colors is the layout used by GL, and loads it into texture.
+ */
+static int fglLoadTexturePalette(FGLTexture *obj, const uint8_t *src)
+{
+	unsigned count = 1 << fglGetPaletteIndexBits(obj->format);
+	uint32_t entries[FGTU_PALETTE_ENTRIES];
+	unsigned palFormat;
+
+	switch (obj->format) {
+	case GL_PALETTE4_RGB8_OES:
+	case GL_PALETTE8_RGB8_OES:
+		for (unsigned i = 0; i < count; ++i, src += 3)
+			entries[i] = (src[0] << 24) | (src[1] << 16)
+							| (src[2] << 8) | 0xff;
+		palFormat = FGTU_TSTA_PAL_TEX_FORMAT_8888;
+		break;
+	case GL_PALETTE4_RGBA8_OES:
+	case GL_PALETTE8_RGBA8_OES:
+		for (unsigned i = 0; i < count; ++i, src += 4)
+			entries[i] = (src[0] << 24) | (src[1] << 16)
+						| (src[2] << 8) | src[3];
+		palFormat = FGTU_TSTA_PAL_TEX_FORMAT_8888;
+		break;
+	case GL_PALETTE4_R5_G6_B5_OES:
+	case GL_PALETTE8_R5_G6_B5_OES:
+		palFormat = FGTU_TSTA_PAL_TEX_FORMAT_565;
+		goto copy16;
+	case GL_PALETTE4_RGBA4_OES:
+	case GL_PALETTE8_RGBA4_OES:
+		palFormat = FGTU_TSTA_PAL_TEX_FORMAT_4444;
+		goto copy16;
+	default:
+		palFormat = FGTU_TSTA_PAL_TEX_FORMAT_1555;
+copy16:
+		for (unsigned i = 0; i < count; ++i, src += 2)
+			entries[i] = src[0] | (src[1] << 8);
+	}
+
+	return fimgSetTexPalette(obj->fimg, palFormat, entries, count);
+}
+
+/*
+ * Copies indices of given number of mipmap levels. Hardware takes 4-bit
+ * indices starting from low nibble of each byte, GL from the high one.
+ */
+static void fglLoadPalettedTexture(FGLTexture *obj, const uint8_t *src,
+							unsigned levels)
+{
+	unsigned bits = fglGetPaletteIndexBits(obj->format);
+	uint8_t *dst = (uint8_t *)obj->surface->vaddr;
+	unsigned width = obj->width;
+	unsigned height = obj->height;
+
+	for (unsigned level = 0; level < levels; ++level) {
+		unsigned offset = fimgGetTexMipmapOffset(obj->fimg, level);
+		size_t count = width*height;
+
+		if (bits == 8) {
+			memcpy(dst + offset, src, count);
+			src += count;
+		} else if (offset % 2 == 0) {
+			uint8_t *dst8 = dst + offset / 2;
+
+			for (size_t i = 0; i < count / 2; ++i)
+				dst8[i] = (src[i] >> 4) | (src[i] << 4);
+			if (count % 2)
+				dst8[count / 2] = (dst8[count / 2] & 0xf0)
+						| (src[count / 2] >> 4);
+			src += (count + 1) / 2;
+		} else {
+			/* Level starts in the middle of a byte */
+			for (size_t i = 0; i < count; ++i) {
+				unsigned index = src[i / 2] >> (4*(~i & 1));
+				size_t texel = offset + i;
+				unsigned shift = 4*(texel % 2);
+
+				dst[texel / 2] = (dst[texel / 2] & ~(0xf << shift))
+						| ((index & 0xf) << shift);
+			}
+			src += (count + 1) / 2;
+		}
+
+		if (width >= 2)
+			width /= 2;
+
+		if (height >= 2)
+			height /= 2;
+	}
+}
+
+/*
+ * Sets up offsets of specified levels of paletted texture only.
+ * Returns size of indices in bytes.
+ */
+static size_t fglCalculateMipmapsPaletted(FGLTexture *obj,
+			unsigned width, unsigned height, unsigned levels)
+{
+	size_t texels = fglCalculateMipmaps(obj, width, height, 0);
+
+	if (levels <= (unsigned)obj->maxLevel) {
+		texels = fimgGetTexMipmapOffset(obj->fimg, levels);
+		obj->maxLevel = levels - 1;
+	}
+
+	return (texels*fglGetPaletteIndexBits(obj->format) + 7) / 8;
+}
+
+/*
+ * Copies (or decodes) compressed image into region of mipmap level.
+ * Offsets of the region must be multiples of block size.
+ */
+static void fglLoadCompressedTexture(FGLTexture *obj, unsigned level,
+			const GLvoid *data, unsigned x, unsigned y,
+			unsigned w, unsigned h)
+{
+	const uint8_t *src8 = (const uint8_t *)data;
+	unsigned offset = fimgGetTexMipmapOffset(obj->fimg, level);
+
+	unsigned width = obj->width >> level;
+	if (!width)
+		width = 1;
+
+	unsigned blocksW = (w + 3) / 4;
+	unsigned blocksH = (h + 3) / 4;
+
+	if (obj->pixFormat == FGL_PIXFMT_S3TC) {
+		/* DXT1 blocks, 4 bits per texel */
+		size_t line = 8*blocksW;
+		size_t dstStride = 8*((width + 3) / 4);
+		uint8_t *dst8 = (uint8_t *)obj->surface->vaddr + offset / 2
+					+ (y / 4)*dstStride + 8*(x / 4);
+
+		if (obj->format == GL_ETC1_RGB8_OES) {
+			uint32_t texels[16];
+
+			do {
+				for (unsigned bx = 0; bx < blocksW; ++bx) {
+					fglDecodeETC1Block(src8, texels);
+					fglEncodeDXT1Block(texels, dst8 + 8*bx);
+					src8 += 8;
+				}
+				dst8 += dstStride;
+			} while (--blocksH);
+			return;
+		}
+
+		if (line == dstStride) {
+			memcpy(dst8, src8, line*blocksH);
+			return;
+		}
+
+		do {
+			memcpy(dst8, src8, line);
+			src8 += line;
+			dst8 += dstStride;
+		} while (--blocksH);
+		return;
+	}
+
+	if (obj->pixFormat == FGL_PIXFMT_RGB565) {
+		uint16_t *dst16 = (uint16_t *)obj->surface->vaddr + offset
+							+ y*width + x;
+		uint32_t texels[16];
+
+		for (unsigned by = 0; by < blocksH; ++by) {
+			unsigned bh = min(4U, h - 4*by);
+
+			for (unsigned bx = 0; bx < blocksW; ++bx) {
+				unsigned bw = min(4U, w - 4*bx);
+
+				fglDecodeETC1Block(src8, texels);
+				for (unsigned ty = 0; ty < bh; ++ty)
+					for (unsigned tx = 0; tx < bw; ++tx)
+						dst16[ty*width + 4*bx + tx] =
+						fglPackRGB565(texels[4*ty + tx]);
+				src8 += 8;
+			}
+
+			dst16 += 4*width;
+		}
+		return;
+	}
+
+	uint32_t *dst32 = (uint32_t *)obj->surface->vaddr + offset
+							+ y*width + x;
+
+	for (unsigned by = 0; by < blocksH; ++by) {
+		unsigned bh = min(4U, h - 4*by);
+
+		for (unsigned bx = 0; bx < blocksW; ++bx) {
+			unsigned bw = min(4U, w - 4*bx);
+
+			fglDecodeDXTBlock(obj->format, src8,
+					dst32 + 4*bx, width, bw, bh);
+			src8 += 16;
+		}
+
+		dst32 += 4*width;
+	}
+}
+
+GL_API void GL_APIENTRY glCompressedTexImage2D (GLenum target, GLint level,
+		GLenum internalformat, GLsizei width, GLsizei height,
+		GLint border, GLsizei imageSize, const GLvoid *data)
+{
+	/* Check conditions required by specification */
+	if (target != GL_TEXTURE_2D) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	bool convert;
+	int pixFormat = fglGetCompressedFormatInfo(internalformat, &convert);
+	if (pixFormat < 0) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	/* Paletted image has all levels, their count given as -level + 1 */
+	unsigned levels = 1;
+	bool paletted = fglIsPalettedFormat(internalformat);
+	if (paletted && level <= 0) {
+		levels = 1 - level;
+		level = 0;
+	}
+
+	if (level < 0 || border != 0 || width < 0 || height < 0) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	if (paletted) {
+		unsigned maxLevels = 1;
+		for (unsigned size = max(width, height); size > 1; size /= 2)
+			++maxLevels;
+
+		if (level > 0 || levels > maxLevels
+		    || levels > FGL_MAX_MIPMAP_LEVEL + 1
+		    || (size_t)imageSize != fglGetPalettedImageSize(
+				internalformat, width, height, levels)) {
+			setError(GL_INVALID_VALUE);
+			return;
+		}
+	} else if ((size_t)imageSize != fglGetCompressedImageSize(
+					internalformat, width, height)) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	FGLContext *ctx = getContext();
+	FGLTexture *obj = ctx->texture[ctx->activeTexture].getTexture();
+
+	/* Mipmap image specification */
+	if (level > 0) {
+		if (obj->eglImage || !obj->surface) {
+			/* Mipmaps can be specified only if base level exists */
+			setError(GL_INVALID_OPERATION);
+			return;
+		}
+
+		if (!obj->compressed || obj->format != internalformat) {
+			/* Must be the same format as base level */
+			setError(GL_INVALID_OPERATION);
+			return;
+		}
+
+		GLint mipmapW, mipmapH;
+
+		mipmapW = obj->width >> level;
+		if (!mipmapW)
+			mipmapW = 1;
+
+		mipmapH = obj->height >> level;
+		if (!mipmapH)
+			mipmapH = 1;
+
+		if (level > obj->maxLevel
+		    || mipmapW != width || mipmapH != height) {
+			/* Invalid size */
+			setError(GL_INVALID_VALUE);
+			return;
+		}
+
+		if (data != NULL) {
+			fglWaitForTexture(ctx, obj);
+			fglLoadCompressedTexture(obj, level, data,
+							0, 0, width, height);
+			obj->dirty = true;
+		}
+
+		return;
+	}
+
+	/* Base image specification */
+	fglWaitForTexture(ctx, obj);
+
+	if (obj->eglImage) {
+		obj->eglImage->disconnect();
+		obj->eglImage = 0;
+		obj->surface = 0;
+	}
+
+	if (width != obj->width || height != obj->height
+	    || (uint32_t)pixFormat != obj->pixFormat)
+		obj->markFramebufferDirty();
+
+	const FGLPixelFormat *pix = FGLPixelFormat::get(pixFormat);
+	obj->invReady = false;
+	obj->width = width;
+	obj->height = height;
+	obj->format = internalformat;
+	obj->type = 0;
+	obj->pixFormat = pixFormat;
+	obj->compressed = GL_TRUE;
+	obj->convert = convert;
+	obj->mask = 0;
+	if (pix->pixFormat != (uint32_t)-1)
+		obj->mask = BIT_VAL(FGL_ATTACHMENT_COLOR);
+
+	if (!width || !height) {
+		delete obj->surface;
+		obj->surface = 0;
+		return;
+	}
+
+	/* Calculate mipmaps */
+	uint32_t size;
+	if (pixFormat == FGL_PIXFMT_S3TC)
+		size = fglCalculateMipmapsS3TC(obj, width, height) / 2;
+	else if (paletted)
+		size = fglCalculateMipmapsPaletted(obj, width, height, levels);
+	else
+		size = pix->pixelSize*fglCalculateMipmaps(obj,
+						width, height, pix->pixelSize);
+
+	if (!fglAllocateTexture(obj, size)) {
+		setError(GL_OUT_OF_MEMORY);
+		return;
+	}
+
+	fimgInitTexture(obj->fimg, pix->flags,
+					pix->texFormat, obj->surface->paddr);
+	fimgSetTex2DSize(obj->fimg, width, height, obj->maxLevel);
+
+	if (data != NULL && paletted) {
+		const uint8_t *src8 = (const uint8_t *)data;
+
+		if (fglLoadTexturePalette(obj, src8)) {
+			setError(GL_OUT_OF_MEMORY);
+			return;
+		}
+
+		src8 += fglGetPaletteEntrySize(internalformat)
+				<< fglGetPaletteIndexBits(internalformat);
+		fglLoadPalettedTexture(obj, src8, levels);
+		obj->dirty = true;
+		return;
+	}
+
+	if (data != NULL) {
+		fglLoadCompressedTexture(obj, level, data, 0, 0, width, height);
+
+		/* Decoded textures can be filtered like uncompressed ones */
+		if (pix->pixelSize && obj->genMipmap)
+			fglGenerateMipmaps(ctx, obj);
+
+		obj->dirty = true;
+	}
+}
+
+GL_API void GL_APIENTRY glCompressedTexSubImage2D (GLenum target, GLint level,
+		GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+		GLenum format, GLsizei imageSize, const GLvoid *data)
+{
+	if (target != GL_TEXTURE_2D) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	FGLContext *ctx = getContext();
+	FGLTexture *obj = ctx->texture[ctx->activeTexture].getTexture();
+
+	/* Paletted images can not be modified */
+	if (obj->eglImage || !obj->surface || !obj->compressed
+	    || format != obj->format || fglIsPalettedFormat(format)) {
+		setError(GL_INVALID_OPERATION);
+		return;
+	}
+
+	if (level < 0 || level > obj->maxLevel) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	GLint mipmapW, mipmapH;
+
+	mipmapW = obj->width >> level;
+	if (!mipmapW)
+		mipmapW = 1;
+
+	mipmapH = obj->height >> level;
+	if (!mipmapH)
+		mipmapH = 1;
+
+	if (xoffset < 0 || yoffset < 0 || width < 0 || height < 0
+	    || xoffset + width > mipmapW || yoffset + height > mipmapH) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	/* Only whole blocks can be replaced */
+	if (xoffset % 4 || yoffset % 4
+	    || (width % 4 && xoffset + width != mipmapW)
+	    || (height % 4 && yoffset + height != mipmapH)) {
+		setError(GL_INVALID_OPERATION);
+		return;
+	}
+
+	if ((size_t)imageSize != fglGetCompressedImageSize(format,
+							width, height)) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	if (!data || !width || !height)
+		return;
+
+	fglWaitForTexture(ctx, obj);
+	fglLoadCompressedTexture(obj, level, data,
+					xoffset, yoffset, width, height);
+	obj->dirty = true;
+}
+
+/*
+ * Framebuffer to texture copies
+ *
+ * Pixels are blitted from the color buffer to the texture surface by the
+ * G2D engine, which also converts the format and flips the image, if
+ * the buffer is stored upside down. Combinations of formats not supported
+ * by G2D, like luminance and alpha textures, are copied by the CPU.
+ */
+
+/* Unpacks a pixel of given format to ARGB8888 */
+static inline uint32_t fglUnpackPixel(const FGLPixelFormat *pix, uint32_t val)
+{
+	uint32_t argb = 0;
+
+	for (int i = 0; i < 4; ++i) {
+		unsigned size = pix->comp[i].size;
+		uint32_t c;
+
+		if (!size) {
+			c = (i == FGL_COMP_ALPHA) ? 0xff : 0;
+		} else {
+			c = (val >> pix->comp[i].pos) & ((1 << size) - 1);
+			if (size == 1)
+				c = c ? 0xff : 0;
+			else if (size < 8)
+				c = (c << (8 - size)) | (c >> (2*size - 8));
+		}
+
+		argb |= c << ((i == FGL_COMP_ALPHA) ? 24 : 8*(2 - i));
+	}
+
+	return argb;
+}
+
+/* Packs an ARGB8888 color to a pixel of given format */
+static inline uint32_t fglPackPixel(const FGLPixelFormat *pix, uint32_t argb)
+{
+	uint32_t val = 0;
+
+	for (int i = 0; i < 4; ++i) {
+		unsigned size = pix->comp[i].size;
+		uint32_t c;
+
+		if (!size)
+			continue;
+
+		c = argb >> ((i == FGL_COMP_ALPHA) ? 24 : 8*(2 - i));
+		val |= ((c & 0xff) >> (8 - size)) << pix->comp[i].pos;
+	}
+
+	return val;
+}
+
+static void fglCopyTextureCPU(FGLTexture *obj, unsigned level,
+		unsigned xoffset, unsigned yoffset, FGLAbstractFramebuffer *fb,
+		unsigned x, unsigned y, unsigned width, unsigned height)
+{
+	FGLFramebufferAttachable *fba = fb->get(FGL_ATTACHMENT_COLOR);
+	const FGLPixelFormat *srcPix =
+				FGLPixelFormat::get(fb->getColorFormat());
+	const FGLPixelFormat *dstPix = FGLPixelFormat::get(obj->pixFormat);
+	bool flipY = (fba->getType() != GL_TEXTURE);
+	uint32_t mask = 0;
+	uint32_t set = 0;
+
+	unsigned mipmapW = obj->width >> level;
+	if (!mipmapW)
+		mipmapW = 1;
+
+	/* Components the texture format does not take from the buffer */
+	switch (obj->format) {
+	case GL_ALPHA:
+		set = 0x00ffffff;
+		break;
+	case GL_RGB:
+	case GL_LUMINANCE:
+		set = 0xff000000;
+		break;
+	}
+	mask = ~set;
+
+	size_t srcStride = srcPix->pixelSize * fb->getWidth();
+	size_t dstStride = dstPix->pixelSize * mipmapW;
+	size_t offset = dstPix->pixelSize
+			* fimgGetTexMipmapOffset(obj->fimg, level)
+			+ yoffset * dstStride + xoffset * dstPix->pixelSize;
+
+	const uint8_t *src = (const uint8_t *)fba->surface->vaddr
+					+ x * srcPix->pixelSize;
+	uint8_t *dst = (uint8_t *)obj->surface->vaddr + offset;
+
+	if (flipY) {
+		src += (fb->getHeight() - y - 1) * srcStride;
+		srcStride = -srcStride;
+	} else {
+		src += y * srcStride;
+	}
+
+	for (unsigned j = 0; j < height; ++j) {
+		for (unsigned i = 0; i < width; ++i) {
+			uint32_t val;
+
+			if (srcPix->pixelSize == 2)
+				val = ((const uint16_t *)src)[i];
+			else
+				val = ((const uint32_t *)src)[i];
+
+			val = (fglUnpackPixel(srcPix, val) & mask) | set;
+			val = fglPackPixel(dstPix, val);
+
+			if (dstPix->pixelSize == 2)
+				((uint16_t *)dst)[i] = val;
+			else
+				((uint32_t *)dst)[i] = val;
+		}
+		src += srcStride;
+		dst += dstStride;
+	}
+
+	obj->markDirty(offset, offset + (height - 1) * dstStride
+					+ width * dstPix->pixelSize);
+}
+
+#if defined(FGL_G2D_TEXTURE_COPY) && !defined(FIMG_SOFTWARE_BACKEND)
+static pthread_mutex_t fglG2DMutex = PTHREAD_MUTEX_INITIALIZER;
+static int fglG2DFd = -1;
+static bool fglG2DFailed = false;
+
+/*
+ * Texture copies rely on S3C_G2D_BITBLT returning only after the blit
+ * finished, because the 3D core may read the texture right after, and on
+ * G2D_ROT_FLIP_Y mirroring rows. The interface has no way to wait for
+ * a blit, so both are checked once by reading back a flipped blit of
+ * numbered rows, large enough not to finish during the ioctl return.
+ */
+static bool fglCheckG2D(int fd)
+{
+	const unsigned width = 256, height = 128;
+	const unsigned pixels = width * height;
+	FGLLocalSurface surface(2 * pixels * sizeof(uint16_t));
+	struct s3c_g2d_req req;
+	uint16_t *src, *dst;
+	unsigned x, y;
+
+	if (!surface.isValid())
+		return false;
+
+	src = (uint16_t *)surface.vaddr;
+	dst = src + pixels;
+
+	for (y = 0; y < height; ++y)
+		for (x = 0; x < width; ++x)
+			src[y * width + x] = y + 1;
+	memset(dst, 0, pixels * sizeof(uint16_t));
+	surface.flush();
+
+	req.src.base	= surface.paddr;
+	req.src.fd	= -1;
+	req.src.offs	= 0;
+	req.src.w	= width;
+	req.src.h	= height;
+	req.src.l	= 0;
+	req.src.t	= 0;
+	req.src.r	= width - 1;
+	req.src.b	= height - 1;
+	req.src.fmt	= G2D_RGB16;
+
+	req.dst		= req.src;
+	req.dst.offs	= pixels * sizeof(uint16_t);
+
+	if (ioctl(fd, S3C_G2D_SET_TRANSFORM, G2D_ROT_FLIP_Y) < 0
+	    || ioctl(fd, S3C_G2D_BITBLT, &req) < 0)
+		return false;
+
+	/* Drop cache lines of destination read before the blit */
+	surface.flush();
+
+	for (y = 0; y < height; ++y)
+		for (x = 0; x < width; ++x)
+			if (dst[y * width + x] != height - y)
+				return false;
+
+	return true;
+}
+
+/* Opens G2D device on first use, must be called with fglG2DMutex locked */
+static int fglGetG2D(void)
+{
+	if (fglG2DFd >= 0 || fglG2DFailed)
+		return fglG2DFd;
+
+	int fd = open("/dev/s3c-g2d", O_RDWR);
+	if (fd < 0) {
+		ALOGW("Could not open G2D device (%s), textures will be "
+					"copied by CPU", strerror(errno));
+		fglG2DFailed = true;
+		return -1;
+	}
+
+	if (ioctl(fd, S3C_G2D_SET_RASTER_OP, G2D_ROP_SRC_ONLY) < 0
+	    || ioctl(fd, S3C_G2D_SET_BLENDING, G2D_NO_ALPHA) < 0) {
+		ALOGW("Could not set up G2D device (%s), textures will be "
+					"copied by CPU", strerror(errno));
+		close(fd);
+		fglG2DFailed = true;
+		return -1;
+	}
+
+	if (!fglCheckG2D(fd)) {
+		ALOGW("G2D blits are not finished on return or not flipped "
+				"as expected, textures will be copied by CPU");
+		close(fd);
+		fglG2DFailed = true;
+		return -1;
+	}
+
+	fglG2DFd = fd;
+	return fd;
+}
+
+/*
+ * Returns G2D format matching given pixel format or -1 if there is none.
+ * Alpha of opaque formats is not guaranteed to be written, so sources for
+ * textures without alpha are read as opaque instead, to get alpha of 255.
+ */
+static int fglGetG2DFormat(uint32_t pixFormat, bool opaque)
+{
+	switch (pixFormat) {
+	case FGL_PIXFMT_RGB565:
+		return G2D_RGB16;
+	case FGL_PIXFMT_ARGB1555:
+		return opaque ? -1 : G2D_ARGB16;
+	case FGL_PIXFMT_RGBA5551:
+		return opaque ? -1 : G2D_RGBA16;
+	case FGL_PIXFMT_XRGB8888:
+	case FGL_PIXFMT_ARGB8888:
+		return opaque ? G2D_XRGB32 : G2D_ARGB32;
+	case FGL_PIXFMT_XBGR8888:
+	case FGL_PIXFMT_ABGR8888:
+		return opaque ? G2D_RGBX32 : G2D_RGBA32;
+	default:
+		return -1;
+	}
+}
+
+static bool fglCopyTextureG2D(FGLContext *ctx, FGLTexture *obj,
+		unsigned level, unsigned xoffset, unsigned yoffset,
+		FGLAbstractFramebuffer *fb, unsigned x, unsigned y,
+		unsigned width, unsigned height)
+{
+	FGLFramebufferAttachable *fba = fb->get(FGL_ATTACHMENT_COLOR);
+	const FGLPixelFormat *pix = FGLPixelFormat::get(obj->pixFormat);
+	bool opaque = (obj->format == GL_RGB);
+	bool flipY = (fba->getType() != GL_TEXTURE);
+	struct s3c_g2d_req req;
+	int srcFmt, dstFmt;
+	int fd;
+
+	srcFmt = fglGetG2DFormat(fb->getColorFormat(), opaque);
+	dstFmt = fglGetG2DFormat(obj->pixFormat, false);
+	if (srcFmt < 0 || dstFmt < 0)
+		return false;
+
+	if (!fba->surface->paddr || !obj->surface->paddr
+	    || fb->getWidth() > G2D_MAX_WIDTH
+	    || fb->getHeight() > G2D_MAX_HEIGHT)
+		return false;
+
+	unsigned mipmapW = obj->width >> level;
+	if (!mipmapW)
+		mipmapW = 1;
+
+	unsigned mipmapH = obj->height >> level;
+	if (!mipmapH)
+		mipmapH = 1;
+
+	if (flipY)
+		y = fb->getHeight() - y - height;
+
+	req.src.base	= fba->surface->paddr;
+	req.src.fd	= -1;
+	req.src.offs	= 0;
+	req.src.w	= fb->getWidth();
+	req.src.h	= fb->getHeight();
+	req.src.l	= x;
+	req.src.t	= y;
+	req.src.r	= x + width - 1;
+	req.src.b	= y + height - 1;
+	req.src.fmt	= srcFmt;
+
+	req.dst.base	= obj->surface->paddr;
+	req.dst.fd	= -1;
+	req.dst.offs	= pix->pixelSize
+				* fimgGetTexMipmapOffset(obj->fimg, level);
+	req.dst.w	= mipmapW;
+	req.dst.h	= mipmapH;
+	req.dst.l	= xoffset;
+	req.dst.t	= yoffset;
+	req.dst.r	= xoffset + width - 1;
+	req.dst.b	= yoffset + height - 1;
+	req.dst.fmt	= dstFmt;
+
+	/* Texture memory must not be overwritten by CPU caches later */
+	if (obj->dirty)
+		obj->surface->flush();
+	else
+		obj->surface->flushRange(req.dst.offs,
+				pix->pixelSize * mipmapW * mipmapH);
+
+	pthread_mutex_lock(&fglG2DMutex);
+
+	fd = fglGetG2D();
+	if (fd < 0)
+		goto err_unlock;
+
+	if (ioctl(fd, S3C_G2D_SET_TRANSFORM,
+				flipY ? G2D_ROT_FLIP_Y : G2D_ROT_0) < 0)
+		goto err_unlock;
+
+	if (ioctl(fd, S3C_G2D_BITBLT, &req) < 0) {
+		ALOGW("G2D blit to texture failed (%s)", strerror(errno));
+		goto err_unlock;
+	}
+
+	pthread_mutex_unlock(&fglG2DMutex);
+
+	/*
+	 * Whole surface has been flushed already and the blit is finished,
+	 * but the texture cache can still hold old texels.
+	 */
+	obj->dirty = false;
+	obj->dirtyEnd = 0;
+	fimgInvalidateTextureCache(ctx->fimg);
+	return true;
+
+err_unlock:
+	pthread_mutex_unlock(&fglG2DMutex);
+	return false;
+}
+#endif
+
+/* Copies a rectangle of color buffer to given level of texture */
+static void fglCopyTexture(FGLContext *ctx, FGLTexture *obj, unsigned level,
+		GLint xoffset, GLint yoffset, FGLAbstractFramebuffer *fb,
+		GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	FGLSurface *draw = fb->get(FGL_ATTACHMENT_COLOR)->surface;
+
+	/* Pixels outside of the buffer are undefined, skip them */
+	if (x < 0) {
+		xoffset -= x;
+		width += x;
+		x = 0;
+	}
+
+	if (y < 0) {
+		yoffset -= y;
+		height += y;
+		y = 0;
+	}
+
+	if ((GLuint)(x + width) > fb->getWidth())
+		width = fb->getWidth() - x;
+
+	if ((GLuint)(y + height) > fb->getHeight())
+		height = fb->getHeight() - y;
+
+	if (width <= 0 || height <= 0)
+		return;
+
+	fglWaitForTexture(ctx, obj);
+	draw->waitFence(ctx->fimg);
+
+#if defined(FGL_G2D_TEXTURE_COPY) && !defined(FIMG_SOFTWARE_BACKEND)
+	if (!fglCopyTextureG2D(ctx, obj, level, xoffset, yoffset,
+					fb, x, y, width, height))
+#endif
+	{
+		draw->flush();
+		fglCopyTextureCPU(obj, level, xoffset, yoffset,
+						fb, x, y, width, height);
+	}
+
+	if (!level && obj->genMipmap) {
+		fglGenerateMipmaps(ctx, obj);
+		obj->dirty = true;
+	}
+}
+
+GL_API void GL_APIENTRY glCopyTexImage2D (GLenum target, GLint level,
+		GLenum internalformat, GLint x, GLint y, GLsizei width,
+		GLsizei height, GLint border)
+{
+	if (target != GL_TEXTURE_2D) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	if (level < 0 || width < 0 || height < 0 || border != 0) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	FGLContext *ctx = getContext();
+	FGLTexture *obj = ctx->texture[ctx->activeTexture].getTexture();
+
+	FGLAbstractFramebuffer *fb = ctx->framebuffer.get();
+	if (!fb->isValid()) {
+		setError(GL_INVALID_FRAMEBUFFER_OPERATION_OES);
+		return;
+	}
+
+	FGLFramebufferAttachable *fba = fb->get(FGL_ATTACHMENT_COLOR);
+	if (!fba || !fba->surface || !fba->surface->vaddr) {
+		setError(GL_INVALID_OPERATION);
+		return;
+	}
+
+	const FGLPixelFormat *cfg = FGLPixelFormat::get(fb->getColorFormat());
+	bool fbAlpha = (cfg->comp[FGL_COMP_ALPHA].size != 0);
+	GLenum type = GL_UNSIGNED_BYTE;
+
+	switch (internalformat) {
+	case GL_RGB:
+		/* Keep 16-bit buffers 16-bit, so G2D does not convert */
+		if (cfg->pixelSize == 2)
+			type = GL_UNSIGNED_SHORT_5_6_5;
+		/* Fall through */
+	case GL_LUMINANCE:
+		break;
+	case GL_RGBA:
+	case GL_ALPHA:
+	case GL_LUMINANCE_ALPHA:
+		if (!fbAlpha) {
+			setError(GL_INVALID_OPERATION);
+			return;
+		}
+		break;
+	default:
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	/* Texture can not be copied from itself */
+	if (fba == obj) {
+		setError(GL_INVALID_OPERATION);
+		return;
+	}
+
+	glTexImage2D(target, level, internalformat, width, height,
+				0, internalformat, type, NULL);
+
+	/* Check if the image has been specified */
+	if (!obj->surface || obj->format != internalformat
+	    || obj->type != type || level > obj->maxLevel)
+		return;
+
+	GLint mipmapW = obj->width >> level;
+	if (!mipmapW)
+		mipmapW = 1;
+
+	GLint mipmapH = obj->height >> level;
+	if (!mipmapH)
+		mipmapH = 1;
+
+	if (mipmapW != width || mipmapH != height)
+		return;
+
+	fglCopyTexture(ctx, obj, level, 0, 0, fb, x, y, width, height);
+}
+
+GL_API void GL_APIENTRY glCopyTexSubImage2D (GLenum target, GLint level,
+		GLint xoffset, GLint yoffset, GLint x, GLint y, GLsizei width,
+		GLsizei height)
+{
+	if (target != GL_TEXTURE_2D) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	FGLContext *ctx = getContext();
+	FGLTexture *obj = ctx->texture[ctx->activeTexture].getTexture();
+
+	if (obj->eglImage || !obj->surface || obj->compressed) {
+		setError(GL_INVALID_OPERATION);
+		return;
+	}
+
+	if (level < 0 || level > obj->maxLevel) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	GLint mipmapW = obj->width >> level;
+	if (!mipmapW)
+		mipmapW = 1;
+
+	GLint mipmapH = obj->height >> level;
+	if (!mipmapH)
+		mipmapH = 1;
+
+	if (xoffset < 0 || yoffset < 0 || width < 0 || height < 0
+	    || xoffset + width > mipmapW || yoffset + height > mipmapH) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	FGLAbstractFramebuffer *fb = ctx->framebuffer.get();
+	if (!fb->isValid()) {
+		setError(GL_INVALID_FRAMEBUFFER_OPERATION_OES);
+		return;
+	}
+
+	FGLFramebufferAttachable *fba = fb->get(FGL_ATTACHMENT_COLOR);
+	if (!fba || !fba->surface || !fba->surface->vaddr || fba == obj) {
+		setError(GL_INVALID_OPERATION);
+		return;
+	}
+
+	const FGLPixelFormat *cfg = FGLPixelFormat::get(fb->getColorFormat());
+	if (!cfg->comp[FGL_COMP_ALPHA].size && obj->format != GL_RGB
+	    && obj->format != GL_LUMINANCE) {
+		setError(GL_INVALID_OPERATION);
+		return;
+	}
+
+	fglCopyTexture(ctx, obj, level, xoffset, yoffset,
+					fb, x, y, width, height);
+}
+
+static FGLTexture *fglGetImageTargetTexture(FGLContext *ctx, GLenum target)
+{
+	switch (target) {
+	case GL_TEXTURE_2D:
+		return ctx->texture[ctx->activeTexture].getTexture();
+	case GL_TEXTURE_EXTERNAL_OES:
+		return ctx->textureExternal[ctx->activeTexture].getTexture();
+	default:
+		setError(GL_INVALID_ENUM);
+		return 0;
+	}
+}
+
+static void fglSetupImageTexture(FGLTexture *tex, GLenum target,
+		FGLSurface *surface, uint32_t pixelFormat,
+		uint32_t width, uint32_t height)
+{
+	const FGLPixelFormat *cfg = FGLPixelFormat::get(pixelFormat);
+
+	if (tex->eglImage)
+		tex->eglImage->disconnect();
+	else
+		delete tex->surface;
+
+	tex->invReady	= false;
+	tex->surface	= surface;
+	tex->eglImage	= 0;
+	tex->format	= cfg->readFormat;
+	tex->type	= cfg->readType;
+	tex->pixFormat	= pixelFormat;
+	tex->convert	= 0;
+	tex->maxLevel	= 0;
+	tex->dirty	= true;
+	tex->width	= width;
+	tex->height	= height;
+
+	// Setup fimgTexture
+	fimgInitTexture(tex->fimg,
+			cfg->flags, cfg->texFormat, tex->surface->paddr);
+	fimgSetTex2DSize(tex->fimg, width, height, tex->maxLevel);
+	fimgSetTexMipmap(tex->fimg, FGTU_TSTA_MIPMAP_DISABLED);
+	if (target == GL_TEXTURE_EXTERNAL_OES)
+		fimgSetTexMinFilter(tex->fimg, FGTU_TSTA_FILTER_LINEAR);
+}
+
+GL_API void GL_APIENTRY glEGLImageTargetTexture2DOES (GLenum target,
+							GLeglImageOES img)
+{
+	FGLContext *ctx = getContext();
+	FGLTexture *tex;
+
+	tex = fglGetImageTargetTexture(ctx, target);
+	if (!tex)
+		return;
+
+	FGLImage *image = (FGLImage *)img;
+	if (!image || !image->isValid()) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	fglSetupImageTexture(tex, target, image->surface,
+				image->pixelFormat, image->width, image->height);
+
+	tex->eglImage = image;
+	tex->eglImage->connect();
+}
+
+#ifdef FGL_TRACE
+GL_API void GL_APIENTRY glTraceImageTargetTexture2DFIMG (GLenum target,
+			GLint format, GLsizei width, GLsizei height)
+{
+	FGLContext *ctx = getContext();
+	FGLTexture *tex;
+
+	tex = fglGetImageTargetTexture(ctx, target);
+	if (!tex)
+		return;
+
+	const FGLPixelFormat *cfg = FGLPixelFormat::get(format);
+	if (width <= 0 || height <= 0 || !cfg->pixelSize) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	FGLSurface *surface = new FGLLocalSurface(width * height
+							* cfg->pixelSize);
+	if (!surface || !surface->isValid()) {
+		delete surface;
+		setError(GL_OUT_OF_MEMORY);
+		return;
+	}
+
+	fglSetupImageTexture(tex, target, surface, format, width, height);
+}
+#endif
+
 #if 0
 GL_API void GL_APIENTRY glEGLImageTargetRenderbufferStorageOES (GLenum target, GLeglImageOES image)
 {
@@ -9,6 +9,10 @@ LOCAL_CFLAGS += -Wall -Wno-unused-parameter -O2 -mcpu=arm1176jzf-s -mfloat-abi=s
 LOCAL_CFLAGS += -DLOG_TAG=\"libfimg\"
 LOCAL_CFLAGS += -DFGL_PLATFORM_ANDROID
 
+# Hash of the sources and precompiled shaders, changes only with them
+FIMG_BUILD_ID := $(shell cat $(LOCAL_PATH)/*.[ch] $(LOCAL_PATH)/shaders/*.h | md5sum | cut -c1-16)
+LOCAL_CFLAGS += -DFIMG_BUILD_ID=\"$(FIMG_BUILD_ID)\"
+
 LOCAL_SRC_FILES := \
 	compat.c \
 	fragment.c \
@@ -16,10 +20,18 @@ LOCAL_SRC_FILES := \
 	host_new.c \
 	primitive.c \
 	raster.c \
+	reorder.c \
+	shadercache.c \
 	shaders.c \
 	system.c \
 	texture.c \
 	dump.c
 
+# Emulate the hardware on CPU, e.g. to compare rendering results
+ifeq ($(BOARD_FIMG_SOFTWARE_BACKEND),true)
+LOCAL_CFLAGS += -DFIMG_SOFTWARE_BACKEND
+LOCAL_SRC_FILES += soft.c
+endif
+
 LOCAL_MODULE := libfimg
 include $(BUILD_STATIC_LIBRARY)
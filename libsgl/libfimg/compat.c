@@ -23,6 +23,7 @@
 # include <config.h>
 #endif
 
+#include <math.h>
 #include <string.h>
 #include <stdio.h>
 #include "fimg_private.h"
@@ -114,17 +115,69 @@ struct shaderBlock {
 };
 #define SHADER_BLOCK(blk)	{ blk, sizeof(blk) / 16 }
 
+/* Whole instruction memory, lighting needs up to 33 per light */
+#define MAX_VS_INSTR	(512)
+#define MAX_PS_INSTR	(64)
+#define MAX_INSTR	MAX_VS_INSTR
+
 /* Vertex shader */
 
 static const struct shaderBlock vertexConstFloat = SHADER_BLOCK(vert_cfloat);
 static const struct shaderBlock vertexHeader = SHADER_BLOCK(vert_header);
 static const struct shaderBlock vertexFooter = SHADER_BLOCK(vert_footer);
+static const struct shaderBlock vertexColor = SHADER_BLOCK(vert_color);
+
+static const struct shaderBlock lightingNormal = SHADER_BLOCK(vert_normal);
+static const struct shaderBlock lightingNormalize =
+					SHADER_BLOCK(vert_normalize);
+static const struct shaderBlock lightingEyePosition =
+					SHADER_BLOCK(vert_eye_position);
+static const struct shaderBlock lightingSceneColor[] = {
+	SHADER_BLOCK(vert_scene_color),
+	SHADER_BLOCK(vert_scene_color_cm)
+};
+static const struct shaderBlock lightingFooter =
+					SHADER_BLOCK(vert_lighting_footer);
+
+static const struct shaderBlock lightDirectional =
+					SHADER_BLOCK(vert_light_directional);
+static const struct shaderBlock lightPositional =
+					SHADER_BLOCK(vert_light_positional);
+static const struct shaderBlock lightAttenuation =
+					SHADER_BLOCK(vert_light_attenuation);
+static const struct shaderBlock lightUnattenuated =
+					SHADER_BLOCK(vert_light_unattenuated);
+static const struct shaderBlock lightSpot = SHADER_BLOCK(vert_light_spot);
+static const struct shaderBlock lightTerms = SHADER_BLOCK(vert_light_terms);
+static const struct shaderBlock lightColor[] = {
+	SHADER_BLOCK(vert_light_color),
+	SHADER_BLOCK(vert_light_color_cm)
+};
+static const struct shaderBlock lightAttenuate =
+					SHADER_BLOCK(vert_light_attenuate);
+static const struct shaderBlock lightAccumulate =
+					SHADER_BLOCK(vert_light_accumulate);
 
 static const struct shaderBlock texcoordTransform[] = {
 	SHADER_BLOCK(vert_texture0),
 	SHADER_BLOCK(vert_texture1)
 };
 
+static const struct shaderBlock fogCoord = SHADER_BLOCK(vert_fog_coord);
+static const struct shaderBlock fogFactor[] = {
+	{ 0, 0 },
+	SHADER_BLOCK(vert_fog_linear),
+	SHADER_BLOCK(vert_fog_exp),
+	SHADER_BLOCK(vert_fog_exp2)
+};
+
+static const struct shaderBlock clipDistance[] = {
+	SHADER_BLOCK(vert_clip_plane0),
+	SHADER_BLOCK(vert_clip_plane1),
+	SHADER_BLOCK(vert_clip_plane2),
+	SHADER_BLOCK(vert_clip_plane3)
+};
+
 /* Pixel shader */
 
 static const struct shaderBlock pixelConstFloat = SHADER_BLOCK(frag_cfloat);
@@ -216,6 +269,14 @@ static const struct shaderBlock combine_a = SHADER_BLOCK(frag_combine_a);
 static const struct shaderBlock combine_u = SHADER_BLOCK(frag_combine_uni);
 static const struct shaderBlock tex_swap = SHADER_BLOCK(frag_tex_swap);
 static const struct shaderBlock out_swap = SHADER_BLOCK(frag_out_swap);
+static const struct shaderBlock pixelFog = SHADER_BLOCK(frag_fog);
+
+static const struct shaderBlock clipTest[] = {
+	SHADER_BLOCK(frag_clip_plane0),
+	SHADER_BLOCK(frag_clip_plane1),
+	SHADER_BLOCK(frag_clip_plane2),
+	SHADER_BLOCK(frag_clip_plane3)
+};
 
 /* Shader functions */
 
@@ -268,6 +329,103 @@ static uint32_t loadShaderBlock(const struct shaderBlock *blk,
 	return 4*inst;
 }
 
+#define CONST_BIT(slot)		(1 << ((slot) % 32))
+#define CONST_TEST(map, slot)	((map)[(slot) / 32] & CONST_BIT(slot))
+
+/* Requests value of a const float register, dropping unchanged ones */
+static void queueConstFloat(fimgContext *ctx, fimgConstShadow *sh,
+					const float *pfData, uint32_t slot)
+{
+	if (!CONST_TEST(sh->stale, slot)
+	    && !memcmp(sh->value[slot], pfData, sizeof(sh->value[slot]))) {
+		++ctx->stats.constSkips;
+		return;
+	}
+
+	memcpy(sh->value[slot], pfData, sizeof(sh->value[slot]));
+	sh->dirty[slot / 32] |= CONST_BIT(slot);
+}
+
+static inline void queuePSConstFloat(fimgContext *ctx, const float *pfData,
+								uint32_t slot)
+{
+	queueConstFloat(ctx, &ctx->compat.psConst, pfData, slot);
+}
+
+static inline void queueVSConstFloat(fimgContext *ctx, const float *pfData,
+								uint32_t slot)
+{
+	queueConstFloat(ctx, &ctx->compat.vsConst, pfData, slot);
+}
+
+static void queueVSMatrix(fimgContext *ctx, const float *pfData, uint32_t slot)
+{
+	uint32_t i;
+
+	for (i = 0; i < 4; i++)
+		queueVSConstFloat(ctx, pfData + 4*i, slot + i);
+}
+
+static void queueConstBlock(fimgContext *ctx, fimgConstShadow *sh,
+					const struct shaderBlock *blk)
+{
+	uint32_t i;
+
+	for (i = 0; i < blk->len; i++)
+		queueConstFloat(ctx, sh,
+				(const float *)&blk->data[4*i], i);
+}
+
+static int constsPending(const fimgConstShadow *sh)
+{
+	uint32_t i, pending = 0;
+
+	for (i = 0; i < FGCS_NUM_WORDS; ++i)
+		pending |= sh->dirty[i];
+
+	return pending != 0;
+}
+
+/*****************************************************************************
+ * FUNCTION:	writeConsts
+ * SYNOPSIS:	This function writes queued const float registers to the
+ *		hardware, using burst writes for contiguous runs of them.
+ *		The shader must not be running.
+ * ARGUMENTS:	ctx - hardware context
+ *		sh - shadow of const float registers
+ *		count - number of shadowed registers
+ *		addr - address of first const float register
+ *****************************************************************************/
+static void writeConsts(fimgContext *ctx, fimgConstShadow *sh,
+					uint32_t count, unsigned int addr)
+{
+	uint32_t slot = 0, start;
+
+	while (slot < count) {
+		if (!CONST_TEST(sh->dirty, slot)) {
+			++slot;
+			continue;
+		}
+
+		start = slot;
+		do {
+			sh->dirty[slot / 32] &= ~CONST_BIT(slot);
+			sh->stale[slot / 32] &= ~CONST_BIT(slot);
+			++slot;
+		} while (slot < count && CONST_TEST(sh->dirty, slot));
+
+		fimgWriteBurst(ctx, sh->value[start], 4 * (slot - start),
+							addr + 16 * start);
+		ctx->stats.constWrites += slot - start;
+	}
+}
+
+/* Marks all shadowed registers as holding unknown values */
+static void invalidateConsts(fimgConstShadow *sh)
+{
+	memset(sh->stale, 0xff, sizeof(sh->stale));
+}
+
 static inline void setVertexShaderAttribCount(fimgContext *ctx, uint32_t count)
 {
 	fimgWrite(ctx, count, FGVS_ATTRIB_NUM);
@@ -367,14 +525,19 @@ typedef struct __attribute__ ((__packed__)) _fimgShaderInstruction {
 typedef struct opcodeInfo {
 	uint8_t type;
 	uint8_t srcCount;
+	uint8_t flags;
 } fimgOpcodeInfo;
 
+/* Each component of result depends only on the same one of sources */
+#define OP_FLAG_COMPONENTWISE	(1 << 0)
+
 enum fimgOpcode {
 	OP_NOP = 0,
 	OP_MOV,
 	OP_MOVA,
 	OP_MOVC,
 	OP_ADD,
+	OP_RSVD_05,
 	OP_MUL,
 	OP_MUL_LIT,
 	OP_DP3,
@@ -411,6 +574,12 @@ enum fimgOpcode {
 	OP_TEXKILL,
 	OP_MOVIPS,
 	OP_ADDI,
+	OP_RSVD_2A,
+	OP_RSVD_2B,
+	OP_RSVD_2C,
+	OP_RSVD_2D,
+	OP_RSVD_2E,
+	OP_RSVD_2F,
 	OP_B,
 	OP_BF,
 	OP_RSVD_32,
@@ -442,6 +611,7 @@ static fimgOpcodeInfo opcodeMap[64] = {
 	[OP_MOV] = {
 		.type		= OP_TYPE_MOVE,
 		.srcCount	= 1,
+		.flags		= OP_FLAG_COMPONENTWISE,
 	},
 	[OP_MOVA] = {
 		.type		= OP_TYPE_NORMAL,
@@ -454,10 +624,16 @@ static fimgOpcodeInfo opcodeMap[64] = {
 	[OP_ADD] = {
 		.type		= OP_TYPE_NORMAL,
 		.srcCount	= 2,
+		.flags		= OP_FLAG_COMPONENTWISE,
+	},
+	[OP_RSVD_05] = {
+		.type		= OP_TYPE_RESERVED,
+		.srcCount	= 0,
 	},
 	[OP_MUL] = {
 		.type		= OP_TYPE_NORMAL,
 		.srcCount	= 2,
+		.flags		= OP_FLAG_COMPONENTWISE,
 	},
 	[OP_MUL_LIT] = {
 		.type		= OP_TYPE_NORMAL,
@@ -514,18 +690,22 @@ static fimgOpcodeInfo opcodeMap[64] = {
 	[OP_MAX] = {
 		.type		= OP_TYPE_NORMAL,
 		.srcCount	= 2,
+		.flags		= OP_FLAG_COMPONENTWISE,
 	},
 	[OP_MIN] = {
 		.type		= OP_TYPE_NORMAL,
 		.srcCount	= 2,
+		.flags		= OP_FLAG_COMPONENTWISE,
 	},
 	[OP_SGE] = {
 		.type		= OP_TYPE_NORMAL,
 		.srcCount	= 2,
+		.flags		= OP_FLAG_COMPONENTWISE,
 	},
 	[OP_SLT] = {
 		.type		= OP_TYPE_NORMAL,
 		.srcCount	= 2,
+		.flags		= OP_FLAG_COMPONENTWISE,
 	},
 	[OP_SETP_EQ] = {
 		.type		= OP_TYPE_NORMAL,
@@ -546,14 +726,17 @@ static fimgOpcodeInfo opcodeMap[64] = {
 	[OP_CMP] = {
 		.type		= OP_TYPE_NORMAL,
 		.srcCount	= 3,
+		.flags		= OP_FLAG_COMPONENTWISE,
 	},
 	[OP_MAD] = {
 		.type		= OP_TYPE_NORMAL,
 		.srcCount	= 3,
+		.flags		= OP_FLAG_COMPONENTWISE,
 	},
 	[OP_FRC] = {
 		.type		= OP_TYPE_NORMAL,
 		.srcCount	= 1,
+		.flags		= OP_FLAG_COMPONENTWISE,
 	},
 	[OP_RSVD_1F] = {
 		.type		= OP_TYPE_RESERVED,
@@ -599,6 +782,30 @@ static fimgOpcodeInfo opcodeMap[64] = {
 		.type		= OP_TYPE_NORMAL,
 		.srcCount	= 2,
 	},
+	[OP_RSVD_2A] = {
+		.type		= OP_TYPE_RESERVED,
+		.srcCount	= 0,
+	},
+	[OP_RSVD_2B] = {
+		.type		= OP_TYPE_RESERVED,
+		.srcCount	= 0,
+	},
+	[OP_RSVD_2C] = {
+		.type		= OP_TYPE_RESERVED,
+		.srcCount	= 0,
+	},
+	[OP_RSVD_2D] = {
+		.type		= OP_TYPE_RESERVED,
+		.srcCount	= 0,
+	},
+	[OP_RSVD_2E] = {
+		.type		= OP_TYPE_RESERVED,
+		.srcCount	= 0,
+	},
+	[OP_RSVD_2F] = {
+		.type		= OP_TYPE_RESERVED,
+		.srcCount	= 0,
+	},
 	[OP_B] = {
 		.type		= OP_TYPE_FLOW,
 		.srcCount	= 0,
@@ -676,30 +883,43 @@ enum fimgDstRegType {
 	REG_DST_AL
 };
 
-struct registerMap {
-	union {
-		struct {
-			unsigned srcRegNum	:5;
-			unsigned srcRegType	:3;
-		};
-		uint8_t srcReg;
-	};
-	uint8_t srcSwizzle;
-	uint8_t movInstr;
-	uint8_t flags;
+enum fimgSrcModifier {
+	SRC_MOD_NONE = 0,
+	SRC_MOD_NEG,
+	SRC_MOD_ABS,
+	SRC_MOD_NEG_ABS
 };
 
-#define MAP_FLAG_USED		(1 << 0)
-#define MAP_FLAG_INVALID	(1 << 1)
-
 #define SWIZZLE(a, b, c, d)	((a) | ((b) << 2) | ((c) << 4) | ((d) << 6))
+#define SWIZZLE_IDENTITY	SWIZZLE(0, 1, 2, 3)
 
 #ifdef FIMG_BYPASS_SHADER_OPTIMIZER
-static inline uint32_t optimizeShader(uint32_t *start, uint32_t *end)
+static inline uint32_t optimizeShader(uint32_t *start, uint32_t *end,
+			uint32_t maxInstr, const struct shaderBlock *consts)
 {
 	return (end - start) / 4;
 }
 #else
+/*
+ * The optimizer works on the generated instruction stream in place, running
+ * constant folding, copy propagation, MAD fusion and dead code elimination
+ * until none of them changes anything, then renames temporary registers.
+ * Code with flow control (other than final RET), predication or relative
+ * addressing is left untouched.
+ */
+
+#define NUM_TEMPS		32
+#define INSTR_REMOVED		0xdeadc0de
+#define MAX_PASSES		8
+
+/* Source operand in a form independent of its slot */
+typedef struct {
+	uint8_t type;
+	uint8_t num;
+	uint8_t swizzle;
+	uint8_t modifier;
+} fimgShaderSrc;
+
 static inline uint8_t mergeSwizzle(uint8_t a, uint8_t b)
 {
 	uint8_t swizzle = 0;
@@ -718,380 +938,1118 @@ static inline uint8_t mergeSwizzle(uint8_t a, uint8_t b)
 	return swizzle;
 }
 
-static uint32_t optimizeShader(uint32_t *start, uint32_t *end)
+/* Modifier of x read through y = mod1(x) with modifier mod2 */
+static inline uint8_t mergeModifier(uint8_t mod1, uint8_t mod2)
 {
-	struct registerMap map[32];
-	unsigned int deps[32];
-	int reg;
-	fimgShaderInstruction *instrStart = (fimgShaderInstruction *)start;
-	fimgShaderInstruction *instrEnd = (fimgShaderInstruction *)end;
-	fimgShaderInstruction *instr;
-	fimgShaderInstruction *instrPtr;
-
-	/* State initialization */
-	memset(deps, 0, sizeof(deps));
-	memset(map, 0, sizeof(map));
-
-	/* Optimization pass */
-	for (instr = instrStart; instr < instrEnd; ++instr) {
-		fimgOpcodeInfo *info = &opcodeMap[instr->opcode];
-		uint32_t depMask;
-		uint32_t depReg;
-
-		switch (info->srcCount) {
-		case 1:
-			if (instr->src0_regtype == REG_SRC_R
-			    && map[instr->src0_regnum].flags & MAP_FLAG_INVALID)
-				map[instr->src0_regnum].flags = 0;
-
-			if (instr->src0_regtype == REG_SRC_R
-			    && map[instr->src0_regnum].flags
-			) {
-				instr->src0_swizzle =
-					mergeSwizzle(map[instr->src0_regnum].srcSwizzle,
-								instr->src0_swizzle);
-				instr->src0_regtype = map[instr->src0_regnum].srcRegType;
-				instr->src0_regnum = map[instr->src0_regnum].srcRegNum;
-			}
+	if (mod2 & SRC_MOD_ABS)
+		return mod2;
 
-			break;
-		case 2:
-			if (instr->src0_regtype == REG_SRC_R
-			    && map[instr->src0_regnum].flags & MAP_FLAG_INVALID)
-				map[instr->src0_regnum].flags = 0;
-
-			if (instr->src0_regtype == REG_SRC_R
-				&& map[instr->src0_regnum].flags
-				&& map[instr->src0_regnum].srcRegType != REG_SRC_R
-				&& map[instr->src0_regnum].srcRegType == instr->src1_regtype
-			)
-				map[instr->src0_regnum].flags = 0;
-
-			if (instr->src0_regtype == REG_SRC_R
-				&& map[instr->src0_regnum].flags
-			) {
-				instr->src0_swizzle =
-					mergeSwizzle(map[instr->src0_regnum].srcSwizzle,
-								instr->src0_swizzle);
-				instr->src0_regtype = map[instr->src0_regnum].srcRegType;
-				instr->src0_regnum = map[instr->src0_regnum].srcRegNum;
-			}
+	return mod1 ^ mod2;
+}
 
-			if (instr->src1_regtype == REG_SRC_R
-			    && map[instr->src1_regnum].flags & MAP_FLAG_INVALID)
-				map[instr->src1_regnum].flags = 0;
-
-			if (instr->src1_regtype == REG_SRC_R
-				&& map[instr->src1_regnum].flags
-				&& map[instr->src1_regnum].srcRegType != REG_SRC_R
-				&& map[instr->src1_regnum].srcRegType == instr->src0_regtype
-			)
-				map[instr->src1_regnum].flags = 0;
-
-			if (instr->src1_regtype == REG_SRC_R
-				&& map[instr->src1_regnum].flags
-			) {
-				instr->src1_swizzle =
-					mergeSwizzle(map[instr->src1_regnum].srcSwizzle,
-								instr->src1_swizzle);
-				instr->src1_regtype = map[instr->src1_regnum].srcRegType;
-				instr->src1_regnum = map[instr->src1_regnum].srcRegNum;
-			}
+static void getSrc(const fimgShaderInstruction *instr, unsigned int slot,
+							fimgShaderSrc *src)
+{
+	switch (slot) {
+	case 0:
+		src->type = instr->src0_regtype;
+		src->num = instr->src0_regnum | (instr->src0_extnum << 5);
+		src->swizzle = instr->src0_swizzle;
+		src->modifier = instr->src0_modifier;
+		break;
+	case 1:
+		src->type = instr->src1_regtype;
+		src->num = instr->src1_regnum;
+		src->swizzle = instr->src1_swizzle;
+		src->modifier = instr->src1_modifier;
+		break;
+	default:
+		src->type = instr->src2_regtype;
+		src->num = instr->src2_regnum;
+		src->swizzle = instr->src2_swizzle;
+		src->modifier = instr->src2_modifier;
+	}
+}
 
-			break;
-		case 3:
-			if (instr->src0_regtype == REG_SRC_R
-			    && map[instr->src0_regnum].flags & MAP_FLAG_INVALID)
-				map[instr->src0_regnum].flags = 0;
-
-			if (instr->src0_regtype == REG_SRC_R
-				&& map[instr->src0_regnum].flags
-				&& map[instr->src0_regnum].srcRegType != REG_SRC_R
-				&& (map[instr->src0_regnum].srcRegType == instr->src1_regtype
-				|| map[instr->src0_regnum].srcRegType == instr->src2_regtype)
-			)
-				map[instr->src0_regnum].flags = 0;
-
-			if (instr->src0_regtype == REG_SRC_R
-			    && map[instr->src0_regnum].flags) {
-				instr->src0_swizzle =
-					mergeSwizzle(map[instr->src0_regnum].srcSwizzle,
-								instr->src0_swizzle);
-				instr->src0_regtype = map[instr->src0_regnum].srcRegType;
-				instr->src0_regnum = map[instr->src0_regnum].srcRegNum;
-			}
+static void setSrc(fimgShaderInstruction *instr, unsigned int slot,
+						const fimgShaderSrc *src)
+{
+	switch (slot) {
+	case 0:
+		instr->src0_regtype = src->type;
+		instr->src0_regnum = src->num & 0x1f;
+		instr->src0_extnum = src->num >> 5;
+		instr->src0_swizzle = src->swizzle;
+		instr->src0_modifier = src->modifier;
+		break;
+	case 1:
+		instr->src1_regtype = src->type;
+		instr->src1_regnum = src->num;
+		instr->src1_swizzle = src->swizzle;
+		instr->src1_modifier = src->modifier;
+		break;
+	default:
+		instr->src2_regtype = src->type;
+		instr->src2_regnum = src->num;
+		instr->src2_swizzle = src->swizzle;
+		instr->src2_modifier = src->modifier;
+	}
+}
 
-			if (instr->src1_regtype == REG_SRC_R
-			    && map[instr->src1_regnum].flags & MAP_FLAG_INVALID)
-				map[instr->src1_regnum].flags = 0;
-
-			if (instr->src1_regtype == REG_SRC_R
-				&& map[instr->src1_regnum].flags
-				&& map[instr->src1_regnum].srcRegType != REG_SRC_R
-				&& (map[instr->src1_regnum].srcRegType == instr->src0_regtype
-				|| map[instr->src1_regnum].srcRegType == instr->src2_regtype)
-			)
-				map[instr->src1_regnum].flags = 0;
-
-			if (instr->src1_regtype == REG_SRC_R
-			    && map[instr->src1_regnum].flags) {
-				instr->src1_swizzle =
-					mergeSwizzle(map[instr->src1_regnum].srcSwizzle,
-								instr->src1_swizzle);
-				instr->src1_regtype = map[instr->src1_regnum].srcRegType;
-				instr->src1_regnum = map[instr->src1_regnum].srcRegNum;
-			}
+/*
+ * Operands must fit their slots (only src0 can address registers above 31)
+ * and no two of them can come from the same non-temporary register file.
+ */
+static int validSources(const fimgShaderSrc *src, unsigned int count)
+{
+	unsigned int i, j;
 
-			if (instr->src2_regtype == REG_SRC_R
-			    && map[instr->src2_regnum].flags & MAP_FLAG_INVALID)
-				map[instr->src2_regnum].flags = 0;
-
-			if (instr->src2_regtype == REG_SRC_R
-				&& map[instr->src2_regnum].flags
-				&& map[instr->src2_regnum].srcRegType != REG_SRC_R
-				&& (map[instr->src2_regnum].srcRegType == instr->src0_regtype
-				|| map[instr->src2_regnum].srcRegType == instr->src1_regtype)
-			)
-				map[instr->src2_regnum].flags = 0;
-
-			if (instr->src2_regtype == REG_SRC_R
-			    && map[instr->src2_regnum].flags) {
-				instr->src2_swizzle =
-					mergeSwizzle(map[instr->src2_regnum].srcSwizzle,
-								instr->src2_swizzle);
-				instr->src2_regtype = map[instr->src2_regnum].srcRegType;
-				instr->src2_regnum = map[instr->src2_regnum].srcRegNum;
-			}
-			break;
-		default:
-			break;
-		}
+	for (i = 1; i < count; ++i)
+		if (src[i].num >= NUM_TEMPS)
+			return 0;
 
-		if (info->type <= OP_TYPE_FLOW || instr->dest_regtype != REG_DST_R)
+	for (i = 0; i < count; ++i) {
+		if (src[i].type == REG_SRC_R)
 			continue;
+		for (j = i + 1; j < count; ++j)
+			if (src[j].type == src[i].type)
+				return 0;
+	}
 
-		if (map[instr->dest_regnum].flags & MAP_FLAG_USED) {
-			fimgShaderInstruction *mov =
-				instrStart + map[instr->dest_regnum].movInstr;
+	return 1;
+}
 
-			/* Instructions with non-zero here will be removed */
-			mov->reserved = 0xdeadc0de;
+static inline int isTemp(const fimgShaderSrc *src, unsigned int num)
+{
+	return src->type == REG_SRC_R && src->num == num;
+}
 
-			if (map[instr->dest_regnum].srcRegType == REG_SRC_R)
-				deps[map[instr->dest_regnum].srcRegNum] &= ~(1 << instr->dest_regnum);
+static inline int writesTemp(const fimgShaderInstruction *instr)
+{
+	return opcodeMap[instr->opcode].type > OP_TYPE_FLOW
+		&& instr->opcode != OP_TEXKILL
+		&& instr->dest_regtype == REG_DST_R;
+}
 
-			map[instr->dest_regnum].flags = 0;
-		}
+/* Components of source register read by an instruction */
+static uint32_t srcReadMask(const fimgShaderInstruction *instr,
+							const fimgShaderSrc *src)
+{
+	uint32_t used, mask = 0, comp;
 
-		depMask = deps[instr->dest_regnum];
-		depReg = 0;
-		while (depMask) {
-			if (depMask & 1)
-				map[depReg].flags |= MAP_FLAG_INVALID;
-			depMask >>= 1;
-			++depReg;
-		}
-		deps[instr->dest_regnum] = 0;
+	if (opcodeMap[instr->opcode].flags & OP_FLAG_COMPONENTWISE)
+		used = instr->dest_mask;
+	else if (instr->opcode == OP_DP3)
+		used = 0x7;
+	else
+		used = 0xf;
 
-		if (info->type != OP_TYPE_MOVE)
-			continue;
+	for (comp = 0; comp < 4; ++comp)
+		if (used & (1 << comp))
+			mask |= 1 << ((src->swizzle >> 2*comp) & 3);
 
-		if (instr->dest_mask != 0xf || instr->dest_modifier
-		    || instr->src0_modifier)
-			continue;
+	return mask;
+}
 
-		map[instr->dest_regnum].srcRegNum = instr->src0_regnum;
-		map[instr->dest_regnum].srcRegType = instr->src0_regtype;
-		map[instr->dest_regnum].srcSwizzle = instr->src0_swizzle;
-		map[instr->dest_regnum].movInstr = instr - instrStart;
-		map[instr->dest_regnum].flags = MAP_FLAG_USED;
+static uint32_t tempReadMask(const fimgShaderInstruction *instr,
+							unsigned int num)
+{
+	uint32_t srcCount = opcodeMap[instr->opcode].srcCount;
+	fimgShaderSrc src;
+	uint32_t mask = 0;
+	unsigned int i;
 
-		if (instr->src0_regtype == REG_SRC_R)
-			deps[instr->src0_regnum] |= (1 << instr->dest_regnum);
+	for (i = 0; i < srcCount; ++i) {
+		getSrc(instr, i, &src);
+		if (isTemp(&src, num))
+			mask |= srcReadMask(instr, &src);
 	}
 
-	/* Mark all remaining mapped mov instructions to be removed */
-	for (reg = 0; reg < 32; ++reg) {
-		if (!map[reg].flags)
-			continue;
-		fimgShaderInstruction *mov = instrStart + map[reg].movInstr;
-		mov->reserved = 0xdeadc0de;
-	}
+	return mask;
+}
 
-	/* Done, remove unused instructions and return */
-	instrPtr = instrStart;
-	for (instr = instrStart; instr < instrEnd; ++instr) {
-		if (instr->reserved == 0xdeadc0de)
-			continue;
-		if (opcodeMap[instr->opcode].srcCount == 3)
-			(instr - 1)->next_3src = 1;
-		*(instrPtr++) = *instr;
+static void setOpcode(fimgShaderInstruction *instr, unsigned int opcode,
+				const fimgShaderSrc *src, unsigned int count)
+{
+	static const fimgShaderSrc unused = { 0, 0, SWIZZLE_IDENTITY, 0 };
+	unsigned int i;
+
+	instr->opcode = opcode;
+	for (i = 0; i < 3; ++i)
+		setSrc(instr, i, (i < count) ? &src[i] : &unused);
+}
+
+static int canOptimize(const fimgShaderInstruction *start, uint32_t count)
+{
+	const fimgShaderInstruction *instr;
+	const fimgOpcodeInfo *info;
+
+	for (instr = start; instr < start + count; ++instr) {
+		info = &opcodeMap[instr->opcode];
+
+		if (info->type == OP_TYPE_RESERVED && instr->opcode != OP_NOP)
+			return 0;
+		if (info->type == OP_TYPE_FLOW && (instr->opcode != OP_RET
+		    || instr != start + count - 1))
+			return 0;
+		if (instr->src1_p || instr->src1_pa || instr->src1_pn
+		    || instr->src1_pch || instr->dest_a)
+			return 0;
+		if (instr->src0_ar || instr->src1_ar || instr->src2_ar)
+			return 0;
 	}
 
-	return instrPtr - instrStart;
+	return 1;
 }
-#endif
 
 /*
- * Shader generation code
+ * Constant folding
  */
 
-#define MAX_INSTR	(64)
+typedef struct {
+	const uint32_t *data;
+	uint32_t count;
+	int zero;
+} fimgShaderConsts;
 
-static inline uint32_t *SHADER_SLOT(uint32_t *buf, uint32_t slot)
+/* Value of operand reading a constant with all components equal */
+static int srcConstant(const fimgShaderConsts *consts,
+				const fimgShaderSrc *src, float *val)
 {
-	return buf
-		+ slot*MAX_INSTR*sizeof(fimgShaderInstruction)/sizeof(uint32_t);
+	float c[4];
+	float v;
+
+	if (src->type != REG_SRC_C || src->num >= consts->count)
+		return 0;
+
+	memcpy(c, &consts->data[4*src->num], sizeof(c));
+	if (c[0] != c[1] || c[0] != c[2] || c[0] != c[3])
+		return 0;
+
+	v = c[0];
+	if (src->modifier & SRC_MOD_ABS)
+		v = fabsf(v);
+	if (src->modifier & SRC_MOD_NEG)
+		v = -v;
+
+	*val = v;
+	return 1;
 }
 
-void fimgCompatBuildVertexShader(fimgContext *ctx, uint32_t slot)
+static int isConstant(const fimgShaderConsts *consts,
+				const fimgShaderSrc *src, float val)
 {
-	uint32_t unit;
-	uint32_t *addr;
-	uint32_t *start;
+	float v;
 
-	if (!ctx->compat.vshaderBuf) {
-		ctx->compat.vshaderBuf = malloc(VS_CACHE_SIZE * MAX_INSTR * sizeof(fimgShaderInstruction));
-		if (!ctx->compat.vshaderBuf) {
-			ALOGE("Failed to allocate memory for shader buffer, terminating.");
-			exit(1);
+	return srcConstant(consts, src, &v) && v == val;
+}
+
+/* Replaces multiplications by 0 or 1 and additions of 0 */
+static int foldConstants(fimgShaderInstruction *start, uint32_t count,
+					const fimgShaderConsts *consts)
+{
+	fimgShaderInstruction *instr;
+	fimgShaderSrc src[3];
+	int changed = 0;
+
+	for (instr = start; instr < start + count; ++instr) {
+		fimgShaderSrc zero = { REG_SRC_C, consts->zero,
+						SWIZZLE_IDENTITY, 0 };
+
+		getSrc(instr, 0, &src[0]);
+		getSrc(instr, 1, &src[1]);
+		getSrc(instr, 2, &src[2]);
+
+		switch (instr->opcode) {
+		case OP_MUL:
+			if (consts->zero >= 0 && (isConstant(consts, &src[0], 0)
+			    || isConstant(consts, &src[1], 0)))
+				setOpcode(instr, OP_MOV, &zero, 1);
+			else if (isConstant(consts, &src[0], 1))
+				setOpcode(instr, OP_MOV, &src[1], 1);
+			else if (isConstant(consts, &src[1], 1))
+				setOpcode(instr, OP_MOV, &src[0], 1);
+			else
+				continue;
+			break;
+		case OP_ADD:
+			if (isConstant(consts, &src[0], 0))
+				setOpcode(instr, OP_MOV, &src[1], 1);
+			else if (isConstant(consts, &src[1], 0))
+				setOpcode(instr, OP_MOV, &src[0], 1);
+			else
+				continue;
+			break;
+		case OP_MAD:
+			if (isConstant(consts, &src[0], 0)
+			    || isConstant(consts, &src[1], 0)) {
+				setOpcode(instr, OP_MOV, &src[2], 1);
+			} else if (isConstant(consts, &src[0], 1)) {
+				setOpcode(instr, OP_ADD, &src[1], 2);
+			} else if (isConstant(consts, &src[1], 1)) {
+				src[1] = src[2];
+				setOpcode(instr, OP_ADD, src, 2);
+			} else if (isConstant(consts, &src[2], 0)) {
+				setOpcode(instr, OP_MUL, src, 2);
+			} else {
+				continue;
+			}
+			break;
+		default:
+			continue;
 		}
+
+		changed = 1;
 	}
-	start = addr = SHADER_SLOT(ctx->compat.vshaderBuf, slot);
 
-	addr += loadShaderBlock(&vertexHeader, addr);
+	return changed;
+}
 
-	for (unit = 0; unit < FIMG_NUM_TEXTURE_UNITS; unit++) {
-		if (!FGFP_BITFIELD_GET_IDX(ctx->compat.vsState.vs, VS_TEX_EN, unit))
-			continue;
+/*
+ * Copy propagation
+ */
 
-		addr += loadShaderBlock(&texcoordTransform[unit], addr);
-	}
+/* Replaces reads of temporaries holding copies with reads of originals */
+static int propagateCopies(fimgShaderInstruction *start, uint32_t count)
+{
+	fimgShaderSrc copy[NUM_TEMPS];
+	uint32_t valid = 0;
+	fimgShaderInstruction *instr;
+	int changed = 0;
+	unsigned int i, reg;
+
+	for (instr = start; instr < start + count; ++instr) {
+		const fimgOpcodeInfo *info = &opcodeMap[instr->opcode];
+		fimgShaderSrc src[3];
+
+		for (i = 0; i < info->srcCount; ++i)
+			getSrc(instr, i, &src[i]);
+
+		for (i = 0; i < info->srcCount; ++i) {
+			fimgShaderSrc old = src[i];
+
+			if (src[i].type != REG_SRC_R
+			    || !(valid & (1 << src[i].num)))
+				continue;
+
+			reg = src[i].num;
+			src[i].type = copy[reg].type;
+			src[i].num = copy[reg].num;
+			src[i].swizzle = mergeSwizzle(copy[reg].swizzle,
+							old.swizzle);
+			src[i].modifier = mergeModifier(copy[reg].modifier,
+							old.modifier);
+
+			if (!validSources(src, info->srcCount)) {
+				src[i] = old;
+				continue;
+			}
 
-	addr += loadShaderBlock(&vertexFooter, addr);
+			setSrc(instr, i, &src[i]);
+			changed = 1;
+		}
 
-	FGFP_BITFIELD_SET(ctx->compat.vsState.vs, VS_INVALID, 0);
+		if (!writesTemp(instr))
+			continue;
 
-	ctx->compat.vertexShaders[slot].instrCount = (addr - start) / 4;
-	ctx->compat.vertexShaders[slot].state = ctx->compat.vsState;
-}
+		reg = instr->dest_regnum;
+		valid &= ~(1 << reg);
+		for (i = 0; i < NUM_TEMPS; ++i)
+			if ((valid & (1 << i)) && isTemp(&copy[i], reg))
+				valid &= ~(1 << i);
 
-void fimgCompatLoadVertexShader(fimgContext *ctx)
-{
-	volatile uint32_t *reg;
-	struct shaderBlock blk;
-	uint32_t slot = ctx->compat.curVsNum;
-	struct fimgVertexShaderProgram *vs = &ctx->compat.vertexShaders[slot];
-#ifdef FIMG_DYNSHADER_DEBUG
-	ALOGD("Loading optimized shader");
-#endif
-	reg = vsInstAddr(ctx, 0);
-	blk.data = SHADER_SLOT(ctx->compat.vshaderBuf, slot);
-	blk.len = vs->instrCount;
-	loadShaderBlock(&blk, reg);
+		if (info->type != OP_TYPE_MOVE || instr->dest_mask != 0xf
+		    || instr->dest_modifier || isTemp(&src[0], reg))
+			continue;
 
-	setVertexShaderRange(ctx, 0, vs->instrCount - 1);
-#ifdef FIMG_DYNSHADER_DEBUG
-	ALOGD("Loading const float");
-#endif
-	reg = (volatile uint32_t *)(ctx->base + FGVS_CFLOAT_START);
-	loadShaderBlock(&vertexConstFloat, reg);
-#ifdef FIMG_DYNSHADER_DEBUG
-	ALOGD("Loaded pixel shader");
-#endif
+		copy[reg] = src[0];
+		valid |= 1 << reg;
+	}
+
+	return changed;
 }
 
-void fimgCompatBuildPixelShader(fimgContext *ctx, uint32_t slot)
+/*
+ * MAD fusion
+ */
+
+/* Returns the ADD consuming result of MUL, if it is its only consumer */
+static fimgShaderInstruction *findMulConsumer(fimgShaderInstruction *mul,
+						fimgShaderInstruction *end)
 {
-	uint32_t unit, arg;
-	uint32_t *addr;
-	uint32_t *start;
-	uint32_t instrCount;
-#ifdef FIMG_DYNSHADER_DEBUG
-	ALOGD("Loading pixel shader");
-#endif
-	if (!ctx->compat.pshaderBuf) {
-		ctx->compat.pshaderBuf = malloc(PS_CACHE_SIZE * MAX_INSTR * sizeof(fimgShaderInstruction));
-		if (!ctx->compat.pshaderBuf) {
-			ALOGE("Failed to allocate memory for shader buffer, terminating.");
-			exit(1);
-		}
-	}
-	start = addr = SHADER_SLOT(ctx->compat.pshaderBuf, slot);
+	fimgShaderInstruction *instr, *add = NULL;
+	uint32_t reg = mul->dest_regnum;
+	uint32_t mask = mul->dest_mask;
+	fimgShaderSrc src[2];
 
-#ifdef FIMG_DYNSHADER_DEBUG
-	ALOGD("Generating basic shader code");
-#endif
-	addr += loadShaderBlock(&pixelHeader, addr);
+	getSrc(mul, 0, &src[0]);
+	getSrc(mul, 1, &src[1]);
 
-	for (unit = 0; unit < FIMG_NUM_TEXTURE_UNITS; unit++) {
-		uint32_t reg = ctx->compat.psState.tex[unit];
-		if (!FGFP_BITFIELD_GET(reg, TEX_MODE))
+	for (instr = mul + 1; instr < end && mask; ++instr) {
+		if (instr->reserved == INSTR_REMOVED)
 			continue;
 
-		addr += loadShaderBlock(&textureUnit[unit], addr);
-		if (FGFP_BITFIELD_GET(reg, TEX_SWAP))
-			addr += loadShaderBlock(&tex_swap, addr);
-		addr += loadShaderBlock(&textureFunc[FGFP_BITFIELD_GET(reg, TEX_MODE)], addr);
+		if (tempReadMask(instr, reg) & mask) {
+			if (add || instr->opcode != OP_ADD)
+				return NULL;
+			add = instr;
+		}
 
-		if (FGFP_BITFIELD_GET(reg, TEX_MODE) != FGFP_TEXFUNC_COMBINE)
+		if (!writesTemp(instr))
 			continue;
 
-		for (arg = 0; arg < 3; arg++) {
-			addr += loadShaderBlock(&combineArg[arg]
-					[FGFP_BITFIELD_GET_IDX(reg, TEX_COMBC_SRC, arg)], addr);
-			addr += loadShaderBlock(&combineArgMod[arg]
-					[FGFP_BITFIELD_GET_IDX(reg, TEX_COMBC_MOD, arg)], addr);
+		if (!add) {
+			/* Operands must stay the same until the ADD */
+			if (instr->dest_regnum == reg
+			    || isTemp(&src[0], instr->dest_regnum)
+			    || isTemp(&src[1], instr->dest_regnum))
+				return NULL;
+			continue;
 		}
 
-		addr += loadShaderBlock(&combineFunc[FGFP_BITFIELD_GET(reg, TEX_COMBC_FUNC)],
-									addr);
+		if (instr->dest_regnum == reg)
+			mask &= ~instr->dest_mask;
+	}
 
-		if (FGFP_BITFIELD_GET(reg, TEX_COMBC_FUNC) == FGFP_COMBFUNC_DOT3_RGBA) {
-			addr += loadShaderBlock(&combine_u, addr);
+	return add;
+}
+
+/* Merges MUL followed by ADD of its result into single MAD */
+static int fuseMultiplyAdd(fimgShaderInstruction *start, uint32_t count)
+{
+	fimgShaderInstruction *mul, *add;
+	fimgShaderSrc src[3], tmp;
+	int changed = 0;
+
+	for (mul = start; mul < start + count; ++mul) {
+		if (mul->opcode != OP_MUL || mul->reserved == INSTR_REMOVED
+		    || !writesTemp(mul) || mul->dest_modifier)
 			continue;
-		}
 
-		addr += loadShaderBlock(&combine_c, addr);
+		add = findMulConsumer(mul, start + count);
+		if (!add)
+			continue;
 
-		for (arg = 0; arg < 3; arg++) {
-			addr += loadShaderBlock(&combineArg[arg]
-					[FGFP_BITFIELD_GET_IDX(reg, TEX_COMBA_SRC, arg)], addr);
-			addr += loadShaderBlock(&combineArgMod[arg]
-					[FGFP_BITFIELD_GET_IDX(reg, TEX_COMBA_MOD, arg) | 0x2], addr);
+		getSrc(add, 0, &tmp);
+		getSrc(add, 1, &src[2]);
+		if (!isTemp(&tmp, mul->dest_regnum)) {
+			src[0] = tmp;
+			tmp = src[2];
+			src[2] = src[0];
 		}
 
-		addr += loadShaderBlock(&combineFunc[FGFP_BITFIELD_GET(reg, TEX_COMBA_FUNC)],
-									addr);
-		addr += loadShaderBlock(&combine_a, addr);
-	}
+		/* Result must be read once and only where MUL wrote it */
+		if (isTemp(&src[2], mul->dest_regnum)
+		    || (tmp.modifier & SRC_MOD_ABS)
+		    || (srcReadMask(add, &tmp) & ~mul->dest_mask))
+			continue;
 
-	if (FGFP_BITFIELD_GET(ctx->compat.psState.ps, PS_SWAP))
-		addr += loadShaderBlock(&out_swap, addr);
+		getSrc(mul, 0, &src[0]);
+		getSrc(mul, 1, &src[1]);
+		src[0].swizzle = mergeSwizzle(src[0].swizzle, tmp.swizzle);
+		src[1].swizzle = mergeSwizzle(src[1].swizzle, tmp.swizzle);
+		src[0].modifier = mergeModifier(src[0].modifier, tmp.modifier);
 
-	addr += loadShaderBlock(&pixelFooter, addr);
-#ifdef FIMG_DYNSHADER_DEBUG
-	ALOGD("Optimizing pixel shader");
+		if (!validSources(src, 3))
+			continue;
+
+		setOpcode(add, OP_MAD, src, 3);
+		mul->reserved = INSTR_REMOVED;
+		changed = 1;
+	}
+
+	return changed;
+}
+
+/*
+ * Dead code elimination
+ */
+
+static inline int isIdentityMove(const fimgShaderInstruction *instr)
+{
+	fimgShaderSrc src;
+	uint32_t comp;
+
+	if (instr->opcode != OP_MOV || !writesTemp(instr)
+	    || instr->dest_modifier)
+		return 0;
+
+	getSrc(instr, 0, &src);
+	if (!isTemp(&src, instr->dest_regnum) || src.modifier)
+		return 0;
+
+	for (comp = 0; comp < 4; ++comp)
+		if ((instr->dest_mask & (1 << comp))
+		    && ((src.swizzle >> 2*comp) & 3) != comp)
+			return 0;
+
+	return 1;
+}
+
+/* Removes writes of temporaries never read later and NOPs */
+static int eliminateDeadCode(fimgShaderInstruction *start, uint32_t count)
+{
+	uint8_t live[NUM_TEMPS];
+	fimgShaderInstruction *instr;
+	int changed = 0;
+	unsigned int i;
+
+	memset(live, 0, sizeof(live));
+
+	for (instr = start + count; instr-- > start;) {
+		const fimgOpcodeInfo *info = &opcodeMap[instr->opcode];
+		fimgShaderSrc src;
+
+		if (instr->reserved == INSTR_REMOVED)
+			continue;
+
+		if (instr->opcode == OP_NOP || isIdentityMove(instr)) {
+			instr->reserved = INSTR_REMOVED;
+			changed = 1;
+			continue;
+		}
+
+		if (writesTemp(instr)) {
+			uint32_t used = instr->dest_mask
+					& live[instr->dest_regnum];
+
+			if (!used) {
+				instr->reserved = INSTR_REMOVED;
+				changed = 1;
+				continue;
+			}
+
+			if (used != instr->dest_mask
+			    && (info->flags & OP_FLAG_COMPONENTWISE)) {
+				instr->dest_mask = used;
+				changed = 1;
+			}
+
+			live[instr->dest_regnum] &= ~instr->dest_mask;
+		}
+
+		for (i = 0; i < info->srcCount; ++i) {
+			getSrc(instr, i, &src);
+			if (src.type == REG_SRC_R)
+				live[src.num] |= srcReadMask(instr, &src);
+		}
+	}
+
+	return changed;
+}
+
+/*
+ * Register renaming
+ */
+
+/*
+ * Each full write of a temporary starts a new value, which can be given
+ * any free register. Registers of values are allocated at their first
+ * occurrence and released after their last use.
+ */
+#define NO_REG		0xff
+#define RELEASED	0xff
+
+static void renameTemps(fimgShaderInstruction *start, uint32_t count)
+{
+	uint8_t webReg[4 * MAX_INSTR];
+	uint8_t webEnd[4 * MAX_INSTR];
+	uint16_t srcWeb[MAX_INSTR][3];
+	uint16_t dstWeb[MAX_INSTR];
+	int cur[NUM_TEMPS];
+	uint32_t webCount = 0, busy = 0, pos, web, i, reg;
+	fimgShaderInstruction *instr;
+	fimgShaderSrc src;
+
+	if (count > MAX_INSTR)
+		return;
+
+	for (reg = 0; reg < NUM_TEMPS; ++reg)
+		cur[reg] = -1;
+
+	/* Split temporaries into values */
+	for (pos = 0; pos < count; ++pos) {
+		instr = &start[pos];
+
+		for (i = 0; i < opcodeMap[instr->opcode].srcCount; ++i) {
+			getSrc(instr, i, &src);
+			if (src.type != REG_SRC_R)
+				continue;
+			if (cur[src.num] < 0)
+				cur[src.num] = webCount++;
+			srcWeb[pos][i] = cur[src.num];
+			webEnd[cur[src.num]] = pos;
+		}
+
+		if (!writesTemp(instr))
+			continue;
+
+		reg = instr->dest_regnum;
+		if (cur[reg] < 0 || instr->dest_mask == 0xf)
+			cur[reg] = webCount++;
+		dstWeb[pos] = cur[reg];
+		webEnd[cur[reg]] = pos;
+	}
+
+	memset(webReg, NO_REG, sizeof(webReg));
+
+	/* Allocate registers */
+	for (pos = 0; pos < count; ++pos) {
+		int writes;
+
+		instr = &start[pos];
+		writes = writesTemp(instr);
+
+		for (i = 0; i < opcodeMap[instr->opcode].srcCount; ++i) {
+			getSrc(instr, i, &src);
+			if (src.type != REG_SRC_R)
+				continue;
+
+			web = srcWeb[pos][i];
+			if (webReg[web] == NO_REG) {
+				for (reg = 0; busy & (1 << reg); ++reg)
+					;
+				webReg[web] = reg;
+				busy |= 1 << reg;
+			}
+
+			src.num = webReg[web];
+			setSrc(instr, i, &src);
+		}
+
+		/* Sources are read before destination is written */
+		for (web = 0; web < webCount; ++web) {
+			if (webReg[web] == NO_REG || webEnd[web] > pos
+			    || (writes && web == dstWeb[pos]))
+				continue;
+			busy &= ~(1 << webReg[web]);
+			webEnd[web] = RELEASED;
+		}
+
+		if (!writes)
+			continue;
+
+		web = dstWeb[pos];
+		if (webReg[web] == NO_REG) {
+			for (reg = 0; busy & (1 << reg); ++reg)
+				;
+			webReg[web] = reg;
+			busy |= 1 << reg;
+		}
+
+		instr->dest_regnum = webReg[web];
+		if (webEnd[web] <= pos) {
+			busy &= ~(1 << webReg[web]);
+			webEnd[web] = RELEASED;
+		}
+	}
+}
+
+/* Removes instructions marked by optimization passes */
+static uint32_t removeMarked(fimgShaderInstruction *start, uint32_t count)
+{
+	fimgShaderInstruction *instr, *instrPtr = start;
+
+	for (instr = start; instr < start + count; ++instr) {
+		if (instr->reserved == INSTR_REMOVED)
+			continue;
+		*(instrPtr++) = *instr;
+	}
+
+	return instrPtr - start;
+}
+
+/* Flags instructions followed by 3-source ones, as required by hardware */
+static uint32_t markThreeSourceOps(fimgShaderInstruction *start,
+					uint32_t count, uint32_t maxInstr)
+{
+	uint32_t i;
+
+	if (count && count < maxInstr
+	    && opcodeMap[start->opcode].srcCount == 3) {
+		memmove(start + 1, start, count * sizeof(*start));
+		memset(start, 0, sizeof(*start));
+		++count;
+	}
+
+	for (i = 0; i < count; ++i)
+		start[i].next_3src = i + 1 < count
+				&& opcodeMap[start[i + 1].opcode].srcCount == 3;
+
+	return count;
+}
+
+static uint32_t optimizeShader(uint32_t *start, uint32_t *end,
+			uint32_t maxInstr, const struct shaderBlock *constBlock)
+{
+	fimgShaderInstruction *instr = (fimgShaderInstruction *)start;
+	uint32_t count = (end - start) / 4;
+	fimgShaderConsts consts;
+	uint32_t i;
+	int pass, changed;
+
+	if (!canOptimize(instr, count))
+		return count;
+
+	consts.data = constBlock->data;
+	consts.count = constBlock->len;
+	consts.zero = -1;
+	for (i = 0; i < consts.count; ++i) {
+		const uint32_t *c = &consts.data[4*i];
+
+		if (!c[0] && !c[1] && !c[2] && !c[3]) {
+			consts.zero = i;
+			break;
+		}
+	}
+
+	for (pass = 0; pass < MAX_PASSES; ++pass) {
+		changed = foldConstants(instr, count, &consts);
+		changed |= propagateCopies(instr, count);
+		changed |= fuseMultiplyAdd(instr, count);
+		count = removeMarked(instr, count);
+		changed |= eliminateDeadCode(instr, count);
+		count = removeMarked(instr, count);
+		if (!changed)
+			break;
+	}
+
+	renameTemps(instr, count);
+
+	return markThreeSourceOps(instr, count, maxInstr);
+}
+#endif
+
+/*
+ * Shader generation code
+ */
+
+#define NELEM(i)	(sizeof(i)/sizeof(*i))
+
+#ifdef FIMG_SHADER_DISK_CACHE
+/* Identifies the generator, shaders stored by other builds are discarded */
+const char fimgShaderBuildId[] = FIMG_BUILD_ID;
+#endif
+
+static inline uint32_t *SHADER_SLOT(uint32_t *buf, uint32_t slot,
+							uint32_t maxInstr)
+{
+	return buf
+		+ slot*maxInstr*sizeof(fimgShaderInstruction)/sizeof(uint32_t);
+}
+
+/*
+ * Shader cache
+ *
+ * Generated programs are kept in host memory, hashed by their key (shader
+ * state with don't care bits masked out) and evicted in LRU order when
+ * the cache is full. Only the current program of each type is loaded
+ * into the hardware.
+ */
+
+static inline uint32_t hashShaderKey(const uint32_t *key, uint32_t len)
+{
+	uint32_t hash = 2166136261U;
+
+	while (len--) {
+		hash ^= *(key++);
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static inline fimgShaderCacheEntry **shaderBucket(fimgShaderCache *cache,
+							uint32_t hash)
+{
+	hash ^= hash >> 16;
+	return &cache->buckets[hash % FIMG_SHADER_CACHE_BUCKETS];
+}
+
+static inline void lruUnlink(fimgShaderCacheEntry *e)
+{
+	e->lruPrev->lruNext = e->lruNext;
+	e->lruNext->lruPrev = e->lruPrev;
+}
+
+static inline void lruPushFront(fimgShaderCache *cache,
+						fimgShaderCacheEntry *e)
+{
+	e->lruPrev = &cache->lru;
+	e->lruNext = cache->lru.lruNext;
+	cache->lru.lruNext->lruPrev = e;
+	cache->lru.lruNext = e;
+}
+
+static void initShaderCache(fimgShaderCache *cache, uint32_t keyLen,
+				uint32_t maxInstr, uint32_t capacity)
+{
+	cache->keyLen = keyLen;
+	cache->maxInstr = maxInstr;
+	cache->capacity = capacity;
+	cache->lru.lruPrev = &cache->lru;
+	cache->lru.lruNext = &cache->lru;
+}
+
+static void destroyShaderCache(fimgShaderCache *cache)
+{
+	free(cache->entries);
+	free(cache->codeBuf);
+	cache->entries = NULL;
+	cache->codeBuf = NULL;
+}
+
+static fimgShaderCacheEntry *lookupShader(fimgShaderCache *cache,
+					const uint32_t *key, uint32_t hash)
+{
+	fimgShaderCacheEntry *e;
+
+	for (e = *shaderBucket(cache, hash); e; e = e->hashNext) {
+		if (e->hash != hash)
+			continue;
+		if (!memcmp(e->key, key, cache->keyLen * sizeof(*key)))
+			break;
+	}
+
+	if (e && e != cache->lru.lruNext) {
+		lruUnlink(e);
+		lruPushFront(cache, e);
+	}
+
+	return e;
+}
+
+/* Takes a free entry or the least recently used one when cache is full */
+static fimgShaderCacheEntry *allocShader(fimgShaderCache *cache,
+					const uint32_t *key, uint32_t hash)
+{
+	fimgShaderCacheEntry *e, **p;
+	uint32_t i;
+
+	if (!cache->entries) {
+		cache->entries = calloc(cache->capacity, sizeof(*cache->entries));
+		cache->codeBuf = malloc(cache->capacity * cache->maxInstr
+					* sizeof(fimgShaderInstruction));
+		if (!cache->entries || !cache->codeBuf) {
+			ALOGE("Failed to allocate memory for shader buffer, terminating.");
+			exit(1);
+		}
+
+		for (i = 0; i < cache->capacity; ++i)
+			cache->entries[i].code = SHADER_SLOT(cache->codeBuf,
+							i, cache->maxInstr);
+	}
+
+	if (cache->count < cache->capacity) {
+		e = &cache->entries[cache->count++];
+	} else {
+		e = cache->lru.lruPrev;
+		lruUnlink(e);
+
+		for (p = shaderBucket(cache, e->hash); *p != e;
+							p = &(*p)->hashNext);
+		*p = e->hashNext;
+	}
+
+	memcpy(e->key, key, cache->keyLen * sizeof(*key));
+	e->hash = hash;
+
+	p = shaderBucket(cache, hash);
+	e->hashNext = *p;
+	*p = e;
+
+	lruPushFront(cache, e);
+
+	return e;
+}
+
+/*
+ * Lighting
+ *
+ * Vertex shader constants used by lighting code (see shaders/vert.asm).
+ * Code blocks of a light are written for light 0 and moved to constants
+ * of the right light when generating the shader.
+ */
+
+#define FGFP_SCENE_COLOR	20
+#define FGFP_MATERIAL_EMISSION	21
+#define FGFP_MODEL_AMBIENT	22
+#define FGFP_LIGHTING_PARAMS	23
+#define FGFP_LIGHT(i)		(24 + 8*(i))
+
+/* Constants of a light, relative to FGFP_LIGHT(i) */
+enum {
+	FGFP_LC_POSITION = 0,
+	FGFP_LC_AMBIENT,
+	FGFP_LC_DIFFUSE,
+	FGFP_LC_SPECULAR,
+	FGFP_LC_SPOT,
+	FGFP_LC_ATTENUATION,
+	FGFP_LC_HALF_VECTOR
+};
+
+/* Light constants are always read through src0, which can address them */
+static void relocateLight(uint32_t *start, uint32_t *end, uint32_t light)
+{
+	fimgShaderInstruction *instr = (fimgShaderInstruction *)start;
+	uint32_t num;
+
+	for (; instr < (fimgShaderInstruction *)end; ++instr) {
+		if (instr->src0_regtype != REG_SRC_C)
+			continue;
+
+		num = instr->src0_regnum | (instr->src0_extnum << 5);
+		if (num < FGFP_LIGHT(0) || num >= FGFP_LIGHT(1))
+			continue;
+
+		num += FGFP_LIGHT(light) - FGFP_LIGHT(0);
+		instr->src0_regnum = num & 0x1f;
+		instr->src0_extnum = num >> 5;
+	}
+}
+
+/*****************************************************************************
+ * FUNCTION:	buildLighting
+ * SYNOPSIS:	This function generates vertex shader code computing lit
+ *		vertex color, with code only for enabled lights
+ * ARGUMENTS:	ctx - hardware context
+ *		addr - where to put generated code
+ * RETURNS:	number of generated words
+ *****************************************************************************/
+static uint32_t buildLighting(fimgContext *ctx, uint32_t *addr)
+{
+	uint32_t vs = ctx->compat.vsState.vs;
+	uint32_t lights = ctx->compat.vsState.light;
+	uint32_t cm = FGFP_BITFIELD_GET(vs, VS_COLOR_MATERIAL);
+	uint32_t *start = addr;
+	uint32_t *light;
+	uint32_t i;
+
+	addr += loadShaderBlock(&lightingNormal, addr);
+	if (FGFP_BITFIELD_GET(vs, VS_NORMALIZE))
+		addr += loadShaderBlock(&lightingNormalize, addr);
+
+	for (i = 0; i < FIMG_NUM_LIGHTS; ++i) {
+		if (FGFP_BITFIELD_GET_IDX(lights, LIGHT_EN, i)
+		    && FGFP_BITFIELD_GET_IDX(lights, LIGHT_POSITIONAL, i)) {
+			addr += loadShaderBlock(&lightingEyePosition, addr);
+			break;
+		}
+	}
+
+	addr += loadShaderBlock(&lightingSceneColor[cm], addr);
+
+	for (i = 0; i < FIMG_NUM_LIGHTS; ++i) {
+		uint32_t attenuated = 0;
+
+		if (!FGFP_BITFIELD_GET_IDX(lights, LIGHT_EN, i))
+			continue;
+
+		light = addr;
+
+		if (FGFP_BITFIELD_GET_IDX(lights, LIGHT_POSITIONAL, i)) {
+			addr += loadShaderBlock(&lightPositional, addr);
+			if (FGFP_BITFIELD_GET_IDX(lights, LIGHT_ATTENUATION, i)) {
+				addr += loadShaderBlock(&lightAttenuation, addr);
+				attenuated = 1;
+			}
+		} else {
+			addr += loadShaderBlock(&lightDirectional, addr);
+		}
+
+		if (FGFP_BITFIELD_GET_IDX(lights, LIGHT_SPOT, i)) {
+			if (!attenuated)
+				addr += loadShaderBlock(&lightUnattenuated, addr);
+			addr += loadShaderBlock(&lightSpot, addr);
+			attenuated = 1;
+		}
+
+		addr += loadShaderBlock(&lightTerms, addr);
+		addr += loadShaderBlock(&lightColor[cm], addr);
+		if (attenuated)
+			addr += loadShaderBlock(&lightAttenuate, addr);
+		addr += loadShaderBlock(&lightAccumulate, addr);
+
+		relocateLight(light, addr, i);
+	}
+
+	addr += loadShaderBlock(&lightingFooter, addr);
+
+	return addr - start;
+}
+
+/*****************************************************************************
+ * FUNCTION:	buildVertexShader
+ * SYNOPSIS:	This function generates unoptimized vertex shader code for
+ *		current fixed pipeline state
+ * ARGUMENTS:	ctx - hardware context
+ *		addr - where to put generated code
+ * RETURNS:	number of generated words
+ *****************************************************************************/
+static uint32_t buildVertexShader(fimgContext *ctx, uint32_t *addr)
+{
+	uint32_t unit, plane, fog;
+	uint32_t *start = addr;
+
+	addr += loadShaderBlock(&vertexHeader, addr);
+
+	if (FGFP_BITFIELD_GET(ctx->compat.vsState.vs, VS_LIGHTING))
+		addr += buildLighting(ctx, addr);
+	else
+		addr += loadShaderBlock(&vertexColor, addr);
+
+	for (unit = 0; unit < FIMG_NUM_TEXTURE_UNITS; unit++) {
+		if (!FGFP_BITFIELD_GET_IDX(ctx->compat.vsState.vs, VS_TEX_EN, unit))
+			continue;
+
+		addr += loadShaderBlock(&texcoordTransform[unit], addr);
+	}
+
+	fog = FGFP_BITFIELD_GET(ctx->compat.vsState.vs, VS_FOG_MODE);
+	if (fog != FGFP_FOG_NONE) {
+		addr += loadShaderBlock(&fogCoord, addr);
+		addr += loadShaderBlock(&fogFactor[fog], addr);
+	}
+
+	for (plane = 0; plane < FIMG_NUM_CLIP_PLANES; ++plane)
+		if (FGFP_BITFIELD_GET_IDX(ctx->compat.vsState.vs, VS_CLIP_EN, plane))
+			addr += loadShaderBlock(&clipDistance[plane], addr);
+
+	addr += loadShaderBlock(&vertexFooter, addr);
+
+	return addr - start;
+}
+
+void fimgCompatBuildVertexShader(fimgContext *ctx, fimgShaderCacheEntry *vs)
+{
+	uint32_t len = buildVertexShader(ctx, vs->code);
+
+	vs->instrCount = optimizeShader(vs->code, vs->code + len,
+					MAX_VS_INSTR, &vertexConstFloat);
+}
+
+void fimgCompatLoadVertexShader(fimgContext *ctx)
+{
+	volatile uint32_t *reg;
+	struct shaderBlock blk;
+	fimgShaderCacheEntry *vs = ctx->compat.vsCache.current;
+#ifdef FIMG_DYNSHADER_DEBUG
+	ALOGD("Loading optimized shader");
+#endif
+	reg = vsInstAddr(ctx, 0);
+	blk.data = vs->code;
+	blk.len = vs->instrCount;
+	loadShaderBlock(&blk, reg);
+
+	setVertexShaderRange(ctx, 0, vs->instrCount - 1);
+#ifdef FIMG_DYNSHADER_DEBUG
+	ALOGD("Loading const float");
+#endif
+	queueConstBlock(ctx, &ctx->compat.vsConst, &vertexConstFloat);
+#ifdef FIMG_DYNSHADER_DEBUG
+	ALOGD("Loaded pixel shader");
+#endif
+}
+
+/*****************************************************************************
+ * FUNCTION:	buildPixelShader
+ * SYNOPSIS:	This function generates unoptimized pixel shader code for
+ *		current texture environment and fog state
+ * ARGUMENTS:	ctx - hardware context
+ *		addr - where to put generated code
+ * RETURNS:	number of generated words
+ *****************************************************************************/
+static uint32_t buildPixelShader(fimgContext *ctx, uint32_t *addr)
+{
+	uint32_t unit, arg, plane;
+	uint32_t *start = addr;
+
+#ifdef FIMG_DYNSHADER_DEBUG
+	ALOGD("Generating basic shader code");
 #endif
-	instrCount = optimizeShader(start, addr);
+	addr += loadShaderBlock(&pixelHeader, addr);
+
+	for (plane = 0; plane < FIMG_NUM_CLIP_PLANES; ++plane)
+		if (FGFP_BITFIELD_GET_IDX(ctx->compat.psState.ps, PS_CLIP_EN, plane))
+			addr += loadShaderBlock(&clipTest[plane], addr);
+
+	for (unit = 0; unit < FIMG_NUM_TEXTURE_UNITS; unit++) {
+		uint32_t reg = ctx->compat.psState.tex[unit];
+		if (!FGFP_BITFIELD_GET(reg, TEX_MODE))
+			continue;
+
+		addr += loadShaderBlock(&textureUnit[unit], addr);
+		if (FGFP_BITFIELD_GET(reg, TEX_SWAP))
+			addr += loadShaderBlock(&tex_swap, addr);
+		addr += loadShaderBlock(&textureFunc[FGFP_BITFIELD_GET(reg, TEX_MODE)], addr);
+
+		if (FGFP_BITFIELD_GET(reg, TEX_MODE) != FGFP_TEXFUNC_COMBINE)
+			continue;
+
+		for (arg = 0; arg < 3; arg++) {
+			addr += loadShaderBlock(&combineArg[arg]
+					[FGFP_BITFIELD_GET_IDX(reg, TEX_COMBC_SRC, arg)], addr);
+			addr += loadShaderBlock(&combineArgMod[arg]
+					[FGFP_BITFIELD_GET_IDX(reg, TEX_COMBC_MOD, arg)], addr);
+		}
+
+		addr += loadShaderBlock(&combineFunc[FGFP_BITFIELD_GET(reg, TEX_COMBC_FUNC)],
+									addr);
+
+		if (FGFP_BITFIELD_GET(reg, TEX_COMBC_FUNC) == FGFP_COMBFUNC_DOT3_RGBA) {
+			addr += loadShaderBlock(&combine_u, addr);
+			continue;
+		}
+
+		addr += loadShaderBlock(&combine_c, addr);
+
+		for (arg = 0; arg < 3; arg++) {
+			addr += loadShaderBlock(&combineArg[arg]
+					[FGFP_BITFIELD_GET_IDX(reg, TEX_COMBA_SRC, arg)], addr);
+			addr += loadShaderBlock(&combineArgMod[arg]
+					[FGFP_BITFIELD_GET_IDX(reg, TEX_COMBA_MOD, arg) | 0x2], addr);
+		}
+
+		addr += loadShaderBlock(&combineFunc[FGFP_BITFIELD_GET(reg, TEX_COMBA_FUNC)],
+									addr);
+		addr += loadShaderBlock(&combine_a, addr);
+	}
+
+	if (FGFP_BITFIELD_GET(ctx->compat.psState.ps, PS_FOG))
+		addr += loadShaderBlock(&pixelFog, addr);
+
+	if (FGFP_BITFIELD_GET(ctx->compat.psState.ps, PS_SWAP))
+		addr += loadShaderBlock(&out_swap, addr);
+
+	addr += loadShaderBlock(&pixelFooter, addr);
 
-	FGFP_BITFIELD_SET(ctx->compat.psState.ps, PS_INVALID, 0);
+	return addr - start;
+}
 
-	ctx->compat.pixelShaders[slot].instrCount = instrCount;
-	ctx->compat.pixelShaders[slot].state = ctx->compat.psState;
+void fimgCompatBuildPixelShader(fimgContext *ctx, fimgShaderCacheEntry *ps)
+{
+	uint32_t len;
+#ifdef FIMG_DYNSHADER_DEBUG
+	ALOGD("Loading pixel shader");
+#endif
+	len = buildPixelShader(ctx, ps->code);
+#ifdef FIMG_DYNSHADER_DEBUG
+	ALOGD("Optimizing pixel shader");
+#endif
+	ps->instrCount = optimizeShader(ps->code, ps->code + len,
+					MAX_PS_INSTR, &pixelConstFloat);
 }
 
 void fimgCompatLoadPixelShader(fimgContext *ctx)
 {
 	volatile uint32_t *reg;
 	struct shaderBlock blk;
-	uint32_t slot = ctx->compat.curPsNum;
-	struct fimgPixelShaderProgram *ps = &ctx->compat.pixelShaders[slot];
+	fimgShaderCacheEntry *ps = ctx->compat.psCache.current;
 #ifdef FIMG_DYNSHADER_DEBUG
 	ALOGD("Loading optimized shader");
 #endif
 	reg = psInstAddr(ctx, 0);
-	blk.data = SHADER_SLOT(ctx->compat.pshaderBuf, slot);
+	blk.data = ps->code;
 	blk.len = ps->instrCount;
 	loadShaderBlock(&blk, reg);
 
@@ -1099,8 +2057,7 @@ void fimgCompatLoadPixelShader(fimgContext *ctx)
 #ifdef FIMG_DYNSHADER_DEBUG
 	ALOGD("Loading const float");
 #endif
-	reg = (volatile uint32_t *)(ctx->base + FGPS_CFLOAT_START);
-	loadShaderBlock(&pixelConstFloat, reg);
+	queueConstBlock(ctx, &ctx->compat.psConst, &pixelConstFloat);
 #ifdef FIMG_DYNSHADER_DEBUG
 	ALOGD("Loaded pixel shader");
 #endif
@@ -1117,7 +2074,7 @@ void fimgCompatSetTextureFunc(fimgContext *ctx, uint32_t unit, fimgTexFunc func)
 		ctx->compat.psMask[unit] = FGFP_TEX_MODE_MASK;
 		break;
 	case FGFP_TEXFUNC_COMBINE:
-		ctx->compat.psMask[unit] = ~0UL;
+		ctx->compat.psMask[unit] = 0xffffffff;
 		break;
 	default:
 		ctx->compat.psMask[unit] =
@@ -1196,6 +2153,233 @@ void fimgCompatSetupTexture(fimgContext *ctx, fimgTexture *tex, uint32_t unit)
 				TEX_SWAP, !!(tex->reserved2 & FGTU_TEX_BGR));
 }
 
+/* Lighting state bits are don't care when lighting or the light is off */
+static void updateVertexShaderMask(fimgContext *ctx)
+{
+	uint32_t vs = ctx->compat.vsState.vs;
+	uint32_t i;
+
+	ctx->compat.vsMask[0] = FGFP_VS_LIGHTING_MASK | FGFP_VS_FOG_MODE_MASK
+							| FGFP_VS_CLIP_MASK;
+	for (i = 0; i < FIMG_NUM_TEXTURE_UNITS; ++i)
+		ctx->compat.vsMask[0] |= FGFP_VS_TEX_EN_MASK(i);
+
+	ctx->compat.vsMask[1] = 0;
+
+	if (!FGFP_BITFIELD_GET(vs, VS_LIGHTING))
+		return;
+
+	ctx->compat.vsMask[0] |= FGFP_VS_COLOR_MATERIAL_MASK
+						| FGFP_VS_NORMALIZE_MASK;
+
+	for (i = 0; i < FIMG_NUM_LIGHTS; ++i)
+		if (FGFP_BITFIELD_GET_IDX(ctx->compat.vsState.light, LIGHT_EN, i))
+			ctx->compat.vsMask[1] |= FGFP_LIGHT_MASK(i);
+}
+
+/* Selects code needed for current parameters of the light */
+static void updateLightState(fimgContext *ctx, uint32_t light)
+{
+	fimgLightCompat *l = &ctx->compat.lighting.light[light];
+	uint32_t attenuated;
+
+	attenuated = l->attenuation[0] != 1.0f || l->attenuation[1] != 0.0f
+						|| l->attenuation[2] != 0.0f;
+
+	FGFP_BITFIELD_SET_IDX(ctx->compat.vsState.light, LIGHT_POSITIONAL,
+					light, l->position[3] != 0.0f);
+	FGFP_BITFIELD_SET_IDX(ctx->compat.vsState.light, LIGHT_SPOT,
+					light, l->cutoff != 180.0f);
+	FGFP_BITFIELD_SET_IDX(ctx->compat.vsState.light, LIGHT_ATTENUATION,
+					light, attenuated);
+
+	ctx->compat.lighting.dirty = 1;
+}
+
+void fimgCompatSetLightingEnable(fimgContext *ctx, int enable)
+{
+	FGFP_BITFIELD_SET(ctx->compat.vsState.vs, VS_LIGHTING, !!enable);
+	updateVertexShaderMask(ctx);
+}
+
+void fimgCompatSetColorMaterialEnable(fimgContext *ctx, int enable)
+{
+	FGFP_BITFIELD_SET(ctx->compat.vsState.vs, VS_COLOR_MATERIAL, !!enable);
+	ctx->compat.lighting.dirty = 1;
+}
+
+void fimgCompatSetNormalizeEnable(fimgContext *ctx, int enable)
+{
+	FGFP_BITFIELD_SET(ctx->compat.vsState.vs, VS_NORMALIZE, !!enable);
+}
+
+void fimgCompatSetLightEnable(fimgContext *ctx, uint32_t light, int enable)
+{
+	FGFP_BITFIELD_SET_IDX(ctx->compat.vsState.light, LIGHT_EN,
+							light, !!enable);
+	updateVertexShaderMask(ctx);
+	ctx->compat.lighting.dirty = 1;
+}
+
+void fimgCompatSetLightColor(fimgContext *ctx, uint32_t light,
+				fimgLightColor color, const float *rgba)
+{
+	fimgLightCompat *l = &ctx->compat.lighting.light[light];
+
+	switch (color) {
+	case FGFP_LIGHT_AMBIENT:
+		memcpy(l->ambient, rgba, sizeof(l->ambient));
+		break;
+	case FGFP_LIGHT_DIFFUSE:
+		memcpy(l->diffuse, rgba, sizeof(l->diffuse));
+		break;
+	case FGFP_LIGHT_SPECULAR:
+		memcpy(l->specular, rgba, sizeof(l->specular));
+		break;
+	default:
+		return;
+	}
+
+	ctx->compat.lighting.dirty = 1;
+}
+
+/* Position must be already transformed to eye coordinates */
+void fimgCompatSetLightPosition(fimgContext *ctx, uint32_t light,
+							const float *pos)
+{
+	memcpy(ctx->compat.lighting.light[light].position, pos, 4*sizeof(float));
+	updateLightState(ctx, light);
+}
+
+/* Direction must be already transformed to eye coordinates */
+void fimgCompatSetSpotLight(fimgContext *ctx, uint32_t light,
+			const float *dir, float exponent, float cutoff)
+{
+	fimgLightCompat *l = &ctx->compat.lighting.light[light];
+
+	memcpy(l->direction, dir, 3*sizeof(float));
+	l->exponent = exponent;
+	l->cutoff = cutoff;
+	updateLightState(ctx, light);
+}
+
+void fimgCompatSetLightAttenuation(fimgContext *ctx, uint32_t light,
+			float constant, float linear, float quadratic)
+{
+	fimgLightCompat *l = &ctx->compat.lighting.light[light];
+
+	l->attenuation[0] = constant;
+	l->attenuation[1] = linear;
+	l->attenuation[2] = quadratic;
+	updateLightState(ctx, light);
+}
+
+void fimgCompatSetMaterialColor(fimgContext *ctx, fimgLightColor color,
+							const float *rgba)
+{
+	fimgLightingCompat *l = &ctx->compat.lighting;
+
+	switch (color) {
+	case FGFP_LIGHT_AMBIENT:
+		memcpy(l->ambient, rgba, sizeof(l->ambient));
+		break;
+	case FGFP_LIGHT_DIFFUSE:
+		memcpy(l->diffuse, rgba, sizeof(l->diffuse));
+		break;
+	case FGFP_LIGHT_SPECULAR:
+		memcpy(l->specular, rgba, sizeof(l->specular));
+		break;
+	case FGFP_LIGHT_EMISSION:
+		memcpy(l->emission, rgba, sizeof(l->emission));
+		break;
+	}
+
+	l->dirty = 1;
+}
+
+void fimgCompatSetMaterialShininess(fimgContext *ctx, float shininess)
+{
+	ctx->compat.lighting.shininess = shininess;
+	ctx->compat.lighting.dirty = 1;
+}
+
+void fimgCompatSetLightModelAmbient(fimgContext *ctx, const float *rgba)
+{
+	memcpy(ctx->compat.lighting.modelAmbient, rgba, 4*sizeof(float));
+	ctx->compat.lighting.dirty = 1;
+}
+
+/*
+ * Fog and user clip planes
+ */
+
+void fimgCompatSetFogMode(fimgContext *ctx, fimgFogMode mode)
+{
+	FGFP_BITFIELD_SET(ctx->compat.vsState.vs, VS_FOG_MODE, mode);
+	FGFP_BITFIELD_SET(ctx->compat.psState.ps, PS_FOG,
+						mode != FGFP_FOG_NONE);
+}
+
+void fimgCompatSetFogParams(fimgContext *ctx,
+				float density, float start, float end)
+{
+	ctx->compat.fog.density = density;
+	ctx->compat.fog.start = start;
+	ctx->compat.fog.end = end;
+	ctx->compat.fog.dirty = 1;
+}
+
+void fimgCompatSetFogColor(fimgContext *ctx, const float *rgba)
+{
+	memcpy(ctx->compat.fog.color, rgba, sizeof(ctx->compat.fog.color));
+	ctx->compat.fog.colorDirty = 1;
+}
+
+void fimgCompatSetClipPlaneEnable(fimgContext *ctx, uint32_t plane,
+								int enable)
+{
+	FGFP_BITFIELD_SET_IDX(ctx->compat.vsState.vs, VS_CLIP_EN,
+							plane, !!enable);
+	FGFP_BITFIELD_SET_IDX(ctx->compat.psState.ps, PS_CLIP_EN,
+							plane, !!enable);
+	ctx->compat.clip.dirty = 1;
+}
+
+void fimgCompatSetClipPlane(fimgContext *ctx, uint32_t plane,
+							const float *equation)
+{
+	memcpy(ctx->compat.clip.equation[plane], equation, 4*sizeof(float));
+	ctx->compat.clip.dirty = 1;
+}
+
+static void initLighting(fimgLightingCompat *lighting)
+{
+	static const float ambient[4] = { 0.2f, 0.2f, 0.2f, 1.0f };
+	static const float diffuse[4] = { 0.8f, 0.8f, 0.8f, 1.0f };
+	static const float black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	static const float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	uint32_t i;
+
+	for (i = 0; i < FIMG_NUM_LIGHTS; ++i) {
+		fimgLightCompat *l = &lighting->light[i];
+
+		memcpy(l->ambient, black, sizeof(l->ambient));
+		memcpy(l->diffuse, i ? black : white, sizeof(l->diffuse));
+		memcpy(l->specular, i ? black : white, sizeof(l->specular));
+		l->position[2] = 1.0f;
+		l->direction[2] = -1.0f;
+		l->cutoff = 180.0f;
+		l->attenuation[0] = 1.0f;
+	}
+
+	memcpy(lighting->ambient, ambient, sizeof(lighting->ambient));
+	memcpy(lighting->diffuse, diffuse, sizeof(lighting->diffuse));
+	memcpy(lighting->specular, black, sizeof(lighting->specular));
+	memcpy(lighting->emission, black, sizeof(lighting->emission));
+	memcpy(lighting->modelAmbient, ambient, sizeof(lighting->modelAmbient));
+	lighting->dirty = 1;
+}
+
 void fimgCreateCompatContext(fimgContext *ctx)
 {
 	uint32_t unit;
@@ -1230,15 +2414,29 @@ void fimgCreateCompatContext(fimgContext *ctx)
 		ctx->compat.psState.tex[unit] = reg;
 	}
 
-	for (unit = 0; unit < VS_CACHE_SIZE; ++unit)
-		FGFP_BITFIELD_SET(ctx->compat.vertexShaders[unit].state.vs,
-								VS_INVALID, 1);
-
-	for (unit = 0; unit < PS_CACHE_SIZE; ++unit)
-		FGFP_BITFIELD_SET(ctx->compat.pixelShaders[unit].state.ps,
-								PS_INVALID, 1);
+	initShaderCache(&ctx->compat.vsCache, NELEM(ctx->compat.vsState.val),
+					MAX_VS_INSTR, FIMG_VS_CACHE_SIZE);
+	initShaderCache(&ctx->compat.psCache, NELEM(ctx->compat.psState.val),
+					MAX_PS_INSTR, FIMG_PS_CACHE_SIZE);
 
 	ctx->compat.psMask[FIMG_NUM_TEXTURE_UNITS] = 0xffffffff;
+
+	invalidateConsts(&ctx->compat.vsConst);
+	invalidateConsts(&ctx->compat.psConst);
+
+	initLighting(&ctx->compat.lighting);
+	updateVertexShaderMask(ctx);
+
+	ctx->compat.fog.density = 1.0f;
+	ctx->compat.fog.end = 1.0f;
+	ctx->compat.fog.dirty = 1;
+	ctx->compat.fog.colorDirty = 1;
+}
+
+void fimgDestroyCompatContext(fimgContext *ctx)
+{
+	destroyShaderCache(&ctx->compat.vsCache);
+	destroyShaderCache(&ctx->compat.psCache);
 }
 
 #define FGFP_TEXENV(unit)	(4 + 2*(unit))
@@ -1256,166 +2454,256 @@ static void setPSConstBool(fimgContext *ctx, int val, uint32_t slot)
 }
 #endif
 
-static void loadPSConstFloat(fimgContext *ctx, const float *pfData,
-								uint32_t slot)
+static void normalize3(float *v)
 {
-	const uint32_t *data = (const uint32_t *)pfData;
-	volatile uint32_t *reg = (volatile uint32_t *)(ctx->base
-						+ FGPS_CFLOAT_START + 16*slot);
-#if 0
-	asm ( 	"ldmia %0!, {r0-r3}"
-		"stmia %1!, {r0-r3}"
-		: "=r"(data), "=r"(reg)
-		: "0"(data), "1"(reg)
-		: "r0", "r1", "r2", "r3");
-#else
-	*(reg++) = *(data++);
-	*(reg++) = *(data++);
-	*(reg++) = *(data++);
-	*(reg++) = *(data++);
-#endif
+	float len = sqrtf(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+
+	if (len == 0.0f)
+		return;
+
+	v[0] /= len;
+	v[1] /= len;
+	v[2] /= len;
 }
 
-static void loadVSMatrix(fimgContext *ctx, const float *pfData, uint32_t slot)
+/*****************************************************************************
+ * FUNCTION:	loadLightingConsts
+ * SYNOPSIS:	This function loads lighting parameters into const float
+ *		registers of vertex shader. Products of light and material
+ *		colors, which are constant per draw, are computed here.
+ * ARGUMENTS:	ctx - hardware context
+ *****************************************************************************/
+static void loadLightingConsts(fimgContext *ctx)
 {
-	uint32_t i;
-	const uint32_t *data = (const uint32_t *)pfData;
-	volatile uint32_t *reg = (volatile uint32_t *)(ctx->base
-						+ FGVS_CFLOAT_START + 16*slot);
-	for (i = 0; i < 4; i++) {
-#if 0
-		asm ( 	"ldmia %0!, {r0-r3}"
-			"stmia %1!, {r0-r3}"
-			: "=r"(data), "=r"(reg)
-			: "0"(data), "1"(reg)
-			: "r0", "r1", "r2", "r3");
-#else
-		*(reg++) = *(data++);
-		*(reg++) = *(data++);
-		*(reg++) = *(data++);
-		*(reg++) = *(data++);
-#endif
+	fimgLightingCompat *lighting = &ctx->compat.lighting;
+	uint32_t cm = FGFP_BITFIELD_GET(ctx->compat.vsState.vs,
+							VS_COLOR_MATERIAL);
+	float c[4];
+	uint32_t i, j;
+
+	for (j = 0; j < 3; ++j)
+		c[j] = lighting->emission[j]
+				+ lighting->ambient[j]*lighting->modelAmbient[j];
+	c[3] = lighting->diffuse[3];
+	queueVSConstFloat(ctx, c, FGFP_SCENE_COLOR);
+	queueVSConstFloat(ctx, lighting->emission, FGFP_MATERIAL_EMISSION);
+	queueVSConstFloat(ctx, lighting->modelAmbient, FGFP_MODEL_AMBIENT);
+
+	c[0] = lighting->shininess;
+	c[1] = 0.0f;
+	c[2] = 1.0f;
+	c[3] = 0.0f;
+	queueVSConstFloat(ctx, c, FGFP_LIGHTING_PARAMS);
+
+	for (i = 0; i < FIMG_NUM_LIGHTS; ++i) {
+		fimgLightCompat *l = &lighting->light[i];
+		uint32_t base = FGFP_LIGHT(i);
+
+		if (!FGFP_BITFIELD_GET_IDX(ctx->compat.vsState.light, LIGHT_EN, i))
+			continue;
+
+		memcpy(c, l->position, sizeof(c));
+		if (c[3] == 0.0f)
+			normalize3(c);
+		queueVSConstFloat(ctx, c, base + FGFP_LC_POSITION);
+
+		/* Half vector of directional light does not depend on vertex */
+		c[2] += 1.0f;
+		normalize3(c);
+		queueVSConstFloat(ctx, c, base + FGFP_LC_HALF_VECTOR);
+
+		for (j = 0; j < 4; ++j)
+			c[j] = cm ? l->ambient[j]
+					: l->ambient[j]*lighting->ambient[j];
+		queueVSConstFloat(ctx, c, base + FGFP_LC_AMBIENT);
+
+		for (j = 0; j < 4; ++j)
+			c[j] = cm ? l->diffuse[j]
+					: l->diffuse[j]*lighting->diffuse[j];
+		queueVSConstFloat(ctx, c, base + FGFP_LC_DIFFUSE);
+
+		for (j = 0; j < 4; ++j)
+			c[j] = l->specular[j]*lighting->specular[j];
+		queueVSConstFloat(ctx, c, base + FGFP_LC_SPECULAR);
+
+		memcpy(c, l->direction, 3*sizeof(float));
+		normalize3(c);
+		c[3] = cosf(l->cutoff * (float)M_PI / 180.0f);
+		queueVSConstFloat(ctx, c, base + FGFP_LC_SPOT);
+
+		memcpy(c, l->attenuation, 3*sizeof(float));
+		c[3] = l->exponent;
+		queueVSConstFloat(ctx, c, base + FGFP_LC_ATTENUATION);
 	}
 }
 
-static int compareVertexShaders(fimgContext *ctx,
-			fimgVertexShaderState *a, fimgVertexShaderState *b)
+/* Vertex shader constants of fog and clip planes (see shaders/vert.asm) */
+#define FGFP_FOG_PARAMS		88
+#define FGFP_CLIP_PLANE(i)	(89 + (i))
+
+/* Pixel shader constant of fog color (see shaders/frag.asm) */
+#define FGFP_FOG_COLOR		8
+
+static void loadFogConsts(fimgContext *ctx)
 {
-	return a->val[0] != b->val[0];
-}
+	fimgFogCompat *fog = &ctx->compat.fog;
+	float c[4];
+
+	/* Empty linear fog range leaves fragments unfogged */
+	if (fog->end != fog->start) {
+		c[0] = -1.0f / (fog->end - fog->start);
+		c[1] = fog->end / (fog->end - fog->start);
+	} else {
+		c[0] = 0.0f;
+		c[1] = 1.0f;
+	}
 
-#define NELEM(i)	(sizeof(i)/sizeof(*i))
+	/* Shader computes powers of two */
+	c[2] = -fog->density * (float)M_LOG2E;
+	c[3] = fog->density * sqrtf((float)M_LOG2E);
+
+	queueVSConstFloat(ctx, c, FGFP_FOG_PARAMS);
+}
 
-static int comparePixelShaders(fimgContext *ctx,
-			fimgPixelShaderState *a, fimgPixelShaderState *b)
+/*****************************************************************************
+ * FUNCTION:	loadClipPlanes
+ * SYNOPSIS:	This function loads equations of enabled clip planes into
+ *		const float registers of vertex shader. Planes are transformed
+ *		to object coordinates, so the shader needs one instruction
+ *		per plane instead of transforming vertices to eye coordinates.
+ * ARGUMENTS:	ctx - hardware context
+ *****************************************************************************/
+static void loadClipPlanes(fimgContext *ctx)
 {
-	unsigned int i;
+	const float *m = ctx->compat.matrix[FGFP_MATRIX_MODELVIEW];
+	float c[4];
+	uint32_t i, j;
 
-	for (i = 0; i < NELEM(a->val); ++i)
-		if ((a->val[i] ^ b->val[i]) & ctx->compat.psMask[i])
-			return 1;
+	for (i = 0; i < FIMG_NUM_CLIP_PLANES; ++i) {
+		const float *p = ctx->compat.clip.equation[i];
 
-	return 0;
+		if (!FGFP_BITFIELD_GET_IDX(ctx->compat.vsState.vs, VS_CLIP_EN, i))
+			continue;
+
+		/* Plane times modelview matrix (column-major) */
+		for (j = 0; j < 4; ++j)
+			c[j] = p[0]*m[4*j] + p[1]*m[4*j + 1]
+				+ p[2]*m[4*j + 2] + p[3]*m[4*j + 3];
+
+		queueVSConstFloat(ctx, c, FGFP_CLIP_PLANE(i));
+	}
 }
 
 static void validateVertexShader(fimgContext *ctx)
 {
+	fimgShaderCache *cache = &ctx->compat.vsCache;
+	uint32_t key[FIMG_SHADER_KEY_LEN];
+	fimgShaderCacheEntry *vs = cache->current;
+	uint32_t hash;
 	unsigned int i;
-	int ret;
-#ifdef FIMG_SHADER_CACHE_STATS
-	if (++ctx->compat.vsStatsCounter == 128) {
-		ALOGD("Vertex shader cache stats:");
-		ALOGD("Same hits: %d\n", ctx->compat.vsSameHits);
-		ALOGD("Cache hits: %d\n", ctx->compat.vsCacheHits);
-		ALOGD("Misses: %d\n", ctx->compat.vsMisses);
-		ctx->compat.vsSameHits = 0;
-		ctx->compat.vsCacheHits = 0;
-		ctx->compat.vsMisses = 0;
-		ctx->compat.vsStatsCounter = 0;
-	}
-#endif
-	ret = compareVertexShaders(ctx, &ctx->compat.vsState,
-			&ctx->compat.vertexShaders[ctx->compat.curVsNum].state);
-	if (!ret) {
-#ifdef FIMG_SHADER_CACHE_STATS
-		++ctx->compat.vsSameHits;
-#endif
+
+	/* Bits ignored by generated code must not cause misses */
+	for (i = 0; i < cache->keyLen; ++i)
+		key[i] = ctx->compat.vsState.val[i] & ctx->compat.vsMask[i];
+
+	if (vs && !memcmp(vs->key, key, cache->keyLen * sizeof(*key))) {
+		++ctx->stats.vsSameHits;
 		return;
 	}
 
 	ctx->compat.vshaderLoaded = 0;
 
-	for (i = 0; i < VS_CACHE_SIZE; ++i) {
-		if (i == ctx->compat.curVsNum)
-			continue;
-		ret = compareVertexShaders(ctx, &ctx->compat.vsState,
-					&ctx->compat.vertexShaders[i].state);
-		if (!ret) {
-#ifdef FIMG_SHADER_CACHE_STATS
-			++ctx->compat.vsCacheHits;
-#endif
-			ctx->compat.curVsNum = i;
-			return;
-		}
+	hash = hashShaderKey(key, cache->keyLen);
+	vs = lookupShader(cache, key, hash);
+	if (vs) {
+		++ctx->stats.vsCacheHits;
+		cache->current = vs;
+		return;
 	}
-#ifdef FIMG_SHADER_CACHE_STATS
-	++ctx->compat.vsMisses;
-#endif
-	i = ctx->compat.vsEvictCounter++;
-	ctx->compat.vsEvictCounter %= VS_CACHE_SIZE;
 
-	fimgCompatBuildVertexShader(ctx, i);
-	ctx->compat.curVsNum = i;
+	++ctx->stats.vsMisses;
+	if (cache->count == cache->capacity)
+		++ctx->stats.vsEvictions;
+
+	vs = allocShader(cache, key, hash);
+	cache->current = vs;
+#ifdef FIMG_SHADER_DISK_CACHE
+	vs->instrCount = fimgLoadCachedShader(FIMG_CACHED_VSHADER,
+			key, cache->keyLen, vs->code, cache->maxInstr);
+	if (vs->instrCount) {
+		++ctx->stats.shaderDiskHits;
+		return;
+	}
+#endif
+	fimgCompatBuildVertexShader(ctx, vs);
+#ifdef FIMG_SHADER_DISK_CACHE
+	fimgStoreCachedShader(FIMG_CACHED_VSHADER, key, cache->keyLen,
+						vs->code, vs->instrCount);
+#endif
 }
 
 static void validatePixelShader(fimgContext *ctx)
 {
+	fimgShaderCache *cache = &ctx->compat.psCache;
+	uint32_t key[FIMG_SHADER_KEY_LEN];
+	fimgShaderCacheEntry *ps = cache->current;
+	uint32_t hash;
 	unsigned int i;
-	int ret;
-#ifdef FIMG_SHADER_CACHE_STATS
-	if (++ctx->compat.psStatsCounter == 128) {
-		ALOGD("Pixel shader cache stats:");
-		ALOGD("Same hits: %d\n", ctx->compat.psSameHits);
-		ALOGD("Cache hits: %d\n", ctx->compat.psCacheHits);
-		ALOGD("Misses: %d\n", ctx->compat.psMisses);
-		ctx->compat.psSameHits = 0;
-		ctx->compat.psCacheHits = 0;
-		ctx->compat.psMisses = 0;
-		ctx->compat.psStatsCounter = 0;
-	}
-#endif
-	ret = comparePixelShaders(ctx, &ctx->compat.psState,
-			&ctx->compat.pixelShaders[ctx->compat.curPsNum].state);
-	if (!ret) {
-#ifdef FIMG_SHADER_CACHE_STATS
-		++ctx->compat.psSameHits;
-#endif
+
+	/* Bits ignored by the texture function must not cause misses */
+	for (i = 0; i < cache->keyLen; ++i)
+		key[i] = ctx->compat.psState.val[i] & ctx->compat.psMask[i];
+
+	if (ps && !memcmp(ps->key, key, cache->keyLen * sizeof(*key))) {
+		++ctx->stats.psSameHits;
 		return;
 	}
 
 	ctx->compat.pshaderLoaded = 0;
 
-	for (i = 0; i < PS_CACHE_SIZE; ++i) {
-		if (i == ctx->compat.curPsNum)
-			continue;
-		ret = comparePixelShaders(ctx, &ctx->compat.psState,
-					&ctx->compat.pixelShaders[i].state);
-		if (!ret) {
-#ifdef FIMG_SHADER_CACHE_STATS
-			++ctx->compat.psCacheHits;
-#endif
-			ctx->compat.curPsNum = i;
-			return;
-		}
+	hash = hashShaderKey(key, cache->keyLen);
+	ps = lookupShader(cache, key, hash);
+	if (ps) {
+		++ctx->stats.psCacheHits;
+		cache->current = ps;
+		return;
+	}
+
+	++ctx->stats.psMisses;
+	if (cache->count == cache->capacity)
+		++ctx->stats.psEvictions;
+
+	ps = allocShader(cache, key, hash);
+	cache->current = ps;
+#ifdef FIMG_SHADER_DISK_CACHE
+	ps->instrCount = fimgLoadCachedShader(FIMG_CACHED_PSHADER,
+			key, cache->keyLen, ps->code, cache->maxInstr);
+	if (ps->instrCount) {
+		++ctx->stats.shaderDiskHits;
+		return;
 	}
-#ifdef FIMG_SHADER_CACHE_STATS
-	++ctx->compat.psMisses;
 #endif
-	i = ctx->compat.psEvictCounter++;
-	ctx->compat.psEvictCounter %= PS_CACHE_SIZE;
+	fimgCompatBuildPixelShader(ctx, ps);
+#ifdef FIMG_SHADER_DISK_CACHE
+	fimgStoreCachedShader(FIMG_CACHED_PSHADER, key, cache->keyLen,
+						ps->code, ps->instrCount);
+#endif
+}
 
-	fimgCompatBuildPixelShader(ctx, i);
-	ctx->compat.curPsNum = i;
+/*
+ * Texture units share single palette, so with different palettes used
+ * at the same time, only the one of the last unit is loaded.
+ */
+static void loadTexturePalette(fimgContext *ctx, fimgTexture *tex)
+{
+	if (!tex->paletteSize || tex->paletteId == ctx->compat.paletteId)
+		return;
+
+	fimgSelectiveFlush(ctx, FGHI_HAZARD_TEXTURE);
+	fimgLoadTexPalette(ctx, tex);
+	fimgTouchBlocks(ctx, FIMG_BLOCK_BIT(FIMG_BLOCK_TEXTURE));
+
+	ctx->compat.paletteId = tex->paletteId;
 }
 
 void fimgCompatFlush(fimgContext *ctx)
@@ -1425,21 +2713,52 @@ void fimgCompatFlush(fimgContext *ctx)
 
 	validateVertexShader(ctx);
 	if (!ctx->compat.vshaderLoaded) {
+		fimgSelectiveFlush(ctx, FGHI_HAZARD_VSHADER);
 		fimgCompatLoadVertexShader(ctx);
 		setVertexShaderAttribCount(ctx, ctx->numAttribs);
 		ctx->compat.vshaderLoaded = 1;
+		fimgTouchBlocks(ctx, FIMG_BLOCK_BIT(FIMG_BLOCK_VSHADER));
+	}
+
+	/* Depends on modelview matrix, so before it is marked clean */
+	if ((ctx->compat.vsState.vs & FGFP_VS_CLIP_MASK)
+	    && (ctx->compat.clip.dirty
+	    || ctx->compat.matrixDirty[FGFP_MATRIX_MODELVIEW])
+	    && ctx->compat.matrix[FGFP_MATRIX_MODELVIEW] != NULL) {
+		loadClipPlanes(ctx);
+		ctx->compat.clip.dirty = 0;
 	}
 
-	for (i = 0; i < 2 + FIMG_NUM_TEXTURE_UNITS; i++) {
+	for (i = 0; i < FGFP_NUM_MATRICES; i++) {
 		if (!ctx->compat.matrixDirty[i] || ctx->compat.matrix[i] == NULL)
 			continue;
 
-		loadVSMatrix(ctx, ctx->compat.matrix[i], 4*i);
+		queueVSMatrix(ctx, ctx->compat.matrix[i], 4*i);
 		ctx->compat.matrixDirty[i] = 0;
 	}
 
+	if (FGFP_BITFIELD_GET(ctx->compat.vsState.vs, VS_LIGHTING)
+	    && ctx->compat.lighting.dirty) {
+		loadLightingConsts(ctx);
+		ctx->compat.lighting.dirty = 0;
+	}
+
+	if (FGFP_BITFIELD_GET(ctx->compat.vsState.vs, VS_FOG_MODE)
+	    && ctx->compat.fog.dirty) {
+		loadFogConsts(ctx);
+		ctx->compat.fog.dirty = 0;
+	}
+
+	if (constsPending(&ctx->compat.vsConst)) {
+		fimgSelectiveFlush(ctx, FGHI_HAZARD_VSHADER);
+		writeConsts(ctx, &ctx->compat.vsConst, FGCS_VS_SLOTS,
+							FGVS_CFLOAT_START);
+		fimgTouchBlocks(ctx, FIMG_BLOCK_BIT(FIMG_BLOCK_VSHADER));
+	}
+
 	validatePixelShader(ctx);
 	if (!ctx->compat.pshaderLoaded) {
+		fimgSelectiveFlush(ctx, FGHI_HAZARD_PSHADER);
 		setPixelShaderState(ctx, 0);
 		fimgCompatLoadPixelShader(ctx);
 		psStopped = 1;
@@ -1454,39 +2773,69 @@ void fimgCompatFlush(fimgContext *ctx)
 			continue;
 
 		fimgSetupTexture(ctx, ctx->compat.texture[i].texture, i);
+		loadTexturePalette(ctx, ctx->compat.texture[i].texture);
 
 		if (!ctx->compat.texture[i].dirty)
 			continue;
 
+		queuePSConstFloat(ctx, ctx->compat.texture[i].env,
+							FGFP_TEXENV(i));
+		queuePSConstFloat(ctx, ctx->compat.texture[i].scale,
+							FGFP_COMBSCALE(i));
+
+		ctx->compat.texture[i].dirty = 0;
+	}
+
+	if (FGFP_BITFIELD_GET(ctx->compat.psState.ps, PS_FOG)
+	    && ctx->compat.fog.colorDirty) {
+		queuePSConstFloat(ctx, ctx->compat.fog.color, FGFP_FOG_COLOR);
+		ctx->compat.fog.colorDirty = 0;
+	}
+
+	/* Pixel shader is paused only if some constant really changed */
+	if (constsPending(&ctx->compat.psConst)) {
 		if (!psStopped) {
+			fimgSelectiveFlush(ctx, FGHI_HAZARD_PSHADER);
 			setPixelShaderState(ctx, 0);
 			psStopped = 1;
 		}
 
-		loadPSConstFloat(ctx, ctx->compat.texture[i].env,
-							FGFP_TEXENV(i));
-		loadPSConstFloat(ctx, ctx->compat.texture[i].scale,
-							FGFP_COMBSCALE(i));
-
-		ctx->compat.texture[i].dirty = 0;
+		writeConsts(ctx, &ctx->compat.psConst, FGCS_PS_SLOTS,
+							FGPS_CFLOAT_START);
 	}
 
 	if (psStopped) {
 		setPixelShaderAttribCount(ctx, FIMG_ATTRIB_NUM - 1);
 		setPixelShaderState(ctx, 1);
+		fimgTouchBlocks(ctx, FIMG_BLOCK_BIT(FIMG_BLOCK_PSHADER));
 	}
 }
 
-void fimgRestoreCompatState(fimgContext *ctx)
+/* Shaders of blocks still tagged with our owner ID stay resident */
+void fimgRestoreCompatState(fimgContext *ctx, uint32_t blocks)
 {
 	uint32_t i;
 
-	for (i = 0; i < 2 + FIMG_NUM_TEXTURE_UNITS; i++)
-		ctx->compat.matrixDirty[i] = 1;
+	if (blocks & FIMG_BLOCK_BIT(FIMG_BLOCK_VSHADER)) {
+		for (i = 0; i < FGFP_NUM_MATRICES; i++)
+			ctx->compat.matrixDirty[i] = 1;
 
-	for (i = 0; i < FIMG_NUM_TEXTURE_UNITS; i++)
-		ctx->compat.texture[i].dirty = 1;
+		ctx->compat.lighting.dirty = 1;
+		ctx->compat.fog.dirty = 1;
+		ctx->compat.clip.dirty = 1;
+		ctx->compat.vshaderLoaded = 0;
+		invalidateConsts(&ctx->compat.vsConst);
+	}
 
-	ctx->compat.vshaderLoaded = 0;
-	ctx->compat.pshaderLoaded = 0;
+	if (blocks & FIMG_BLOCK_BIT(FIMG_BLOCK_TEXTURE))
+		ctx->compat.paletteId = 0;
+
+	if (blocks & FIMG_BLOCK_BIT(FIMG_BLOCK_PSHADER)) {
+		for (i = 0; i < FIMG_NUM_TEXTURE_UNITS; i++)
+			ctx->compat.texture[i].dirty = 1;
+
+		ctx->compat.fog.colorDirty = 1;
+		ctx->compat.pshaderLoaded = 0;
+		invalidateConsts(&ctx->compat.psConst);
+	}
 }
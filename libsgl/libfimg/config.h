@@ -46,10 +46,38 @@
 /* Dump generated shaders */
 //#define FIMG_DYNSHADER_DEBUG
 
-/* Show shader cache hit/miss statistics in log */
-//#define FIMG_SHADER_CACHE_STATS
-
 /* Disable shader optimizer */
 //#define FIMG_BYPASS_SHADER_OPTIMIZER
 
+/* Wait only for vertex buffer instead of whole pipeline between batches */
+#define FIMG_SELECTIVE_VERTEX_FLUSH
+
+/* Send only unique vertices of indexed triangle lists */
+#define FIMG_INDEXED_VERTEX_REUSE
+
+/* Timeout of waits for the hardware in milliseconds */
+#define FIMG_WAIT_TIMEOUT		1000
+
+/* Check expiry of hardware lease every given number of draws */
+#define FIMG_LEASE_CHECK_INTERVAL	8
+
+/* Number of generated fixed pipeline shaders kept in host memory */
+#define FIMG_VS_CACHE_SIZE		16
+#define FIMG_PS_CACHE_SIZE		64
+
+/* Keep generated shaders in per-user subdirectories of given directory
+   (only when the build system identifies the sources with FIMG_BUILD_ID) */
+#ifdef FIMG_BUILD_ID
+#define FIMG_SHADER_DISK_CACHE
+#endif
+#ifdef FGL_PLATFORM_ANDROID
+#define FIMG_SHADER_CACHE_DIR		"/data/fimg"
+#else
+#define FIMG_SHADER_CACHE_DIR		"/tmp"
+#endif
+#define FIMG_SHADER_CACHE_MAX_SIZE	(1024 * 1024)
+
+/* Emulate the hardware on CPU (normally enabled by the build system) */
+//#define FIMG_SOFTWARE_BACKEND
+
 #endif /* _FIMG_CONFIG_H_ */
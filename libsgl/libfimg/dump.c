@@ -144,3 +144,72 @@ void fimgDumpState(fimgContext *ctx, unsigned mode, unsigned count, const char *
 #endif
 #endif
 }
+
+/*****************************************************************************
+ * FUNCTION:	fimgGetStats
+ * SYNOPSIS:	This function retrieves hot path counters of given context
+ * ARGUMENTS:	stats - structure to be filled with counter values
+ *****************************************************************************/
+void fimgGetStats(fimgContext *ctx, fimgStats *stats)
+{
+	memcpy(stats, &ctx->stats, sizeof(*stats));
+}
+
+/*****************************************************************************
+ * FUNCTION:	fimgResetStats
+ * SYNOPSIS:	This function zeroes hot path counters of given context
+ *****************************************************************************/
+void fimgResetStats(fimgContext *ctx)
+{
+	memset(&ctx->stats, 0, sizeof(ctx->stats));
+	ctx->stats.startTime = fimgGetTime();
+}
+
+/*****************************************************************************
+ * FUNCTION:	fimgCountMergedDraws
+ * SYNOPSIS:	This function counts a submission of draws merged together
+ *		by the caller
+ * ARGUMENTS:	draws - number of merged draws
+ *****************************************************************************/
+void fimgCountMergedDraws(fimgContext *ctx, uint32_t draws)
+{
+	ctx->stats.mergedDraws += draws;
+	++ctx->stats.mergedSubmits;
+}
+
+/*****************************************************************************
+ * FUNCTION:	fimgDumpStats
+ * SYNOPSIS:	This function prints hot path counters of given context to log
+ * ARGUMENTS:	prefix - string identifying the dump
+ *****************************************************************************/
+void fimgDumpStats(fimgContext *ctx, const char *prefix)
+{
+	const fimgStats *s = &ctx->stats;
+	uint64_t elapsed = fimgGetTime() - s->startTime;
+
+	ALOGI("%s: batches %u, packed %llu B, uploaded %llu B",
+		prefix, s->batches, (unsigned long long)s->bytesPacked,
+		(unsigned long long)s->bytesUploaded);
+	ALOGI("%s: draws %u merged into %u submissions",
+		prefix, s->mergedDraws, s->mergedSubmits);
+	ALOGI("%s: flush waits %u (%u slept, %llu us), locks %u, "
+		"lease expiries %u, restores %u", prefix, s->flushWaits,
+		s->flushSleeps, (unsigned long long)s->flushWaitTime / 1000,
+		s->lockAcquisitions, s->leaseExpiries, s->contextRestores);
+	ALOGI("%s: restores %llu/s, blocks restored %u, kept %u",
+		prefix, elapsed ? (unsigned long long)s->contextRestores
+					* 1000000000ULL / elapsed : 0ULL,
+		s->blockRestores, s->blockRestoresSkipped);
+	ALOGI("%s: fence waits %u, already signaled %u",
+		prefix, s->fenceWaits, s->fenceWaitsSkipped);
+	ALOGI("%s: register writes %u, redundant writes skipped %u",
+		prefix, s->registerWrites, s->registerSkips);
+	ALOGI("%s: shader consts written %u, unchanged skipped %u",
+		prefix, s->constWrites, s->constSkips);
+	ALOGI("%s: VS same %u, hits %u, misses %u, evicted %u; "
+		"PS same %u, hits %u, misses %u, evicted %u; "
+		"tex cache inval %u", prefix, s->vsSameHits, s->vsCacheHits,
+		s->vsMisses, s->vsEvictions, s->psSameHits, s->psCacheHits,
+		s->psMisses, s->psEvictions, s->texCacheInvalidations);
+	ALOGI("%s: shaders loaded from disk %u", prefix, s->shaderDiskHits);
+}
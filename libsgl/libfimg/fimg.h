@@ -67,6 +67,10 @@ int fimgFlushCache(fimgContext *ctx,
 int fimgWaitForCacheFlush(fimgContext *ctx,
 				unsigned int ccflush, unsigned int zcflush);
 void fimgFinish(fimgContext *ctx);
+uint32_t fimgGetFence(fimgContext *ctx);
+int fimgFenceSignaled(fimgContext *ctx, uint32_t fence);
+int fimgPollFence(fimgContext *ctx, uint32_t fence);
+void fimgWaitFence(fimgContext *ctx, uint32_t fence);
 void fimgSoftReset(fimgContext *ctx);
 void fimgGetVersion(fimgContext *ctx, int *major, int *minor, int *rev);
 unsigned int fimgGetInterrupt(fimgContext *ctx);
@@ -124,6 +128,19 @@ void fimgSetAttribute(fimgContext *ctx,
 		      unsigned int numComp);
 void fimgSetAttribCount(fimgContext *ctx, unsigned char count);
 
+/* Cache of packed vertex batches for static geometry */
+typedef struct _fimgVertexCache fimgVertexCache;
+
+fimgVertexCache *fimgCreateVertexCache(void);
+void fimgInvalidateVertexCache(fimgVertexCache *vc);
+void fimgDestroyVertexCache(fimgVertexCache *vc);
+void fimgDrawArraysCached(fimgContext *ctx, fimgVertexCache *vc,
+		unsigned int mode, fimgArray *arrays, unsigned int count);
+
+/* Triangle list reordering for better vertex reuse */
+void fimgOptimizeTrianglesUByteIdx(uint8_t *indices, unsigned int count);
+void fimgOptimizeTrianglesUShortIdx(uint16_t *indices, unsigned int count);
+
 /*
  * Primitive Engine
  */
@@ -216,6 +233,7 @@ int fimgLoadPShader(fimgContext *ctx,
  */
 
 #define FGTU_MAX_MIPMAP_LEVEL	11
+#define FGTU_PALETTE_ENTRIES	256
 
 /* Type definitions */
 enum {
@@ -318,6 +336,8 @@ void fimgSetTexMinFilter(fimgTexture *texture, unsigned mode);
 void fimgSetTexMagFilter(fimgTexture *texture, unsigned mode);
 void fimgSetTexMipmap(fimgTexture *texture, unsigned mode);
 void fimgSetTexCoordSys(fimgTexture *texture, unsigned mode);
+int fimgSetTexPalette(fimgTexture *texture, unsigned int format,
+				const uint32_t *entries, unsigned int count);
 void fimgInvalidateTextureCache(fimgContext *ctx);
 
 /*
@@ -327,13 +347,17 @@ void fimgInvalidateTextureCache(fimgContext *ctx);
 #ifdef FIMG_FIXED_PIPELINE
 
 #define FIMG_NUM_TEXTURE_UNITS	2
+#define FIMG_NUM_LIGHTS		8
+#define FIMG_NUM_CLIP_PLANES	4
 
 typedef enum {
 	FGFP_MATRIX_TRANSFORM = 0,
 	FGFP_MATRIX_LIGHTING,
-	FGFP_MATRIX_TEXTURE
+	FGFP_MATRIX_TEXTURE,
+	FGFP_MATRIX_MODELVIEW = FGFP_MATRIX_TEXTURE + FIMG_NUM_TEXTURE_UNITS
 } fimgMatrix;
 #define FGFP_MATRIX_TEXTURE(i)	(FGFP_MATRIX_TEXTURE + (i))
+#define FGFP_NUM_MATRICES	(FGFP_MATRIX_MODELVIEW + 1)
 
 typedef enum {
 	FGFP_TEXFUNC_NONE = 0,
@@ -370,6 +394,20 @@ typedef enum {
 	FGFP_COMBARG_ONE_MINUS_SRC_ALPHA
 } fimgCombArgMod;
 
+typedef enum {
+	FGFP_LIGHT_AMBIENT = 0,
+	FGFP_LIGHT_DIFFUSE,
+	FGFP_LIGHT_SPECULAR,
+	FGFP_LIGHT_EMISSION
+} fimgLightColor;
+
+typedef enum {
+	FGFP_FOG_NONE = 0,
+	FGFP_FOG_LINEAR,
+	FGFP_FOG_EXP,
+	FGFP_FOG_EXP2
+} fimgFogMode;
+
 void fimgLoadMatrix(fimgContext *ctx, unsigned int matrix, const float *pData);
 void fimgEnableTexture(fimgContext *ctx, unsigned int unit);
 void fimgDisableTexture(fimgContext *ctx, unsigned int unit);
@@ -392,6 +430,30 @@ void fimgCompatSetAlphaScale(fimgContext *ctx, unsigned unit, float scale);
 void fimgCompatSetEnvColor(fimgContext *ctx, unsigned unit,
 					float r, float g, float b, float a);
 void fimgCompatSetupTexture(fimgContext *ctx, fimgTexture *tex, uint32_t unit);
+void fimgCompatSetLightingEnable(fimgContext *ctx, int enable);
+void fimgCompatSetColorMaterialEnable(fimgContext *ctx, int enable);
+void fimgCompatSetNormalizeEnable(fimgContext *ctx, int enable);
+void fimgCompatSetLightEnable(fimgContext *ctx, unsigned light, int enable);
+void fimgCompatSetLightColor(fimgContext *ctx, unsigned light,
+				fimgLightColor color, const float *rgba);
+void fimgCompatSetLightPosition(fimgContext *ctx, unsigned light,
+							const float *pos);
+void fimgCompatSetSpotLight(fimgContext *ctx, unsigned light,
+			const float *dir, float exponent, float cutoff);
+void fimgCompatSetLightAttenuation(fimgContext *ctx, unsigned light,
+			float constant, float linear, float quadratic);
+void fimgCompatSetMaterialColor(fimgContext *ctx, fimgLightColor color,
+							const float *rgba);
+void fimgCompatSetMaterialShininess(fimgContext *ctx, float shininess);
+void fimgCompatSetLightModelAmbient(fimgContext *ctx, const float *rgba);
+void fimgCompatSetFogMode(fimgContext *ctx, fimgFogMode mode);
+void fimgCompatSetFogParams(fimgContext *ctx,
+				float density, float start, float end);
+void fimgCompatSetFogColor(fimgContext *ctx, const float *rgba);
+void fimgCompatSetClipPlaneEnable(fimgContext *ctx, unsigned plane,
+								int enable);
+void fimgCompatSetClipPlane(fimgContext *ctx, unsigned plane,
+							const float *equation);
 
 #endif
 
@@ -561,18 +623,76 @@ enum {
 	FIMG_DEPTH_FUNC
 };
 
+/*
+ * Statistics
+ */
+
+typedef struct _fimgStats {
+	uint64_t startTime;		/* of counting, in nanoseconds */
+	/* Vertex transfer */
+	uint32_t batches;
+	uint64_t bytesPacked;
+	uint64_t bytesUploaded;
+	uint32_t mergedDraws;		/* client draws queued by upper layer */
+	uint32_t mergedSubmits;		/* hardware submissions of them */
+	/* Synchronization with hardware */
+	uint32_t flushWaits;
+	uint32_t flushSleeps;
+	uint64_t flushWaitTime;		/* in nanoseconds */
+	uint32_t lockAcquisitions;
+	uint32_t leaseExpiries;
+	uint32_t contextRestores;
+	uint32_t blockRestores;
+	uint32_t blockRestoresSkipped;
+	uint32_t fenceWaits;
+	uint32_t fenceWaitsSkipped;
+	/* Register shadow */
+	uint32_t registerWrites;
+	uint32_t registerSkips;
+	uint32_t constWrites;		/* in vec4 registers */
+	uint32_t constSkips;
+	/* Caches */
+	uint32_t vsSameHits;
+	uint32_t vsCacheHits;
+	uint32_t vsMisses;
+	uint32_t vsEvictions;
+	uint32_t psSameHits;
+	uint32_t psCacheHits;
+	uint32_t psMisses;
+	uint32_t psEvictions;
+	uint32_t shaderDiskHits;
+	uint32_t texCacheInvalidations;
+} fimgStats;
+
+void fimgGetStats(fimgContext *ctx, fimgStats *stats);
+void fimgResetStats(fimgContext *ctx);
+void fimgDumpStats(fimgContext *ctx, const char *prefix);
+void fimgCountMergedDraws(fimgContext *ctx, uint32_t draws);
+
 /*
  * OS support
  */
 
 fimgContext *fimgCreateContext(void);
 void fimgDestroyContext(fimgContext *ctx);
-void fimgRestoreContext(fimgContext *ctx);
+void fimgRestoreContext(fimgContext *ctx, int reset);
 int fimgAcquireHardwareLock(fimgContext *ctx);
 int fimgReleaseHardwareLock(fimgContext *ctx);
+void fimgSetHardwareLease(fimgContext *ctx, unsigned int slice);
+void fimgEndHardwareLease(fimgContext *ctx);
 int fimgDeviceOpen(fimgContext *ctx);
 void fimgDeviceClose(fimgContext *ctx);
 int fimgWaitForFlush(fimgContext *ctx, uint32_t target);
+int fimgWaitForIdle(fimgContext *ctx, uint32_t pipeMask,
+				uint32_t cacheMask, unsigned int timeout);
+
+#ifdef FIMG_SOFTWARE_BACKEND
+/* Memory accessible by emulated hardware */
+void *fimgSoftAlloc(unsigned long size, unsigned long *paddr);
+void fimgSoftFree(void *vaddr);
+unsigned long fimgSoftMap(void *vaddr, unsigned long size);
+void fimgSoftUnmap(void *vaddr);
+#endif
 
 //=============================================================================
 
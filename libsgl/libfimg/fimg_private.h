@@ -23,14 +23,27 @@
 #define _FIMG_PRIVATE_H_
 
 /* Include public part */
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
+#include <sched.h>
+#include <time.h>
 #include "platform.h"
 #include "fimg.h"
 
 #define TRACE(a)	LOGD(#a); a
 
+/* Monotonic time in nanoseconds */
+static inline uint64_t fimgGetTime(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 #define likely(x)       __builtin_expect((x),1)
 #define unlikely(x)     __builtin_expect((x),0)
 
@@ -363,8 +376,17 @@ struct _fimgTexture {
 	unsigned int baseAddr;
 	unsigned int reserved1;
 	unsigned int reserved2;
+	/* Not mapped to registers, shared palette of the texture unit */
+	uint32_t *palette;
+	unsigned int paletteSize;
+	uint32_t paletteId;
 };
 
+/* Number of registers of single texture unit */
+#define FGTU_NUM_REGS		(offsetof(fimgTexture, palette) / 4)
+
+void fimgLoadTexPalette(fimgContext *ctx, const fimgTexture *texture);
+
 /*
  * Hardware context
  */
@@ -476,8 +498,10 @@ void fimgRestoreFragmentState(fimgContext *ctx);
 #define FGFP_TEX_COMBA_FUNC_MASK	(0x7 << 28)
 #define FGFP_PS_SWAP_SHIFT		(0)
 #define FGFP_PS_SWAP_MASK		(0x1 << 0)
-#define FGFP_PS_INVALID_SHIFT		(31)
-#define FGFP_PS_INVALID_MASK		(0x1 << 31)
+#define FGFP_PS_FOG_SHIFT		(1)
+#define FGFP_PS_FOG_MASK		(0x1 << 1)
+#define FGFP_PS_CLIP_EN_SHIFT(i)	(2 + (i))
+#define FGFP_PS_CLIP_EN_MASK(i)		(0x1 << (2 + (i)))
 
 typedef union _fimgPixelShaderState {
 	uint32_t val[FIMG_NUM_TEXTURE_UNITS + 1];
@@ -489,13 +513,33 @@ typedef union _fimgPixelShaderState {
 
 #define FGFP_VS_TEX_EN_SHIFT(i)		(i)
 #define FGFP_VS_TEX_EN_MASK(i)		(0x1 << (i))
-#define FGFP_VS_INVALID_SHIFT		(31)
-#define FGFP_VS_INVALID_MASK		(0x1 << 31)
+#define FGFP_VS_LIGHTING_SHIFT		(2)
+#define FGFP_VS_LIGHTING_MASK		(0x1 << 2)
+#define FGFP_VS_COLOR_MATERIAL_SHIFT	(3)
+#define FGFP_VS_COLOR_MATERIAL_MASK	(0x1 << 3)
+#define FGFP_VS_NORMALIZE_SHIFT		(4)
+#define FGFP_VS_NORMALIZE_MASK		(0x1 << 4)
+#define FGFP_VS_FOG_MODE_SHIFT		(5)
+#define FGFP_VS_FOG_MODE_MASK		(0x3 << 5)
+#define FGFP_VS_CLIP_EN_SHIFT(i)	(7 + (i))
+#define FGFP_VS_CLIP_EN_MASK(i)		(0x1 << (7 + (i)))
+#define FGFP_VS_CLIP_MASK		(0xf << 7)
+#define FGFP_LIGHT_SHIFT(i)		(4*(i))
+#define FGFP_LIGHT_MASK(i)		(0xf << (4*(i)))
+#define FGFP_LIGHT_EN_SHIFT(i)		(4*(i))
+#define FGFP_LIGHT_EN_MASK(i)		(0x1 << (4*(i)))
+#define FGFP_LIGHT_POSITIONAL_SHIFT(i)	(4*(i) + 1)
+#define FGFP_LIGHT_POSITIONAL_MASK(i)	(0x1 << (4*(i) + 1))
+#define FGFP_LIGHT_SPOT_SHIFT(i)	(4*(i) + 2)
+#define FGFP_LIGHT_SPOT_MASK(i)		(0x1 << (4*(i) + 2))
+#define FGFP_LIGHT_ATTENUATION_SHIFT(i)	(4*(i) + 3)
+#define FGFP_LIGHT_ATTENUATION_MASK(i)	(0x1 << (4*(i) + 3))
 
 typedef union _fimgVertexShaderState {
-	uint32_t val[1];
+	uint32_t val[2];
 	struct {
 		uint32_t vs;
+		uint32_t light;
 	};
 } fimgVertexShaderState;
 
@@ -506,59 +550,182 @@ typedef struct {
 	fimgTexture *texture;
 } fimgTextureCompat;
 
-typedef struct fimgPixelShaderProgram {
-	uint32_t instrCount;
-	fimgPixelShaderState state;
-} fimgPixelShaderProgram;
+typedef struct {
+	float ambient[4];
+	float diffuse[4];
+	float specular[4];
+	float position[4];
+	float direction[4];
+	float exponent;
+	float cutoff;
+	float attenuation[3];
+} fimgLightCompat;
 
-typedef struct fimgVertexShaderProgram {
+typedef struct {
+	int dirty;
+	fimgLightCompat light[FIMG_NUM_LIGHTS];
+	float ambient[4];
+	float diffuse[4];
+	float specular[4];
+	float emission[4];
+	float shininess;
+	float modelAmbient[4];
+} fimgLightingCompat;
+
+typedef struct {
+	int dirty;
+	int colorDirty;
+	float density;
+	float start;
+	float end;
+	float color[4];
+} fimgFogCompat;
+
+typedef struct {
+	int dirty;
+	/* In eye coordinates */
+	float equation[FIMG_NUM_CLIP_PLANES][4];
+} fimgClipCompat;
+
+/*
+ * Shader constant shadow
+ *
+ * Holds vec4 values requested for const float registers used by compat
+ * shaders, so only the ones which really change are written to hardware.
+ * Stale slots hold unknown values, e.g. after another context used them.
+ */
+#define FGCS_VS_SLOTS		96	/* c0 - c95 */
+#define FGCS_PS_SLOTS		16	/* c0 - c15 */
+#define FGCS_NUM_WORDS		((FGCS_VS_SLOTS + 31) / 32)
+
+typedef struct {
+	uint32_t value[FGCS_VS_SLOTS][4];
+	uint32_t dirty[FGCS_NUM_WORDS];
+	uint32_t stale[FGCS_NUM_WORDS];
+} fimgConstShadow;
+
+#define FIMG_SHADER_KEY_LEN		(FIMG_NUM_TEXTURE_UNITS + 1)
+#define FIMG_SHADER_CACHE_BUCKETS	64
+
+/* Generated program, keyed by (masked) shader state */
+typedef struct fimgShaderCacheEntry {
+	uint32_t key[FIMG_SHADER_KEY_LEN];
+	uint32_t hash;
 	uint32_t instrCount;
-	fimgVertexShaderState state;
-} fimgVertexShaderProgram;
+	uint32_t *code;
+	struct fimgShaderCacheEntry *hashNext;
+	struct fimgShaderCacheEntry *lruPrev;
+	struct fimgShaderCacheEntry *lruNext;
+} fimgShaderCacheEntry;
 
-#define VS_CACHE_SIZE	4
-#define PS_CACHE_SIZE	8
+typedef struct {
+	uint32_t		keyLen;
+	uint32_t		maxInstr;
+	uint32_t		capacity;
+	uint32_t		count;
+	fimgShaderCacheEntry	*entries;
+	uint32_t		*codeBuf;
+	fimgShaderCacheEntry	*current;
+	/* lru.lruNext is the most, lru.lruPrev the least recently used */
+	fimgShaderCacheEntry	lru;
+	fimgShaderCacheEntry	*buckets[FIMG_SHADER_CACHE_BUCKETS];
+} fimgShaderCache;
 
 typedef struct {
-	uint32_t		*vshaderBuf;
 	int			vshaderLoaded;
-	uint32_t		curVsNum;
-	uint32_t		vsEvictCounter;
+	uint32_t		vsMask[2];
 	fimgVertexShaderState	vsState;
-	fimgVertexShaderProgram	vertexShaders[VS_CACHE_SIZE];
-#ifdef FIMG_SHADER_CACHE_STATS
-	uint8_t			vsMisses;
-	uint8_t			vsSameHits;
-	uint8_t			vsCacheHits;
-	uint8_t			vsStatsCounter;
-#endif
+	fimgShaderCache		vsCache;
 
-	uint32_t		*pshaderBuf;
 	int			pshaderLoaded;
-	uint32_t		curPsNum;
-	uint32_t		psEvictCounter;
 	uint32_t		psMask[FIMG_NUM_TEXTURE_UNITS + 1];
 	fimgPixelShaderState	psState;
-	fimgPixelShaderProgram	pixelShaders[PS_CACHE_SIZE];
-#ifdef FIMG_SHADER_CACHE_STATS
-	uint8_t			psMisses;
-	uint8_t			psSameHits;
-	uint8_t			psCacheHits;
-	uint8_t			psStatsCounter;
-#endif
+	fimgShaderCache		psCache;
 
 	fimgTextureCompat	texture[FIMG_NUM_TEXTURE_UNITS];
+	fimgLightingCompat	lighting;
+	fimgFogCompat		fog;
+	fimgClipCompat		clip;
+
+	fimgConstShadow		vsConst;
+	fimgConstShadow		psConst;
 
-	int			matrixDirty[2 + FIMG_NUM_TEXTURE_UNITS];
-	const float		*matrix[2 + FIMG_NUM_TEXTURE_UNITS];
+	/* ID of palette loaded to the hardware, 0 if unknown */
+	uint32_t		paletteId;
+
+	int			matrixDirty[FGFP_NUM_MATRICES];
+	const float		*matrix[FGFP_NUM_MATRICES];
 } fimgCompatContext;
 
+#ifdef FIMG_SHADER_DISK_CACHE
+enum {
+	FIMG_CACHED_VSHADER = 0,
+	FIMG_CACHED_PSHADER
+};
+
+extern const char fimgShaderBuildId[];
+
+uint32_t fimgLoadCachedShader(uint32_t type, const uint32_t *key,
+			uint32_t keyLen, uint32_t *code, uint32_t maxInstr);
+void fimgStoreCachedShader(uint32_t type, const uint32_t *key,
+		uint32_t keyLen, const uint32_t *code, uint32_t instrCount);
+#endif
+
 void fimgCreateCompatContext(fimgContext *ctx);
-void fimgRestoreCompatState(fimgContext *ctx);
+void fimgDestroyCompatContext(fimgContext *ctx);
+void fimgRestoreCompatState(fimgContext *ctx, uint32_t blocks);
 void fimgCompatFlush(fimgContext *ctx);
 
 #endif
 
+typedef struct _fimgAttribPacker fimgAttribPacker;
+typedef struct _fimgReuseState fimgReuseState;
+
+/*
+ * Register shadow
+ *
+ * Covers the register windows which are set through fimgQueue*(). Every
+ * register has a slot holding requested value and value last written
+ * to the hardware, plus dirty and stale (hardware value unknown) bits.
+ */
+#define FGSH_PRIMITIVE		0		/* 0x30004 - 0x30018 */
+#define FGSH_RASTER		6		/* 0x38000 - 0x3802c */
+#define FGSH_RASTER2		18		/* 0x3c000 - 0x3c004 */
+#define FGSH_TEXTURE		20		/* 0x60000 - 0x6009c */
+#define FGSH_FRAGMENT		(FGSH_TEXTURE + 20 * FIMG_NUM_TEXTURE_UNITS)
+#define FGSH_NUM_SLOTS		(FGSH_FRAGMENT + 15)
+#define FGSH_NUM_WORDS		((FGSH_NUM_SLOTS + 31) / 32)
+
+typedef struct {
+	uint32_t value[FGSH_NUM_SLOTS];
+	uint32_t hw[FGSH_NUM_SLOTS];
+	uint32_t dirty[FGSH_NUM_WORDS];
+	uint32_t stale[FGSH_NUM_WORDS];
+} fimgRegisterShadow;
+
+/*
+ * Block tags
+ *
+ * After writing a block of registers, the context stores its owner ID and
+ * generation of the block in spare vertex shader constants, so on lock
+ * hand-off only blocks tagged by another context have to be restored.
+ */
+enum {
+	FIMG_BLOCK_PRIMITIVE = 0,
+	FIMG_BLOCK_RASTER,
+	FIMG_BLOCK_TEXTURE,
+	FIMG_BLOCK_FRAGMENT,
+	FIMG_BLOCK_VSHADER,
+	FIMG_BLOCK_PSHADER,
+	FIMG_NUM_BLOCKS
+};
+
+#define FIMG_BLOCK_BIT(block)	(1 << (block))
+#define FIMG_BLOCK_ALL		((1 << FIMG_NUM_BLOCKS) - 1)
+
+/* Vertex shader float constants 253 - 255 */
+#define FIMG_TAG_ADDR(block)	(0x14000 + 16 * 253 + 8 * (block))
+
 struct _fimgContext {
 	volatile char *base;
 	int fd;
@@ -577,18 +744,63 @@ struct _fimgContext {
 	unsigned int fbHeight;
 	unsigned int fbFlags;
 	int flipY;
-	/* Register queue */
-	unsigned int *queueStart;
-	unsigned int *queue;
-	unsigned int queueLen;
+	/* Register shadow */
+	fimgRegisterShadow shadow;
+	/* Block tags */
+	uint32_t ownerId;
+	uint32_t generation[FIMG_NUM_BLOCKS];
+	uint32_t touchedBlocks;
 	/* Lock state */
 	unsigned int locked;
+	/* Hardware waits */
+	unsigned int waitSpins;
+	unsigned int waitNoIrq;
+	/* Hardware lease */
+	uint64_t leaseSlice;		/* in nanoseconds, 0 if disabled */
+	uint64_t leaseStart;
+	unsigned int leaseDraws;
+	unsigned int leaseExpired;
+	unsigned int leaseContended;
 	/* Vertex data */
 	uint8_t *vertexData;
 	size_t vertexDataSize;
+	const fimgAttribPacker *packer[FIMG_ATTRIB_NUM];
+	fimgReuseState *reuse;
+	/* Hot path counters */
+	fimgStats stats;
 };
 
 /* Registry accessors */
+#ifdef FIMG_SOFTWARE_BACKEND
+void fimgSoftWrite(fimgContext *ctx, unsigned int data, unsigned int addr);
+unsigned int fimgSoftRead(fimgContext *ctx, unsigned int addr);
+
+static inline void fimgWrite(fimgContext *ctx, unsigned int data, unsigned int addr)
+{
+	fimgSoftWrite(ctx, data, addr);
+}
+
+static inline unsigned int fimgRead(fimgContext *ctx, unsigned int addr)
+{
+	return fimgSoftRead(ctx, addr);
+}
+
+static inline void fimgWriteF(fimgContext *ctx, float data, unsigned int addr)
+{
+	union { float f; unsigned int u; } val;
+
+	val.f = data;
+	fimgSoftWrite(ctx, val.u, addr);
+}
+
+static inline float fimgReadF(fimgContext *ctx, unsigned int addr)
+{
+	union { float f; unsigned int u; } val;
+
+	val.u = fimgSoftRead(ctx, addr);
+	return val.f;
+}
+#else
 static inline void fimgWrite(fimgContext *ctx, unsigned int data, unsigned int addr)
 {
 	volatile unsigned int *reg = (volatile unsigned int *)((volatile char *)ctx->base + addr);
@@ -644,89 +856,173 @@ static inline float fimgReadF(fimgContext *ctx, unsigned int addr)
 	__sync_synchronize();
 	return val;
 }
+#endif /* FIMG_SOFTWARE_BACKEND */
+
+/*
+ * Pipeline hazards
+ *
+ * Registers of given block may be modified only after all the stages
+ * consuming them are idle. Every stage is fed by the stages before it,
+ * so the masks are cumulative.
+ */
+#define FGHI_HAZARD_HOST	(FGHI_PIPELINE_FIFO | FGHI_PIPELINE_HOSTIF \
+				| FGHI_PIPELINE_HVF)
+#define FGHI_HAZARD_VSHADER	(FGHI_HAZARD_HOST | FGHI_PIPELINE_VCACHE \
+				| FGHI_PIPELINE_VSHADER)
+#define FGHI_HAZARD_PRIMITIVE	(FGHI_HAZARD_VSHADER | FGHI_PIPELINE_PRIM_ENG)
+#define FGHI_HAZARD_RASTER	(FGHI_HAZARD_PRIMITIVE | FGHI_PIPELINE_TRI_ENG \
+				| FGHI_PIPELINE_RA_ENG)
+#define FGHI_HAZARD_PSHADER	(FGHI_HAZARD_RASTER | FGHI_PIPELINE_PSHADER)
+#define FGHI_HAZARD_TEXTURE	(FGHI_HAZARD_PSHADER)
+#define FGHI_HAZARD_FRAGMENT	(FGHI_PIPELINE_ALL)
+#define FGHI_HAZARD_GLOBAL	(FGHI_PIPELINE_ALL)
+
+static inline uint32_t fimgRegisterHazard(unsigned int addr)
+{
+	if (addr >= 0x70000)
+		return FGHI_HAZARD_FRAGMENT;
+	if (addr >= 0x60000)
+		return FGHI_HAZARD_TEXTURE;
+	if (addr >= 0x40000)
+		return FGHI_HAZARD_PSHADER;
+	if (addr >= 0x38000)
+		return FGHI_HAZARD_RASTER;
+	if (addr >= 0x30000)
+		return FGHI_HAZARD_PRIMITIVE;
+	if (addr >= 0x10000)
+		return FGHI_HAZARD_VSHADER;
+	if (addr >= 0x8000)
+		return FGHI_HAZARD_HOST;
+	return FGHI_HAZARD_GLOBAL;
+}
 
 /* Register queue */
-#define FIMG_MAX_QUEUE_LEN	64
+static inline unsigned int fimgShadowSlot(unsigned int addr)
+{
+	if (addr >= 0x70000)
+		return FGSH_FRAGMENT + (addr - 0x70000) / 4;
+	if (addr >= 0x60000)
+		return FGSH_TEXTURE + (addr - 0x60000) / 4;
+	if (addr >= 0x3c000)
+		return FGSH_RASTER2 + (addr - 0x3c000) / 4;
+	if (addr >= 0x38000)
+		return FGSH_RASTER + (addr - 0x38000) / 4;
+	return FGSH_PRIMITIVE + (addr - 0x30004) / 4;
+}
 
-static inline void fimgQueueFlush(fimgContext *ctx)
+static inline void fimgQueue(fimgContext *ctx, unsigned int data, unsigned int addr)
 {
-	unsigned int cnt;
-	unsigned int *ptr;
+	unsigned int slot = fimgShadowSlot(addr);
 
-	if (!ctx->queueLen)
-		return;
+	ctx->shadow.value[slot] = data;
+	ctx->shadow.dirty[slot / 32] |= 1 << (slot % 32);
+}
 
-	/* Above the maximum length it's more effective to restore the whole
-	 * context than just the changed registers */
-	if (ctx->queueLen == FIMG_MAX_QUEUE_LEN) {
-		fimgRestoreContext(ctx);
-		return;
-	}
+static inline void fimgQueueF(fimgContext *ctx, float data, unsigned int addr)
+{
+	union { float f; unsigned int u; } val;
+
+	val.f = data;
+	fimgQueue(ctx, val.u, addr);
+}
+
+static inline void fimgQueueBlock(fimgContext *ctx, const uint32_t *data,
+					unsigned int count, unsigned int addr)
+{
+	unsigned int slot = fimgShadowSlot(addr);
 
-	cnt = ctx->queueLen;
-	ptr = ctx->queueStart + 2;
+	memcpy(&ctx->shadow.value[slot], data, count * sizeof(*data));
 
-	while (cnt--) {
-		fimgWrite(ctx, ptr[1], ptr[0]);
-		ptr += 2;
+	while (count--) {
+		ctx->shadow.dirty[slot / 32] |= 1 << (slot % 32);
+		++slot;
 	}
-
-	ctx->queueLen = 0;
-	ctx->queue = ctx->queueStart;
-	ctx->queue[0] = 0;
 }
 
-static inline void fimgQueue(fimgContext *ctx, unsigned int data, unsigned int addr)
+/* Writes contiguous registers using burst transfers */
+static inline void fimgWriteBurst(fimgContext *ctx, const uint32_t *data,
+					unsigned int count, unsigned int addr)
 {
-	if (ctx->queue[0] == addr) {
-		ctx->queue[1] = data;
-		return;
+#ifdef FIMG_SOFTWARE_BACKEND
+	while (count--) {
+		fimgSoftWrite(ctx, *(data++), addr);
+		addr += 4;
+	}
+#else
+	volatile uint32_t *reg = (volatile uint32_t *)(ctx->base + addr);
+	unsigned int bursts = count / 4;
+
+	if (bursts) {
+		asm volatile (
+			"1:\n\t"
+			"ldmia %1!, {r0-r3}\n\t"
+			"stmia %0!, {r0-r3}\n\t"
+			"subs %2, %2, $1\n\t"
+			"bne 1b\n\t"
+			: "+r"(reg), "+r"(data), "+r"(bursts)
+			:
+			: "r0", "r1", "r2", "r3", "cc", "memory"
+		);
+		count %= 4;
 	}
 
-	/* Above the maximum length it's more effective to restore the whole
-	 * context than just the changed registers */
-	if (ctx->queueLen == FIMG_MAX_QUEUE_LEN)
-		return;
+	while (count--)
+		*(reg++) = *(data++);
 
-	ctx->queue += 2;
-	ctx->queueLen++;
-	ctx->queue[0] = addr;
-	ctx->queue[1] = data;
+	__sync_synchronize();
+#endif
 }
 
-static inline void fimgQueueF(fimgContext *ctx, float data, unsigned int addr)
-{
-	if (ctx->queue[0] == addr) {
-		((float *)ctx->queue)[1] = data;
-		return;
-	}
+/* Sequence number of last batch sent by any context, see fimgGetFence() */
+extern volatile uint32_t fimgFenceSubmitted;
 
-	/* Above the maximum length it's more effective to restore the whole
-	 * context than just the changed registers */
-	if (ctx->queueLen == FIMG_MAX_QUEUE_LEN)
-		return;
+void fimgQueueFlush(fimgContext *ctx);
+void fimgInvalidateShadow(fimgContext *ctx, uint32_t blocks);
 
-	ctx->queue += 2;
-	ctx->queueLen++;
-	ctx->queue[0] = addr;
-	((float *)ctx->queue)[1] = data;
+/* Marks blocks as written, to be tagged at the end of the flush */
+static inline void fimgTouchBlocks(fimgContext *ctx, uint32_t blocks)
+{
+	ctx->touchedBlocks |= blocks;
 }
 
+void fimgWriteTags(fimgContext *ctx);
+
 /* Hardware context */
 
 static inline void fimgGetHardware(fimgContext *ctx)
 {
 	int ret;
 
+	/* Still leased */
+	if (ctx->locked)
+		return;
+
+	/* Let contexts waiting for expired lease take the hardware first */
+	if (ctx->leaseExpired)
+		sched_yield();
+
 	ret = fimgAcquireHardwareLock(ctx);
+	++ctx->stats.lockAcquisitions;
+
+	if (ctx->leaseSlice) {
+		/* Someone was waiting, so shorten leases until end of frame */
+		if (ctx->leaseExpired && ret > 0)
+			ctx->leaseContended = 1;
+		ctx->leaseExpired = 0;
+		ctx->leaseDraws = 0;
+		ctx->leaseStart = fimgGetTime();
+	}
+
 	if (likely(!ret))
 		return;
 
 	switch (ret) {
 	case 2:
-		/* Fall through */
+		/* Hardware was powered down, so all the registers are reset */
+		fimgRestoreContext(ctx, 1);
+		break;
 	case 1:
-		fimgRestoreContext(ctx);
+		fimgRestoreContext(ctx, 0);
 		break;
 	default:
 		fprintf(stderr, "FIMG: Could not acquire hardware lock");
@@ -737,17 +1033,50 @@ static inline void fimgGetHardware(fimgContext *ctx)
 static inline void fimgFlushContext(fimgContext *ctx)
 {
 	if (ctx->invalTexCache) {
+		fimgSelectiveFlush(ctx, FGHI_HAZARD_TEXTURE);
 		fimgInvalidateCache(ctx, 0, 3);
 		ctx->invalTexCache = 0;
+		++ctx->stats.texCacheInvalidations;
 	}
-	fimgQueueFlush(ctx);
 #ifdef FIMG_FIXED_PIPELINE
+	/* Queues texture registers */
 	fimgCompatFlush(ctx);
 #endif
+	fimgQueueFlush(ctx);
+
+	if (ctx->touchedBlocks)
+		fimgWriteTags(ctx);
+}
+
+/* Checks whether lease time slice has passed */
+static inline int fimgLeaseExpired(fimgContext *ctx, uint64_t now)
+{
+	uint64_t slice = ctx->leaseSlice;
+
+	if (ctx->leaseContended)
+		slice /= 4;
+
+	if (now - ctx->leaseStart < slice)
+		return 0;
+
+	ctx->leaseExpired = 1;
+	++ctx->stats.leaseExpiries;
+	return 1;
 }
 
+/*
+ * Leases are checked here, in the thread owning the hardware lock. Holders
+ * that stop drawing must end the lease themselves (at flush, end of frame
+ * or before blocking), see fimgEndHardwareLease().
+ */
 static inline void fimgPutHardware(fimgContext *ctx)
 {
+	if (ctx->leaseSlice) {
+		if (likely(++ctx->leaseDraws % FIMG_LEASE_CHECK_INTERVAL)
+		    || !fimgLeaseExpired(ctx, fimgGetTime()))
+			return;
+	}
+
 	fimgReleaseHardwareLock(ctx);
 }
 
@@ -24,6 +24,7 @@
 #endif
 
 #include "fimg_private.h"
+#include <time.h>
 #include <unistd.h>
 
 /*
@@ -66,6 +67,76 @@ uint32_t fimgGetPipelineStatus(fimgContext *ctx)
 	return fimgRead(ctx, FGGB_PIPESTATE);
 }
 
+/* Bounds of adaptive spinning, in register reads */
+#define WAIT_SPINS_MIN		16
+#define WAIT_SPINS_MAX		1024
+
+static inline int isIdle(fimgContext *ctx, uint32_t pipeMask,
+							uint32_t cacheMask)
+{
+	if (pipeMask && (fimgRead(ctx, FGGB_PIPESTATE) & pipeMask))
+		return 0;
+
+	if (cacheMask && (fimgRead(ctx, FGGB_CACHECTL) & cacheMask))
+		return 0;
+
+	return 1;
+}
+
+/*
+ * Waits for given pipeline stages and cache operations accounting the time
+ * spent waiting. Short waits are spun on, long ones sleep until G3D interrupt.
+ * The spin limit grows when spinning succeeds and shrinks when it does not.
+ */
+static int waitForIdle(fimgContext *ctx, uint32_t pipeMask, uint32_t cacheMask)
+{
+	uint64_t start = fimgGetTime();
+	unsigned int spins = ctx->waitSpins;
+	int ret = 0;
+
+	while (spins--) {
+		if (isIdle(ctx, pipeMask, cacheMask)) {
+			if (ctx->waitSpins < WAIT_SPINS_MAX)
+				ctx->waitSpins *= 2;
+			goto done;
+		}
+	}
+
+	if (ctx->waitSpins > WAIT_SPINS_MIN)
+		ctx->waitSpins /= 2;
+
+	++ctx->stats.flushSleeps;
+
+	if (!ctx->waitNoIrq) {
+		ret = fimgWaitForIdle(ctx, pipeMask, cacheMask,
+							FIMG_WAIT_TIMEOUT);
+		if (!ret)
+			goto done;
+
+		if (ret == -ENOSYS) {
+			ALOGI("Kernel does not support S3C_G3D_WAIT, "
+						"using S3C_G3D_FLUSH");
+			ctx->waitNoIrq = 1;
+		}
+
+		/* Failed wait does not mean idle hardware, so poll */
+		ret = 0;
+	}
+
+	/* Older kernels can only wait for the pipeline */
+	if (pipeMask)
+		ret = fimgWaitForFlush(ctx, pipeMask);
+
+	while (!ret && !isIdle(ctx, 0, cacheMask))
+		sched_yield();
+
+done:
+	++ctx->stats.flushWaits;
+	ctx->stats.flushWaitTime += fimgGetTime() - start;
+
+	return ret;
+}
+
 /*****************************************************************************
  * FUNCTIONS:	fimgFlush
  * SYNOPSIS:	This function flushes the fimg3d pipeline
@@ -80,17 +151,161 @@ int fimgFlush(fimgContext *ctx)
 		return 0;
 
 	/* Flush whole pipeline */
-	return fimgWaitForFlush(ctx, FGHI_PIPELINE_ALL);
+	return waitForIdle(ctx, FGHI_PIPELINE_ALL, 0);
 }
 
 int fimgSelectiveFlush(fimgContext *ctx, uint32_t mask)
 {
 	if (fimgRead(ctx, FGGB_PIPESTATE) & mask)
-		return fimgWaitForFlush(ctx, mask);
+		return waitForIdle(ctx, mask, 0);
 
 	return 0;
 }
 
+/*
+ * Register shadow
+ */
+
+static const struct {
+	unsigned int addr;
+	unsigned int slot;
+	unsigned int count;
+	uint32_t hazard;
+	unsigned int block;
+} shadowWindows[] = {
+	{ 0x30004, FGSH_PRIMITIVE, 6, FGHI_HAZARD_PRIMITIVE,
+							FIMG_BLOCK_PRIMITIVE },
+	{ 0x38000, FGSH_RASTER, 12, FGHI_HAZARD_RASTER, FIMG_BLOCK_RASTER },
+	{ 0x3c000, FGSH_RASTER2, 2, FGHI_HAZARD_RASTER, FIMG_BLOCK_RASTER },
+	{ 0x60000, FGSH_TEXTURE, FGSH_FRAGMENT - FGSH_TEXTURE,
+					FGHI_HAZARD_TEXTURE, FIMG_BLOCK_TEXTURE },
+	{ 0x70000, FGSH_FRAGMENT, FGSH_NUM_SLOTS - FGSH_FRAGMENT,
+					FGHI_HAZARD_FRAGMENT, FIMG_BLOCK_FRAGMENT },
+};
+
+#define NUM_SHADOW_WINDOWS	(sizeof(shadowWindows) / sizeof(*shadowWindows))
+
+#define SLOT_BIT(slot)		(1 << ((slot) % 32))
+#define SLOT_TEST(map, slot)	((map)[(slot) / 32] & SLOT_BIT(slot))
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgQueueFlush
+ * SYNOPSIS:	This function writes queued registers to the hardware,
+ *		skipping the ones already holding requested values and
+ *		using burst writes for contiguous runs of registers
+ *****************************************************************************/
+void fimgQueueFlush(fimgContext *ctx)
+{
+	fimgRegisterShadow *sh = &ctx->shadow;
+	uint32_t hazards = 0;
+	unsigned int i, slot, end, start;
+	uint32_t pending = 0;
+
+	for (i = 0; i < FGSH_NUM_WORDS; ++i)
+		pending |= sh->dirty[i];
+	if (!pending)
+		return;
+
+	/* Drop redundant writes and collect stages to be waited for */
+	for (i = 0; i < NUM_SHADOW_WINDOWS; ++i) {
+		slot = shadowWindows[i].slot;
+		end = slot + shadowWindows[i].count;
+
+		for (; slot < end; ++slot) {
+			if (!SLOT_TEST(sh->dirty, slot))
+				continue;
+
+			if (sh->value[slot] == sh->hw[slot]
+			    && !SLOT_TEST(sh->stale, slot)) {
+				sh->dirty[slot / 32] &= ~SLOT_BIT(slot);
+				++ctx->stats.registerSkips;
+				continue;
+			}
+
+			hazards |= shadowWindows[i].hazard;
+		}
+	}
+
+	if (!hazards)
+		return;
+
+	/* Wait only for the stages using the registers to be written */
+	fimgSelectiveFlush(ctx, hazards);
+
+	for (i = 0; i < NUM_SHADOW_WINDOWS; ++i) {
+		slot = shadowWindows[i].slot;
+		end = slot + shadowWindows[i].count;
+
+		while (slot < end) {
+			if (!SLOT_TEST(sh->dirty, slot)) {
+				++slot;
+				continue;
+			}
+
+			start = slot;
+			do {
+				sh->dirty[slot / 32] &= ~SLOT_BIT(slot);
+				sh->stale[slot / 32] &= ~SLOT_BIT(slot);
+				++slot;
+			} while (slot < end && SLOT_TEST(sh->dirty, slot));
+
+			fimgWriteBurst(ctx, &sh->value[start], slot - start,
+				shadowWindows[i].addr
+				+ 4 * (start - shadowWindows[i].slot));
+			memcpy(&sh->hw[start], &sh->value[start],
+					(slot - start) * sizeof(*sh->value));
+			ctx->stats.registerWrites += slot - start;
+			fimgTouchBlocks(ctx,
+					FIMG_BLOCK_BIT(shadowWindows[i].block));
+		}
+	}
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgInvalidateShadow
+ * SYNOPSIS:	This function marks shadowed registers of given blocks
+ *		as holding unknown values
+ * ARGUMENTS:	blocks - mask of FIMG_BLOCK_BIT() values
+ *****************************************************************************/
+void fimgInvalidateShadow(fimgContext *ctx, uint32_t blocks)
+{
+	fimgRegisterShadow *sh = &ctx->shadow;
+	unsigned int i, slot, end;
+
+	for (i = 0; i < NUM_SHADOW_WINDOWS; ++i) {
+		if (!(blocks & FIMG_BLOCK_BIT(shadowWindows[i].block)))
+			continue;
+
+		slot = shadowWindows[i].slot;
+		end = slot + shadowWindows[i].count;
+
+		for (; slot < end; ++slot)
+			sh->stale[slot / 32] |= SLOT_BIT(slot);
+	}
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgWriteTags
+ * SYNOPSIS:	This function tags blocks written during the flush with
+ *		owner ID of the context and new generation of the block
+ *****************************************************************************/
+void fimgWriteTags(fimgContext *ctx)
+{
+	uint32_t blocks = ctx->touchedBlocks;
+	unsigned int i;
+
+	/* Writing a block already required vertex shader to be idle */
+	for (i = 0; i < FIMG_NUM_BLOCKS; ++i) {
+		if (!(blocks & FIMG_BLOCK_BIT(i)))
+			continue;
+
+		fimgWrite(ctx, ctx->ownerId, FIMG_TAG_ADDR(i));
+		fimgWrite(ctx, ++ctx->generation[i], FIMG_TAG_ADDR(i) + 4);
+	}
+
+	ctx->touchedBlocks = 0;
+}
+
 /*****************************************************************************
  * FUNCTIONS:	fimgInvalidateCache
  * SYNOPSIS:
@@ -109,7 +324,8 @@ int fimgInvalidateCache(fimgContext *ctx,
 
 	fimgWrite(ctx, ctl.val, FGGB_CACHECTL); // start clearing the cache
 
-	while(fimgRead(ctx, FGGB_CACHECTL) & ctl.val);
+	if (fimgRead(ctx, FGGB_CACHECTL) & ctl.val)
+		return waitForIdle(ctx, 0, ctl.val);
 
 	return 0;
 }
@@ -150,25 +366,129 @@ int fimgWaitForCacheFlush(fimgContext *ctx,
 	ctl.ccflush = ccflush;
 	ctl.zcflush = zcflush;
 
-	while(fimgRead(ctx, FGGB_CACHECTL) & ctl.val);
+	if (fimgRead(ctx, FGGB_CACHECTL) & ctl.val)
+		return waitForIdle(ctx, 0, ctl.val);
 
 	return 0;
 }
 
-/*****************************************************************************
- * FUNCTIONS:	fimgFinish
- * SYNOPSIS:
- * PARAMETERS:
- * RETURNS:
+/*
+ * Fences
  *
- *****************************************************************************/
-void fimgFinish(fimgContext *ctx)
+ * Every batch of vertices sent to the hardware gets a sequence number,
+ * shared by all contexts of the process. The hardware only reports the
+ * pipeline being idle, so completing a fence completes all the work
+ * submitted before it, by any context. Any context holding the hardware
+ * can therefore complete fences of other contexts, while completion can be
+ * checked from any thread.
+ */
+
+volatile uint32_t fimgFenceSubmitted;
+static volatile uint32_t fimgFenceCompleted;
+
+static inline int fenceCompleted(uint32_t fence)
 {
-	fimgGetHardware(ctx);
+	return (int32_t)(fence - fimgFenceCompleted) <= 0;
+}
+
+/* Waits for all submitted work to reach memory, hardware must be locked */
+static void finishWork(fimgContext *ctx)
+{
+	/* Batches are counted with the hardware locked, so all are sent */
+	uint32_t fence = fimgFenceSubmitted;
+	uint32_t completed;
+
 	fimgFlush(ctx);
 	fimgFlushCache(ctx, 3, 3);
 	fimgSelectiveFlush(ctx, FGHI_PIPELINE_CCACHE);
 	fimgWaitForCacheFlush(ctx, 3, 3);
+
+	/* Threads checking fences could have completed a later one */
+	do {
+		completed = fimgFenceCompleted;
+		if ((int32_t)(fence - completed) <= 0)
+			break;
+	} while (!__sync_bool_compare_and_swap(&fimgFenceCompleted,
+							completed, fence));
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgFinish
+ * SYNOPSIS:	This function waits for all submitted work to complete
+ *		and ends hardware lease
+ *****************************************************************************/
+void fimgFinish(fimgContext *ctx)
+{
+	fimgGetHardware(ctx);
+	finishWork(ctx);
+	fimgPutHardware(ctx);
+	fimgEndHardwareLease(ctx);
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgGetFence
+ * SYNOPSIS:	This function creates a fence for the work submitted so far
+ * RETURNS:	fence sequence number
+ *****************************************************************************/
+uint32_t fimgGetFence(fimgContext *ctx)
+{
+	return fimgFenceSubmitted;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgFenceSignaled
+ * SYNOPSIS:	This function checks whether given fence has been completed
+ *		by any context, without accessing the hardware, so it may be
+ *		called from any thread
+ * RETURNS:	non-zero if completed
+ *****************************************************************************/
+int fimgFenceSignaled(fimgContext *ctx, uint32_t fence)
+{
+	return fenceCompleted(fence);
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgPollFence
+ * SYNOPSIS:	This function checks without blocking whether the work
+ *		preceding given fence has completed
+ * RETURNS:	non-zero if completed
+ *****************************************************************************/
+int fimgPollFence(fimgContext *ctx, uint32_t fence)
+{
+	int ret = 0;
+
+	if (fenceCompleted(fence))
+		return 1;
+
+	fimgGetHardware(ctx);
+
+	/* Only cache flush left to do */
+	if (!(fimgRead(ctx, FGGB_PIPESTATE) & FGHI_PIPELINE_ALL)) {
+		finishWork(ctx);
+		ret = 1;
+	}
+
+	fimgPutHardware(ctx);
+
+	return ret;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgWaitFence
+ * SYNOPSIS:	This function waits until the work preceding given fence
+ *		has completed and its results reached memory
+ *****************************************************************************/
+void fimgWaitFence(fimgContext *ctx, uint32_t fence)
+{
+	if (fenceCompleted(fence)) {
+		++ctx->stats.fenceWaitsSkipped;
+		return;
+	}
+
+	++ctx->stats.fenceWaits;
+
+	fimgGetHardware(ctx);
+	finishWork(ctx);
 	fimgPutHardware(ctx);
 }
 
@@ -278,7 +598,7 @@ uint32_t fimgGetInterruptState(fimgContext *ctx)
 
 void fimgCreateGlobalContext(fimgContext *ctx)
 {
-	// Nothing to initialize yet
+	ctx->waitSpins = WAIT_SPINS_MIN;
 }
 
 void fimgRestoreGlobalState(fimgContext *ctx)
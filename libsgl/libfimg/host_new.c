@@ -180,12 +180,20 @@ static unsigned int calculateBatchSize(fimgArray *arrays, int count)
 	return vertexWordsToVertexCount[size];
 }
 
-static void fillVertexBuffer(fimgContext *ctx)
+static void uploadVertexData(fimgContext *ctx,
+					const uint32_t *data, size_t size)
 {
+#ifdef FIMG_SOFTWARE_BACKEND
+	unsigned count = (size + 3) / 4;
+
+	fimgWrite(ctx, 0, FGHI_VBADDR);
+
+	while (count--)
+		fimgWrite(ctx, *(data++), FGHI_VB_ENTRY);
+#else
 	volatile uint32_t *reg =
 			(volatile uint32_t *)(ctx->base + FGHI_VB_ENTRY);
-	uint32_t *data = (uint32_t *)ctx->vertexData;
-	unsigned count = (ctx->vertexDataSize + 31) / 32;
+	unsigned count = (size + 31) / 32;
 
 	fimgWrite(ctx, 0, FGHI_VBADDR);
 
@@ -195,10 +203,23 @@ static void fillVertexBuffer(fimgContext *ctx)
 		"stmia %0!, {r0-r7}\n\t"
 		"subs %2, %2, $1\n\t"
 		"bne 1b\n\t"
+		: "+r"(reg), "+r"(data), "+r"(count)
 		:
-		: "r"(reg), "r"(data), "r"(count)
-		: "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7"
+		: "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7",
+		  "cc", "memory"
 	);
+#endif
+
+	__sync_fetch_and_add(&fimgFenceSubmitted, 1);
+	++ctx->stats.batches;
+	ctx->stats.bytesUploaded += size;
+}
+
+static inline void fillVertexBuffer(fimgContext *ctx)
+{
+	ctx->stats.bytesPacked += ctx->vertexDataSize;
+	uploadVertexData(ctx, (const uint32_t *)ctx->vertexData,
+							ctx->vertexDataSize);
 }
 
 #define BUF_ADDR_32(buf, offs)	\
@@ -209,109 +230,262 @@ static void fillVertexBuffer(fimgContext *ctx)
 			((const uint8_t *)(buf) + (offs))
 
 /*
- * Unindexed
+ * Attribute packers
+ *
+ * Specialized for source data layout (attribute width and alignment)
+ * and index type. Appropriate packer for each attribute is selected once
+ * per draw call by selectPackers().
  */
 
-static uint32_t packAttribute(fimgContext *ctx, uint32_t *buf,
-						fimgArray *a, int pos, int cnt)
+struct _fimgAttribPacker {
+	uint32_t (*direct)(uint32_t *buf, const fimgArray *a,
+						uint32_t pos, uint32_t cnt);
+	uint32_t (*idx8)(uint32_t *buf, const fimgArray *a,
+					const uint8_t *idx, uint32_t cnt);
+	uint32_t (*idx16)(uint32_t *buf, const fimgArray *a,
+					const uint16_t *idx, uint32_t cnt);
+};
+
+#if defined(__ARM_ARCH_6__) || defined(__ARM_ARCH_6J__) \
+    || defined(__ARM_ARCH_6K__) || defined(__ARM_ARCH_6Z__) \
+    || defined(__ARM_ARCH_6ZK__) || defined(__ARM_ARCH_7A__)
+#define HAVE_ARMV6_SIMD
+#endif
+
+static inline uint32_t halfwordPair(uint32_t lo, uint32_t hi)
 {
-	register uint32_t word;
-	uint32_t size;
+#ifdef HAVE_ARMV6_SIMD
+	uint32_t word;
 
-	/* Vertices must be word aligned */
-	size = (a->width + 3) & ~3;
-	size *= cnt;
+	asm ("pkhbt %0, %1, %2, lsl #16" : "=r"(word) : "r"(lo), "r"(hi));
 
-	switch(a->width % 4) {
-	/* words */
-	case 0:
-		/* Check if vertices are word aligned */
-		if ((uintptr_t)a->pointer % 4 == 0 && a->stride % 4 == 0) {
-			uint32_t len, srcpad = (a->stride - a->width) / 4;
-			const uint32_t *data =
-					BUF_ADDR_32(a->pointer, pos*a->stride);
+	return word;
+#else
+	return lo | (hi << 16);
+#endif
+}
 
-			while (cnt--) {
-				len = a->width;
+/* Single vertex copy routines */
 
-				while (len) {
-					*(buf++) = *(data++);
-					len -= 4;
-				}
+static inline uint32_t *copyWords1(uint32_t *buf, const uint8_t *src)
+{
+	const uint32_t *data = (const uint32_t *)src;
 
-				data += srcpad;
-			}
+	*(buf++) = data[0];
+	return buf;
+}
 
-			break;
-		}
-	/* halfwords */
-	case 2:
-		/* Check if vertices are halfword aligned */
-		if ((uintptr_t)a->pointer % 2 == 0 && a->stride % 2 == 0) {
-			uint32_t len, srcpad = (a->stride - a->width) / 2;
-			const uint16_t *data =
-					BUF_ADDR_16(a->pointer, pos*a->stride);
-
-			while (cnt--) {
-				len = a->width;
-
-				while (len >= 4) {
-					word = *(data++);
-					word |= *(data++) << 16;
-					*(buf++) = word;
-					len -= 4;
-				}
-
-				/* Single halfword left */
-				if (len)
-					*(buf++) = *(data++);
-
-				data += srcpad;
-			}
+static inline uint32_t *copyWords2(uint32_t *buf, const uint8_t *src)
+{
+	const uint32_t *data = (const uint32_t *)src;
 
-			break;
-		}
-	/* bytes */
-	default:
-		/* Fallback - no check required */
-		{
-			uint32_t len, srcpad = a->stride - a->width;
-			const uint8_t *data =
-					BUF_ADDR_8(a->pointer, pos*a->stride);
-
-			while (cnt--) {
-				len = a->width;
-
-				while (len >= 4) {
-					word = *(data++);
-					word |= *(data++) << 8;
-					word |= *(data++) << 16;
-					word |= *(data++) << 24;
-					*(buf++) = word;
-					len -= 4;
-				}
-
-				// Up to 3 bytes left
-				if (len) {
-					word = *(data++);
-					if (len == 2)
-						word |= *(data++) << 8;
-					if (len == 3)
-						word |= *(data++) << 16;
-
-					*(buf++) = word;
-				}
-
-				data += srcpad;
-			}
+	*(buf++) = data[0];
+	*(buf++) = data[1];
+	return buf;
+}
 
-			break;
-		}
+static inline uint32_t *copyWords3(uint32_t *buf, const uint8_t *src)
+{
+	const uint32_t *data = (const uint32_t *)src;
+
+	*(buf++) = data[0];
+	*(buf++) = data[1];
+	*(buf++) = data[2];
+	return buf;
+}
+
+static inline uint32_t *copyWords4(uint32_t *buf, const uint8_t *src)
+{
+	const uint32_t *data = (const uint32_t *)src;
+
+	*(buf++) = data[0];
+	*(buf++) = data[1];
+	*(buf++) = data[2];
+	*(buf++) = data[3];
+	return buf;
+}
+
+/* Word aligned data with trailing halfword (i.e. 3 x GL_SHORT) */
+static inline uint32_t *copyWordsHalf(uint32_t *buf,
+					const uint8_t *src, uint32_t width)
+{
+	const uint32_t *data = (const uint32_t *)src;
+	uint32_t len = width;
+
+	while (len >= 4) {
+		*(buf++) = *(data++);
+		len -= 4;
 	}
 
+	*(buf++) = *(const uint16_t *)data;
+	return buf;
+}
+
+static inline uint32_t *copyHalfwords(uint32_t *buf,
+					const uint8_t *src, uint32_t width)
+{
+	const uint16_t *data = (const uint16_t *)src;
+	uint32_t len = width;
+
+	while (len >= 4) {
+		*(buf++) = halfwordPair(data[0], data[1]);
+		data += 2;
+		len -= 4;
+	}
+
+	/* Single halfword left */
+	if (len)
+		*(buf++) = *data;
+
+	return buf;
+}
+
+/* Fallback - no alignment required */
+static inline uint32_t *copyBytes(uint32_t *buf,
+					const uint8_t *src, uint32_t width)
+{
+	uint32_t len = width;
+	uint32_t word;
+
+	while (len >= 4) {
+		word = src[0] | (src[1] << 8) | (src[2] << 16) | (src[3] << 24);
+		*(buf++) = word;
+		src += 4;
+		len -= 4;
+	}
+
+	/* Up to 3 bytes left */
+	if (len) {
+		word = src[0];
+		if (len > 1)
+			word |= src[1] << 8;
+		if (len > 2)
+			word |= src[2] << 16;
+		*(buf++) = word;
+	}
+
+	return buf;
+}
+
+/* Optional arguments are passed to copy routine after source address */
+#define DEFINE_PACKERS(name, copy, ...)					\
+static uint32_t name(uint32_t *buf, const fimgArray *a,		\
+					uint32_t pos, uint32_t cnt)	\
+{									\
+	const uint8_t *data = BUF_ADDR_8(a->pointer, pos*a->stride);	\
+	uint32_t *start = buf;						\
+									\
+	while (cnt--) {							\
+		buf = copy(buf, data, ##__VA_ARGS__);			\
+		data += a->stride;					\
+	}								\
+									\
+	return 4*(buf - start);						\
+}									\
+									\
+static uint32_t name##Idx8(uint32_t *buf, const fimgArray *a,		\
+				const uint8_t *idx, uint32_t cnt)	\
+{									\
+	uint32_t *start = buf;						\
+									\
+	while (cnt--)							\
+		buf = copy(buf, BUF_ADDR_8(a->pointer,			\
+				*(idx++)*a->stride), ##__VA_ARGS__);	\
+									\
+	return 4*(buf - start);						\
+}									\
+									\
+static uint32_t name##Idx16(uint32_t *buf, const fimgArray *a,	\
+				const uint16_t *idx, uint32_t cnt)	\
+{									\
+	uint32_t *start = buf;						\
+									\
+	while (cnt--)							\
+		buf = copy(buf, BUF_ADDR_8(a->pointer,			\
+				*(idx++)*a->stride), ##__VA_ARGS__);	\
+									\
+	return 4*(buf - start);						\
+}
+
+DEFINE_PACKERS(packWords1, copyWords1)
+DEFINE_PACKERS(packWords2, copyWords2)
+DEFINE_PACKERS(packWords3, copyWords3)
+DEFINE_PACKERS(packWords4, copyWords4)
+DEFINE_PACKERS(packWordsHalf, copyWordsHalf, a->width)
+DEFINE_PACKERS(packHalfwords, copyHalfwords, a->width)
+DEFINE_PACKERS(packBytes, copyBytes, a->width)
+
+/* Tightly packed word aligned data can be copied at once */
+static uint32_t packContiguous(uint32_t *buf, const fimgArray *a,
+						uint32_t pos, uint32_t cnt)
+{
+	uint32_t size = cnt*a->width;
+
+	memcpy(buf, BUF_ADDR_8(a->pointer, pos*a->stride), size);
 	return size;
 }
 
+/* Indexed by number of words */
+static const fimgAttribPacker wordPackers[MAX_WORDS_PER_ATTRIB + 1] = {
+	[1] = { packWords1, packWords1Idx8, packWords1Idx16 },
+	[2] = { packWords2, packWords2Idx8, packWords2Idx16 },
+	[3] = { packWords3, packWords3Idx8, packWords3Idx16 },
+	[4] = { packWords4, packWords4Idx8, packWords4Idx16 },
+};
+
+static const fimgAttribPacker contiguousPackers[MAX_WORDS_PER_ATTRIB + 1] = {
+	[1] = { packContiguous, packWords1Idx8, packWords1Idx16 },
+	[2] = { packContiguous, packWords2Idx8, packWords2Idx16 },
+	[3] = { packContiguous, packWords3Idx8, packWords3Idx16 },
+	[4] = { packContiguous, packWords4Idx8, packWords4Idx16 },
+};
+
+static const fimgAttribPacker wordsHalfPacker = {
+	packWordsHalf, packWordsHalfIdx8, packWordsHalfIdx16
+};
+
+static const fimgAttribPacker halfwordPacker = {
+	packHalfwords, packHalfwordsIdx8, packHalfwordsIdx16
+};
+
+static const fimgAttribPacker bytePacker = {
+	packBytes, packBytesIdx8, packBytesIdx16
+};
+
+static void selectPackers(fimgContext *ctx, const fimgArray *arrays)
+{
+	const fimgArray *a = arrays;
+	uint32_t align;
+	unsigned int i;
+
+	for (i = 0; i < ctx->numAttribs; ++i, ++a) {
+		/* Constants are not packed */
+		if (!a->stride) {
+			ctx->packer[i] = NULL;
+			continue;
+		}
+
+		align = (uintptr_t)a->pointer | a->stride;
+
+		if (align % 4 == 0 && a->width % 4 == 0) {
+			if (a->stride == a->width)
+				ctx->packer[i] = &contiguousPackers[a->width / 4];
+			else
+				ctx->packer[i] = &wordPackers[a->width / 4];
+		} else if (align % 4 == 0 && a->width % 4 == 2) {
+			ctx->packer[i] = &wordsHalfPacker;
+		} else if (align % 2 == 0 && a->width % 2 == 0) {
+			ctx->packer[i] = &halfwordPacker;
+		} else {
+			ctx->packer[i] = &bytePacker;
+		}
+	}
+}
+
+/*
+ * Unindexed
+ */
+
 /* Generic vertex copy */
 static uint32_t copyVertices1To1(fimgContext *ctx, fimgArray *arrays,
 						uint32_t *first, uint32_t *count)
@@ -332,13 +506,7 @@ static uint32_t copyVertices1To1(fimgContext *ctx, fimgArray *arrays,
 			continue;
 		}
 		setVtxBufAttrib(ctx, i, offset, (a->width + 3) & ~3, batchSize);
-		if (a->stride == a->width && !(a->width % 4)) {
-			memcpy(buf + offset, (const uint8_t *)a->pointer
-					+ *first*a->stride, batchSize*a->width);
-			offset += batchSize*a->width;
-			continue;
-		}
-		offset += packAttribute(ctx,
+		offset += ctx->packer[i]->direct(
 				(uint32_t *)(buf + offset), a, *first, batchSize);
 	}
 
@@ -371,13 +539,7 @@ static uint32_t copyVerticesLinestrip(fimgContext *ctx,
 			continue;
 		}
 		setVtxBufAttrib(ctx, i, offset, (a->width + 3) & ~3, batchSize);
-		if (a->stride == a->width && !(a->width % 4)) {
-			memcpy(buf + offset, (const uint8_t *)a->pointer
-					+ *first*a->stride, batchSize*a->width);
-			offset += batchSize*a->width;
-			continue;
-		}
-		offset += packAttribute(ctx,
+		offset += ctx->packer[i]->direct(
 				(uint32_t *)(buf + offset), a, *first, batchSize);
 	}
 
@@ -413,13 +575,7 @@ static uint32_t copyVerticesLines(fimgContext *ctx, fimgArray *arrays,
 			continue;
 		}
 		setVtxBufAttrib(ctx, i, offset, (a->width + 3) & ~3, batchSize);
-		if (a->stride == a->width && !(a->width % 4)) {
-			memcpy(buf + offset, (const uint8_t*)a->pointer
-					+ *first*a->stride, batchSize*a->width);
-			offset += batchSize*a->width;
-			continue;
-		}
-		offset += packAttribute(ctx,
+		offset += ctx->packer[i]->direct(
 				(uint32_t *)(buf + offset), a, *first, batchSize);
 	}
 
@@ -454,18 +610,9 @@ static uint32_t copyVerticesTristrip(fimgContext *ctx,
 			continue;
 		}
 		setVtxBufAttrib(ctx, i, offset, (a->width + 3) & ~3, batchSize + 1);
-		if (a->stride == a->width && !(a->width % 4)) {
-			memcpy(buf + offset, (const uint8_t *)a->pointer
-					+ *first*a->stride, batchSize*a->width);
-			offset += batchSize*a->width;
-			memcpy(buf + offset, (const uint8_t *)a->pointer
-					+ (*first + batchSize - 1)*a->stride, 1*a->width);
-			offset += 1*a->width;
-			continue;
-		}
-		offset += packAttribute(ctx,
+		offset += ctx->packer[i]->direct(
 				(uint32_t *)(buf + offset), a, *first, batchSize);
-		offset += packAttribute(ctx,
+		offset += ctx->packer[i]->direct(
 				(uint32_t *)(buf + offset), a, *first + batchSize - 1, 1);
 	}
 
@@ -498,26 +645,13 @@ static uint32_t copyVerticesTrifan(fimgContext *ctx,
 			continue;
 		}
 		setVtxBufAttrib(ctx, i, offset, (a->width + 3) & ~3, batchSize + 2);
-		if (a->stride == a->width && !(a->width % 4)) {
-			memcpy(buf + offset, a->pointer, a->width);
-			offset += a->width;
-			memcpy(buf + offset, a->pointer, a->width);
-			offset += a->width;
-			memcpy(buf + offset, a->pointer, a->width);
-			offset += a->width;
-			memcpy(buf + offset, (const uint8_t *)a->pointer
-						+ (*first + 1)*a->stride,
-						(batchSize - 1)*a->width);
-			offset += (batchSize - 1)*a->width;
-			continue;
-		}
-		offset += packAttribute(ctx,
+		offset += ctx->packer[i]->direct(
 				(uint32_t *)(buf + offset), a, 0, 1);
-		offset += packAttribute(ctx,
+		offset += ctx->packer[i]->direct(
 				(uint32_t *)(buf + offset), a, 0, 1);
-		offset += packAttribute(ctx,
+		offset += ctx->packer[i]->direct(
 				(uint32_t *)(buf + offset), a, 0, 1);
-		offset += packAttribute(ctx,
+		offset += ctx->packer[i]->direct(
 				(uint32_t *)(buf + offset), a,
 						*first + 1, batchSize - 1);
 	}
@@ -554,13 +688,7 @@ static uint32_t copyVerticesTris(fimgContext *ctx, fimgArray *arrays,
 			continue;
 		}
 		setVtxBufAttrib(ctx, i, offset, (a->width + 3) & ~3, batchSize);
-		if (a->stride == a->width && !(a->width % 4)) {
-			memcpy(buf + offset, (const uint8_t *)a->pointer
-					+ *first*a->stride, batchSize*a->width);
-			offset += batchSize*a->width;
-			continue;
-		}
-		offset += packAttribute(ctx,
+		offset += ctx->packer[i]->direct(
 				(uint32_t *)(buf + offset), a, *first, batchSize);
 	}
 
@@ -575,157 +703,6 @@ static uint32_t copyVerticesTris(fimgContext *ctx, fimgArray *arrays,
  * Indexed uint16_t
  */
 
-static uint32_t packAttributeIdx16(fimgContext *ctx, uint32_t *buf,
-				fimgArray *a, const uint16_t *idx, int cnt)
-{
-	register uint32_t word;
-	uint32_t size;
-	uint32_t len;
-
-	if (!cnt)
-		return 0;
-
-	/* Vertices must be word aligned */
-	size = (a->width + 3) & ~3;
-	size *= cnt;
-
-	switch(a->width % 4) {
-	/* words */
-	case 0:
-		/* Check if vertices are word aligned */
-		if ((uintptr_t)a->pointer % 4 == 0 && a->stride % 4 == 0) {
-			const uint32_t *data, *next_data;
-
-			next_data = BUF_ADDR_32(a->pointer, *(idx++)*a->stride);
-			--cnt;
-
-			while (cnt--) {
-				data = next_data;
-				next_data = BUF_ADDR_32(a->pointer,
-							*(idx++)*a->stride);
-				len = a->width;
-
-				while (len) {
-					*(buf++) = *(data++);
-					len -= 4;
-				}
-			}
-
-			data = next_data;
-			len = a->width;
-
-			while (len) {
-				*(buf++) = *(data++);
-				len -= 4;
-			}
-
-			break;
-		}
-	/* halfwords */
-	case 2:
-		/* Check if vertices are halfword aligned */
-		if ((uintptr_t)a->pointer % 2 == 0 && a->stride % 2 == 0) {
-			const uint16_t *data, *next_data;
-
-			next_data = BUF_ADDR_16(a->pointer, *(idx++)*a->stride);
-			--cnt;
-
-			while (cnt--) {
-				data = next_data;
-				next_data = BUF_ADDR_16(a->pointer,
-							*(idx++)*a->stride);
-				len = a->width;
-
-				while (len >= 4) {
-					word = *(data++);
-					word |= *(data++) << 16;
-					*(buf++) = word;
-					len -= 4;
-				}
-
-				/* Single halfword left */
-				if (len)
-					*(buf++) = *(data++);
-			}
-
-			data = next_data;
-			len = a->width;
-
-			while (len >= 4) {
-				word = *(data++);
-				word |= *(data++) << 16;
-				*(buf++) = word;
-				len -= 4;
-			}
-
-			break;
-		}
-	/* bytes */
-	default:
-		/* Fallback - no check required */
-		{
-			const uint8_t *data, *next_data;
-
-			next_data = BUF_ADDR_8(a->pointer, *(idx++)*a->stride);
-			--cnt;
-
-			while (cnt--) {
-				data = next_data;
-				next_data = BUF_ADDR_8(a->pointer,
-							*(idx++)*a->stride);
-				len = a->width;
-
-				while (len >= 4) {
-					word = *(data++);
-					word |= *(data++) << 8;
-					word |= *(data++) << 16;
-					word |= *(data++) << 24;
-					*(buf++) = word;
-					len -= 4;
-				}
-
-				// Up to 3 bytes left
-				if (len) {
-					word = *(data++);
-					if (len == 2)
-						word |= *(data++) << 8;
-					if (len == 3)
-						word |= *(data++) << 16;
-
-					*(buf++) = word;
-				}
-			}
-
-			data = next_data;
-			len = a->width;
-
-			while (len >= 4) {
-				word = *(data++);
-				word |= *(data++) << 8;
-				word |= *(data++) << 16;
-				word |= *(data++) << 24;
-				*(buf++) = word;
-				len -= 4;
-			}
-
-			// Up to 3 bytes left
-			if (len) {
-				word = *(data++);
-				if (len == 2)
-					word |= *(data++) << 8;
-				if (len == 3)
-					word |= *(data++) << 16;
-
-				*(buf++) = word;
-			}
-
-			break;
-		}
-	}
-
-	return size;
-}
-
 static uint32_t copyVertices1To1Idx16(fimgContext *ctx, fimgArray *arrays,
 			const uint16_t *indices, uint32_t *pos, uint32_t *count)
 {
@@ -745,7 +722,7 @@ static uint32_t copyVertices1To1Idx16(fimgContext *ctx, fimgArray *arrays,
 			continue;
 		}
 		setVtxBufAttrib(ctx, i, offset, (a->width + 3) & ~3, batchSize);
-		offset += packAttributeIdx16(ctx, (uint32_t *)(buf + offset),
+		offset += ctx->packer[i]->idx16((uint32_t *)(buf + offset),
 						a, indices + *pos, batchSize);
 	}
 
@@ -778,7 +755,7 @@ static uint32_t copyVerticesLinestripIdx16(fimgContext *ctx, fimgArray *arrays,
 			continue;
 		}
 		setVtxBufAttrib(ctx, i, offset, (a->width + 3) & ~3, batchSize);
-		offset += packAttributeIdx16(ctx, (uint32_t *)(buf + offset),
+		offset += ctx->packer[i]->idx16((uint32_t *)(buf + offset),
 						a, indices + *pos, batchSize);
 	}
 
@@ -815,7 +792,7 @@ static uint32_t copyVerticesLinesIdx16(fimgContext *ctx, fimgArray *arrays,
 			continue;
 		}
 		setVtxBufAttrib(ctx, i, offset, (a->width + 3) & ~3, batchSize);
-		offset += packAttributeIdx16(ctx, (uint32_t *)(buf + offset),
+		offset += ctx->packer[i]->idx16((uint32_t *)(buf + offset),
 						a, indices + *pos, batchSize);
 	}
 
@@ -850,9 +827,9 @@ static uint32_t copyVerticesTristripIdx16(fimgContext *ctx, fimgArray *arrays,
 			continue;
 		}
 		setVtxBufAttrib(ctx, i, offset, (a->width + 3) & ~3, batchSize + 1);
-		offset += packAttributeIdx16(ctx, (uint32_t *)(buf + offset),
+		offset += ctx->packer[i]->idx16((uint32_t *)(buf + offset),
 						a, indices + *pos, batchSize);
-		offset += packAttributeIdx16(ctx, (uint32_t *)(buf + offset),
+		offset += ctx->packer[i]->idx16((uint32_t *)(buf + offset),
 						a, indices + *pos + batchSize - 1, 1);
 	}
 
@@ -885,13 +862,13 @@ static uint32_t copyVerticesTrifanIdx16(fimgContext *ctx, fimgArray *arrays,
 			continue;
 		}
 		setVtxBufAttrib(ctx, i, offset, (a->width + 3) & ~3, batchSize + 2);
-		offset += packAttributeIdx16(ctx,
+		offset += ctx->packer[i]->idx16(
 				(uint32_t *)(buf + offset), a, indices, 1);
-		offset += packAttributeIdx16(ctx,
+		offset += ctx->packer[i]->idx16(
 				(uint32_t *)(buf + offset), a, indices, 1);
-		offset += packAttributeIdx16(ctx,
+		offset += ctx->packer[i]->idx16(
 				(uint32_t *)(buf + offset), a, indices, 1);
-		offset += packAttributeIdx16(ctx, (uint32_t *)(buf + offset),
+		offset += ctx->packer[i]->idx16((uint32_t *)(buf + offset),
 					a, indices + *pos + 1, batchSize - 1);
 	}
 
@@ -927,7 +904,7 @@ static uint32_t copyVerticesTrisIdx16(fimgContext *ctx, fimgArray *arrays,
 			continue;
 		}
 		setVtxBufAttrib(ctx, i, offset, (a->width + 3) & ~3, batchSize);
-		offset += packAttributeIdx16(ctx, (uint32_t *)(buf + offset),
+		offset += ctx->packer[i]->idx16((uint32_t *)(buf + offset),
 						a, indices + *pos, batchSize);
 	}
 
@@ -942,157 +919,6 @@ static uint32_t copyVerticesTrisIdx16(fimgContext *ctx, fimgArray *arrays,
  * Indexed uint8_t
  */
 
-static uint32_t packAttributeIdx8(fimgContext *ctx, uint32_t *buf,
-				fimgArray *a, const uint8_t *idx, int cnt)
-{
-	register uint32_t word;
-	uint32_t size;
-	uint32_t len;
-
-	if (!cnt)
-		return 0;
-
-	/* Vertices must be word aligned */
-	size = (a->width + 3) & ~3;
-	size *= cnt;
-
-	switch(a->width % 4) {
-	/* words */
-	case 0:
-		/* Check if vertices are word aligned */
-		if ((uintptr_t)a->pointer % 4 == 0 && a->stride % 4 == 0) {
-			const uint32_t *data, *next_data;
-
-			next_data = BUF_ADDR_32(a->pointer, *(idx++)*a->stride);
-			--cnt;
-
-			while (cnt--) {
-				data = next_data;
-				next_data = BUF_ADDR_32(a->pointer,
-							*(idx++)*a->stride);
-				len = a->width;
-
-				while (len) {
-					*(buf++) = *(data++);
-					len -= 4;
-				}
-			}
-
-			data = next_data;
-			len = a->width;
-
-			while (len) {
-				*(buf++) = *(data++);
-				len -= 4;
-			}
-
-			break;
-		}
-	/* halfwords */
-	case 2:
-		/* Check if vertices are halfword aligned */
-		if ((uintptr_t)a->pointer % 2 == 0 && a->stride % 2 == 0) {
-			const uint16_t *data, *next_data;
-
-			next_data = BUF_ADDR_16(a->pointer, *(idx++)*a->stride);
-			--cnt;
-
-			while (cnt--) {
-				data = next_data;
-				next_data = BUF_ADDR_16(a->pointer,
-							*(idx++)*a->stride);
-				len = a->width;
-
-				while (len >= 4) {
-					word = *(data++);
-					word |= *(data++) << 16;
-					*(buf++) = word;
-					len -= 4;
-				}
-
-				/* Single halfword left */
-				if (len)
-					*(buf++) = *(data++);
-			}
-
-			data = next_data;
-			len = a->width;
-
-			while (len >= 4) {
-				word = *(data++);
-				word |= *(data++) << 16;
-				*(buf++) = word;
-				len -= 4;
-			}
-
-			break;
-		}
-	/* bytes */
-	default:
-		/* Fallback - no check required */
-		{
-			const uint8_t *data, *next_data;
-
-			next_data = BUF_ADDR_8(a->pointer, *(idx++)*a->stride);
-			--cnt;
-
-			while (cnt--) {
-				data = next_data;
-				next_data = BUF_ADDR_8(a->pointer,
-							*(idx++)*a->stride);
-				len = a->width;
-
-				while (len >= 4) {
-					word = *(data++);
-					word |= *(data++) << 8;
-					word |= *(data++) << 16;
-					word |= *(data++) << 24;
-					*(buf++) = word;
-					len -= 4;
-				}
-
-				// Up to 3 bytes left
-				if (len) {
-					word = *(data++);
-					if (len == 2)
-						word |= *(data++) << 8;
-					if (len == 3)
-						word |= *(data++) << 16;
-
-					*(buf++) = word;
-				}
-			}
-
-			data = next_data;
-			len = a->width;
-
-			while (len >= 4) {
-				word = *(data++);
-				word |= *(data++) << 8;
-				word |= *(data++) << 16;
-				word |= *(data++) << 24;
-				*(buf++) = word;
-				len -= 4;
-			}
-
-			// Up to 3 bytes left
-			if (len) {
-				word = *(data++);
-				if (len == 2)
-					word |= *(data++) << 8;
-				if (len == 3)
-					word |= *(data++) << 16;
-
-				*(buf++) = word;
-			}
-
-			break;
-		}
-	}
-
-	return size;
-}
-
 static uint32_t copyVertices1To1Idx8(fimgContext *ctx, fimgArray *arrays,
 			const uint8_t *indices, uint32_t *pos, uint32_t *count)
 {
@@ -1112,7 +938,7 @@ static uint32_t copyVertices1To1Idx8(fimgContext *ctx, fimgArray *arrays,
 			continue;
 		}
 		setVtxBufAttrib(ctx, i, offset, (a->width + 3) & ~3, batchSize);
-		offset += packAttributeIdx8(ctx, (uint32_t *)(buf + offset),
+		offset += ctx->packer[i]->idx8((uint32_t *)(buf + offset),
 						a, indices + *pos, batchSize);
 	}
 
@@ -1145,7 +971,7 @@ static uint32_t copyVerticesLinestripIdx8(fimgContext *ctx, fimgArray *arrays,
 			continue;
 		}
 		setVtxBufAttrib(ctx, i, offset, (a->width + 3) & ~3, batchSize);
-		offset += packAttributeIdx8(ctx, (uint32_t *)(buf + offset),
+		offset += ctx->packer[i]->idx8((uint32_t *)(buf + offset),
 						a, indices + *pos, batchSize);
 	}
 
@@ -1182,7 +1008,7 @@ static uint32_t copyVerticesLinesIdx8(fimgContext *ctx, fimgArray *arrays,
 			continue;
 		}
 		setVtxBufAttrib(ctx, i, offset, (a->width + 3) & ~3, batchSize);
-		offset += packAttributeIdx8(ctx, (uint32_t *)(buf + offset),
+		offset += ctx->packer[i]->idx8((uint32_t *)(buf + offset),
 						a, indices + *pos, batchSize);
 	}
 
@@ -1217,9 +1043,9 @@ static uint32_t copyVerticesTristripIdx8(fimgContext *ctx, fimgArray *arrays,
 			continue;
 		}
 		setVtxBufAttrib(ctx, i, offset, (a->width + 3) & ~3, batchSize + 1);
-		offset += packAttributeIdx8(ctx, (uint32_t *)(buf + offset),
+		offset += ctx->packer[i]->idx8((uint32_t *)(buf + offset),
 						a, indices + *pos, batchSize);
-		offset += packAttributeIdx8(ctx, (uint32_t *)(buf + offset),
+		offset += ctx->packer[i]->idx8((uint32_t *)(buf + offset),
 						a, indices + *pos + batchSize - 1, 1);
 	}
 
@@ -1252,13 +1078,13 @@ static uint32_t copyVerticesTrifanIdx8(fimgContext *ctx, fimgArray *arrays,
 			continue;
 		}
 		setVtxBufAttrib(ctx, i, offset, (a->width + 3) & ~3, batchSize + 2);
-		offset += packAttributeIdx8(ctx,
+		offset += ctx->packer[i]->idx8(
 				(uint32_t *)(buf + offset), a, indices, 1);
-		offset += packAttributeIdx8(ctx,
+		offset += ctx->packer[i]->idx8(
 				(uint32_t *)(buf + offset), a, indices, 1);
-		offset += packAttributeIdx8(ctx,
+		offset += ctx->packer[i]->idx8(
 				(uint32_t *)(buf + offset), a, indices, 1);
-		offset += packAttributeIdx8(ctx, (uint32_t *)(buf + offset),
+		offset += ctx->packer[i]->idx8((uint32_t *)(buf + offset),
 					a, indices + *pos + 1, batchSize - 1);
 	}
 
@@ -1294,7 +1120,7 @@ static uint32_t copyVerticesTrisIdx8(fimgContext *ctx, fimgArray *arrays,
 			continue;
 		}
 		setVtxBufAttrib(ctx, i, offset, (a->width + 3) & ~3, batchSize);
-		offset += packAttributeIdx8(ctx, (uint32_t *)(buf + offset),
+		offset += ctx->packer[i]->idx8((uint32_t *)(buf + offset),
 						a, indices + *pos, batchSize);
 	}
 
@@ -1372,6 +1198,205 @@ static inline void drawAutoinc(fimgContext *ctx,
 	fimgWrite(ctx, first, FGHI_FIFO_ENTRY);
 }
 
+#ifdef FIMG_INDEXED_VERTEX_REUSE
+/*
+ * Indexed triangle lists with vertex reuse
+ *
+ * Every vertex referenced by a batch is packed only once and the hardware
+ * is fed with indices remapped to the batch-local vertex table, instead of
+ * expanding all the indices into full vertices. Poorly ordered triangles
+ * share few vertices within a batch, so a batch is only sent this way if
+ * its unique vertices and indices take less space than expanded vertices.
+ */
+
+#define REUSE_HASH_SIZE		2048
+#define REUSE_HASH_MASK		(REUSE_HASH_SIZE - 1)
+#define REUSE_MAX_INDICES	(3*1024)
+
+struct _fimgReuseState {
+	uint16_t generation;
+	uint16_t tag[REUSE_HASH_SIZE];
+	uint16_t source[REUSE_HASH_SIZE];
+	uint16_t local[REUSE_HASH_SIZE];
+	uint16_t vertices[VERTEX_BUFFER_WORDS];
+	uint32_t indices[REUSE_MAX_INDICES];
+	uint32_t numIndices;	/* 0 if the batch has been expanded */
+};
+
+static void prepareReuseState(fimgContext *ctx)
+{
+	if (ctx->reuse)
+		return;
+
+	ctx->reuse = calloc(1, sizeof(*ctx->reuse));
+	if (!ctx->reuse) {
+		ALOGE("Failed to allocate vertex reuse state. Terminating.");
+		exit(ENOMEM);
+	}
+}
+
+static inline void resetReuseTable(fimgReuseState *r)
+{
+	if (!++r->generation) {
+		memset(r->tag, 0, sizeof(r->tag));
+		r->generation = 1;
+	}
+}
+
+/* Returns batch-local index of the vertex or -1 if it has to be added */
+static inline int lookupReuseTable(fimgReuseState *r, uint16_t index,
+							unsigned int *slot)
+{
+	unsigned int h = (index * 2654435761U) >> 21;
+
+	for (;; ++h) {
+		h &= REUSE_HASH_MASK;
+
+		if (r->tag[h] != r->generation) {
+			*slot = h;
+			return -1;
+		}
+
+		if (r->source[h] == index)
+			return r->local[h];
+	}
+}
+
+#define DEFINE_COPY_TRIS_REUSE(name, type)				\
+static uint32_t name(fimgContext *ctx, fimgArray *arrays,		\
+		const type *indices, uint32_t *pos, uint32_t *count)	\
+{									\
+	fimgReuseState *r = ctx->reuse;					\
+	fimgArray *a = arrays;						\
+	uint32_t maxVertices = calculateBatchSize(arrays, ctx->numAttribs);\
+	uint32_t numVertices = 0;					\
+	uint32_t numIndices = 0;					\
+	uint32_t vertexSize = 0;					\
+	uint32_t offset = DATA_OFFSET;					\
+	uint8_t *buf = ctx->vertexData;					\
+	const type *idx = indices + *pos;				\
+	uint32_t i, j;							\
+									\
+	if (*count < 3)							\
+		return 0;						\
+									\
+	if (maxVertices > VERTEX_BUFFER_WORDS)				\
+		maxVertices = VERTEX_BUFFER_WORDS;			\
+									\
+	for (i = 0; i < ctx->numAttribs; ++i)				\
+		if (arrays[i].stride)					\
+			vertexSize += (arrays[i].width + 3) & ~3;	\
+									\
+	resetReuseTable(r);						\
+									\
+	while (numIndices + 3 <= *count					\
+	    && numIndices + 3 <= REUSE_MAX_INDICES) {			\
+		unsigned int slot[3];					\
+		int local[3];						\
+		uint32_t added = 0;					\
+									\
+		for (j = 0; j < 3; ++j) {				\
+			local[j] = lookupReuseTable(r,			\
+						idx[j], &slot[j]);	\
+			if (local[j] < 0)				\
+				++added;				\
+		}							\
+									\
+		if (numVertices + added > maxVertices)			\
+			break;						\
+									\
+		for (j = 0; j < 3; ++j) {				\
+			if (local[j] < 0) {				\
+				/* Might have been added by previous one */\
+				local[j] = lookupReuseTable(r,		\
+						idx[j], &slot[j]);	\
+			}						\
+			if (local[j] < 0) {				\
+				r->tag[slot[j]] = r->generation;	\
+				r->source[slot[j]] = idx[j];		\
+				r->local[slot[j]] = numVertices;	\
+				r->vertices[numVertices] = idx[j];	\
+				local[j] = numVertices++;		\
+			}						\
+			r->indices[numIndices++] = local[j];		\
+		}							\
+									\
+		idx += 3;						\
+	}								\
+									\
+	/* Every index takes a word of the FIFO */			\
+	if (numVertices * vertexSize + 4 * numIndices			\
+					>= numIndices * vertexSize) {	\
+		idx = indices + *pos;					\
+		if (numIndices > maxVertices)				\
+			numIndices = maxVertices - maxVertices % 3;	\
+		for (j = 0; j < numIndices; ++j)			\
+			r->vertices[j] = idx[j];			\
+		numVertices = numIndices;				\
+		r->numIndices = 0;					\
+	} else {							\
+		r->numIndices = numIndices;				\
+	}								\
+									\
+	for (i = 0; i < ctx->numAttribs; ++i, ++a) {			\
+		if (!a->stride) {					\
+			setVtxBufAttrib(ctx, i, CONST_ADDR(i), 0, numVertices);\
+			memcpy(buf + CONST_ADDR(i), a->pointer, a->width);\
+			continue;					\
+		}							\
+		setVtxBufAttrib(ctx, i, offset,				\
+				(a->width + 3) & ~3, numVertices);	\
+		offset += ctx->packer[i]->idx16(			\
+				(uint32_t *)(buf + offset), a,		\
+				r->vertices, numVertices);		\
+	}								\
+									\
+	ctx->vertexDataSize = offset;					\
+									\
+	*pos += numIndices;						\
+	*count -= numIndices;						\
+	return numIndices;						\
+}
+
+DEFINE_COPY_TRIS_REUSE(copyVerticesTrisReuseIdx8, uint8_t)
+DEFINE_COPY_TRIS_REUSE(copyVerticesTrisReuseIdx16, uint16_t)
+
+static void drawIndexed(fimgContext *ctx, const uint32_t *indices,
+							uint32_t count)
+{
+	uint32_t space;
+
+	/* FIFO is empty at this point */
+	fimgWrite(ctx, count, FGHI_FIFO_ENTRY);
+
+	while (count) {
+		space = fimgRead(ctx, FGHI_DWSPACE);
+		if (!space)
+			continue;
+
+		if (space > count)
+			space = count;
+		count -= space;
+
+		while (space--)
+			fimgWrite(ctx, *(indices++), FGHI_FIFO_ENTRY);
+	}
+}
+
+static void setIndexedMode(fimgContext *ctx, int enable)
+{
+	fimgHInterface control = ctx->host.control;
+
+	if (enable) {
+		control.autoinc = 0;
+		control.idxtype = FGHI_CONTROLIdxTYPE_UINT;
+	}
+
+	fimgSelectiveFlush(ctx, FGHI_HAZARD_HOST);
+	fimgWrite(ctx, control.val, FGHI_CONTROL);
+}
+#endif /* FIMG_INDEXED_VERTEX_REUSE */
+
 static void setupAttributes(fimgContext *ctx, fimgArray *arrays)
 {
 	fimgAttribute last;
@@ -1397,6 +1422,34 @@ static void setupVertexBuffer(fimgContext *ctx)
 	}
 }
 
+static void prepareVertexData(fimgContext *ctx)
+{
+	if (ctx->vertexData)
+		return;
+
+	ctx->vertexData = memalign(32, VERTEX_BUFFER_SIZE);
+	if (!ctx->vertexData) {
+		ALOGE("Failed to allocate vertex data buffer. Terminating.");
+		exit(ENOMEM);
+	}
+}
+
+/*
+ * Batches are uploaded by CPU, so the staging buffer is free again as soon
+ * as uploadVertexData() returns and next batch is packed while hardware
+ * still processes previous one. Only the host interface has to be done
+ * with the hardware vertex buffer before it can be filled again.
+ */
+static inline void waitForVertexBuffer(fimgContext *ctx)
+{
+#ifdef FIMG_SELECTIVE_VERTEX_FLUSH
+	fimgSelectiveFlush(ctx, FGHI_PIPELINE_FIFO
+				| FGHI_PIPELINE_HOSTIF | FGHI_PIPELINE_HVF);
+#else
+	fimgFlush(ctx);
+#endif
+}
+
 void fimgDrawArrays(fimgContext *ctx, unsigned int mode,
 					fimgArray *arrays, unsigned int count)
 {
@@ -1411,13 +1464,9 @@ void fimgDrawArrays(fimgContext *ctx, unsigned int mode,
 		return;
 	}
 
-	if (!ctx->vertexData) {
-		ctx->vertexData = memalign(32, VERTEX_BUFFER_SIZE);
-		if (!ctx->vertexData) {
-			ALOGE("Failed to allocate vertex data buffer. Terminating.");
-			exit(ENOMEM);
-		}
-	}
+	prepareVertexData(ctx);
+
+	selectPackers(ctx, arrays);
 
 	/* Prepare first batch without waiting for hardware */
 	copied = primitiveHandler[mode].direct(ctx, arrays, &first, &count);
@@ -1426,8 +1475,8 @@ void fimgDrawArrays(fimgContext *ctx, unsigned int mode,
 
 	/* Get hardware */
 	fimgGetHardware(ctx);
-	fimgFlush(ctx);
 	fimgFlushContext(ctx);
+	fimgSelectiveFlush(ctx, FGHI_HAZARD_PRIMITIVE);
 	fimgSetVertexContext(ctx, mode);
 
 	setupAttributes(ctx, arrays);
@@ -1436,12 +1485,7 @@ void fimgDrawArrays(fimgContext *ctx, unsigned int mode,
 #endif
 
 	do {
-#if 0
-		fimgSelectiveFlush(ctx, FGHI_PIPELINE_FIFO
-				| FGHI_PIPELINE_HOSTIF | FGHI_PIPELINE_HVF);
-#else
-		fimgFlush(ctx);
-#endif
+		waitForVertexBuffer(ctx);
 		fillVertexBuffer(ctx);
 		setupVertexBuffer(ctx);
 		drawAutoinc(ctx, 0, copied);
@@ -1453,6 +1497,61 @@ void fimgDrawArrays(fimgContext *ctx, unsigned int mode,
 	fimgPutHardware(ctx);
 }
 
+#ifdef FIMG_INDEXED_VERTEX_REUSE
+#define DEFINE_DRAW_TRIS_REUSE(name, type, copy)			\
+static void name(fimgContext *ctx, fimgArray *arrays,			\
+				unsigned int count, const type *indices)\
+{									\
+	unsigned int copied;						\
+	unsigned int pos = 0;						\
+	int indexed = 0;						\
+									\
+	prepareVertexData(ctx);						\
+	prepareReuseState(ctx);						\
+	selectPackers(ctx, arrays);					\
+									\
+	/* Prepare first batch without waiting for hardware */		\
+	copied = copy(ctx, arrays, indices, &pos, &count);		\
+	if (!copied)							\
+		return;							\
+									\
+	/* Get hardware */						\
+	fimgGetHardware(ctx);						\
+	fimgFlushContext(ctx);						\
+	fimgSelectiveFlush(ctx, FGHI_HAZARD_PRIMITIVE);			\
+	fimgSetVertexContext(ctx, FGPE_TRIANGLES);			\
+									\
+	setupAttributes(ctx, arrays);					\
+									\
+	do {								\
+		waitForVertexBuffer(ctx);				\
+		fillVertexBuffer(ctx);					\
+		setupVertexBuffer(ctx);					\
+		/* Expanded batches are drawn as usual */		\
+		if (indexed != !!ctx->reuse->numIndices) {		\
+			indexed = !indexed;				\
+			setIndexedMode(ctx, indexed);			\
+		}							\
+		if (indexed)						\
+			drawIndexed(ctx, ctx->reuse->indices, copied);	\
+		else							\
+			drawAutoinc(ctx, 0, copied);			\
+		copied = copy(ctx, arrays, indices, &pos, &count);	\
+	} while (copied);						\
+									\
+	if (indexed)							\
+		setIndexedMode(ctx, 0);					\
+									\
+	/* Release hardware */						\
+	fimgPutHardware(ctx);						\
+}
+
+DEFINE_DRAW_TRIS_REUSE(drawTrisReuseIdx8, uint8_t,
+					copyVerticesTrisReuseIdx8)
+DEFINE_DRAW_TRIS_REUSE(drawTrisReuseIdx16, uint16_t,
+					copyVerticesTrisReuseIdx16)
+#endif /* FIMG_INDEXED_VERTEX_REUSE */
+
 void fimgDrawElementsUByteIdx(fimgContext *ctx, unsigned int mode,
 		fimgArray *arrays, unsigned int count, const uint8_t *indices)
 {
@@ -1462,18 +1561,21 @@ void fimgDrawElementsUByteIdx(fimgContext *ctx, unsigned int mode,
 	if (mode >= FGPE_PRIMITIVE_MAX)
 		return;
 
+#ifdef FIMG_INDEXED_VERTEX_REUSE
+	if (mode == FGPE_TRIANGLES) {
+		drawTrisReuseIdx8(ctx, arrays, count, indices);
+		return;
+	}
+#endif
+
 	if (!primitiveHandler[mode].indexed_8) {
 		ALOGE("%s: Unsupported mode %d", __func__, mode);
 		return;
 	}
 
-	if (!ctx->vertexData) {
-		ctx->vertexData = memalign(32, VERTEX_BUFFER_SIZE);
-		if (!ctx->vertexData) {
-			ALOGE("Failed to allocate vertex data buffer. Terminating.");
-			exit(ENOMEM);
-		}
-	}
+	prepareVertexData(ctx);
+
+	selectPackers(ctx, arrays);
 
 	/* Prepare first batch without waiting for hardware */
 	copied = primitiveHandler[mode].indexed_8(ctx,
@@ -1483,8 +1585,8 @@ void fimgDrawElementsUByteIdx(fimgContext *ctx, unsigned int mode,
 
 	/* Get hardware */
 	fimgGetHardware(ctx);
-	fimgFlush(ctx);
 	fimgFlushContext(ctx);
+	fimgSelectiveFlush(ctx, FGHI_HAZARD_PRIMITIVE);
 	fimgSetVertexContext(ctx, mode);
 
 	setupAttributes(ctx, arrays);
@@ -1493,12 +1595,7 @@ void fimgDrawElementsUByteIdx(fimgContext *ctx, unsigned int mode,
 #endif
 
 	do {
-#if 0
-		fimgSelectiveFlush(ctx, FGHI_PIPELINE_FIFO
-				| FGHI_PIPELINE_HOSTIF | FGHI_PIPELINE_HVF);
-#else
-		fimgFlush(ctx);
-#endif
+		waitForVertexBuffer(ctx);
 		fillVertexBuffer(ctx);
 		setupVertexBuffer(ctx);
 		drawAutoinc(ctx, 0, copied);
@@ -1519,18 +1616,21 @@ void fimgDrawElementsUShortIdx(fimgContext *ctx, unsigned int mode,
 	if (mode >= FGPE_PRIMITIVE_MAX)
 		return;
 
+#ifdef FIMG_INDEXED_VERTEX_REUSE
+	if (mode == FGPE_TRIANGLES) {
+		drawTrisReuseIdx16(ctx, arrays, count, indices);
+		return;
+	}
+#endif
+
 	if (!primitiveHandler[mode].indexed_16) {
 		ALOGE("%s: Unsupported mode %d", __func__, mode);
 		return;
 	}
 
-	if (!ctx->vertexData) {
-		ctx->vertexData = memalign(32, VERTEX_BUFFER_SIZE);
-		if (!ctx->vertexData) {
-			ALOGE("Failed to allocate vertex data buffer. Terminating.");
-			exit(ENOMEM);
-		}
-	}
+	prepareVertexData(ctx);
+
+	selectPackers(ctx, arrays);
 
 	/* Prepare first batch without waiting for hardware */
 	copied = primitiveHandler[mode].indexed_16(ctx,
@@ -1540,8 +1640,8 @@ void fimgDrawElementsUShortIdx(fimgContext *ctx, unsigned int mode,
 
 	/* Get hardware */
 	fimgGetHardware(ctx);
-	fimgFlush(ctx);
 	fimgFlushContext(ctx);
+	fimgSelectiveFlush(ctx, FGHI_HAZARD_PRIMITIVE);
 	fimgSetVertexContext(ctx, mode);
 
 	setupAttributes(ctx, arrays);
@@ -1550,12 +1650,7 @@ void fimgDrawElementsUShortIdx(fimgContext *ctx, unsigned int mode,
 #endif
 
 	do {
-#if 0
-		fimgSelectiveFlush(ctx, FGHI_PIPELINE_FIFO
-				| FGHI_PIPELINE_HOSTIF | FGHI_PIPELINE_HVF);
-#else
-		fimgFlush(ctx);
-#endif
+		waitForVertexBuffer(ctx);
 		fillVertexBuffer(ctx);
 		setupVertexBuffer(ctx);
 		drawAutoinc(ctx, 0, copied);
@@ -1567,6 +1662,237 @@ void fimgDrawElementsUShortIdx(fimgContext *ctx, unsigned int mode,
 	fimgPutHardware(ctx);
 }
 
+/*
+ * Vertex cache
+ *
+ * Batches of static geometry are packed once and kept in hardware layout,
+ * so drawing them again is just a burst copy into the vertex buffer.
+ * Only constant attributes have to be updated, as they can change between
+ * draw calls.
+ */
+
+#define VERTEX_CACHE_ENTRIES	4
+
+typedef struct {
+	uint32_t *data;
+	uint32_t size;
+	uint32_t count;
+	fimgVtxBufAttrib vbctrl[FIMG_ATTRIB_NUM];
+	unsigned int vbbase[FIMG_ATTRIB_NUM];
+} fimgVertexBatch;
+
+typedef struct {
+	/* Key */
+	unsigned int mode;
+	unsigned int count;
+	unsigned int numAttribs;
+	fimgArray arrays[FIMG_ATTRIB_NUM];
+	/* Packed data */
+	fimgVertexBatch *batches;
+	unsigned int numBatches;
+} fimgVertexCacheEntry;
+
+struct _fimgVertexCache {
+	fimgVertexCacheEntry entry[VERTEX_CACHE_ENTRIES];
+	unsigned int evictCounter;
+};
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCreateVertexCache
+ * SYNOPSIS:	This function creates an empty cache of packed vertex batches
+ * RETURNS:	Pointer to created cache, NULL on failure
+ *****************************************************************************/
+fimgVertexCache *fimgCreateVertexCache(void)
+{
+	return calloc(1, sizeof(fimgVertexCache));
+}
+
+static void freeVertexCacheEntry(fimgVertexCacheEntry *e)
+{
+	unsigned int i;
+
+	if (!e->batches)
+		return;
+
+	for (i = 0; i < e->numBatches; ++i)
+		free(e->batches[i].data);
+
+	free(e->batches);
+	e->batches = NULL;
+	e->numBatches = 0;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgInvalidateVertexCache
+ * SYNOPSIS:	This function drops all batches from vertex cache
+ *		(must be called whenever source data changes)
+ *****************************************************************************/
+void fimgInvalidateVertexCache(fimgVertexCache *vc)
+{
+	unsigned int i;
+
+	if (!vc)
+		return;
+
+	for (i = 0; i < VERTEX_CACHE_ENTRIES; ++i)
+		freeVertexCacheEntry(&vc->entry[i]);
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgDestroyVertexCache
+ * SYNOPSIS:	This function destroys vertex cache
+ *****************************************************************************/
+void fimgDestroyVertexCache(fimgVertexCache *vc)
+{
+	fimgInvalidateVertexCache(vc);
+	free(vc);
+}
+
+static int compareVertexCacheEntry(fimgVertexCacheEntry *e,
+		unsigned int mode, fimgArray *arrays, unsigned int count,
+		unsigned int numAttribs)
+{
+	unsigned int i;
+
+	if (!e->batches || e->mode != mode || e->count != count
+	    || e->numAttribs != numAttribs)
+		return 0;
+
+	for (i = 0; i < numAttribs; ++i) {
+		if (e->arrays[i].stride != arrays[i].stride
+		    || e->arrays[i].width != arrays[i].width)
+			return 0;
+
+		/* Constants are updated on every draw */
+		if (arrays[i].stride && e->arrays[i].pointer != arrays[i].pointer)
+			return 0;
+	}
+
+	return 1;
+}
+
+static fimgVertexCacheEntry *recordVertexCacheEntry(fimgContext *ctx,
+		fimgVertexCache *vc, unsigned int mode, fimgArray *arrays,
+		unsigned int count)
+{
+	fimgVertexCacheEntry *e = &vc->entry[vc->evictCounter];
+	unsigned int first = 0;
+	unsigned int maxBatches = 0;
+	unsigned int copied;
+
+	vc->evictCounter = (vc->evictCounter + 1) % VERTEX_CACHE_ENTRIES;
+	freeVertexCacheEntry(e);
+
+	e->mode = mode;
+	e->count = count;
+	e->numAttribs = ctx->numAttribs;
+	memcpy(e->arrays, arrays, ctx->numAttribs * sizeof(*arrays));
+
+	while ((copied = primitiveHandler[mode].direct(ctx,
+						arrays, &first, &count))) {
+		fimgVertexBatch *b;
+
+		if (e->numBatches == maxBatches) {
+			maxBatches = maxBatches ? 2*maxBatches : 4;
+			b = realloc(e->batches, maxBatches * sizeof(*b));
+			if (!b)
+				goto fail;
+			e->batches = b;
+		}
+
+		b = &e->batches[e->numBatches];
+		b->data = memalign(32, (ctx->vertexDataSize + 31) & ~31);
+		if (!b->data)
+			goto fail;
+		++e->numBatches;
+
+		memcpy(b->data, ctx->vertexData, ctx->vertexDataSize);
+		b->size = ctx->vertexDataSize;
+		ctx->stats.bytesPacked += b->size;
+		b->count = copied;
+		memcpy(b->vbctrl, ctx->host.vbctrl, sizeof(b->vbctrl));
+		memcpy(b->vbbase, ctx->host.vbbase, sizeof(b->vbbase));
+	}
+
+	return e;
+
+fail:
+	ALOGW("Failed to allocate vertex cache batch.");
+	freeVertexCacheEntry(e);
+	return NULL;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgDrawArraysCached
+ * SYNOPSIS:	This function draws static geometry using packed batches
+ *		stored in given vertex cache, packing them on first use
+ *****************************************************************************/
+void fimgDrawArraysCached(fimgContext *ctx, fimgVertexCache *vc,
+		unsigned int mode, fimgArray *arrays, unsigned int count)
+{
+	fimgVertexCacheEntry *e = NULL;
+	unsigned int i, j;
+
+	if (!vc || mode >= FGPE_PRIMITIVE_MAX
+	    || !primitiveHandler[mode].direct) {
+		fimgDrawArrays(ctx, mode, arrays, count);
+		return;
+	}
+
+	prepareVertexData(ctx);
+
+	for (i = 0; i < VERTEX_CACHE_ENTRIES; ++i) {
+		if (compareVertexCacheEntry(&vc->entry[i], mode,
+					arrays, count, ctx->numAttribs)) {
+			e = &vc->entry[i];
+			break;
+		}
+	}
+
+	if (!e) {
+		selectPackers(ctx, arrays);
+		e = recordVertexCacheEntry(ctx, vc, mode, arrays, count);
+		if (!e) {
+			fimgDrawArrays(ctx, mode, arrays, count);
+			return;
+		}
+	}
+
+	if (!e->numBatches)
+		return;
+
+	/* Get hardware */
+	fimgGetHardware(ctx);
+	fimgFlushContext(ctx);
+	fimgSelectiveFlush(ctx, FGHI_HAZARD_PRIMITIVE);
+	fimgSetVertexContext(ctx, mode);
+
+	setupAttributes(ctx, arrays);
+#ifdef FIMG_DUMP_STATE_BEFORE_DRAW
+	fimgDumpState(ctx, mode, count, __func__);
+#endif
+
+	for (i = 0; i < e->numBatches; ++i) {
+		fimgVertexBatch *b = &e->batches[i];
+
+		for (j = 0; j < ctx->numAttribs; ++j)
+			if (!arrays[j].stride)
+				memcpy((uint8_t *)b->data + CONST_ADDR(j),
+					arrays[j].pointer, arrays[j].width);
+
+		memcpy(ctx->host.vbctrl, b->vbctrl, sizeof(b->vbctrl));
+		memcpy(ctx->host.vbbase, b->vbbase, sizeof(b->vbbase));
+
+		waitForVertexBuffer(ctx);
+		uploadVertexData(ctx, b->data, b->size);
+		setupVertexBuffer(ctx);
+		drawAutoinc(ctx, 0, b->count);
+	}
+
+	/* Release hardware */
+	fimgPutHardware(ctx);
+}
+
 /*
  * Context management
  */
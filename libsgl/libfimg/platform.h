@@ -47,6 +47,11 @@
 #define LOGD(fmt, ...)	\
 		pr_log(LOG_DBG, __FILE__, __LINE__, fmt, ##__VA_ARGS__)
 
+#define ALOGE	LOGE
+#define ALOGW	LOGW
+#define ALOGI	LOGI
+#define ALOGD	LOGD
+
 #endif
 
 #ifndef HAVE___SYNC_SYNCHRONIZE
@@ -149,10 +149,10 @@ void fimgCreatePrimitiveContext(fimgContext *ctx)
 void fimgRestorePrimitiveState(fimgContext *ctx)
 {
 	fimgWrite(ctx, ctx->primitive.vctx.val, FGPE_VERTEX_CONTEXT);
-	fimgWriteF(ctx, ctx->primitive.ox, FGPE_VIEWPORT_OX);
-	fimgWriteF(ctx, ctx->primitive.oy, FGPE_VIEWPORT_OY);
-	fimgWriteF(ctx, ctx->primitive.halfPX, FGPE_VIEWPORT_HALF_PX);
-	fimgWriteF(ctx, ctx->primitive.halfPY, FGPE_VIEWPORT_HALF_PY);
-	fimgWriteF(ctx, ctx->primitive.halfDistance, FGPE_DEPTHRANGE_HALF_F_SUB_N);
-	fimgWriteF(ctx, ctx->primitive.center, FGPE_DEPTHRANGE_HALF_F_ADD_N);
+	fimgQueueF(ctx, ctx->primitive.ox, FGPE_VIEWPORT_OX);
+	fimgQueueF(ctx, ctx->primitive.oy, FGPE_VIEWPORT_OY);
+	fimgQueueF(ctx, ctx->primitive.halfPX, FGPE_VIEWPORT_HALF_PX);
+	fimgQueueF(ctx, ctx->primitive.halfPY, FGPE_VIEWPORT_HALF_PY);
+	fimgQueueF(ctx, ctx->primitive.halfDistance, FGPE_DEPTHRANGE_HALF_F_SUB_N);
+	fimgQueueF(ctx, ctx->primitive.center, FGPE_DEPTHRANGE_HALF_F_ADD_N);
 }
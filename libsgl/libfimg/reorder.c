@@ -0,0 +1,266 @@
+/*
+ * fimg/reorder.c
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE TRIANGLE ORDER OPTIMIZATION
+ *
+ * Copyrights:	2013 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "fimg_private.h"
+
+/*
+ * Triangle lists are reordered using the algorithm described by Tom Forsyth
+ * in "Linear-Speed Vertex Cache Optimisation". Triangles sharing vertices
+ * end up close to each other, so more of them fit into single batch of
+ * unique vertices and the vertex cache of the GPU gets more hits.
+ */
+
+#define CACHE_SIZE		32
+#define MAX_VALENCE		32
+#define LAST_TRI_SCORE		(0.75f)
+#define VALENCE_BOOST_SCALE	(2.0f)
+
+static float cacheScore[CACHE_SIZE];
+static float valenceScore[MAX_VALENCE];
+static int scoresReady;
+
+static void initScores(void)
+{
+	float x;
+	int i;
+
+	for (i = 0; i < CACHE_SIZE; ++i) {
+		if (i < 3) {
+			/* Vertices of last triangle */
+			cacheScore[i] = LAST_TRI_SCORE;
+			continue;
+		}
+
+		x = 1.0f - (float)(i - 3) / (CACHE_SIZE - 3);
+		cacheScore[i] = x * sqrtf(x);
+	}
+
+	valenceScore[0] = 0.0f;
+	for (i = 1; i < MAX_VALENCE; ++i)
+		valenceScore[i] = VALENCE_BOOST_SCALE / sqrtf(i);
+
+	scoresReady = 1;
+}
+
+static inline float vertexScore(int cachePos, unsigned int remaining)
+{
+	float score = 0.0f;
+
+	if (!remaining)
+		return -1.0f;
+
+	if (cachePos >= 0)
+		score = cacheScore[cachePos];
+
+	if (remaining >= MAX_VALENCE)
+		remaining = MAX_VALENCE - 1;
+
+	return score + valenceScore[remaining];
+}
+
+static int optimizeTriangles(uint16_t *indices, unsigned int count)
+{
+	unsigned int numTris = count / 3;
+	unsigned int numVerts = 0;
+	unsigned int *triOffset = NULL;
+	unsigned int *vertTris = NULL;
+	unsigned int *remaining = NULL;
+	int *cachePos = NULL;
+	uint8_t *added = NULL;
+	uint16_t *out = NULL;
+	unsigned int cache[CACHE_SIZE + 3];
+	unsigned int cacheLen = 0;
+	unsigned int outTris = 0;
+	unsigned int cursor = 0;
+	int best = -1;
+	unsigned int i, j, k;
+	int ret = -1;
+
+	if (numTris < 2)
+		return 0;
+
+	if (!scoresReady)
+		initScores();
+
+	for (i = 0; i < 3*numTris; ++i)
+		if (indices[i] >= numVerts)
+			numVerts = indices[i] + 1;
+
+	triOffset = calloc(numVerts + 1, sizeof(*triOffset));
+	remaining = calloc(numVerts, sizeof(*remaining));
+	cachePos = malloc(numVerts * sizeof(*cachePos));
+	vertTris = malloc(3 * numTris * sizeof(*vertTris));
+	added = calloc(numTris, sizeof(*added));
+	out = malloc(3 * numTris * sizeof(*out));
+	if (!triOffset || !remaining || !cachePos || !vertTris
+	    || !added || !out)
+		goto out;
+
+	/* Build vertex to triangle adjacency */
+	for (i = 0; i < 3*numTris; ++i)
+		++remaining[indices[i]];
+
+	for (i = 0; i < numVerts; ++i) {
+		triOffset[i + 1] = triOffset[i] + remaining[i];
+		remaining[i] = 0;
+		cachePos[i] = -1;
+	}
+
+	for (i = 0; i < 3*numTris; ++i) {
+		unsigned int v = indices[i];
+		vertTris[triOffset[v] + remaining[v]++] = i / 3;
+	}
+
+	while (outTris < numTris) {
+		unsigned int newCache[CACHE_SIZE + 3];
+		unsigned int newLen = 0;
+		float bestScore = -1.0f;
+
+		if (best < 0) {
+			/* Nothing in cache - take next unused triangle */
+			while (added[cursor])
+				++cursor;
+			best = cursor;
+		}
+
+		added[best] = 1;
+		memcpy(&out[3*outTris++], &indices[3*best], 3*sizeof(*out));
+
+		for (j = 0; j < 3; ++j) {
+			unsigned int v = indices[3*best + j];
+			unsigned int *tris = &vertTris[triOffset[v]];
+
+			/* Remove the triangle from vertex adjacency list */
+			for (k = 0; k < remaining[v]; ++k) {
+				if (tris[k] == (unsigned int)best) {
+					tris[k] = tris[--remaining[v]];
+					break;
+				}
+			}
+
+			newCache[newLen++] = v;
+		}
+
+		/* Move vertices of the triangle to the front of LRU cache */
+		for (i = 0; i < cacheLen; ++i) {
+			unsigned int v = cache[i];
+
+			if (v == newCache[0] || v == newCache[1]
+			    || v == newCache[2])
+				continue;
+
+			if (newLen < CACHE_SIZE)
+				newCache[newLen++] = v;
+			else
+				cachePos[v] = -1;
+		}
+
+		for (i = 0; i < newLen; ++i) {
+			cache[i] = newCache[i];
+			cachePos[newCache[i]] = i;
+		}
+		cacheLen = newLen;
+
+		/* Pick best triangle using cached vertices */
+		best = -1;
+		for (i = 0; i < cacheLen; ++i) {
+			unsigned int v = cache[i];
+			unsigned int *tris = &vertTris[triOffset[v]];
+
+			for (k = 0; k < remaining[v]; ++k) {
+				const uint16_t *t = &indices[3*tris[k]];
+				float score;
+
+				score = vertexScore(cachePos[t[0]], remaining[t[0]])
+					+ vertexScore(cachePos[t[1]], remaining[t[1]])
+					+ vertexScore(cachePos[t[2]], remaining[t[2]]);
+
+				if (score > bestScore) {
+					bestScore = score;
+					best = tris[k];
+				}
+			}
+		}
+	}
+
+	memcpy(indices, out, 3 * numTris * sizeof(*out));
+	ret = 0;
+
+out:
+	free(out);
+	free(added);
+	free(vertTris);
+	free(cachePos);
+	free(remaining);
+	free(triOffset);
+
+	return ret;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgOptimizeTrianglesUShortIdx
+ * SYNOPSIS:	This function reorders triangle list in place for better
+ *		vertex reuse
+ * PARAMETERS:	[IN/OUT] indices: triangle list indices
+ *		[IN] count: number of indices
+ *****************************************************************************/
+void fimgOptimizeTrianglesUShortIdx(uint16_t *indices, unsigned int count)
+{
+	if (optimizeTriangles(indices, count))
+		ALOGW("%s: Failed to allocate memory, skipping.", __func__);
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgOptimizeTrianglesUByteIdx
+ * SYNOPSIS:	This function reorders triangle list in place for better
+ *		vertex reuse
+ * PARAMETERS:	[IN/OUT] indices: triangle list indices
+ *		[IN] count: number of indices
+ *****************************************************************************/
+void fimgOptimizeTrianglesUByteIdx(uint8_t *indices, unsigned int count)
+{
+	uint16_t *tmp;
+	unsigned int i;
+
+	tmp = malloc(count * sizeof(*tmp));
+	if (!tmp) {
+		ALOGW("%s: Failed to allocate memory, skipping.", __func__);
+		return;
+	}
+
+	for (i = 0; i < count; ++i)
+		tmp[i] = indices[i];
+
+	if (!optimizeTriangles(tmp, count))
+		for (i = 0; i < count; ++i)
+			indices[i] = tmp[i];
+	else
+		ALOGW("%s: Failed to allocate memory, skipping.", __func__);
+
+	free(tmp);
+}
@@ -47,5 +47,22 @@
  * 		< 0, on error
  */
 #define S3C_G3D_FLUSH			_IO(G3D_IOCTL_MAGIC, 2)
+/*
+ * S3C_G3D_WAIT
+ * Sleep until requested pipeline stages are idle and requested cache
+ * operations are finished, woken up by G3D interrupt.
+ * Argument:	Pointer to struct s3c_g3d_wait_req.
+ * Returns:	0, on success,
+ * 		-ETIMEDOUT, if the timeout expired,
+ * 		< 0, on other error (-ENOTTY if not supported)
+ */
+#define S3C_G3D_WAIT			_IOW(G3D_IOCTL_MAGIC, 3, \
+						struct s3c_g3d_wait_req)
+
+struct s3c_g3d_wait_req {
+	unsigned int	pipe_mask;	/* as in FGGB_PIPESTATE */
+	unsigned int	cache_mask;	/* as in FGGB_CACHECTL */
+	unsigned int	timeout;	/* in milliseconds */
+};
 
 #endif
@@ -0,0 +1,450 @@
+/*
+ * fimg/shadercache.c
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE PERSISTENT SHADER CACHE
+ *
+ * Copyrights:	2010 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Optimized fixed pipeline shaders are stored in a file per user ID, so
+ * they do not have to be generated again by every started process. The
+ * cache directory is shared by all users, so each of them keeps the file
+ * in a private subdirectory, which nobody else can put links into.
+ *
+ * The file starts with a header identifying format version and build of
+ * the shader generator, followed by records appended one by one with
+ * a single write under an exclusive lock. The file is mapped read only
+ * and searched when a shader is not found in the in-memory cache. Records
+ * are checksummed, so a record being written by another process at the
+ * same time is simply ignored. A file of another version or build is
+ * replaced by renaming a fresh one over it, which keeps existing mappings
+ * of other processes valid.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "fimg_private.h"
+
+#ifdef FIMG_SHADER_DISK_CACHE
+
+#define CACHE_MAGIC		0x43534746	/* "FGSC" */
+#define CACHE_VERSION		1
+
+/* Shader instructions are four words long */
+#define INSTR_SIZE		(4 * sizeof(uint32_t))
+
+struct cacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t buildHash;
+	uint32_t instrSize;
+};
+
+struct cacheRecord {
+	uint32_t size;		/* of whole record in bytes */
+	uint32_t type;
+	uint32_t hash;		/* of key */
+	uint32_t checksum;	/* of key and code */
+	uint32_t keyLen;
+	uint32_t instrCount;
+	uint32_t data[];	/* key words followed by code */
+};
+
+enum {
+	CACHE_UNOPENED = 0,
+	CACHE_OPENED,
+	CACHE_DISABLED
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	int state;
+	int fd;
+	const uint8_t *map;
+	size_t mapSize;
+	uint32_t buildHash;
+} cache = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.fd = -1,
+};
+
+static uint32_t hashWords(uint32_t hash, const uint32_t *data, uint32_t len)
+{
+	while (len--) {
+		hash ^= *(data++);
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static uint32_t hashString(const char *str)
+{
+	uint32_t hash = 2166136261U;
+
+	while (*str) {
+		hash ^= (uint8_t)*(str++);
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static int writeHeader(int fd)
+{
+	struct cacheHeader hdr;
+
+	hdr.magic = CACHE_MAGIC;
+	hdr.version = CACHE_VERSION;
+	hdr.buildHash = cache.buildHash;
+	hdr.instrSize = INSTR_SIZE;
+
+	if (write(fd, &hdr, sizeof(hdr)) != sizeof(hdr))
+		return -1;
+
+	return 0;
+}
+
+static int checkHeader(int fd)
+{
+	struct cacheHeader hdr;
+
+	if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+		return -1;
+
+	if (hdr.magic != CACHE_MAGIC || hdr.version != CACHE_VERSION
+	    || hdr.buildHash != cache.buildHash
+	    || hdr.instrSize != INSTR_SIZE)
+		return -1;
+
+	return 0;
+}
+
+/*****************************************************************************
+ * FUNCTION:	replaceFile
+ * SYNOPSIS:	This function creates an empty cache file in place of
+ *		an existing one of other version or build
+ * ARGUMENTS:	path - path to the cache file
+ * RETURNS:	descriptor of new file or -1 on error
+ *****************************************************************************/
+static int replaceFile(const char *path)
+{
+	char tmp[PATH_MAX];
+	int fd;
+
+	snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid());
+
+	fd = open(tmp, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW, 0600);
+	if (fd < 0)
+		return -1;
+
+	if (writeHeader(fd) || rename(tmp, path)) {
+		close(fd);
+		unlink(tmp);
+		return -1;
+	}
+
+	return fd;
+}
+
+/*****************************************************************************
+ * FUNCTION:	openUserDir
+ * SYNOPSIS:	This function creates (if needed) private directory of
+ *		current user inside shared cache directory
+ * ARGUMENTS:	path - path to the private directory
+ * RETURNS:	0 on success, -1 if the directory cannot be used
+ *****************************************************************************/
+static int openUserDir(const char *path)
+{
+	struct stat st;
+	int fd;
+
+	if (mkdir(path, 0700) && errno != EEXIST) {
+		ALOGI("Shader cache %s not available (%s)",
+						path, strerror(errno));
+		return -1;
+	}
+
+	/* Somebody else could have created it first, even as a link */
+	fd = open(path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+	if (fd < 0 || fstat(fd, &st) || st.st_uid != getuid()
+	    || (st.st_mode & (S_IRWXG | S_IRWXO))) {
+		ALOGE("Shader cache %s has wrong owner or mode, ignoring",
+									path);
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+
+	close(fd);
+	return 0;
+}
+
+/*****************************************************************************
+ * FUNCTION:	openCache
+ * SYNOPSIS:	This function opens (creating if needed) cache file of
+ *		current user
+ * RETURNS:	0 on success, -1 if the cache is not available
+ *****************************************************************************/
+static int openCache(void)
+{
+	const char *dir;
+	char path[PATH_MAX];
+	struct stat st;
+	int fd;
+
+	dir = getenv("FIMG_SHADER_CACHE_DIR");
+	if (!dir)
+		dir = FIMG_SHADER_CACHE_DIR;
+	if (!dir[0])
+		return -1;
+
+	snprintf(path, sizeof(path), "%s/fimg-%u", dir, (unsigned)getuid());
+	if (openUserDir(path))
+		return -1;
+
+	strncat(path, "/shaders.bin", sizeof(path) - strlen(path) - 1);
+
+	cache.buildHash = hashString(fimgShaderBuildId);
+
+	fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW, 0600);
+	if (fd < 0 && errno == EEXIST)
+		fd = open(path, O_RDWR | O_NOFOLLOW);
+	if (fd < 0) {
+		ALOGI("Shader cache %s not available (%s)",
+						path, strerror(errno));
+		return -1;
+	}
+
+	/* Never use shaders written by somebody else */
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_uid != getuid()
+	    || (st.st_mode & (S_IWGRP | S_IWOTH))) {
+		ALOGE("Shader cache %s has wrong owner or mode, ignoring",
+									path);
+		close(fd);
+		return -1;
+	}
+
+	flock(fd, LOCK_EX);
+
+	if (st.st_size == 0) {
+		if (writeHeader(fd))
+			goto err_unlock;
+	} else if (checkHeader(fd)) {
+		int newFd = replaceFile(path);
+
+		if (newFd < 0)
+			goto err_unlock;
+
+		flock(fd, LOCK_UN);
+		close(fd);
+		fd = newFd;
+		flock(fd, LOCK_EX);
+	}
+
+	flock(fd, LOCK_UN);
+
+	cache.fd = fd;
+	return 0;
+
+err_unlock:
+	ALOGE("Failed to initialize shader cache %s", path);
+	flock(fd, LOCK_UN);
+	close(fd);
+	return -1;
+}
+
+/* Maps the whole file again if it has grown since last mapping */
+static void mapCache(void)
+{
+	struct stat st;
+	void *map;
+
+	if (fstat(cache.fd, &st) || (size_t)st.st_size == cache.mapSize)
+		return;
+
+	if (cache.map)
+		munmap((void *)cache.map, cache.mapSize);
+
+	cache.map = NULL;
+	cache.mapSize = 0;
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, cache.fd, 0);
+	if (map == MAP_FAILED)
+		return;
+
+	cache.map = map;
+	cache.mapSize = st.st_size;
+}
+
+static int getCache(void)
+{
+	if (cache.state == CACHE_UNOPENED)
+		cache.state = openCache() ? CACHE_DISABLED : CACHE_OPENED;
+
+	return cache.state == CACHE_OPENED;
+}
+
+static const struct cacheRecord *findRecord(uint32_t type,
+			const uint32_t *key, uint32_t keyLen, uint32_t hash)
+{
+	const uint8_t *pos, *end;
+	const struct cacheRecord *rec;
+	uint32_t checksum;
+
+	if (!cache.map)
+		return NULL;
+
+	pos = cache.map + sizeof(struct cacheHeader);
+	end = cache.map + cache.mapSize;
+
+	for (; end - pos >= (ptrdiff_t)sizeof(*rec); pos += rec->size) {
+		rec = (const struct cacheRecord *)pos;
+
+		if (rec->size < sizeof(*rec) || rec->size % 4
+		    || rec->size > (size_t)(end - pos))
+			break;
+
+		if (rec->type != type || rec->hash != hash
+		    || rec->keyLen != keyLen)
+			continue;
+
+		if (rec->size != sizeof(*rec) + 4 * (keyLen
+							+ 4 * rec->instrCount))
+			continue;
+
+		if (memcmp(rec->data, key, keyLen * sizeof(*key)))
+			continue;
+
+		checksum = hashWords(2166136261U, rec->data,
+					keyLen + 4 * rec->instrCount);
+		if (checksum != rec->checksum)
+			continue;
+
+		return rec;
+	}
+
+	return NULL;
+}
+
+/*****************************************************************************
+ * FUNCTION:	fimgLoadCachedShader
+ * SYNOPSIS:	This function looks up a shader in the persistent cache
+ * ARGUMENTS:	type - shader type (FIMG_CACHED_VSHADER or FIMG_CACHED_PSHADER)
+ *		key - shader state words
+ *		keyLen - number of shader state words
+ *		code - buffer for shader code
+ *		maxInstr - capacity of the buffer in instructions
+ * RETURNS:	number of loaded instructions or 0 if not found
+ *****************************************************************************/
+uint32_t fimgLoadCachedShader(uint32_t type, const uint32_t *key,
+			uint32_t keyLen, uint32_t *code, uint32_t maxInstr)
+{
+	const struct cacheRecord *rec;
+	uint32_t hash, count = 0;
+
+	hash = hashWords(2166136261U, key, keyLen);
+
+	pthread_mutex_lock(&cache.mutex);
+
+	if (!getCache())
+		goto unlock;
+
+	rec = findRecord(type, key, keyLen, hash);
+	if (!rec) {
+		/* Maybe stored meanwhile by us or another process */
+		mapCache();
+		rec = findRecord(type, key, keyLen, hash);
+	}
+
+	if (!rec || !rec->instrCount || rec->instrCount > maxInstr)
+		goto unlock;
+
+	count = rec->instrCount;
+	memcpy(code, rec->data + keyLen, count * INSTR_SIZE);
+
+unlock:
+	pthread_mutex_unlock(&cache.mutex);
+	return count;
+}
+
+/*****************************************************************************
+ * FUNCTION:	fimgStoreCachedShader
+ * SYNOPSIS:	This function appends a shader to the persistent cache
+ * ARGUMENTS:	type - shader type (FIMG_CACHED_VSHADER or FIMG_CACHED_PSHADER)
+ *		key - shader state words
+ *		keyLen - number of shader state words
+ *		code - shader code
+ *		instrCount - number of instructions
+ *****************************************************************************/
+void fimgStoreCachedShader(uint32_t type, const uint32_t *key,
+		uint32_t keyLen, const uint32_t *code, uint32_t instrCount)
+{
+	struct cacheRecord *rec;
+	struct stat st;
+	size_t size;
+
+	size = sizeof(*rec) + 4 * (keyLen + 4 * instrCount);
+
+	rec = malloc(size);
+	if (!rec)
+		return;
+
+	rec->size = size;
+	rec->type = type;
+	rec->hash = hashWords(2166136261U, key, keyLen);
+	rec->keyLen = keyLen;
+	rec->instrCount = instrCount;
+	memcpy(rec->data, key, keyLen * sizeof(*key));
+	memcpy(rec->data + keyLen, code,
+				instrCount * INSTR_SIZE);
+	rec->checksum = hashWords(2166136261U, rec->data,
+						keyLen + 4 * instrCount);
+
+	pthread_mutex_lock(&cache.mutex);
+
+	if (!getCache())
+		goto unlock;
+
+	flock(cache.fd, LOCK_EX);
+
+	if (fstat(cache.fd, &st)
+	    || st.st_size + size > FIMG_SHADER_CACHE_MAX_SIZE)
+		goto unlock_file;
+
+	/* Drop partial record, so it does not hide following ones */
+	if (pwrite(cache.fd, rec, size, st.st_size) != (ssize_t)size)
+		ftruncate(cache.fd, st.st_size);
+
+unlock_file:
+	flock(cache.fd, LOCK_UN);
+unlock:
+	pthread_mutex_unlock(&cache.mutex);
+	free(rec);
+}
+
+#endif /* FIMG_SHADER_DISK_CACHE */
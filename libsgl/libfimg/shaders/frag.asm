@@ -45,6 +45,9 @@ def c3, 4.0, 4.0, 4.0, 4.0
 # Combiner scale 1
 # def c7, 1.0, 1.0, 1.0, 1.0
 
+# Fog color
+# def c8, 0.0, 0.0, 0.0, 0.0
+
 % f header
 
 # Shader header
@@ -56,6 +59,32 @@ label start
 
 ################################################################################
 
+% f clip_plane0
+
+# User clip planes
+#
+# Input:	v4 - interpolated signed distances from planes
+
+# Plane 0
+	texkill v4.xxxx
+
+% f clip_plane1
+
+# Plane 1
+	texkill v4.yyyy
+
+% f clip_plane2
+
+# Plane 2
+	texkill v4.zzzz
+
+% f clip_plane3
+
+# Plane 3
+	texkill v4.wwww
+
+################################################################################
+
 % f texture0
 
 # Sampling function
@@ -648,6 +677,21 @@ label start
 
 ################################################################################
 
+% f fog
+
+# Fog function
+#
+# Inputs:	r0 - fragment color
+#		v3 - interpolated fog factor
+#
+# Output:	r0 - fogged fragment color
+
+# Fog
+	add r1.xyz, r0, -c8
+	mad r0.xyz, r1, v3.xxxx, c8
+
+################################################################################
+
 % f out_swap
 
 # Output RGB -> BGR color component swap
@@ -12,6 +12,22 @@ static const unsigned int frag_header[] = {
 	0x00000000, 0x00000000, 0x00f820e4, 0x00000000,
 };
 
+static const unsigned int frag_clip_plane0[] = {
+	0x00000000, 0x00040000, 0x13800000, 0x00000000,
+};
+
+static const unsigned int frag_clip_plane1[] = {
+	0x00000000, 0x00040000, 0x13800055, 0x00000000,
+};
+
+static const unsigned int frag_clip_plane2[] = {
+	0x00000000, 0x00040000, 0x138000aa, 0x00000000,
+};
+
+static const unsigned int frag_clip_plane3[] = {
+	0x00000000, 0x00040000, 0x138000ff, 0x00000000,
+};
+
 static const unsigned int frag_texture0[] = {
 	0x00000000, 0x0001e407, 0x107821e4, 0x00000000,
 	0x00000000, 0x02040000, 0x00f822e4, 0x00000000,
@@ -195,6 +211,11 @@ static const unsigned int frag_combine_dot3[] = {
 	0x03000000, 0x0104e402, 0x037824e4, 0x00000000,
 };
 
+static const unsigned int frag_fog[] = {
+	0x08000000, 0x0100e442, 0x223821e4, 0x00000000,
+	0x03e40208, 0x01010000, 0x0eb820e4, 0x00000000,
+};
+
 static const unsigned int frag_out_swap[] = {
 	0x00000000, 0x01000000, 0x00f820c6, 0x00000000,
 };
@@ -50,6 +50,38 @@ fimg_version	0x01050000
 # def c14, 0.0, 0.0, 1.0, 0.0
 # def c15, 0.0, 0.0, 0.0, 1.0
 
+# Modelview matrix
+# def c16, 1.0, 0.0, 0.0, 0.0
+# def c17, 0.0, 1.0, 0.0, 0.0
+# def c18, 0.0, 0.0, 1.0, 0.0
+# def c19, 0.0, 0.0, 0.0, 1.0
+
+# Lighting (loaded only when lighting is enabled)
+# c20 - scene color (emission + material ambient * model ambient),
+#       material diffuse alpha
+# c21 - material emission (color material)
+# c22 - light model ambient (color material)
+# c23 - material shininess, 0.0, 1.0, 0.0
+
+# Light i (i = 0..7) at c24 + 8*i, light 0 used in code below
+# c24 - eye space position (normalized direction of directional light)
+# c25 - ambient (multiplied by material ambient without color material)
+# c26 - diffuse (multiplied by material diffuse without color material)
+# c27 - specular multiplied by material specular
+# c28 - normalized spot direction, cosine of spot cutoff angle
+# c29 - constant, linear, quadratic attenuation, spot exponent
+# c30 - normalized half vector of directional light
+
+# Fog (loaded only when fog is enabled)
+# c88 - linear fog scale -1/(end - start), linear fog bias end/(end - start),
+#       exp fog scale -density*log2(e), exp2 fog scale density*sqrt(log2(e))
+
+# User clip planes i (i = 0..3), in object coordinates
+# c89 - plane 0
+# c90 - plane 1
+# c91 - plane 2
+# c92 - plane 3
+
 % v header
 
 # Shader header
@@ -60,10 +92,135 @@ label start
 	mad r0.xyzw, c2.xyzw, v0.zzzz, r0.xyzw
 	mad o0.xyzw, c3.xyzw, v0.wwww, r0.xyzw
 
+# Code is being inserted here dynamically
+
+################################################################################
+
+% v color
+
+# Vertex color
 	# Pass vertex color
 	mov o1, v2
 
-# Code is being inserted here dynamically
+################################################################################
+
+% v normal
+
+# Lighting
+	# Transform normal by lighting matrix (inverse of modelview)
+	dp3 r3.x, c4, v1
+	dp3 r3.y, c5, v1
+	dp3 r3.z, c6, v1
+
+% v normalize
+
+	# Normalize the normal
+	dp3 r3.w, r3, r3
+	rsq r3.w, r3.w
+	mul r3.xyz, r3, r3.w
+
+% v eye_position
+
+	# Transform position to eye space
+	mul r5.xyzw, c16.xyzw, v0.xxxx
+	mad r5.xyzw, c17.xyzw, v0.yyyy, r5.xyzw
+	mad r5.xyzw, c18.xyzw, v0.zzzz, r5.xyzw
+	mad r5.xyzw, c19.xyzw, v0.wwww, r5.xyzw
+
+% v scene_color
+
+	# Start with emitted and ambient scene color
+	mov r6, c20
+
+% v scene_color_cm
+
+	# Start with emitted and ambient scene color, material from vertex
+	mov r6, c21
+	mad r6.xyz, c22, v2, r6
+	mov r6.w, v2.w
+
+% v light_directional
+
+# Light 0 (constants relocated for other lights)
+	# Direction and half vector are constant
+	mov r8.xyz, c24
+	mov r9.xyz, c30
+
+% v light_positional
+
+	# Direction to light (distance squared in r8.w, inverse in r7.w)
+	add r8.xyz, c24, -r5
+	dp3 r8.w, r8, r8
+	rsq r7.w, r8.w
+	mul r8.xyz, r8, r7.w
+	# Half vector
+	add r9.xyz, c23.yyzz, r8
+	dp3 r9.w, r9, r9
+	rsq r9.w, r9.w
+	mul r9.xyz, r9, r9.w
+
+% v light_attenuation
+
+	# Attenuation factor into r10.x
+	dst r10, r8.w, r7.w
+	dp3 r10.x, c29, r10
+	rcp r10.x, r10.x
+
+% v light_unattenuated
+
+	mov r10.x, c23.z
+
+% v light_spot
+
+	# Multiply attenuation factor by spotlight effect
+	dp3 r13.x, c28, -r8
+	max r13.y, c23.y, r13.x
+	log_lit r13.y, r13.y
+	mul_lit r13.y, c29.w, r13.y
+	exp_lit r13.y, r13.y
+	slt r13.z, c28.w, r13.x
+	mul r13.y, r13.y, r13.z
+	mul r10.x, r10.x, r13.y
+
+% v light_terms
+
+	# Diffuse factor into r11.x, specular factor into r11.w
+	dp3 r11.x, r3, r8
+	dp3 r11.y, r3, r9
+	max r11.xy, c23.y, r11
+	slt r11.z, c23.y, r11.x
+	log_lit r11.w, r11.y
+	mul_lit r11.w, c23.x, r11.w
+	exp_lit r11.w, r11.w
+	mul r11.w, r11.w, r11.z
+
+% v light_color
+
+	# Light color into r12
+	mov r12.xyz, c25
+	mad r12.xyz, c26, r11.x, r12
+	mad r12.xyz, c27, r11.w, r12
+
+% v light_color_cm
+
+	# Light color into r12, material from vertex
+	mul r12.xyz, c25, v2
+	mul r13.xyz, c26, v2
+	mad r12.xyz, r13, r11.x, r12
+	mad r12.xyz, c27, r11.w, r12
+
+% v light_attenuate
+
+	mul r12.xyz, r12, r10.x
+
+% v light_accumulate
+
+	add r6.xyz, r6, r12
+
+% v lighting_footer
+
+	# Output lit color
+	mov_sat o1, r6
 
 ################################################################################
 
@@ -87,6 +244,59 @@ label start
 
 ################################################################################
 
+% v fog_coord
+
+# Fog
+	# Absolute eye space z approximates distance from the eye
+	mul r14.z, c16.zzzz, v0.xxxx
+	mad r14.z, c17.zzzz, v0.yyyy, r14.zzzz
+	mad r14.z, c18.zzzz, v0.zzzz, r14.zzzz
+	mad r14.z, c19.zzzz, v0.wwww, r14.zzzz
+
+% v fog_linear
+
+	# Linear fog factor
+	mul r14.x, c88.xxxx, abs(r14.zzzz)
+	add_sat o4.x, c88.yyyy, r14.xxxx
+
+% v fog_exp
+
+	# Exponential fog factor
+	mul r14.x, c88.zzzz, abs(r14.zzzz)
+	exp o4.x, r14.xxxx
+
+% v fog_exp2
+
+	# Squared exponential fog factor
+	mul r14.x, c88.wwww, r14.zzzz
+	mul r14.x, -r14.xxxx, r14.xxxx
+	exp o4.x, r14.xxxx
+
+################################################################################
+
+% v clip_plane0
+
+# User clip planes
+	# Signed distance from plane 0, negative outside
+	dp4 o5.x, c89, v0
+
+% v clip_plane1
+
+	# Signed distance from plane 1
+	dp4 o5.y, c90, v0
+
+% v clip_plane2
+
+	# Signed distance from plane 2
+	dp4 o5.z, c91, v0
+
+% v clip_plane3
+
+	# Signed distance from plane 3
+	dp4 o5.w, c92, v0
+
+################################################################################
+
 % v footer
 
 # Shader footer
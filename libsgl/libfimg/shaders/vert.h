@@ -9,9 +9,114 @@ static const unsigned int vert_header[] = {
 	0x00e40100, 0x02015500, 0x2ef820e4, 0x00000000,
 	0x00e40100, 0x0202aa00, 0x2ef820e4, 0x00000000,
 	0x00e40100, 0x0203ff00, 0x0ef800e4, 0x00000000,
+};
+
+static const unsigned int vert_color[] = {
 	0x00000000, 0x00020000, 0x00f801e4, 0x00000000,
 };
 
+static const unsigned int vert_normal[] = {
+	0x01000000, 0x0204e400, 0x040823e4, 0x00000000,
+	0x01000000, 0x0205e400, 0x041023e4, 0x00000000,
+	0x01000000, 0x0206e400, 0x042023e4, 0x00000000,
+};
+
+static const unsigned int vert_normalize[] = {
+	0x03000000, 0x0103e401, 0x044023e4, 0x00000000,
+	0x00000000, 0x01030000, 0x08c023ff, 0x00000000,
+	0x03000000, 0x0103ff01, 0x033823e4, 0x00000000,
+};
+
+static const unsigned int vert_eye_position[] = {
+	0x00000000, 0x02100000, 0x237825e4, 0x00000000,
+	0x00e40105, 0x02115500, 0x2ef825e4, 0x00000000,
+	0x00e40105, 0x0212aa00, 0x2ef825e4, 0x00000000,
+	0x00e40105, 0x0213ff00, 0x0ef825e4, 0x00000000,
+};
+
+static const unsigned int vert_scene_color[] = {
+	0x00000000, 0x02140000, 0x00f826e4, 0x00000000,
+};
+
+static const unsigned int vert_scene_color_cm[] = {
+	0x00000000, 0x02150000, 0x20f826e4, 0x00000000,
+	0x02e40106, 0x0216e400, 0x0eb826e4, 0x00000000,
+	0x00000000, 0x00020000, 0x00c026ff, 0x00000000,
+};
+
+static const unsigned int vert_light_directional[] = {
+	0x00000000, 0x02180000, 0x00b828e4, 0x00000000,
+	0x00000000, 0x021e0000, 0x00b829e4, 0x00000000,
+};
+
+static const unsigned int vert_light_positional[] = {
+	0x05000000, 0x0218e441, 0x023828e4, 0x00000000,
+	0x08000000, 0x0108e401, 0x044028e4, 0x00000000,
+	0x00000000, 0x01080000, 0x08c027ff, 0x00000000,
+	0x07000000, 0x0108ff01, 0x033828e4, 0x00000000,
+	0x08000000, 0x0217e401, 0x023829a5, 0x00000000,
+	0x09000000, 0x0109e401, 0x044029e4, 0x00000000,
+	0x00000000, 0x01090000, 0x08c029ff, 0x00000000,
+	0x09000000, 0x0109ff01, 0x033829e4, 0x00000000,
+};
+
+static const unsigned int vert_light_attenuation[] = {
+	0x07000000, 0x0108ff01, 0x05f82aff, 0x00000000,
+	0x0a000000, 0x021de401, 0x04082ae4, 0x00000000,
+	0x00000000, 0x010a0000, 0x08082a00, 0x00000000,
+};
+
+static const unsigned int vert_light_unattenuated[] = {
+	0x00000000, 0x02170000, 0x00882aaa, 0x00000000,
+};
+
+static const unsigned int vert_light_spot[] = {
+	0x08000000, 0x021ce441, 0x04082de4, 0x00000000,
+	0x0d000000, 0x02170001, 0x0a102d55, 0x00000000,
+	0x00000000, 0x010d0000, 0x07902d55, 0x00000000,
+	0x0d000000, 0x021d5501, 0x03902dff, 0x00000000,
+	0x00000000, 0x010d0000, 0x06902d55, 0x00000000,
+	0x0d000000, 0x021c0001, 0x0ba02dff, 0x00000000,
+	0x0d000000, 0x010daa01, 0x03102d55, 0x00000000,
+	0x0d000000, 0x010a5501, 0x03082a00, 0x00000000,
+};
+
+static const unsigned int vert_light_terms[] = {
+	0x08000000, 0x0103e401, 0x04082be4, 0x00000000,
+	0x09000000, 0x0103e401, 0x04102be4, 0x00000000,
+	0x0b000000, 0x0217e401, 0x0a182b55, 0x00000000,
+	0x0b000000, 0x02170001, 0x0ba02b55, 0x00000000,
+	0x00000000, 0x010b0000, 0x07c02b55, 0x00000000,
+	0x0b000000, 0x0217ff01, 0x03c02b00, 0x00000000,
+	0x00000000, 0x010b0000, 0x06c02bff, 0x00000000,
+	0x0b000000, 0x010baa01, 0x03402bff, 0x00000000,
+};
+
+static const unsigned int vert_light_color[] = {
+	0x00000000, 0x02190000, 0x20b82ce4, 0x00000000,
+	0x0be4010c, 0x021a0001, 0x2eb82ce4, 0x00000000,
+	0x0be4010c, 0x021bff01, 0x0eb82ce4, 0x00000000,
+};
+
+static const unsigned int vert_light_color_cm[] = {
+	0x02000000, 0x0219e400, 0x03382ce4, 0x00000000,
+	0x02000000, 0x021ae400, 0x23382de4, 0x00000000,
+	0x0be4010c, 0x010d0001, 0x2eb82ce4, 0x00000000,
+	0x0be4010c, 0x021bff01, 0x0eb82ce4, 0x00000000,
+};
+
+static const unsigned int vert_light_attenuate[] = {
+	0x0a000000, 0x010c0001, 0x03382ce4, 0x00000000,
+};
+
+static const unsigned int vert_light_accumulate[] = {
+	0x0c000000, 0x0106e401, 0x023826e4, 0x00000000,
+};
+
+static const unsigned int vert_lighting_footer[] = {
+	0x00000000, 0x01060000, 0x00fa01e4, 0x00000000,
+};
+
 static const unsigned int vert_texture0[] = {
 	0x04000000, 0x02080000, 0x237821e4, 0x00000000,
 	0x04e40101, 0x02095500, 0x2ef821e4, 0x00000000,
@@ -26,6 +131,45 @@ static const unsigned int vert_texture1[] = {
 	0x05e40102, 0x020fff00, 0x0ef803e4, 0x00000000,
 };
 
+static const unsigned int vert_fog_coord[] = {
+	0x00000000, 0x02100000, 0x23202eaa, 0x00000000,
+	0x00aa010e, 0x02115500, 0x2ea02eaa, 0x00000000,
+	0x00aa010e, 0x0212aa00, 0x2ea02eaa, 0x00000000,
+	0x00aa010e, 0x0213ff00, 0x0ea02eaa, 0x00000000,
+};
+
+static const unsigned int vert_fog_linear[] = {
+	0x0e000000, 0x0258aa81, 0x03082e00, 0x00000000,
+	0x0e000000, 0x02580001, 0x020a0455, 0x00000000,
+};
+
+static const unsigned int vert_fog_exp[] = {
+	0x0e000000, 0x0258aa81, 0x03082eaa, 0x00000000,
+	0x00000000, 0x010e0000, 0x06080400, 0x00000000,
+};
+
+static const unsigned int vert_fog_exp2[] = {
+	0x0e000000, 0x0258aa01, 0x03082eff, 0x00000000,
+	0x0e000000, 0x410e0001, 0x03082e00, 0x00000000,
+	0x00000000, 0x010e0000, 0x06080400, 0x00000000,
+};
+
+static const unsigned int vert_clip_plane0[] = {
+	0x00000000, 0x0259e400, 0x048805e4, 0x00000000,
+};
+
+static const unsigned int vert_clip_plane1[] = {
+	0x00000000, 0x025ae400, 0x049005e4, 0x00000000,
+};
+
+static const unsigned int vert_clip_plane2[] = {
+	0x00000000, 0x025be400, 0x04a005e4, 0x00000000,
+};
+
+static const unsigned int vert_clip_plane3[] = {
+	0x00000000, 0x025ce400, 0x04c005e4, 0x00000000,
+};
+
 static const unsigned int vert_footer[] = {
 	0x00000000, 0x00000000, 0x1e000000, 0x00000000,
 };
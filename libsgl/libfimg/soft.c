@@ -0,0 +1,2534 @@
+/*
+ * fimg/soft.c
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE SOFTWARE EMULATION
+ *
+ * Copyrights:	2010 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This file replaces the kernel device interface (see system.c) with
+ * a process-local model of the 3D engine, so the whole library can be run
+ * and debugged on machines without the hardware.
+ *
+ * The register file is emulated by plain memory, written by the usual
+ * register accessors. Writes with side effects (host FIFO, vertex buffer,
+ * palette) are intercepted and the draw requests received by the host
+ * interface are executed synchronously: vertices are fetched from the
+ * emulated vertex buffer, vertex and pixel shader programs are interpreted
+ * from instruction memory and primitives are rasterized into memory
+ * allocated with fimgSoftAlloc() or registered with fimgSoftMap(), using
+ * the same state registers as the hardware does.
+ *
+ * Only what the library uses is emulated. Flow control instructions other
+ * than RET, vertex textures, YUV texture formats and dithering are not.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fimg_private.h"
+
+#define FIMG_SFR_SIZE		0x80000
+
+/* Registers with side effects or used by the emulation */
+#define FGGB_PIPESTATE		0x0000
+#define FGGB_CACHECTL		0x0004
+#define FGGB_RST		0x0008
+#define FGGB_VERSION		0x0010
+
+#define FGHI_FIFO_SIZE		32
+
+#define FGHI_DWSPACE		0x8000
+#define FGHI_CONTROL		0x8008
+#define FGHI_VBADDR		0x8010
+#define FGHI_FIFO_ENTRY		0xc000
+#define FGHI_VB_ENTRY		0xe000
+#define FGHI_VB_ENTRY_END	0x10000
+#define FGHI_ATTRIB(i)		(0x8040 + 4*(i))
+#define FGHI_ATTRIB_VBCTRL(i)	(0x8080 + 4*(i))
+#define FGHI_ATTRIB_VBBASE(i)	(0x80c0 + 4*(i))
+
+typedef enum {
+	FGHI_CONTROLIdxTYPE_UINT = 0,
+	FGHI_CONTROLIdxTYPE_USHORT,
+	FGHI_CONTROLIdxTYPE_UBYTE = 3
+} fimgHostIndexType;
+
+#define FGVS_INSTMEM_START	(0x10000)
+#define FGVS_CFLOAT_START	(0x14000)
+#define FGVS_PCRANGE		(0x20000)
+
+#define FGPS_INSTMEM_START	(0x40000)
+#define FGPS_CFLOAT_START	(0x44000)
+#define FGPS_EXE_MODE		(0x4c800)
+#define FGPS_PC_START		(0x4c804)
+#define FGPS_PC_END		(0x4c808)
+#define FGPS_IBSTATUS		(0x4c814)
+
+#define FGPE_VERTEX_CONTEXT		(0x30000)
+#define FGPE_VIEWPORT_OX		(0x30004)
+#define FGPE_VIEWPORT_OY		(0x30008)
+#define FGPE_VIEWPORT_HALF_PX		(0x3000c)
+#define FGPE_VIEWPORT_HALF_PY		(0x30010)
+#define FGPE_DEPTHRANGE_HALF_F_SUB_N	(0x30014)
+#define FGPE_DEPTHRANGE_HALF_F_ADD_N	(0x30018)
+
+#define FGRA_PIX_SAMP		(0x38000)
+#define FGRA_D_OFF_EN		(0x38004)
+#define FGRA_D_OFF_FACTOR	(0x38008)
+#define FGRA_D_OFF_UNITS	(0x3800c)
+#define FGRA_BFCULL		(0x38014)
+#define FGRA_YCLIP		(0x38018)
+#define FGRA_PWIDTH		(0x3801c)
+#define FGRA_PSIZE_MIN		(0x38020)
+#define FGRA_PSIZE_MAX		(0x38024)
+#define FGRA_COORDREPLACE	(0x38028)
+#define FGRA_LWIDTH		(0x3802c)
+#define FGRA_XCLIP		(0x3c004)
+
+#define FGTU_TSTA(i)		(0x60000 + 0x50 * (i))
+#define FGTU_PALETTE_ADDR	(0x60290)
+#define FGTU_PALETTE_IN		(0x60294)
+
+#define FGPF_SCISSOR_X		(0x70000)
+#define FGPF_SCISSOR_Y		(0x70004)
+#define FGPF_ALPHAT		(0x70008)
+#define FGPF_FRONTST		(0x7000c)
+#define FGPF_BACKST		(0x70010)
+#define FGPF_DEPTHT		(0x70014)
+#define FGPF_CCLR		(0x70018)
+#define FGPF_BLEND		(0x7001c)
+#define FGPF_LOGOP		(0x70020)
+#define FGPF_CBMSK		(0x70024)
+#define FGPF_DBMSK		(0x70028)
+#define FGPF_FBCTL		(0x7002c)
+#define FGPF_DBADDR		(0x70030)
+#define FGPF_CBADDR		(0x70034)
+#define FGPF_FBW		(0x70038)
+
+/* Emulated hardware parameters */
+#define SOFT_VB_SIZE		(64 * 1024)
+#define SOFT_VS_SLOTS		512
+#define SOFT_PS_SLOTS		512
+#define SOFT_FLOAT_CONSTS	256
+#define SOFT_TEXTURE_UNITS	8
+#define SOFT_MAX_VARYINGS	(FIMG_ATTRIB_NUM - 1)
+#define SOFT_MAX_OUTPUTS	(SOFT_MAX_VARYINGS + 1)
+#define SOFT_VERTEX_CACHE	64
+
+/* Fake physical address space of emulated memory */
+#define SOFT_MEM_BASE		0x40000000UL
+#define SOFT_MEM_END		0xf0000000UL
+#define SOFT_MEM_ALIGN		4096UL
+
+/* Shader instruction set */
+enum {
+	SOP_NOP		= 0x00,
+	SOP_MOV		= 0x01,
+	SOP_MOVA	= 0x02,
+	SOP_MOVC	= 0x03,
+	SOP_ADD		= 0x04,
+	SOP_MUL		= 0x06,
+	SOP_MUL_LIT	= 0x07,
+	SOP_DP3		= 0x08,
+	SOP_DP4		= 0x09,
+	SOP_DPH		= 0x0a,
+	SOP_DST		= 0x0b,
+	SOP_EXP		= 0x0c,
+	SOP_EXP_LIT	= 0x0d,
+	SOP_LOG		= 0x0e,
+	SOP_LOG_LIT	= 0x0f,
+	SOP_RCP		= 0x10,
+	SOP_RSQ		= 0x11,
+	SOP_DP2ADD	= 0x12,
+	SOP_MAX		= 0x14,
+	SOP_MIN		= 0x15,
+	SOP_SGE		= 0x16,
+	SOP_SLT		= 0x17,
+	SOP_CMP		= 0x1c,
+	SOP_MAD		= 0x1d,
+	SOP_FRC		= 0x1e,
+	SOP_TEXLD	= 0x20,
+	SOP_TEXKILL	= 0x27,
+	SOP_RET		= 0x3c
+};
+
+enum {
+	SRC_V = 0,
+	SRC_R,
+	SRC_C,
+	SRC_I,
+	SRC_AL,
+	SRC_B,
+	SRC_P,
+	SRC_S
+};
+
+enum {
+	DST_O = 0,
+	DST_R,
+	DST_P,
+	DST_A0,
+	DST_AL
+};
+
+#define PS_OUT_COLOR		16
+
+typedef struct {
+	uint8_t type;
+	uint8_t num;
+	uint8_t mod;
+	uint8_t swz[4];
+} softOperand;
+
+typedef struct {
+	uint8_t opcode;
+	uint8_t dstType;
+	uint8_t dstNum;
+	uint8_t dstMask;
+	uint8_t sat;
+	softOperand src[3];
+} softInstr;
+
+typedef struct {
+	softInstr code[SOFT_PS_SLOTS];
+	unsigned int len;
+	float c[SOFT_FLOAT_CONSTS][4];
+} softShader;
+
+/*
+ * Emulated device
+ */
+
+typedef struct _softRegion {
+	unsigned long paddr;
+	unsigned long size;
+	uint8_t *vaddr;
+	int owned;
+	struct _softRegion *next;
+} softRegion;
+
+typedef struct {
+	uint32_t *regs;
+	int refCount;
+	fimgContext *owner;
+
+	/* Host interface */
+	uint8_t vb[SOFT_VB_SIZE];
+	uint32_t vbAddr;
+	unsigned int fifoState;
+	uint32_t count;
+	uint32_t received;
+	uint32_t *indices;
+	uint32_t indicesSize;
+
+	/* Texture unit */
+	uint32_t palette[256];
+	uint32_t paletteAddr;
+
+	/* Memory */
+	softRegion *regions;
+} softDevice;
+
+enum {
+	FIFO_COUNT = 0,
+	FIFO_FIRST,
+	FIFO_INDICES
+};
+
+static softDevice *softDev;
+static pthread_mutex_t softDevMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t softHwLock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline uint32_t softReg(softDevice *dev, unsigned int addr)
+{
+	return dev->regs[addr / 4];
+}
+
+static inline float softRegF(softDevice *dev, unsigned int addr)
+{
+	union { uint32_t u; float f; } val;
+
+	val.u = dev->regs[addr / 4];
+	return val.f;
+}
+
+/*
+ * Memory
+ */
+
+static uint8_t *softTranslate(softDevice *dev,
+				unsigned long paddr, unsigned long *avail)
+{
+	softRegion *r;
+	uint8_t *vaddr = NULL;
+
+	pthread_mutex_lock(&softDevMutex);
+	for (r = dev->regions; r; r = r->next) {
+		if (paddr >= r->paddr && paddr < r->paddr + r->size) {
+			*avail = r->paddr + r->size - paddr;
+			vaddr = r->vaddr + (paddr - r->paddr);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&softDevMutex);
+
+	return vaddr;
+}
+
+/* Must be called with softDevMutex held */
+static softRegion *softInsertRegion(softDevice *dev, unsigned long size)
+{
+	softRegion **pos = &dev->regions;
+	unsigned long paddr = SOFT_MEM_BASE;
+	softRegion *r;
+
+	size = (size + SOFT_MEM_ALIGN - 1) & ~(SOFT_MEM_ALIGN - 1);
+
+	/* First fit in the list sorted by address */
+	while (*pos && (*pos)->paddr - paddr < size) {
+		paddr = (*pos)->paddr + (*pos)->size;
+		pos = &(*pos)->next;
+	}
+
+	if (SOFT_MEM_END - paddr < size)
+		return NULL;
+
+	r = calloc(1, sizeof(*r));
+	if (!r)
+		return NULL;
+
+	r->paddr = paddr;
+	r->size = size;
+	r->next = *pos;
+	*pos = r;
+
+	return r;
+}
+
+/* Must be called with softDevMutex held */
+static void softRemoveRegion(softDevice *dev, void *vaddr)
+{
+	softRegion **pos = &dev->regions;
+	softRegion *r;
+
+	while ((r = *pos) != NULL) {
+		if (r->vaddr == vaddr) {
+			*pos = r->next;
+			if (r->owned)
+				free(r->vaddr);
+			free(r);
+			return;
+		}
+		pos = &r->next;
+	}
+}
+
+static softDevice *softGetDevice(void)
+{
+	softDevice *dev;
+
+	pthread_mutex_lock(&softDevMutex);
+
+	if (!softDev) {
+		dev = calloc(1, sizeof(*dev));
+		if (!dev)
+			goto out;
+
+		dev->regs = calloc(1, FIMG_SFR_SIZE);
+		if (!dev->regs) {
+			free(dev);
+			goto out;
+		}
+
+		dev->regs[FGGB_VERSION / 4] = 0x01050000;
+		softDev = dev;
+	}
+
+	++softDev->refCount;
+out:
+	dev = softDev;
+	pthread_mutex_unlock(&softDevMutex);
+
+	return dev;
+}
+
+static void softPutDevice(softDevice *dev)
+{
+	softRegion *r;
+
+	pthread_mutex_lock(&softDevMutex);
+
+	if (--dev->refCount) {
+		pthread_mutex_unlock(&softDevMutex);
+		return;
+	}
+
+	/* Keep the memory valid, it may be still used by surfaces */
+	r = dev->regions;
+	free(dev->regs);
+	free(dev->indices);
+	memset(dev, 0, sizeof(*dev));
+	dev->regions = r;
+
+	pthread_mutex_unlock(&softDevMutex);
+}
+
+/*****************************************************************************
+ * FUNCTION:	fimgSoftAlloc
+ * SYNOPSIS:	This function allocates memory accessible by emulated hardware
+ * RETURNS:	virtual address of allocated memory or NULL on error
+ * ARGUMENTS:	size - requested size in bytes
+ *		paddr - location to store emulated physical address at
+ *****************************************************************************/
+void *fimgSoftAlloc(unsigned long size, unsigned long *paddr)
+{
+	softDevice *dev = softGetDevice();
+	softRegion *r;
+	void *vaddr;
+
+	if (!dev)
+		return NULL;
+
+	vaddr = calloc(1, size);
+	if (!vaddr) {
+		softPutDevice(dev);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&softDevMutex);
+	r = softInsertRegion(dev, size);
+	if (r) {
+		r->vaddr = vaddr;
+		r->owned = 1;
+		*paddr = r->paddr;
+	}
+	pthread_mutex_unlock(&softDevMutex);
+
+	if (!r) {
+		ALOGE("Out of emulated physical address space.");
+		free(vaddr);
+		softPutDevice(dev);
+		return NULL;
+	}
+
+	return vaddr;
+}
+
+/*****************************************************************************
+ * FUNCTION:	fimgSoftFree
+ * SYNOPSIS:	This function frees memory allocated by fimgSoftAlloc
+ * ARGUMENTS:	vaddr - virtual address of the memory
+ *****************************************************************************/
+void fimgSoftFree(void *vaddr)
+{
+	softDevice *dev = softDev;
+
+	if (!vaddr || !dev)
+		return;
+
+	pthread_mutex_lock(&softDevMutex);
+	softRemoveRegion(dev, vaddr);
+	pthread_mutex_unlock(&softDevMutex);
+
+	softPutDevice(dev);
+}
+
+/*****************************************************************************
+ * FUNCTION:	fimgSoftMap
+ * SYNOPSIS:	This function makes external memory accessible by emulated
+ *		hardware
+ * RETURNS:	emulated physical address of the memory or 0 on error
+ * ARGUMENTS:	vaddr - virtual address of the memory
+ *		size - size of the memory in bytes
+ *****************************************************************************/
+unsigned long fimgSoftMap(void *vaddr, unsigned long size)
+{
+	softDevice *dev = softGetDevice();
+	unsigned long paddr = 0;
+	softRegion *r;
+
+	if (!dev)
+		return 0;
+
+	pthread_mutex_lock(&softDevMutex);
+	r = softInsertRegion(dev, size);
+	if (r) {
+		r->vaddr = vaddr;
+		paddr = r->paddr;
+	}
+	pthread_mutex_unlock(&softDevMutex);
+
+	if (!r) {
+		ALOGE("Out of emulated physical address space.");
+		softPutDevice(dev);
+	}
+
+	return paddr;
+}
+
+/*****************************************************************************
+ * FUNCTION:	fimgSoftUnmap
+ * SYNOPSIS:	This function removes memory mapping created by fimgSoftMap
+ * ARGUMENTS:	vaddr - virtual address of the memory
+ *****************************************************************************/
+void fimgSoftUnmap(void *vaddr)
+{
+	fimgSoftFree(vaddr);
+}
+
+/*
+ * Device interface
+ */
+
+/*****************************************************************************
+ * FUNCTION:	fimgDeviceOpen
+ * SYNOPSIS:	This function attaches the context to emulated device.
+ * RETURNS:	 0, on success
+ *		-errno, on error
+ *****************************************************************************/
+int fimgDeviceOpen(fimgContext *ctx)
+{
+	softDevice *dev = softGetDevice();
+
+	if (!dev) {
+		ALOGE("Couldn't create emulated 3D device.");
+		return -ENOMEM;
+	}
+
+	ctx->fd = -1;
+	ctx->base = (volatile char *)dev->regs;
+
+	ALOGD("Opened emulated 3D device.");
+
+	return 0;
+}
+
+/*****************************************************************************
+ * FUNCTION:	fimgDeviceClose
+ * SYNOPSIS:	This function detaches the context from emulated device
+ *****************************************************************************/
+void fimgDeviceClose(fimgContext *ctx)
+{
+	softDevice *dev = softDev;
+
+	pthread_mutex_lock(&softHwLock);
+	if (dev->owner == ctx)
+		dev->owner = NULL;
+	pthread_mutex_unlock(&softHwLock);
+
+	softPutDevice(dev);
+
+	ALOGD("Closed emulated 3D device.");
+}
+
+/*****************************************************************************
+ * FUNCTION:	fimgAcquireHardwareLock
+ * SYNOPSIS:	This function claims the hardware for exclusive use
+ * RETURNS:	0 on success,
+ *		positive value if the context needs to be restored,
+ *		negative value on error
+ *****************************************************************************/
+int fimgAcquireHardwareLock(fimgContext *ctx)
+{
+	softDevice *dev = softDev;
+	int ret = 0;
+
+	pthread_mutex_lock(&softHwLock);
+
+	if (dev->owner != ctx) {
+		dev->owner = ctx;
+		ret = 1;
+	}
+
+	ctx->locked = 1;
+
+	return ret;
+}
+
+/*****************************************************************************
+ * FUNCTION:	fimgReleaseHardwareLock
+ * SYNOPSIS:	This function ends exclusive use of the hardware
+ * RETURNS:	0 on success,
+ *		negative value on error
+ *****************************************************************************/
+int fimgReleaseHardwareLock(fimgContext *ctx)
+{
+	ctx->locked = 0;
+
+	pthread_mutex_unlock(&softHwLock);
+
+	return 0;
+}
+
+/*****************************************************************************
+ * FUNCTION:	fimgWaitForFlush
+ * SYNOPSIS:	This function waits for the hardware to flush the pipeline
+ *		(emulated pipeline is always empty)
+ * RETURNS:	0 on success,
+ *		negative value on error
+ * ARGUMENTS:	target - requested pipeline stages to be flushed
+ *****************************************************************************/
+int fimgWaitForFlush(fimgContext *ctx, uint32_t target)
+{
+	return 0;
+}
+
+/*****************************************************************************
+ * FUNCTION:	fimgWaitForIdle
+ * SYNOPSIS:	This function waits for the hardware to become idle
+ *		(emulated pipeline and caches are always idle)
+ * RETURNS:	0 on success,
+ *		negative value on error
+ *****************************************************************************/
+int fimgWaitForIdle(fimgContext *ctx, uint32_t pipeMask,
+				uint32_t cacheMask, unsigned int timeout)
+{
+	return 0;
+}
+
+/*
+ * Vertex fetch
+ */
+
+static float halfToFloat(uint16_t h)
+{
+	int exp = (h >> 10) & 0x1f;
+	int mant = h & 0x3ff;
+	float val;
+
+	if (!exp)
+		val = ldexpf(mant, -24);
+	else if (exp == 31)
+		val = mant ? NAN : INFINITY;
+	else
+		val = ldexpf(mant | 0x400, exp - 25);
+
+	return (h & 0x8000) ? -val : val;
+}
+
+static float fetchComponent(const uint8_t *p, unsigned int dt)
+{
+	uint32_t word;
+	float val;
+
+	switch (dt) {
+	case FGHI_ATTRIB_DT_BYTE:
+		return *(const int8_t *)p;
+	case FGHI_ATTRIB_DT_UBYTE:
+		return *p;
+	case FGHI_ATTRIB_DT_NBYTE:
+		val = *(const int8_t *)p / 127.0f;
+		return (val < -1.0f) ? -1.0f : val;
+	case FGHI_ATTRIB_DT_NUBYTE:
+		return *p / 255.0f;
+	case FGHI_ATTRIB_DT_SHORT:
+		return (int16_t)(p[0] | (p[1] << 8));
+	case FGHI_ATTRIB_DT_USHORT:
+		return (uint16_t)(p[0] | (p[1] << 8));
+	case FGHI_ATTRIB_DT_NSHORT:
+		val = (int16_t)(p[0] | (p[1] << 8)) / 32767.0f;
+		return (val < -1.0f) ? -1.0f : val;
+	case FGHI_ATTRIB_DT_NUSHORT:
+		return (uint16_t)(p[0] | (p[1] << 8)) / 65535.0f;
+	case FGHI_ATTRIB_DT_HALF_FLOAT:
+		return halfToFloat(p[0] | (p[1] << 8));
+	}
+
+	word = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+
+	switch (dt) {
+	case FGHI_ATTRIB_DT_INT:
+		return (int32_t)word;
+	case FGHI_ATTRIB_DT_UINT:
+		return word;
+	case FGHI_ATTRIB_DT_FIXED:
+		return (int32_t)word / 65536.0f;
+	case FGHI_ATTRIB_DT_NFIXED:
+		return (int32_t)word / 2147483648.0f;
+	case FGHI_ATTRIB_DT_NINT:
+		val = (int32_t)word / 2147483647.0f;
+		return (val < -1.0f) ? -1.0f : val;
+	case FGHI_ATTRIB_DT_NUINT:
+		return word / 4294967295.0f;
+	default: {
+		union { uint32_t u; float f; } fval;
+		fval.u = word;
+		return fval.f;
+	}
+	}
+}
+
+static const unsigned int componentSize[] = {
+	[FGHI_ATTRIB_DT_BYTE]		= 1,
+	[FGHI_ATTRIB_DT_SHORT]		= 2,
+	[FGHI_ATTRIB_DT_INT]		= 4,
+	[FGHI_ATTRIB_DT_FIXED]		= 4,
+	[FGHI_ATTRIB_DT_UBYTE]		= 1,
+	[FGHI_ATTRIB_DT_USHORT]		= 2,
+	[FGHI_ATTRIB_DT_UINT]		= 4,
+	[FGHI_ATTRIB_DT_FLOAT]		= 4,
+	[FGHI_ATTRIB_DT_NBYTE]		= 1,
+	[FGHI_ATTRIB_DT_NSHORT]		= 2,
+	[FGHI_ATTRIB_DT_NINT]		= 4,
+	[FGHI_ATTRIB_DT_NFIXED]		= 4,
+	[FGHI_ATTRIB_DT_NUBYTE]		= 1,
+	[FGHI_ATTRIB_DT_NUSHORT]	= 2,
+	[FGHI_ATTRIB_DT_NUINT]		= 4,
+	[FGHI_ATTRIB_DT_HALF_FLOAT]	= 2,
+};
+
+/*
+ * Draw state
+ */
+
+typedef struct {
+	float out[SOFT_MAX_OUTPUTS][4];
+	float win[4];
+} softVertex;
+
+typedef struct {
+	fimgTexControl control;
+	unsigned int uSize;
+	unsigned int vSize;
+	unsigned int offset[FGTU_MAX_MIPMAP_LEVEL];
+	unsigned int minLevel;
+	unsigned int maxLevel;
+	const uint8_t *data;
+	unsigned long avail;
+} softTexture;
+
+typedef struct {
+	softDevice *dev;
+
+	/* Host interface */
+	unsigned int numAttribs;
+	fimgAttribute attrib[FIMG_ATTRIB_NUM];
+	fimgVtxBufAttrib vbctrl[FIMG_ATTRIB_NUM];
+	uint32_t vbbase[FIMG_ATTRIB_NUM];
+
+	/* Primitive engine */
+	unsigned int type;
+	unsigned int numVaryings;
+	fimgVertexContext vctx;
+	float ox, oy, halfPX, halfPY, halfDistance, center;
+
+	/* Rasterizer */
+	float sampleOffset;
+	unsigned int depthOffset;
+	float dOffFactor, dOffUnits;
+	fimgCullingControl cull;
+	int xmin, xmax, ymin, ymax;
+	float pointWidth, pointWidthMin, pointWidthMax;
+	uint32_t coordReplace;
+	float lineWidth;
+
+	/* Shaders */
+	softShader *vs;
+	softShader *ps;
+	int psEnabled;
+
+	/* Texture units */
+	softTexture tex[SOFT_TEXTURE_UNITS];
+	uint32_t texValid;
+
+	/* Per-fragment unit */
+	fimgAlphaTestData alpha;
+	fimgStencilTestData stFront, stBack;
+	fimgDepthTestData depth;
+	fimgBlendControl blend;
+	float blendColor[4];
+	fimgLogOpControl logop;
+	fimgColorBufMask mask;
+	fimgDepthBufMask dbmask;
+	fimgFramebufferControl fbctl;
+	unsigned int width;
+	uint8_t *color;
+	uint32_t *zbuf;
+	unsigned int bpp;
+
+	/* Primitive assembly */
+	softVertex prim[3];
+	softVertex first;
+	unsigned int primCount;
+	unsigned int vertexCount;
+
+	/* Post-transform vertex cache */
+	uint32_t cacheTag[SOFT_VERTEX_CACHE];
+	softVertex cache[SOFT_VERTEX_CACHE];
+} softDraw;
+
+/* Per triangle interpolation setup */
+typedef struct {
+	unsigned int numVaryings;
+	float dNdx[SOFT_MAX_VARYINGS][4];
+	float dNdy[SOFT_MAX_VARYINGS][4];
+	float dDdx, dDdy;
+	float D;
+	float v[SOFT_MAX_VARYINGS][4];
+	int front;
+} softFragment;
+
+/*
+ * Shader interpreter
+ */
+
+static void decodeOperand(softOperand *op, unsigned int type,
+			unsigned int num, unsigned int mod, unsigned int swz)
+{
+	int i;
+
+	op->type = type;
+	op->num = num;
+	op->mod = mod;
+	for (i = 0; i < 4; ++i)
+		op->swz[i] = (swz >> (2*i)) & 3;
+}
+
+static void softLoadShader(softDevice *dev, softShader *sh,
+			unsigned int inst, unsigned int cfloat,
+			unsigned int start, unsigned int end, unsigned int slots)
+{
+	unsigned int pc;
+
+	memcpy(sh->c, (const uint8_t *)dev->regs + cfloat, sizeof(sh->c));
+
+	sh->len = 0;
+	if (start >= slots)
+		return;
+	if (end >= slots)
+		end = slots - 1;
+
+	for (pc = start; pc <= end; ++pc) {
+		const uint32_t *w = dev->regs + (inst + 16*pc) / 4;
+		softInstr *in = &sh->code[sh->len++];
+
+		in->opcode = (w[2] >> 23) & 0x3f;
+		in->dstNum = (w[2] >> 8) & 0x1f;
+		in->dstType = (w[2] >> 13) & 7;
+		in->sat = ((w[2] >> 17) & 3) == 1;
+		in->dstMask = (w[2] >> 19) & 0xf;
+
+		decodeOperand(&in->src[0], (w[1] >> 24) & 7,
+			((w[1] >> 16) & 0x1f) | (((w[1] >> 21) & 7) << 5),
+			(w[1] >> 30) & 3, w[2] & 0xff);
+		decodeOperand(&in->src[1], w[1] & 7, (w[0] >> 24) & 0x1f,
+			(w[1] >> 6) & 3, (w[1] >> 8) & 0xff);
+		decodeOperand(&in->src[2], (w[0] >> 8) & 7, w[0] & 0x1f,
+			(w[0] >> 14) & 3, (w[0] >> 16) & 0xff);
+
+		if (in->opcode == SOP_RET)
+			break;
+	}
+}
+
+static void softSampleTexture(softDraw *d, unsigned int unit,
+			const float *coord, float lod, float *out);
+
+typedef struct {
+	float (*in)[4];
+	float (*out)[4];
+	float r[32][4];
+	softDraw *draw;
+	softFragment *frag;
+} softShaderState;
+
+static void readOperand(softShaderState *st, const softShader *sh,
+					const softOperand *op, float *val)
+{
+	static const float zero[4];
+	const float *reg;
+	int i;
+
+	switch (op->type) {
+	case SRC_V:
+		reg = st->in[op->num & 0xf];
+		break;
+	case SRC_R:
+		reg = st->r[op->num];
+		break;
+	case SRC_C:
+		reg = sh->c[op->num];
+		break;
+	default:
+		reg = zero;
+		break;
+	}
+
+	for (i = 0; i < 4; ++i) {
+		float v = reg[op->swz[i]];
+
+		switch (op->mod) {
+		case 1:
+			v = -v;
+			break;
+		case 2:
+			v = fabsf(v);
+			break;
+		case 3:
+			v = -fabsf(v);
+			break;
+		}
+
+		val[i] = v;
+	}
+}
+
+static float texLod(softShaderState *st, const softOperand *op,
+						const softTexture *tex)
+{
+	softFragment *f = st->frag;
+	float dudx, dudy, dvdx, dvdy, rx, ry;
+	unsigned int j = op->num;
+	unsigned int cs = op->swz[0], ct = op->swz[1];
+
+	if (op->type != SRC_V || j >= f->numVaryings)
+		return 0.0f;
+
+	dudx = (f->dNdx[j][cs] - f->v[j][cs] * f->dDdx) / f->D;
+	dudy = (f->dNdy[j][cs] - f->v[j][cs] * f->dDdy) / f->D;
+	dvdx = (f->dNdx[j][ct] - f->v[j][ct] * f->dDdx) / f->D;
+	dvdy = (f->dNdy[j][ct] - f->v[j][ct] * f->dDdy) / f->D;
+
+	if (tex->control.texCoordSys == FGTU_TSTA_TEX_COOR_PARAM) {
+		dudx *= tex->uSize;
+		dudy *= tex->uSize;
+		dvdx *= tex->vSize;
+		dvdy *= tex->vSize;
+	}
+
+	rx = dudx*dudx + dvdx*dvdx;
+	ry = dudy*dudy + dvdy*dvdy;
+
+	return 0.5f * log2f((rx > ry) ? rx : ry);
+}
+
+/* Returns non-zero if the fragment was killed */
+static int softRunShader(softShaderState *st, const softShader *sh)
+{
+	const softInstr *in = sh->code;
+	const softInstr *end = sh->code + sh->len;
+	float a[4], b[4], c[4], res[4];
+	float *dst;
+	int i;
+
+	for (; in != end; ++in) {
+		switch (in->opcode) {
+		case SOP_NOP:
+			continue;
+		case SOP_RET:
+			return 0;
+		}
+
+		readOperand(st, sh, &in->src[0], a);
+		readOperand(st, sh, &in->src[1], b);
+
+		switch (in->opcode) {
+		case SOP_MOV:
+			memcpy(res, a, sizeof(res));
+			break;
+		case SOP_ADD:
+			for (i = 0; i < 4; ++i)
+				res[i] = a[i] + b[i];
+			break;
+		case SOP_MUL:
+			for (i = 0; i < 4; ++i)
+				res[i] = a[i] * b[i];
+			break;
+		case SOP_MUL_LIT:
+			/* Zero times anything (even infinity) is zero */
+			for (i = 0; i < 4; ++i)
+				res[i] = (a[i] == 0.0f || b[i] == 0.0f)
+							? 0.0f : a[i] * b[i];
+			break;
+		case SOP_MAD:
+			readOperand(st, sh, &in->src[2], c);
+			for (i = 0; i < 4; ++i)
+				res[i] = a[i] * b[i] + c[i];
+			break;
+		case SOP_DP3:
+			res[0] = a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+			res[1] = res[2] = res[3] = res[0];
+			break;
+		case SOP_DP4:
+			res[0] = a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3];
+			res[1] = res[2] = res[3] = res[0];
+			break;
+		case SOP_DPH:
+			res[0] = a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + b[3];
+			res[1] = res[2] = res[3] = res[0];
+			break;
+		case SOP_DP2ADD:
+			readOperand(st, sh, &in->src[2], c);
+			res[0] = a[0]*b[0] + a[1]*b[1] + c[0];
+			res[1] = res[2] = res[3] = res[0];
+			break;
+		case SOP_DST:
+			res[0] = 1.0f;
+			res[1] = a[1] * b[1];
+			res[2] = a[2];
+			res[3] = b[3];
+			break;
+		case SOP_EXP:
+		case SOP_EXP_LIT:
+			res[0] = res[1] = res[2] = res[3] = exp2f(a[0]);
+			break;
+		case SOP_LOG:
+		case SOP_LOG_LIT:
+			res[0] = res[1] = res[2] = res[3] = log2f(fabsf(a[0]));
+			break;
+		case SOP_RCP:
+			res[0] = res[1] = res[2] = res[3] = 1.0f / a[0];
+			break;
+		case SOP_RSQ:
+			res[0] = res[1] = res[2] = res[3] =
+						1.0f / sqrtf(fabsf(a[0]));
+			break;
+		case SOP_MAX:
+			for (i = 0; i < 4; ++i)
+				res[i] = (a[i] >= b[i]) ? a[i] : b[i];
+			break;
+		case SOP_MIN:
+			for (i = 0; i < 4; ++i)
+				res[i] = (a[i] < b[i]) ? a[i] : b[i];
+			break;
+		case SOP_SGE:
+			for (i = 0; i < 4; ++i)
+				res[i] = (a[i] >= b[i]) ? 1.0f : 0.0f;
+			break;
+		case SOP_SLT:
+			for (i = 0; i < 4; ++i)
+				res[i] = (a[i] < b[i]) ? 1.0f : 0.0f;
+			break;
+		case SOP_CMP:
+			readOperand(st, sh, &in->src[2], c);
+			for (i = 0; i < 4; ++i)
+				res[i] = (a[i] >= 0.0f) ? b[i] : c[i];
+			break;
+		case SOP_FRC:
+			for (i = 0; i < 4; ++i)
+				res[i] = a[i] - floorf(a[i]);
+			break;
+		case SOP_TEXLD: {
+			unsigned int unit = in->src[1].num % SOFT_TEXTURE_UNITS;
+			float lod;
+
+			if (!st->frag) {
+				res[0] = res[1] = res[2] = 0.0f;
+				res[3] = 1.0f;
+				break;
+			}
+			lod = texLod(st, &in->src[0], &st->draw->tex[unit]);
+			softSampleTexture(st->draw, unit, a, lod, res);
+			break;
+		}
+		case SOP_TEXKILL:
+			if (a[0] < 0.0f || a[1] < 0.0f
+			    || a[2] < 0.0f || a[3] < 0.0f)
+				return 1;
+			continue;
+		default:
+			/* Not emulated */
+			continue;
+		}
+
+		switch (in->dstType) {
+		case DST_O:
+			dst = st->out[in->dstNum];
+			break;
+		case DST_R:
+			dst = st->r[in->dstNum];
+			break;
+		default:
+			continue;
+		}
+
+		for (i = 0; i < 4; ++i) {
+			float v = res[i];
+
+			if (!(in->dstMask & (1 << i)))
+				continue;
+			if (in->sat)
+				v = (v < 0.0f) ? 0.0f : ((v > 1.0f) ? 1.0f : v);
+			dst[i] = v;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Texture unit
+ */
+
+static void unpackTexel16(uint32_t val, unsigned int fmt,
+					unsigned int rgba, float *out)
+{
+	switch (fmt) {
+	case FGTU_TSTA_TEXTURE_FORMAT_565:
+		out[0] = ((val >> 11) & 0x1f) / 31.0f;
+		out[1] = ((val >> 5) & 0x3f) / 63.0f;
+		out[2] = (val & 0x1f) / 31.0f;
+		out[3] = 1.0f;
+		break;
+	case FGTU_TSTA_TEXTURE_FORMAT_1555:
+		if (rgba) {
+			out[0] = ((val >> 11) & 0x1f) / 31.0f;
+			out[1] = ((val >> 6) & 0x1f) / 31.0f;
+			out[2] = ((val >> 1) & 0x1f) / 31.0f;
+			out[3] = val & 1;
+		} else {
+			out[0] = ((val >> 10) & 0x1f) / 31.0f;
+			out[1] = ((val >> 5) & 0x1f) / 31.0f;
+			out[2] = (val & 0x1f) / 31.0f;
+			out[3] = (val >> 15) & 1;
+		}
+		break;
+	case FGTU_TSTA_TEXTURE_FORMAT_4444:
+		if (rgba) {
+			out[0] = ((val >> 12) & 0xf) / 15.0f;
+			out[1] = ((val >> 8) & 0xf) / 15.0f;
+			out[2] = ((val >> 4) & 0xf) / 15.0f;
+			out[3] = (val & 0xf) / 15.0f;
+		} else {
+			out[3] = ((val >> 12) & 0xf) / 15.0f;
+			out[0] = ((val >> 8) & 0xf) / 15.0f;
+			out[1] = ((val >> 4) & 0xf) / 15.0f;
+			out[2] = (val & 0xf) / 15.0f;
+		}
+		break;
+	case FGTU_TSTA_TEXTURE_FORMAT_DEPTHCOMP16:
+		out[0] = out[1] = out[2] = val / 65535.0f;
+		out[3] = 1.0f;
+		break;
+	case FGTU_TSTA_TEXTURE_FORMAT_88:
+		out[0] = out[1] = out[2] = (val & 0xff) / 255.0f;
+		out[3] = ((val >> 8) & 0xff) / 255.0f;
+		break;
+	}
+}
+
+static void unpackTexel32(uint32_t val, unsigned int rgba, float *out)
+{
+	if (rgba) {
+		out[0] = ((val >> 24) & 0xff) / 255.0f;
+		out[1] = ((val >> 16) & 0xff) / 255.0f;
+		out[2] = ((val >> 8) & 0xff) / 255.0f;
+		out[3] = (val & 0xff) / 255.0f;
+	} else {
+		out[3] = ((val >> 24) & 0xff) / 255.0f;
+		out[0] = ((val >> 16) & 0xff) / 255.0f;
+		out[1] = ((val >> 8) & 0xff) / 255.0f;
+		out[2] = (val & 0xff) / 255.0f;
+	}
+}
+
+static void unpackPalette(softDevice *dev, const softTexture *tex,
+					unsigned int idx, float *out)
+{
+	uint32_t val = dev->palette[idx & 0xff];
+
+	switch (tex->control.paletteFmt) {
+	case FGTU_TSTA_PAL_TEX_FORMAT_1555:
+		unpackTexel16(val, FGTU_TSTA_TEXTURE_FORMAT_1555,
+						tex->control.alphaFmt, out);
+		break;
+	case FGTU_TSTA_PAL_TEX_FORMAT_565:
+		unpackTexel16(val, FGTU_TSTA_TEXTURE_FORMAT_565, 0, out);
+		break;
+	case FGTU_TSTA_PAL_TEX_FORMAT_4444:
+		unpackTexel16(val, FGTU_TSTA_TEXTURE_FORMAT_4444,
+						tex->control.alphaFmt, out);
+		break;
+	default:
+		unpackTexel32(val, tex->control.alphaFmt, out);
+		break;
+	}
+}
+
+static void decodeDXT1(const uint8_t *block, unsigned int x,
+					unsigned int y, float *out)
+{
+	unsigned int c0 = block[0] | (block[1] << 8);
+	unsigned int c1 = block[2] | (block[3] << 8);
+	unsigned int sel = (block[4 + y] >> (2*x)) & 3;
+	float col0[4], col1[4];
+	int i;
+
+	unpackTexel16(c0, FGTU_TSTA_TEXTURE_FORMAT_565, 0, col0);
+	unpackTexel16(c1, FGTU_TSTA_TEXTURE_FORMAT_565, 0, col1);
+
+	for (i = 0; i < 3; ++i) {
+		switch (sel) {
+		case 0:
+			out[i] = col0[i];
+			break;
+		case 1:
+			out[i] = col1[i];
+			break;
+		case 2:
+			out[i] = (c0 > c1) ? (2*col0[i] + col1[i]) / 3
+					: (col0[i] + col1[i]) / 2;
+			break;
+		case 3:
+			out[i] = (c0 > c1) ? (col0[i] + 2*col1[i]) / 3 : 0.0f;
+			break;
+		}
+	}
+
+	out[3] = (sel == 3 && c0 <= c1) ? 0.0f : 1.0f;
+}
+
+static void fetchTexel(softDraw *d, const softTexture *tex,
+			unsigned int level, int x, int y, float *out)
+{
+	unsigned int fmt = tex->control.textureFmt;
+	unsigned int w = tex->uSize >> level;
+	unsigned int texel, bits;
+	unsigned long offset;
+	const uint8_t *p;
+
+	if (!w)
+		w = 1;
+
+	texel = (level ? tex->offset[level - 1] : 0);
+
+	switch (fmt) {
+	case FGTU_TSTA_TEXTURE_FORMAT_S3TC:
+		offset = texel / 2 + 8 * ((y / 4) * ((w + 3) / 4) + x / 4);
+		if (offset + 8 > tex->avail)
+			goto out_of_range;
+		decodeDXT1(tex->data + offset, x & 3, y & 3, out);
+		return;
+	case FGTU_TSTA_TEXTURE_FORMAT_1BPP:
+		bits = 1;
+		break;
+	case FGTU_TSTA_TEXTURE_FORMAT_2BPP:
+		bits = 2;
+		break;
+	case FGTU_TSTA_TEXTURE_FORMAT_4BPP:
+		bits = 4;
+		break;
+	case FGTU_TSTA_TEXTURE_FORMAT_8BPP:
+	case FGTU_TSTA_TEXTURE_FORMAT_8:
+		bits = 8;
+		break;
+	case FGTU_TSTA_TEXTURE_FORMAT_8888:
+		bits = 32;
+		break;
+	case FGTU_TSTA_TEXTURE_FORMAT_1555:
+	case FGTU_TSTA_TEXTURE_FORMAT_565:
+	case FGTU_TSTA_TEXTURE_FORMAT_4444:
+	case FGTU_TSTA_TEXTURE_FORMAT_DEPTHCOMP16:
+	case FGTU_TSTA_TEXTURE_FORMAT_88:
+		bits = 16;
+		break;
+	default:
+		/* YUV formats are not emulated */
+		goto out_of_range;
+	}
+
+	texel += y * w + x;
+	offset = ((unsigned long)texel * bits) / 8;
+	if (offset + (bits + 7) / 8 > tex->avail)
+		goto out_of_range;
+	p = tex->data + offset;
+
+	switch (bits) {
+	case 1:
+	case 2:
+	case 4: {
+		unsigned int shift = (texel * bits) % 8;
+		unpackPalette(d->dev, tex, (*p >> shift) & ((1 << bits) - 1),
+									out);
+		break;
+	}
+	case 8:
+		if (fmt == FGTU_TSTA_TEXTURE_FORMAT_8BPP) {
+			unpackPalette(d->dev, tex, *p, out);
+		} else {
+			out[0] = out[1] = out[2] = *p / 255.0f;
+			out[3] = 1.0f;
+		}
+		break;
+	case 16:
+		unpackTexel16(p[0] | (p[1] << 8), fmt,
+					tex->control.alphaFmt, out);
+		break;
+	case 32:
+		unpackTexel32(p[0] | (p[1] << 8) | (p[2] << 16)
+				| ((uint32_t)p[3] << 24),
+				tex->control.alphaFmt, out);
+		break;
+	}
+	return;
+
+out_of_range:
+	out[0] = out[1] = out[2] = 0.0f;
+	out[3] = 1.0f;
+}
+
+static int wrapCoord(int c, int size, unsigned int mode)
+{
+	switch (mode) {
+	case FGTU_TSTA_ADDR_MODE_CLAMP:
+		return (c < 0) ? 0 : ((c >= size) ? size - 1 : c);
+	case FGTU_TSTA_ADDR_MODE_FLIP:
+		c %= 2*size;
+		if (c < 0)
+			c += 2*size;
+		return (c >= size) ? 2*size - 1 - c : c;
+	default:
+		c %= size;
+		return (c < 0) ? c + size : c;
+	}
+}
+
+static void sampleLevel(softDraw *d, const softTexture *tex,
+		unsigned int level, float s, float t, int linear, float *out)
+{
+	int w = tex->uSize >> level;
+	int h = tex->vSize >> level;
+	unsigned int um = tex->control.uAddrMode;
+	unsigned int vm = tex->control.vAddrMode;
+	float u, v, fu, fv, t00[4], t01[4], t10[4], t11[4];
+	int x0, y0, x1, y1, i;
+
+	if (!w)
+		w = 1;
+	if (!h)
+		h = 1;
+
+	if (tex->control.texCoordSys == FGTU_TSTA_TEX_COOR_PARAM) {
+		u = s * w;
+		v = t * h;
+	} else {
+		u = ldexpf(s, -(int)level);
+		v = ldexpf(t, -(int)level);
+	}
+
+	if (!linear) {
+		x0 = wrapCoord((int)floorf(u), w, um);
+		y0 = wrapCoord((int)floorf(v), h, vm);
+		fetchTexel(d, tex, level, x0, y0, out);
+		return;
+	}
+
+	u -= 0.5f;
+	v -= 0.5f;
+	x0 = (int)floorf(u);
+	y0 = (int)floorf(v);
+	fu = u - x0;
+	fv = v - y0;
+	x1 = wrapCoord(x0 + 1, w, um);
+	y1 = wrapCoord(y0 + 1, h, vm);
+	x0 = wrapCoord(x0, w, um);
+	y0 = wrapCoord(y0, h, vm);
+
+	fetchTexel(d, tex, level, x0, y0, t00);
+	fetchTexel(d, tex, level, x1, y0, t01);
+	fetchTexel(d, tex, level, x0, y1, t10);
+	fetchTexel(d, tex, level, x1, y1, t11);
+
+	for (i = 0; i < 4; ++i) {
+		float top = t00[i] + fu * (t01[i] - t00[i]);
+		float bottom = t10[i] + fu * (t11[i] - t10[i]);
+		out[i] = top + fv * (bottom - top);
+	}
+}
+
+static void softSampleTexture(softDraw *d, unsigned int unit,
+			const float *coord, float lod, float *out)
+{
+	const softTexture *tex = &d->tex[unit];
+	unsigned int minLevel, maxLevel, level;
+	float other[4], frac;
+	int linear;
+	int i;
+
+	if (!(d->texValid & (1 << unit))) {
+		out[0] = out[1] = out[2] = 0.0f;
+		out[3] = 1.0f;
+		return;
+	}
+
+	if (lod <= 0.0f || tex->control.useMipmap == FGTU_TSTA_MIPMAP_DISABLED) {
+		linear = (lod <= 0.0f) ? tex->control.magFilter
+					: tex->control.minFilter;
+		sampleLevel(d, tex, 0, coord[0], coord[1], linear, out);
+		return;
+	}
+
+	minLevel = tex->minLevel;
+	maxLevel = tex->maxLevel;
+	if (maxLevel > FGTU_MAX_MIPMAP_LEVEL)
+		maxLevel = FGTU_MAX_MIPMAP_LEVEL;
+	if (minLevel > maxLevel)
+		minLevel = maxLevel;
+	linear = tex->control.minFilter;
+
+	if (tex->control.useMipmap == FGTU_TSTA_MIPMAP_NEAREST) {
+		level = (unsigned int)(lod + 0.5f);
+		if (level < minLevel)
+			level = minLevel;
+		if (level > maxLevel)
+			level = maxLevel;
+		sampleLevel(d, tex, level, coord[0], coord[1], linear, out);
+		return;
+	}
+
+	level = (unsigned int)lod;
+	frac = lod - level;
+	if (level >= maxLevel) {
+		level = maxLevel;
+		frac = 0.0f;
+	}
+	if (level < minLevel) {
+		level = minLevel;
+		frac = 0.0f;
+	}
+
+	sampleLevel(d, tex, level, coord[0], coord[1], linear, out);
+	if (frac == 0.0f)
+		return;
+
+	sampleLevel(d, tex, level + 1, coord[0], coord[1], linear, other);
+	for (i = 0; i < 4; ++i)
+		out[i] += frac * (other[i] - out[i]);
+}
+
+/*
+ * Per-fragment unit
+ */
+
+static inline int testCompare(unsigned int mode, uint32_t a, uint32_t b)
+{
+	switch (mode) {
+	case FGPF_TEST_MODE_NEVER:	return 0;
+	case FGPF_TEST_MODE_ALWAYS:	return 1;
+	case FGPF_TEST_MODE_LESS:	return a < b;
+	case FGPF_TEST_MODE_LEQUAL:	return a <= b;
+	case FGPF_TEST_MODE_EQUAL:	return a == b;
+	case FGPF_TEST_MODE_GREATER:	return a > b;
+	case FGPF_TEST_MODE_GEQUAL:	return a >= b;
+	default:			return a != b;
+	}
+}
+
+static inline int stencilCompare(unsigned int mode, uint32_t ref, uint32_t val)
+{
+	switch (mode) {
+	case FGPF_STENCIL_MODE_NEVER:	return 0;
+	case FGPF_STENCIL_MODE_ALWAYS:	return 1;
+	case FGPF_STENCIL_MODE_GREATER:	return ref > val;
+	case FGPF_STENCIL_MODE_GEQUAL:	return ref >= val;
+	case FGPF_STENCIL_MODE_EQUAL:	return ref == val;
+	case FGPF_STENCIL_MODE_LESS:	return ref < val;
+	case FGPF_STENCIL_MODE_LEQUAL:	return ref <= val;
+	default:			return ref != val;
+	}
+}
+
+static inline uint32_t stencilOp(unsigned int op, uint32_t val, uint32_t ref)
+{
+	switch (op) {
+	case FGPF_TEST_ACTION_ZERO:	return 0;
+	case FGPF_TEST_ACTION_REPLACE:	return ref;
+	case FGPF_TEST_ACTION_INCR:	return (val < 0xff) ? val + 1 : val;
+	case FGPF_TEST_ACTION_DECR:	return val ? val - 1 : val;
+	case FGPF_TEST_ACTION_INVERT:	return ~val & 0xff;
+	case FGPF_TEST_ACTION_INCR_WRAP:	return (val + 1) & 0xff;
+	case FGPF_TEST_ACTION_DECR_WRAP:	return (val - 1) & 0xff;
+	default:			return val;
+	}
+}
+
+static inline uint32_t toUnorm(float v, unsigned int max)
+{
+	if (!(v > 0.0f))
+		return 0;
+	if (v >= 1.0f)
+		return max;
+	return (uint32_t)(v * max + 0.5f);
+}
+
+static const unsigned int colorBpp[] = {
+	[FGPF_COLOR_MODE_555]	= 2,
+	[FGPF_COLOR_MODE_565]	= 2,
+	[FGPF_COLOR_MODE_4444]	= 2,
+	[FGPF_COLOR_MODE_1555]	= 2,
+	[FGPF_COLOR_MODE_0888]	= 4,
+	[FGPF_COLOR_MODE_8888]	= 4,
+};
+
+static uint32_t packColor(const softDraw *d, const float *c)
+{
+	switch (d->fbctl.colormode) {
+	case FGPF_COLOR_MODE_555:
+		return (toUnorm(c[0], 31) << 10) | (toUnorm(c[1], 31) << 5)
+			| toUnorm(c[2], 31) | 0x8000;
+	case FGPF_COLOR_MODE_565:
+		return (toUnorm(c[0], 31) << 11) | (toUnorm(c[1], 63) << 5)
+			| toUnorm(c[2], 31);
+	case FGPF_COLOR_MODE_4444:
+		return (toUnorm(c[3], 15) << 12) | (toUnorm(c[0], 15) << 8)
+			| (toUnorm(c[1], 15) << 4) | toUnorm(c[2], 15);
+	case FGPF_COLOR_MODE_1555:
+		return ((c[3] >= 0.5f) << 15) | (toUnorm(c[0], 31) << 10)
+			| (toUnorm(c[1], 31) << 5) | toUnorm(c[2], 31);
+	case FGPF_COLOR_MODE_0888:
+		return (d->fbctl.alphaconst << 24) | (toUnorm(c[0], 255) << 16)
+			| (toUnorm(c[1], 255) << 8) | toUnorm(c[2], 255);
+	default:
+		return (toUnorm(c[3], 255) << 24) | (toUnorm(c[0], 255) << 16)
+			| (toUnorm(c[1], 255) << 8) | toUnorm(c[2], 255);
+	}
+}
+
+static void unpackColor(const softDraw *d, uint32_t val, float *c)
+{
+	switch (d->fbctl.colormode) {
+	case FGPF_COLOR_MODE_555:
+		unpackTexel16(val & 0x7fff, FGTU_TSTA_TEXTURE_FORMAT_1555, 0, c);
+		c[3] = 1.0f;
+		break;
+	case FGPF_COLOR_MODE_565:
+		unpackTexel16(val, FGTU_TSTA_TEXTURE_FORMAT_565, 0, c);
+		break;
+	case FGPF_COLOR_MODE_4444:
+		unpackTexel16(val, FGTU_TSTA_TEXTURE_FORMAT_4444, 0, c);
+		break;
+	case FGPF_COLOR_MODE_1555:
+		unpackTexel16(val, FGTU_TSTA_TEXTURE_FORMAT_1555, 0, c);
+		break;
+	case FGPF_COLOR_MODE_0888:
+		unpackTexel32(val, 0, c);
+		c[3] = d->fbctl.alphaconst / 255.0f;
+		break;
+	default:
+		unpackTexel32(val, 0, c);
+		break;
+	}
+}
+
+/* Bits of packed color covered by given channel (r, g, b, a) */
+static uint32_t channelBits(unsigned int mode, unsigned int channel)
+{
+	static const uint32_t bits[][4] = {
+		[FGPF_COLOR_MODE_555]	= { 0x7c00, 0x03e0, 0x001f, 0x8000 },
+		[FGPF_COLOR_MODE_565]	= { 0xf800, 0x07e0, 0x001f, 0x0000 },
+		[FGPF_COLOR_MODE_4444]	= { 0x0f00, 0x00f0, 0x000f, 0xf000 },
+		[FGPF_COLOR_MODE_1555]	= { 0x7c00, 0x03e0, 0x001f, 0x8000 },
+		[FGPF_COLOR_MODE_0888]	= { 0xff0000, 0xff00, 0xff, 0xff000000 },
+		[FGPF_COLOR_MODE_8888]	= { 0xff0000, 0xff00, 0xff, 0xff000000 },
+	};
+
+	return bits[mode][channel];
+}
+
+static float blendFactor(unsigned int func, const float *src,
+			const float *dst, const float *cc, int i)
+{
+	switch (func) {
+	case FGPF_BLEND_FUNC_ZERO:			return 0.0f;
+	case FGPF_BLEND_FUNC_ONE:			return 1.0f;
+	case FGPF_BLEND_FUNC_SRC_COLOR:			return src[i];
+	case FGPF_BLEND_FUNC_ONE_MINUS_SRC_COLOR:	return 1.0f - src[i];
+	case FGPF_BLEND_FUNC_DST_COLOR:			return dst[i];
+	case FGPF_BLEND_FUNC_ONE_MINUS_DST_COLOR:	return 1.0f - dst[i];
+	case FGPF_BLEND_FUNC_SRC_ALPHA:			return src[3];
+	case FGPF_BLEND_FUNC_ONE_MINUS_SRC_ALPHA:	return 1.0f - src[3];
+	case FGPF_BLEND_FUNC_DST_ALPHA:			return dst[3];
+	case FGPF_BLEND_FUNC_ONE_MINUS_DST_ALPHA:	return 1.0f - dst[3];
+	case FGPF_BLEND_FUNC_CONST_COLOR:		return cc[i];
+	case FGPF_BLEND_FUNC_ONE_MINUS_CONST_COLOR:	return 1.0f - cc[i];
+	case FGPF_BLEND_FUNC_CONST_ALPHA:		return cc[3];
+	case FGPF_BLEND_FUNC_ONE_MINUS_CONST_ALPHA:	return 1.0f - cc[3];
+	default:
+		if (i == 3)
+			return 1.0f;
+		return (src[3] < 1.0f - dst[3]) ? src[3] : 1.0f - dst[3];
+	}
+}
+
+static float blendEquation(unsigned int eq, float s, float d,
+						float sf, float df)
+{
+	switch (eq) {
+	case FGPF_BLEND_EQUATION_SUB:		return s*sf - d*df;
+	case FGPF_BLEND_EQUATION_REVSUB:	return d*df - s*sf;
+	case FGPF_BLEND_EQUATION_MIN:		return (s < d) ? s : d;
+	case FGPF_BLEND_EQUATION_MAX:		return (s > d) ? s : d;
+	default:				return s*sf + d*df;
+	}
+}
+
+static uint32_t logicOp(unsigned int op, uint32_t s, uint32_t d)
+{
+	switch (op) {
+	case FGPF_LOGOP_CLEAR:		return 0;
+	case FGPF_LOGOP_AND:		return s & d;
+	case FGPF_LOGOP_AND_REVERSE:	return s & ~d;
+	case FGPF_LOGOP_COPY:		return s;
+	case FGPF_LOGOP_AND_INVERTED:	return ~s & d;
+	case FGPF_LOGOP_NOOP:		return d;
+	case FGPF_LOGOP_XOR:		return s ^ d;
+	case FGPF_LOGOP_OR:		return s | d;
+	case FGPF_LOGOP_NOR:		return ~(s | d);
+	case FGPF_LOGOP_EQUIV:		return ~(s ^ d);
+	case FGPF_LOGOP_INVERT:		return ~d;
+	case FGPF_LOGOP_OR_REVERSE:	return s | ~d;
+	case FGPF_LOGOP_COPY_INVERTED:	return ~s;
+	case FGPF_LOGOP_OR_INVERTED:	return ~s | d;
+	case FGPF_LOGOP_NAND:		return ~(s & d);
+	default:			return ~0U;
+	}
+}
+
+static void softWriteFragment(softDraw *d, int x, int y, float z,
+						float *src, int front)
+{
+	uint32_t *zptr = NULL, zval = 0, color, dcolor, mask;
+	unsigned int offset = y * d->width + x;
+	float dst[4];
+	int i;
+
+	/* Alpha test */
+	if (d->alpha.enable && !testCompare(d->alpha.mode,
+				toUnorm(src[3], 255), d->alpha.value))
+		return;
+
+	/* Stencil and depth tests */
+	if (d->zbuf) {
+		fimgStencilTestData st = front ? d->stFront : d->stBack;
+		uint32_t smask = ~(front ? d->dbmask.frontmask
+					: d->dbmask.backmask) & 0xff;
+		uint32_t z24 = toUnorm(z, 0xffffff);
+		uint32_t sval, nval = 0;
+		int pass = 1, op = -1;
+
+		zptr = d->zbuf + offset;
+		zval = *zptr;
+		sval = zval >> 24;
+
+		if (st.enable && !stencilCompare(st.mode,
+				st.ref & st.mask, sval & st.mask)) {
+			op = st.sfail;
+			pass = 0;
+		} else if (d->depth.enable && !testCompare(d->depth.mode,
+						z24, zval & 0xffffff)) {
+			op = st.dpfail;
+			pass = 0;
+		} else if (st.enable) {
+			op = st.dppass;
+		}
+
+		if (op >= 0)
+			nval = stencilOp(op, sval, st.ref);
+		if (op >= 0 && ((nval ^ sval) & smask))
+			zval = (zval & 0xffffff)
+				| ((((sval & ~smask) | (nval & smask))
+							& 0xff) << 24);
+		if (pass && d->depth.enable && !d->dbmask.depth)
+			zval = (zval & 0xff000000) | z24;
+
+		*zptr = zval;
+
+		if (!pass)
+			return;
+	}
+
+	/* Blending */
+	if (d->bpp == 2)
+		dcolor = ((uint16_t *)d->color)[offset];
+	else
+		dcolor = ((uint32_t *)d->color)[offset];
+
+	for (i = 0; i < 4; ++i)
+		src[i] = (src[i] < 0.0f) ? 0.0f
+				: ((src[i] > 1.0f) ? 1.0f : src[i]);
+
+	if (d->blend.enable) {
+		float out[4];
+
+		unpackColor(d, dcolor, dst);
+		for (i = 0; i < 3; ++i)
+			out[i] = blendEquation(d->blend.cblendequation,
+				src[i], dst[i],
+				blendFactor(d->blend.csrcblendfunc,
+						src, dst, d->blendColor, i),
+				blendFactor(d->blend.cdstblendfunc,
+						src, dst, d->blendColor, i));
+		out[3] = blendEquation(d->blend.ablendequation,
+				src[3], dst[3],
+				blendFactor(d->blend.asrcblendfunc,
+						src, dst, d->blendColor, 3),
+				blendFactor(d->blend.adstblendfunc,
+						src, dst, d->blendColor, 3));
+		memcpy(src, out, sizeof(out));
+	}
+
+	if (d->fbctl.opaque)
+		src[3] = 1.0f;
+
+	color = packColor(d, src);
+
+	/* Logical operation */
+	if (d->logop.enable) {
+		uint32_t abits = channelBits(d->fbctl.colormode, 3);
+
+		color = (logicOp(d->logop.color, color, dcolor) & ~abits)
+			| (logicOp(d->logop.alpha, color, dcolor) & abits);
+	}
+
+	/* Color mask (set bits disable writes) */
+	mask = 0;
+	if (d->mask.r)
+		mask |= channelBits(d->fbctl.colormode, 0);
+	if (d->mask.g)
+		mask |= channelBits(d->fbctl.colormode, 1);
+	if (d->mask.b)
+		mask |= channelBits(d->fbctl.colormode, 2);
+	if (d->mask.a)
+		mask |= channelBits(d->fbctl.colormode, 3);
+	color = (color & ~mask) | (dcolor & mask);
+
+	if (d->bpp == 2)
+		((uint16_t *)d->color)[offset] = color;
+	else
+		((uint32_t *)d->color)[offset] = color;
+}
+
+/*
+ * Rasterizer
+ */
+
+static inline int edgeTieBreak(float dx, float dy)
+{
+	return (dy > 0.0f) || (dy == 0.0f && dx < 0.0f);
+}
+
+static void softRasterTriangle(softDraw *d, const softVertex *v0,
+			const softVertex *v1, const softVertex *v2,
+			const softVertex *pv, int polygon)
+{
+	float area, x0, y0, x1, y1, x2, y2;
+	float dwdx[3], dwdy[3], dqdx[3], dqdy[3], w[3], wrow[3];
+	float z[3], invw[3], dzdx, dzdy, zOffset = 0.0f;
+	const softVertex *v[3];
+	softFragment frag;
+	softShaderState st;
+	float out[32][4];
+	int tie[3], front = 1;
+	int minx, maxx, miny, maxy, px, py;
+	unsigned int nv = d->numVaryings;
+	unsigned int i, j, c;
+
+	x0 = v0->win[0]; y0 = v0->win[1];
+	x1 = v1->win[0]; y1 = v1->win[1];
+	x2 = v2->win[0]; y2 = v2->win[1];
+
+	area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+	if (!(area > 0.0f || area < 0.0f))
+		return;
+
+	if (polygon) {
+		/* Orientation in normalized device coordinates */
+		int ccw = (area * d->halfPX * d->halfPY) > 0.0f;
+
+		front = d->cull.clockwise ? !ccw : ccw;
+
+		if (d->cull.enable) {
+			switch (d->cull.face) {
+			case FGRA_BFCULL_FACE_BACK:
+				if (!front)
+					return;
+				break;
+			case FGRA_BFCULL_FACE_FRONT:
+				if (front)
+					return;
+				break;
+			default:
+				return;
+			}
+		}
+	}
+
+	v[0] = v0;
+	if (area < 0.0f) {
+		v[1] = v2;
+		v[2] = v1;
+		area = -area;
+	} else {
+		v[1] = v1;
+		v[2] = v2;
+	}
+
+	/* Bounding box clipped to active area */
+	minx = (int)floorf(fminf(x0, fminf(x1, x2)));
+	maxx = (int)ceilf(fmaxf(x0, fmaxf(x1, x2))) + 1;
+	miny = (int)floorf(fminf(y0, fminf(y1, y2)));
+	maxy = (int)ceilf(fmaxf(y0, fmaxf(y1, y2))) + 1;
+	if (minx < d->xmin)
+		minx = d->xmin;
+	if (maxx > d->xmax)
+		maxx = d->xmax;
+	if (miny < d->ymin)
+		miny = d->ymin;
+	if (maxy > d->ymax)
+		maxy = d->ymax;
+	if (minx >= maxx || miny >= maxy)
+		return;
+
+	/* Edge functions, w[i] is the one opposite to vertex i */
+	for (i = 0; i < 3; ++i) {
+		const softVertex *a = v[(i + 1) % 3];
+		const softVertex *b = v[(i + 2) % 3];
+		float dx = b->win[0] - a->win[0];
+		float dy = b->win[1] - a->win[1];
+		float sx = minx + d->sampleOffset;
+		float sy = miny + d->sampleOffset;
+
+		dwdx[i] = -dy;
+		dwdy[i] = dx;
+		wrow[i] = dx * (sy - a->win[1]) - dy * (sx - a->win[0]);
+		tie[i] = edgeTieBreak(dx, dy);
+
+		z[i] = v[i]->win[2];
+		invw[i] = v[i]->win[3];
+		dqdx[i] = dwdx[i] / area * invw[i];
+		dqdy[i] = dwdy[i] / area * invw[i];
+	}
+
+	/* Interpolation setup */
+	memset(&frag, 0, sizeof(frag));
+	frag.numVaryings = nv;
+	frag.front = front;
+	frag.dDdx = dqdx[0] + dqdx[1] + dqdx[2];
+	frag.dDdy = dqdy[0] + dqdy[1] + dqdy[2];
+	for (j = 0; j < nv; ++j) {
+		int flat = d->vctx.flatShadeEn
+				&& (d->vctx.flatShadeSel & (1 << (j + 1)));
+
+		for (c = 0; c < 4; ++c) {
+			if (flat)
+				continue;
+			for (i = 0; i < 3; ++i) {
+				frag.dNdx[j][c] += dqdx[i] * v[i]->out[j + 1][c];
+				frag.dNdy[j][c] += dqdy[i] * v[i]->out[j + 1][c];
+			}
+		}
+	}
+
+	dzdx = (dwdx[0]*z[0] + dwdx[1]*z[1] + dwdx[2]*z[2]) / area;
+	dzdy = (dwdy[0]*z[0] + dwdy[1]*z[1] + dwdy[2]*z[2]) / area;
+	if (polygon && d->depthOffset)
+		zOffset = d->dOffFactor * fmaxf(fabsf(dzdx), fabsf(dzdy))
+				+ d->dOffUnits / 16777216.0f;
+
+	memset(out, 0, sizeof(out));
+	st.in = frag.v;
+	st.out = out;
+	st.draw = d;
+	st.frag = &frag;
+
+	for (py = miny; py < maxy; ++py) {
+		for (i = 0; i < 3; ++i)
+			w[i] = wrow[i];
+
+		for (px = minx; px < maxx; ++px) {
+			float b[3], q[3], zf;
+
+			for (i = 0; i < 3; ++i)
+				if (w[i] < 0.0f || (w[i] == 0.0f && !tie[i]))
+					goto next;
+
+			for (i = 0; i < 3; ++i) {
+				b[i] = w[i] / area;
+				q[i] = b[i] * invw[i];
+			}
+			frag.D = q[0] + q[1] + q[2];
+			if (!(frag.D > 0.0f))
+				goto next;
+
+			for (j = 0; j < nv; ++j) {
+				int flat = d->vctx.flatShadeEn
+					&& (d->vctx.flatShadeSel & (1 << (j + 1)));
+
+				for (c = 0; c < 4; ++c) {
+					if (flat) {
+						frag.v[j][c] = pv->out[j + 1][c];
+						continue;
+					}
+					frag.v[j][c] = (q[0]*v[0]->out[j + 1][c]
+						+ q[1]*v[1]->out[j + 1][c]
+						+ q[2]*v[2]->out[j + 1][c])
+						/ frag.D;
+				}
+			}
+
+			zf = b[0]*z[0] + b[1]*z[1] + b[2]*z[2] + zOffset;
+
+			if (d->psEnabled) {
+				if (softRunShader(&st, d->ps))
+					goto next;
+			} else {
+				memcpy(out[PS_OUT_COLOR], frag.v[0],
+						sizeof(out[PS_OUT_COLOR]));
+			}
+
+			softWriteFragment(d, px, py, zf, out[PS_OUT_COLOR], front);
+next:
+			for (i = 0; i < 3; ++i)
+				w[i] += dwdx[i];
+		}
+
+		for (i = 0; i < 3; ++i)
+			wrow[i] += dwdy[i];
+	}
+}
+
+/* Points and lines are rasterized as screen aligned quads */
+static void softRasterQuad(softDraw *d, softVertex *q, const softVertex *pv)
+{
+	softRasterTriangle(d, &q[0], &q[1], &q[2], pv, 0);
+	softRasterTriangle(d, &q[2], &q[1], &q[3], pv, 0);
+}
+
+static void softRasterPoint(softDraw *d, const softVertex *v)
+{
+	float size = d->pointWidth;
+	softVertex q[4];
+	unsigned int i, j;
+
+	if (size < d->pointWidthMin)
+		size = d->pointWidthMin;
+	if (size > d->pointWidthMax)
+		size = d->pointWidthMax;
+	size *= 0.5f;
+
+	for (i = 0; i < 4; ++i) {
+		q[i] = *v;
+		q[i].win[0] += (i & 1) ? size : -size;
+		q[i].win[1] += (i & 2) ? size : -size;
+
+		if (d->type != FGPE_POINT_SPRITE)
+			continue;
+
+		for (j = 1; j < SOFT_MAX_OUTPUTS; ++j) {
+			if (!(d->coordReplace & (1 << j)))
+				continue;
+			q[i].out[j][0] = (i & 1) ? 1.0f : 0.0f;
+			q[i].out[j][1] = (i & 2) ? 1.0f : 0.0f;
+			q[i].out[j][2] = 0.0f;
+			q[i].out[j][3] = 1.0f;
+		}
+	}
+
+	softRasterQuad(d, q, v);
+}
+
+static void softRasterLine(softDraw *d, const softVertex *v0,
+						const softVertex *v1)
+{
+	float dx = v1->win[0] - v0->win[0];
+	float dy = v1->win[1] - v0->win[1];
+	float len = sqrtf(dx*dx + dy*dy);
+	float nx, ny;
+	softVertex q[4];
+
+	if (!(len > 0.0f))
+		return;
+
+	nx = -dy / len * 0.5f * d->lineWidth;
+	ny = dx / len * 0.5f * d->lineWidth;
+
+	q[0] = *v0;
+	q[1] = *v0;
+	q[2] = *v1;
+	q[3] = *v1;
+	q[0].win[0] += nx;
+	q[0].win[1] += ny;
+	q[1].win[0] -= nx;
+	q[1].win[1] -= ny;
+	q[2].win[0] += nx;
+	q[2].win[1] += ny;
+	q[3].win[0] -= nx;
+	q[3].win[1] -= ny;
+
+	softRasterQuad(d, q, v1);
+}
+
+/*
+ * Primitive engine
+ */
+
+static void softViewport(const softDraw *d, softVertex *v)
+{
+	float invw = 1.0f / v->out[0][3];
+
+	v->win[0] = d->ox + d->halfPX * v->out[0][0] * invw;
+	v->win[1] = d->oy + d->halfPY * v->out[0][1] * invw;
+	v->win[2] = d->center + d->halfDistance * v->out[0][2] * invw;
+	v->win[3] = invw;
+}
+
+static void lerpVertex(softVertex *dst, const softVertex *a,
+				const softVertex *b, float t, unsigned int count)
+{
+	unsigned int i, c;
+
+	for (i = 0; i < count; ++i)
+		for (c = 0; c < 4; ++c)
+			dst->out[i][c] = a->out[i][c]
+					+ t * (b->out[i][c] - a->out[i][c]);
+}
+
+/* Clips polygon against near and far planes, returns vertex count */
+static unsigned int clipPolygon(softDraw *d, softVertex *poly,
+					softVertex *tmp, unsigned int n)
+{
+	unsigned int plane, i, m;
+	unsigned int count = d->numVaryings + 1;
+	softVertex *src = poly, *dst = tmp, *swap;
+
+	for (plane = 0; plane < 2; ++plane) {
+		float sign = plane ? -1.0f : 1.0f;
+
+		m = 0;
+		for (i = 0; i < n; ++i) {
+			const softVertex *a = &src[i];
+			const softVertex *b = &src[(i + 1) % n];
+			float da = a->out[0][3] + sign * a->out[0][2];
+			float db = b->out[0][3] + sign * b->out[0][2];
+
+			if (da >= 0.0f)
+				dst[m++] = *a;
+			if ((da >= 0.0f) != (db >= 0.0f))
+				lerpVertex(&dst[m++], a, b, da / (da - db),
+									count);
+		}
+
+		n = m;
+		swap = src;
+		src = dst;
+		dst = swap;
+		if (n < 3)
+			return 0;
+	}
+
+	/* Two passes leave the result in the original buffer */
+	return n;
+}
+
+static inline int insideClipVolume(const softVertex *v)
+{
+	float w = v->out[0][3];
+
+	return w > 0.0f && v->out[0][2] >= -w && v->out[0][2] <= w;
+}
+
+static void softTriangle(softDraw *d, const softVertex *a,
+			const softVertex *b, const softVertex *c)
+{
+	softVertex poly[9], tmp[9];
+	unsigned int i, n;
+
+	if (insideClipVolume(a) && insideClipVolume(b) && insideClipVolume(c)) {
+		softRasterTriangle(d, a, b, c, c, 1);
+		return;
+	}
+
+	poly[0] = *a;
+	poly[1] = *b;
+	poly[2] = *c;
+
+	n = clipPolygon(d, poly, tmp, 3);
+	for (i = 0; i < n; ++i)
+		softViewport(d, &poly[i]);
+
+	for (i = 2; i < n; ++i)
+		softRasterTriangle(d, &poly[0], &poly[i - 1], &poly[i], c, 1);
+}
+
+static void softLine(softDraw *d, const softVertex *a, const softVertex *b)
+{
+	if (!insideClipVolume(a) || !insideClipVolume(b))
+		return;
+
+	softRasterLine(d, a, b);
+}
+
+static void softPoint(softDraw *d, const softVertex *a)
+{
+	if (!insideClipVolume(a))
+		return;
+
+	softRasterPoint(d, a);
+}
+
+static void softAssemble(softDraw *d, const softVertex *v)
+{
+	softVertex *p = d->prim;
+	unsigned int n = d->vertexCount++;
+
+	switch (d->type) {
+	case FGPE_POINT_SPRITE:
+	case FGPE_POINTS:
+		softPoint(d, v);
+		break;
+	case FGPE_LINES:
+		if (n & 1)
+			softLine(d, &p[0], v);
+		else
+			p[0] = *v;
+		break;
+	case FGPE_LINE_LOOP:
+		if (!n)
+			d->first = *v;
+		/* Fall through */
+	case FGPE_LINE_STRIP:
+		if (n)
+			softLine(d, &p[0], v);
+		p[0] = *v;
+		break;
+	case FGPE_TRIANGLES:
+		if (n % 3 == 2)
+			softTriangle(d, &p[0], &p[1], v);
+		else
+			p[n % 3] = *v;
+		break;
+	case FGPE_TRIANGLE_STRIP:
+		if (n >= 2) {
+			if (n & 1)
+				softTriangle(d, &p[1], &p[0], v);
+			else
+				softTriangle(d, &p[0], &p[1], v);
+			p[0] = p[1];
+		}
+		p[(n >= 1) ? 1 : 0] = *v;
+		break;
+	case FGPE_TRIANGLE_FAN:
+		if (n >= 2)
+			softTriangle(d, &p[0], &p[1], v);
+		p[(n >= 1) ? 1 : 0] = *v;
+		break;
+	}
+}
+
+static void softFinishPrimitive(softDraw *d)
+{
+	if (d->type == FGPE_LINE_LOOP && d->vertexCount > 1)
+		softLine(d, &d->prim[0], &d->first);
+}
+
+/*
+ * Vertex processing
+ */
+
+static void softFetchVertex(softDraw *d, uint32_t index, float (*in)[4])
+{
+	softDevice *dev = d->dev;
+	unsigned int i, c;
+
+	for (i = 0; i < d->numAttribs; ++i) {
+		fimgAttribute attr = d->attrib[i];
+		unsigned int size = componentSize[attr.dt];
+		uint32_t addr = d->vbbase[i] + index * d->vbctrl[i].stride;
+		unsigned int sel[4];
+		float src[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+		for (c = 0; c <= attr.numcomp; ++c) {
+			uint8_t buf[4];
+			unsigned int k;
+
+			for (k = 0; k < size; ++k)
+				buf[k] = dev->vb[(addr + k) % SOFT_VB_SIZE];
+			src[c] = fetchComponent(buf, attr.dt);
+			addr += size;
+		}
+
+		sel[0] = attr.srcx;
+		sel[1] = attr.srcy;
+		sel[2] = attr.srcz;
+		sel[3] = attr.srcw;
+		for (c = 0; c < 4; ++c)
+			in[i][c] = src[sel[c]];
+	}
+}
+
+static const softVertex *softProcessVertex(softDraw *d, uint32_t index)
+{
+	unsigned int slot = index % SOFT_VERTEX_CACHE;
+	softVertex *v = &d->cache[slot];
+	softShaderState st;
+	float in[16][4];
+
+	if (d->cacheTag[slot] == index)
+		return v;
+
+	memset(in, 0, sizeof(in));
+	softFetchVertex(d, index, in);
+
+	memset(v, 0, sizeof(*v));
+	memset(&st, 0, sizeof(st));
+	st.in = in;
+	st.out = v->out;
+	st.draw = d;
+	softRunShader(&st, d->vs);
+
+	if (insideClipVolume(v))
+		softViewport(d, v);
+
+	d->cacheTag[slot] = index;
+
+	return v;
+}
+
+static softTexture *softSetupTexture(softDraw *d, unsigned int unit)
+{
+	softDevice *dev = d->dev;
+	softTexture *tex = &d->tex[unit];
+	const uint32_t *regs = dev->regs + FGTU_TSTA(unit) / 4;
+	unsigned int i;
+
+	tex->control.val = regs[0];
+	tex->uSize = regs[1];
+	tex->vSize = regs[2];
+	for (i = 0; i < FGTU_MAX_MIPMAP_LEVEL; ++i)
+		tex->offset[i] = regs[4 + i];
+	tex->minLevel = regs[15];
+	tex->maxLevel = regs[16];
+	tex->data = softTranslate(dev, regs[17], &tex->avail);
+
+	if (!tex->data || !tex->uSize || !tex->vSize)
+		return NULL;
+
+	return tex;
+}
+
+static int softSetupDraw(softDevice *dev, softDraw *d)
+{
+	unsigned int i, pcStart, pcEnd;
+	fimgClippingControl clip;
+	fimgScissorTestData scissor;
+	unsigned long avail, rows;
+	uint32_t range, cclr;
+
+	memset(d->cacheTag, 0xff, sizeof(d->cacheTag));
+	d->dev = dev;
+	d->primCount = 0;
+	d->vertexCount = 0;
+
+	/* Host interface */
+	d->numAttribs = 0;
+	for (i = 0; i < FIMG_ATTRIB_NUM; ++i) {
+		d->attrib[i].val = softReg(dev, FGHI_ATTRIB(i));
+		d->vbctrl[i].val = softReg(dev, FGHI_ATTRIB_VBCTRL(i));
+		d->vbbase[i] = softReg(dev, FGHI_ATTRIB_VBBASE(i));
+		d->numAttribs = i + 1;
+		if (d->attrib[i].lastattr)
+			break;
+	}
+
+	/* Primitive engine */
+	d->vctx.val = softReg(dev, FGPE_VERTEX_CONTEXT);
+	if (!d->vctx.type)
+		return -1;
+	d->type = __builtin_ctz(d->vctx.type);
+	d->numVaryings = d->vctx.vsOut;
+	if (d->numVaryings > SOFT_MAX_VARYINGS)
+		d->numVaryings = SOFT_MAX_VARYINGS;
+	d->ox = softRegF(dev, FGPE_VIEWPORT_OX);
+	d->oy = softRegF(dev, FGPE_VIEWPORT_OY);
+	d->halfPX = softRegF(dev, FGPE_VIEWPORT_HALF_PX);
+	d->halfPY = softRegF(dev, FGPE_VIEWPORT_HALF_PY);
+	d->halfDistance = softRegF(dev, FGPE_DEPTHRANGE_HALF_F_SUB_N);
+	d->center = softRegF(dev, FGPE_DEPTHRANGE_HALF_F_ADD_N);
+
+	/* Rasterizer */
+	d->sampleOffset = softReg(dev, FGRA_PIX_SAMP) ? 0.0f : 0.5f;
+	d->depthOffset = softReg(dev, FGRA_D_OFF_EN);
+	d->dOffFactor = softRegF(dev, FGRA_D_OFF_FACTOR);
+	d->dOffUnits = softRegF(dev, FGRA_D_OFF_UNITS);
+	d->cull.val = softReg(dev, FGRA_BFCULL);
+	d->pointWidth = softRegF(dev, FGRA_PWIDTH);
+	d->pointWidthMin = softRegF(dev, FGRA_PSIZE_MIN);
+	d->pointWidthMax = softRegF(dev, FGRA_PSIZE_MAX);
+	d->coordReplace = softReg(dev, FGRA_COORDREPLACE);
+	d->lineWidth = softRegF(dev, FGRA_LWIDTH);
+
+	clip.val = softReg(dev, FGRA_XCLIP);
+	d->xmin = clip.minval;
+	d->xmax = clip.maxval;
+	clip.val = softReg(dev, FGRA_YCLIP);
+	d->ymin = clip.minval;
+	d->ymax = clip.maxval;
+
+	scissor.val = softReg(dev, FGPF_SCISSOR_X);
+	if (scissor.enable) {
+		if (d->xmin < (int)scissor.min)
+			d->xmin = scissor.min;
+		if (d->xmax > (int)scissor.max)
+			d->xmax = scissor.max;
+		scissor.val = softReg(dev, FGPF_SCISSOR_Y);
+		if (d->ymin < (int)scissor.min)
+			d->ymin = scissor.min;
+		if (d->ymax > (int)scissor.max)
+			d->ymax = scissor.max;
+	}
+
+	/* Per-fragment unit */
+	d->alpha.val = softReg(dev, FGPF_ALPHAT);
+	d->stFront.val = softReg(dev, FGPF_FRONTST);
+	d->stBack.val = softReg(dev, FGPF_BACKST);
+	d->depth.val = softReg(dev, FGPF_DEPTHT);
+	d->blend.val = softReg(dev, FGPF_BLEND);
+	d->logop.val = softReg(dev, FGPF_LOGOP);
+	d->mask.val = softReg(dev, FGPF_CBMSK);
+	d->dbmask.val = softReg(dev, FGPF_DBMSK);
+	d->fbctl.val = softReg(dev, FGPF_FBCTL);
+	d->width = softReg(dev, FGPF_FBW);
+
+	cclr = softReg(dev, FGPF_CCLR);
+	for (i = 0; i < 4; ++i)
+		d->blendColor[i] = ((cclr >> (24 - 8*i)) & 0xff) / 255.0f;
+
+	if (!d->width || d->fbctl.colormode > FGPF_COLOR_MODE_8888)
+		return -1;
+	if (d->xmax > (int)d->width)
+		d->xmax = d->width;
+
+	d->bpp = colorBpp[d->fbctl.colormode];
+	d->color = softTranslate(dev, softReg(dev, FGPF_CBADDR), &avail);
+	if (!d->color) {
+		ALOGW("Color buffer address %08x is not emulated memory.",
+					softReg(dev, FGPF_CBADDR));
+		return -1;
+	}
+	rows = avail / (d->width * d->bpp);
+	if (d->ymax > (int)rows)
+		d->ymax = rows;
+
+	d->zbuf = (uint32_t *)softTranslate(dev,
+					softReg(dev, FGPF_DBADDR), &avail);
+	if (d->zbuf && avail / (d->width * 4) < (unsigned long)d->ymax)
+		d->zbuf = NULL;
+
+	/* Shaders */
+	range = softReg(dev, FGVS_PCRANGE);
+	pcStart = range & 0x1ff;
+	pcEnd = (range & (1U << 31)) ? SOFT_VS_SLOTS - 1
+					: (range >> 16) & 0x1ff;
+	softLoadShader(dev, d->vs, FGVS_INSTMEM_START, FGVS_CFLOAT_START,
+					pcStart, pcEnd, SOFT_VS_SLOTS);
+
+	d->psEnabled = softReg(dev, FGPS_EXE_MODE) & 1;
+	if (d->psEnabled) {
+		pcStart = softReg(dev, FGPS_PC_START) & 0x1ff;
+		range = softReg(dev, FGPS_PC_END);
+		pcEnd = (range & (1 << 9)) ? SOFT_PS_SLOTS - 1 : range & 0x1ff;
+		softLoadShader(dev, d->ps, FGPS_INSTMEM_START,
+				FGPS_CFLOAT_START, pcStart, pcEnd,
+				SOFT_PS_SLOTS);
+	}
+
+	/* Texture units */
+	d->texValid = 0;
+	for (i = 0; i < SOFT_TEXTURE_UNITS; ++i)
+		if (softSetupTexture(d, i))
+			d->texValid |= 1 << i;
+
+	return 0;
+}
+
+static void softDrawVertices(softDevice *dev, uint32_t first,
+				uint32_t count, const uint32_t *indices)
+{
+	static softShader vs, ps;
+	static softDraw draw;
+	softDraw *d = &draw;
+	uint32_t i;
+
+	/* Serialized by the hardware lock */
+	d->vs = &vs;
+	d->ps = &ps;
+
+	if (softSetupDraw(dev, d))
+		return;
+
+	for (i = 0; i < count; ++i) {
+		uint32_t index = indices ? indices[i] : first + i;
+		softAssemble(d, softProcessVertex(d, index));
+	}
+
+	softFinishPrimitive(d);
+}
+
+/*
+ * Host interface
+ */
+
+static void softFifoWrite(softDevice *dev, uint32_t data)
+{
+	fimgHInterface control;
+	unsigned int perWord, i;
+
+	switch (dev->fifoState) {
+	case FIFO_COUNT:
+		if (!data)
+			return;
+
+		dev->count = data;
+		dev->received = 0;
+
+		control.val = softReg(dev, FGHI_CONTROL);
+		if (control.autoinc) {
+			dev->fifoState = FIFO_FIRST;
+			return;
+		}
+
+		if (dev->indicesSize < data) {
+			uint32_t *buf = realloc(dev->indices, 4 * data);
+			if (!buf) {
+				ALOGE("Failed to allocate index buffer. Terminating.");
+				exit(ENOMEM);
+			}
+			dev->indices = buf;
+			dev->indicesSize = data;
+		}
+
+		dev->fifoState = FIFO_INDICES;
+		return;
+
+	case FIFO_FIRST:
+		dev->fifoState = FIFO_COUNT;
+		softDrawVertices(dev, data, dev->count, NULL);
+		return;
+
+	case FIFO_INDICES:
+		control.val = softReg(dev, FGHI_CONTROL);
+		switch (control.idxtype) {
+		case FGHI_CONTROLIdxTYPE_UBYTE:
+			perWord = 4;
+			break;
+		case FGHI_CONTROLIdxTYPE_USHORT:
+			perWord = 2;
+			break;
+		default:
+			perWord = 1;
+			break;
+		}
+
+		for (i = 0; i < perWord && dev->received < dev->count; ++i) {
+			dev->indices[dev->received++] =
+				(data >> (32 / perWord * i))
+				& (0xffffffffU >> (32 - 32 / perWord));
+		}
+
+		if (dev->received < dev->count)
+			return;
+
+		dev->fifoState = FIFO_COUNT;
+		softDrawVertices(dev, 0, dev->count, dev->indices);
+		return;
+	}
+}
+
+/*
+ * Register access
+ */
+
+/*****************************************************************************
+ * FUNCTION:	fimgSoftWrite
+ * SYNOPSIS:	This function emulates a write to hardware register
+ * ARGUMENTS:	data - value to write
+ *		addr - register offset
+ *****************************************************************************/
+void fimgSoftWrite(fimgContext *ctx, unsigned int data, unsigned int addr)
+{
+	softDevice *dev = softDev;
+
+	if (addr >= FIMG_SFR_SIZE)
+		return;
+
+	if (addr >= FGHI_FIFO_ENTRY && addr < FGHI_VB_ENTRY) {
+		softFifoWrite(dev, data);
+		return;
+	}
+
+	if (addr >= FGHI_VB_ENTRY && addr < FGHI_VB_ENTRY_END) {
+		uint32_t vbAddr = dev->vbAddr % SOFT_VB_SIZE;
+
+		dev->vb[vbAddr] = data;
+		dev->vb[(vbAddr + 1) % SOFT_VB_SIZE] = data >> 8;
+		dev->vb[(vbAddr + 2) % SOFT_VB_SIZE] = data >> 16;
+		dev->vb[(vbAddr + 3) % SOFT_VB_SIZE] = data >> 24;
+		dev->vbAddr += 4;
+		return;
+	}
+
+	switch (addr) {
+	case FGGB_RST:
+		dev->fifoState = FIFO_COUNT;
+		break;
+	case FGHI_VBADDR:
+		dev->vbAddr = data;
+		break;
+	case FGTU_PALETTE_ADDR:
+		dev->paletteAddr = data;
+		break;
+	case FGTU_PALETTE_IN:
+		dev->palette[dev->paletteAddr++ & 0xff] = data;
+		break;
+	}
+
+	dev->regs[addr / 4] = data;
+}
+
+/*****************************************************************************
+ * FUNCTION:	fimgSoftRead
+ * SYNOPSIS:	This function emulates a read from hardware register
+ * RETURNS:	register value
+ * ARGUMENTS:	addr - register offset
+ *****************************************************************************/
+unsigned int fimgSoftRead(fimgContext *ctx, unsigned int addr)
+{
+	softDevice *dev = softDev;
+
+	switch (addr) {
+	case FGGB_PIPESTATE:
+	case FGGB_CACHECTL:
+	case FGPS_IBSTATUS:
+		/* Emulated pipeline is always idle */
+		return 0;
+	case FGHI_DWSPACE:
+		return FGHI_FIFO_SIZE;
+	}
+
+	if (addr >= FIMG_SFR_SIZE)
+		return 0;
+
+	return dev->regs[addr / 4];
+}
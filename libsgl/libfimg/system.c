@@ -39,6 +39,7 @@
 
 #define FIMG_SFR_SIZE 0x80000
 
+#ifndef FIMG_SOFTWARE_BACKEND
 /*****************************************************************************
  * FUNCTION:	fimgDeviceOpen
  * SYNOPSIS:	This function opens and maps the G3D device.
@@ -79,6 +80,7 @@ void fimgDeviceClose(fimgContext *ctx)
 
 	ALOGD("fimg3D: Closed /dev/s3c-g3d (%d).", ctx->fd);
 }
+#endif /* FIMG_SOFTWARE_BACKEND */
 
 /**
 	Context management
@@ -92,20 +94,13 @@ void fimgDeviceClose(fimgContext *ctx)
 fimgContext *fimgCreateContext(void)
 {
 	fimgContext *ctx;
-	uint32_t *queue;
 
 	if ((ctx = malloc(sizeof(*ctx))) == NULL)
 		return NULL;
 
-	if ((queue = malloc(2*(FIMG_MAX_QUEUE_LEN + 1)*sizeof(uint32_t))) == NULL) {
-		free(ctx);
-		return NULL;
-	}
-
 	memset(ctx, 0, sizeof(fimgContext));
 
 	if(fimgDeviceOpen(ctx)) {
-		free(queue);
 		free(ctx);
 		return NULL;
 	}
@@ -119,9 +114,16 @@ fimgContext *fimgCreateContext(void)
 	fimgCreateCompatContext(ctx);
 #endif
 
-	ctx->queue = queue;
-	ctx->queue[0] = 0;
-	ctx->queueStart = queue;
+	/* Hardware state is unknown until first restore */
+	memset(ctx->shadow.stale, 0xff, sizeof(ctx->shadow.stale));
+
+	/* Unique across processes, never matches tags of a reset GPU */
+	ctx->ownerId = (getpid() * 2654435761U) ^ (uint32_t)fimgGetTime()
+				^ (uint32_t)(uintptr_t)ctx;
+	if (!ctx->ownerId)
+		ctx->ownerId = 1;
+
+	ctx->stats.startTime = fimgGetTime();
 
 	return ctx;
 }
@@ -132,46 +134,127 @@ fimgContext *fimgCreateContext(void)
  *****************************************************************************/
 void fimgDestroyContext(fimgContext *ctx)
 {
+	fimgSetHardwareLease(ctx, 0);
 	fimgDeviceClose(ctx);
-	free(ctx->queueStart);
 	free(ctx->vertexData);
+	free(ctx->reuse);
 #ifdef FIMG_FIXED_PIPELINE
-	free(ctx->compat.vshaderBuf);
-	free(ctx->compat.pshaderBuf);
+	fimgDestroyCompatContext(ctx);
 #endif
 	free(ctx);
 }
 
+/*****************************************************************************
+ * FUNCTION:	fimgLostBlocks
+ * SYNOPSIS:	This function checks which blocks have been overwritten
+ *		since last written by this context
+ * RETURNS:	mask of FIMG_BLOCK_BIT() values
+ *****************************************************************************/
+static uint32_t fimgLostBlocks(fimgContext *ctx)
+{
+	uint32_t lost = 0;
+	unsigned int i;
+
+	/* Previous owner could still be using the constants */
+	fimgSelectiveFlush(ctx, FGHI_HAZARD_VSHADER);
+
+	for (i = 0; i < FIMG_NUM_BLOCKS; ++i) {
+		if (fimgRead(ctx, FIMG_TAG_ADDR(i)) != ctx->ownerId
+		    || fimgRead(ctx, FIMG_TAG_ADDR(i) + 4) != ctx->generation[i])
+			lost |= FIMG_BLOCK_BIT(i);
+	}
+
+	return lost;
+}
+
 /*****************************************************************************
  * FUNCTION:	fimgRestoreContext
  * SYNOPSIS:	This function restores a device context to hardware registers
+ * ARGUMENTS:	reset - non-zero if the hardware has been power cycled, so
+ *			no state survived and block tags are not valid
  *****************************************************************************/
-void fimgRestoreContext(fimgContext *ctx)
+void fimgRestoreContext(fimgContext *ctx, int reset)
 {
+	uint32_t lost;
+	unsigned int i;
+
+	if (reset)
+		lost = FIMG_BLOCK_ALL;
+	else
+		lost = fimgLostBlocks(ctx);
+
+	for (i = 0; i < FIMG_NUM_BLOCKS; ++i) {
+		if (lost & FIMG_BLOCK_BIT(i))
+			++ctx->stats.blockRestores;
+		else
+			++ctx->stats.blockRestoresSkipped;
+	}
+
+	/* Another context could have changed the registers */
+	fimgInvalidateShadow(ctx, lost);
+
 //	fprintf(stderr, "fimg: Restoring global state\n"); fflush(stderr);
 	fimgRestoreGlobalState(ctx);
 //	fprintf(stderr, "fimg: Restoring host state\n"); fflush(stderr);
 	fimgRestoreHostState(ctx);
 //	fprintf(stderr, "fimg: Restoring primitive state\n"); fflush(stderr);
-	fimgRestorePrimitiveState(ctx);
+	if (lost & FIMG_BLOCK_BIT(FIMG_BLOCK_PRIMITIVE))
+		fimgRestorePrimitiveState(ctx);
 //	fprintf(stderr, "fimg: Restoring rasterizer state\n"); fflush(stderr);
-	fimgRestoreRasterizerState(ctx);
+	if (lost & FIMG_BLOCK_BIT(FIMG_BLOCK_RASTER))
+		fimgRestoreRasterizerState(ctx);
 //	fprintf(stderr, "fimg: Restoring fragment state\n"); fflush(stderr);
-	fimgRestoreFragmentState(ctx);
+	if (lost & FIMG_BLOCK_BIT(FIMG_BLOCK_FRAGMENT))
+		fimgRestoreFragmentState(ctx);
 #ifdef FIMG_FIXED_PIPELINE
 //	fprintf(stderr, "fimg: Restoring compat state\n"); fflush(stderr);
-	fimgRestoreCompatState(ctx);
+	fimgRestoreCompatState(ctx, lost);
 #endif
 
-	ctx->queue = ctx->queueStart;
-	ctx->queue[0] = 0;
-	ctx->queueLen = 0;
+	++ctx->stats.contextRestores;
+}
+
+/**
+	Hardware lease
+*/
+
+/*****************************************************************************
+ * FUNCTION:	fimgSetHardwareLease
+ * SYNOPSIS:	This function makes the context keep the hardware lock
+ *		across draws, until fimgEndHardwareLease() or fimgFinish()
+ *		is called or given time slice expires
+ * ARGUMENTS:	slice - lease time slice in microseconds, 0 to lock
+ *			the hardware for every draw separately
+ *****************************************************************************/
+void fimgSetHardwareLease(fimgContext *ctx, unsigned int slice)
+{
+	ctx->leaseSlice = slice * 1000ULL;
+
+	if (!slice)
+		fimgEndHardwareLease(ctx);
+}
+
+/*****************************************************************************
+ * FUNCTION:	fimgEndHardwareLease
+ * SYNOPSIS:	This function releases the hardware if still leased
+ *		by the context, e.g. at the end of a frame or before
+ *		blocking; must be called from the thread holding the lease
+ *****************************************************************************/
+void fimgEndHardwareLease(fimgContext *ctx)
+{
+	if (ctx->locked)
+		fimgReleaseHardwareLock(ctx);
+
+	ctx->leaseExpired = 0;
+	ctx->leaseContended = 0;
 }
 
 /**
 	Power management
 */
 
+#ifndef FIMG_SOFTWARE_BACKEND
+
 /*****************************************************************************
  * FUNCTION:	fimgAcquireHardwareLock
  * SYNOPSIS:	This function claims the hardware for exclusive use
@@ -240,3 +323,42 @@ int fimgWaitForFlush(fimgContext *ctx, uint32_t target)
 	return 0;
 }
 
+/*****************************************************************************
+ * FUNCTION:	fimgWaitForIdle
+ * SYNOPSIS:	This function sleeps until the hardware interrupt signals
+ *		that pipeline stages are idle and cache operations finished
+ * RETURNS:	0 on success,
+ *		-ENOSYS if not supported by the kernel,
+ *		other negative value on error
+ * ARGUMENTS:	pipeMask - pipeline stages to be flushed (as in FGGB_PIPESTATE)
+ *		cacheMask - cache operations to finish (as in FGGB_CACHECTL)
+ *		timeout - in milliseconds
+ *****************************************************************************/
+int fimgWaitForIdle(fimgContext *ctx, uint32_t pipeMask,
+				uint32_t cacheMask, unsigned int timeout)
+{
+	struct s3c_g3d_wait_req req;
+	int err;
+
+	req.pipe_mask = pipeMask;
+	req.cache_mask = cacheMask;
+	req.timeout = timeout;
+
+	do {
+		if (!ioctl(ctx->fd, S3C_G3D_WAIT, &req))
+			return 0;
+	} while (errno == EINTR);
+
+	err = errno;
+	if (err == ENOTTY || err == EINVAL)
+		return -ENOSYS;
+
+	if (err == ETIMEDOUT)
+		ALOGE("Timed out waiting for the hardware");
+	else
+		ALOGE("Could not wait for the hardware (%s)", strerror(err));
+	fimgDumpState(ctx, 0, 0, __func__);
+
+	return -err;
+}
+#endif /* FIMG_SOFTWARE_BACKEND */
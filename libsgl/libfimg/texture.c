@@ -23,6 +23,7 @@
 # include <config.h>
 #endif
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include "fimg_private.h"
@@ -96,12 +97,18 @@ fimgTexture *fimgCreateTexture(void)
 
 void fimgDestroyTexture(fimgTexture *texture)
 {
+	free(texture->palette);
 	free(texture);
 }
 
 void fimgInitTexture(fimgTexture *texture, unsigned int flags,
 				unsigned int format, unsigned long addr)
 {
+	free(texture->palette);
+	texture->palette = NULL;
+	texture->paletteSize = 0;
+	texture->paletteId = 0;
+
 	texture->reserved2 = flags;
 	texture->control.textureFmt = format;
 	texture->control.alphaFmt = !!(flags & FGTU_TEX_RGBA);
@@ -132,20 +139,74 @@ void fimgInvalidateTextureCache(fimgContext *ctx)
 
 void fimgSetupTexture(fimgContext *ctx, fimgTexture *texture, unsigned unit)
 {
-	volatile uint32_t *reg = (volatile uint32_t *)(ctx->base +FGTU_TSTA(unit));
-	uint32_t *data = (uint32_t *)texture;
-	unsigned count = sizeof(fimgTexture) / 4;
+	fimgQueueBlock(ctx, (const uint32_t *)texture,
+					FGTU_NUM_REGS, FGTU_TSTA(unit));
+}
+
+/*
+ * Texture palette
+ *
+ * All texture units share a single palette of 256 entries, so it is
+ * loaded when a texture with palette other than the current one is set
+ * up. Every palette set gets an unique ID to find out whether it is
+ * already loaded, even by a texture which reused memory of a freed one.
+ */
+
+static pthread_mutex_t paletteMutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t lastPaletteId;
+
+/*****************************************************************************
+* FUNCTIONS:	fimgSetTexPalette
+* SYNOPSIS:	This function sets palette of texture with 1, 2, 4 or 8-bit
+*		indices of colors.
+* PARAMETERS:	[IN] unsigned int format: palette format
+*			(FGTU_TSTA_PAL_TEX_FORMAT_*)
+*		[IN] const uint32_t *entries: palette entries in given format
+*		[IN] unsigned int count: number of entries (1~256)
+* RETURNS:	0 on success, -1 if out of memory
+*****************************************************************************/
+int fimgSetTexPalette(fimgTexture *texture, unsigned int format,
+				const uint32_t *entries, unsigned int count)
+{
+	if (count > FGTU_PALETTE_ENTRIES)
+		count = FGTU_PALETTE_ENTRIES;
+
+	if (!texture->palette) {
+		texture->palette = malloc(FGTU_PALETTE_ENTRIES
+						* sizeof(*texture->palette));
+		if (!texture->palette)
+			return -1;
+	}
+
+	memcpy(texture->palette, entries, count * sizeof(*entries));
+	texture->paletteSize = count;
+	texture->control.paletteFmt = format;
+
+	pthread_mutex_lock(&paletteMutex);
+	/* 0 means no palette loaded */
+	if (!++lastPaletteId)
+		++lastPaletteId;
+	texture->paletteId = lastPaletteId;
+	pthread_mutex_unlock(&paletteMutex);
+
+	return 0;
+}
+
+/*****************************************************************************
+* FUNCTIONS:	fimgLoadTexPalette
+* SYNOPSIS:	This function writes palette of texture to the hardware.
+*		Texture unit must be idle.
+* PARAMETERS:	[IN] const fimgTexture *texture: texture with palette
+*****************************************************************************/
+void fimgLoadTexPalette(fimgContext *ctx, const fimgTexture *texture)
+{
+	unsigned int i;
+
+	fimgWrite(ctx, 0, FGTU_PALETTE_ADDR);
 
-	asm volatile (
-		"1:\n\t"
-		"ldmia %1!, {r0-r3}\n\t"
-		"stmia %0!, {r0-r3}\n\t"
-		"subs %4, %4, $1\n\t"
-		"bne 1b\n\t"
-		: "=r"(reg), "=r"(data)
-		: "0"(reg), "1"(data), "r"(count / 4)
-		: "r0", "r1", "r2", "r3"
-	);
+	/* Address is incremented after each entry */
+	for (i = 0; i < texture->paletteSize; ++i)
+		fimgWrite(ctx, texture->palette[i], FGTU_PALETTE_IN);
 }
 
 /*****************************************************************************
@@ -265,13 +326,13 @@ void fimgSetTexUnitParams(fimgContext *ctx,
 
 	curReg = TexRegs;
 	regAddr = FGTU_TSTA(unit);
-	fimgWrite(ctx, *(curReg++), regAddr);
+	fimgQueue(ctx, *(curReg++), regAddr);
 	regAddr += 4;
-	fimgWrite(ctx, *(curReg++), regAddr);
+	fimgQueue(ctx, *(curReg++), regAddr);
 	regAddr += 4;
-	fimgWrite(ctx, *(curReg++), regAddr);
+	fimgQueue(ctx, *(curReg++), regAddr);
 	regAddr += 4;
-	fimgWrite(ctx, *(curReg++), regAddr);
+	fimgQueue(ctx, *(curReg++), regAddr);
 
 	if(params->ctrl.bits.useMipmap) {
 		switch(params->ctrl.bits.textureFmt) {
@@ -305,7 +366,7 @@ void fimgSetTexUnitParams(fimgContext *ctx,
 void fimgSetTexStatusParams(fimgContext *ctx,
 			    unsigned int unit, fimgTexControl params)
 {
-	fimgWrite(ctx, params.val, FGTU_TSTA(unit));
+	fimgQueue(ctx, params.val, FGTU_TSTA(unit));
 }
 
 /*****************************************************************************
@@ -336,7 +397,7 @@ unsigned int fimgCalculateMipmapOffset(fimgContext *ctx, unsigned int unit,
 	uCheckSize = uUSize > uVSize ? uUSize : uVSize;
 	uCheckSize /= 2;
 	while(uCheckSize > 0) {
-		fimgWrite(ctx, uOffset, regAddr);
+		fimgQueue(ctx, uOffset, regAddr);
 		regAddr += 4;
 
 		if(++uMipMapLevel == maxLevel)
@@ -356,8 +417,8 @@ unsigned int fimgCalculateMipmapOffset(fimgContext *ctx, unsigned int unit,
 		uOffset += uMipMapSize;
 	}
 
-	fimgWrite(ctx, 0, FGTU_T_MIN_L(unit));
-	fimgWrite(ctx, uMipMapLevel, FGTU_T_MAX_L(unit));
+	fimgQueue(ctx, 0, FGTU_T_MIN_L(unit));
+	fimgQueue(ctx, uMipMapLevel, FGTU_T_MAX_L(unit));
 
 	return uMipMapLevel;
 }
@@ -390,7 +451,7 @@ unsigned int fimgCalculateMipmapOffsetYUV(fimgContext *ctx, unsigned int unit,
 	uCheckSize = uUSize > uVSize ? uUSize : uVSize;
 	uCheckSize /= 2;
 	while(uCheckSize > 0) {
-		fimgWrite(ctx, uOffset, regAddr);
+		fimgQueue(ctx, uOffset, regAddr);
 		regAddr += 4;
 
 		if(++uMipMapLevel == maxLevel)
@@ -413,8 +474,8 @@ unsigned int fimgCalculateMipmapOffsetYUV(fimgContext *ctx, unsigned int unit,
 		uOffset += uMipMapSize % 2;
 	}
 
-	fimgWrite(ctx, 0, FGTU_T_MIN_L(unit));
-	fimgWrite(ctx, uMipMapLevel, FGTU_T_MAX_L(unit));
+	fimgQueue(ctx, 0, FGTU_T_MIN_L(unit));
+	fimgQueue(ctx, uMipMapLevel, FGTU_T_MAX_L(unit));
 
 	return uMipMapLevel;
 }
@@ -447,7 +508,7 @@ unsigned int fimgCalculateMipmapOffsetS3TC(fimgContext *ctx, unsigned int unit,
 	uCheckSize = uUSize > uVSize ? uUSize : uVSize;
 	uCheckSize /= 2;
 	while(uCheckSize > 0) {
-		fimgWrite(ctx, uOffset, regAddr);
+		fimgQueue(ctx, uOffset, regAddr);
 		regAddr += 4;
 
 		if(++uMipMapLevel == maxLevel)
@@ -470,8 +531,8 @@ unsigned int fimgCalculateMipmapOffsetS3TC(fimgContext *ctx, unsigned int unit,
 		uOffset += (16 - (uMipMapSize % 16)) % 16;
 	}
 
-	fimgWrite(ctx, 0, FGTU_T_MIN_L(unit));
-	fimgWrite(ctx, uMipMapLevel, FGTU_T_MAX_L(unit));
+	fimgQueue(ctx, 0, FGTU_T_MIN_L(unit));
+	fimgQueue(ctx, uMipMapLevel, FGTU_T_MAX_L(unit));
 
 	return uMipMapLevel;
 }
@@ -106,6 +106,11 @@ static inline void setGlThreadSpecific(FGLContext* value)
 #define LOGD(fmt, ...)	\
 		pr_log(LOG_DBG, __FILE__, __LINE__, fmt, ##__VA_ARGS__)
 
+#define ALOGE	LOGE
+#define ALOGW	LOGW
+#define ALOGI	LOGI
+#define ALOGD	LOGD
+
 #endif /* PLATFORM_HAS_CUSTOM_LOG */
 
 #endif /* _EGLPLATFORM_H_ */
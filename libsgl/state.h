@@ -132,13 +132,17 @@ struct FGLEGLState {
 	EGLConfig config;
 	EGLSurface draw;
 	EGLSurface depth;
+	unsigned statsFrames;
+	unsigned statsInterval;
 
 	FGLEGLState() :
 		flags(0),
 		dpy(0),
 		config(0),
 		draw(0),
-		depth(0) {};
+		depth(0),
+		statsFrames(0),
+		statsInterval(0) {};
 };
 
 struct FGLTextureState {
@@ -271,6 +275,11 @@ struct FGLEnableState {
 	unsigned dither		:1;
 	unsigned colorLogicOp	:1;
 	unsigned alphaTest	:1;
+	unsigned lighting	:1;
+	unsigned colorMaterial	:1;
+	unsigned normalize	:1;
+	unsigned rescaleNormal	:1;
+	unsigned fog		:1;
 
 	FGLEnableState() :
 		cullFace(0),
@@ -280,7 +289,104 @@ struct FGLEnableState {
 		depthTest(0),
 		blend(0),
 		dither(1),
-		colorLogicOp(0) {};
+		colorLogicOp(0),
+		lighting(0),
+		colorMaterial(0),
+		normalize(0),
+		rescaleNormal(0),
+		fog(0) {};
+};
+
+struct FGLLightState {
+	FGLvec4f ambient;
+	FGLvec4f diffuse;
+	FGLvec4f specular;
+	/* Position and spot direction are stored in eye coordinates */
+	FGLvec4f position;
+	FGLvec3f direction;
+	GLfloat exponent;
+	GLfloat cutoff;
+	GLfloat constantAttenuation;
+	GLfloat linearAttenuation;
+	GLfloat quadraticAttenuation;
+	bool enabled;
+
+	FGLLightState() :
+		exponent(0.0f),
+		cutoff(180.0f),
+		constantAttenuation(1.0f),
+		linearAttenuation(0.0f),
+		quadraticAttenuation(0.0f),
+		enabled(false)
+	{
+		static const FGLvec4f black = { 0.0f, 0.0f, 0.0f, 1.0f };
+		static const FGLvec4f pos = { 0.0f, 0.0f, 1.0f, 0.0f };
+		static const FGLvec3f dir = { 0.0f, 0.0f, -1.0f };
+
+		memcpy(ambient, black, sizeof(ambient));
+		memcpy(diffuse, black, sizeof(diffuse));
+		memcpy(specular, black, sizeof(specular));
+		memcpy(position, pos, sizeof(position));
+		memcpy(direction, dir, sizeof(direction));
+	}
+};
+
+struct FGLLightingState {
+	FGLLightState light[FGL_MAX_LIGHTS];
+	FGLvec4f ambient;
+	FGLvec4f diffuse;
+	FGLvec4f specular;
+	FGLvec4f emission;
+	GLfloat shininess;
+	FGLvec4f modelAmbient;
+	bool twoSide;
+
+	FGLLightingState() :
+		shininess(0.0f),
+		twoSide(false)
+	{
+		static const FGLvec4f white = { 1.0f, 1.0f, 1.0f, 1.0f };
+		static const FGLvec4f black = { 0.0f, 0.0f, 0.0f, 1.0f };
+		static const FGLvec4f amb = { 0.2f, 0.2f, 0.2f, 1.0f };
+		static const FGLvec4f diff = { 0.8f, 0.8f, 0.8f, 1.0f };
+
+		memcpy(light[0].diffuse, white, sizeof(white));
+		memcpy(light[0].specular, white, sizeof(white));
+		memcpy(ambient, amb, sizeof(ambient));
+		memcpy(diffuse, diff, sizeof(diffuse));
+		memcpy(specular, black, sizeof(specular));
+		memcpy(emission, black, sizeof(emission));
+		memcpy(modelAmbient, amb, sizeof(modelAmbient));
+	}
+};
+
+struct FGLFogState {
+	GLenum mode;
+	GLfloat density;
+	GLfloat start;
+	GLfloat end;
+	FGLvec4f color;
+
+	FGLFogState() :
+		mode(GL_EXP),
+		density(1.0f),
+		start(0.0f),
+		end(1.0f)
+	{
+		memset(color, 0, sizeof(color));
+	}
+};
+
+struct FGLClipPlaneState {
+	/* Stored in eye coordinates */
+	FGLvec4f equation;
+	bool enabled;
+
+	FGLClipPlaneState() :
+		enabled(false)
+	{
+		memset(equation, 0, sizeof(equation));
+	}
 };
 
 struct FGLFramebufferState {
@@ -310,6 +416,21 @@ struct FGLFramebufferState {
 	}
 };
 
+struct FGLDeferredDrawState {
+	uint32_t mode;
+	uint32_t count;
+	uint32_t draws;
+	/* Attribute layout of queued vertices (zero width means constant) */
+	GLint type[4 + FGL_MAX_TEXTURE_UNITS];
+	GLint size[4 + FGL_MAX_TEXTURE_UNITS];
+	GLint width[4 + FGL_MAX_TEXTURE_UNITS];
+	uint32_t data[4 + FGL_MAX_TEXTURE_UNITS][4*FGL_DEFERRED_DRAW_VERTICES];
+
+	FGLDeferredDrawState() :
+		count(0),
+		draws(0) {};
+};
+
 struct FGLContext {
 	/* HW state */
 	fimgContext *fimg;
@@ -331,8 +452,12 @@ struct FGLContext {
 	FGLClearState clear;
 	FGLTexture *busyTexture[FGL_MAX_TEXTURE_UNITS];
 	FGLEnableState enable;
+	FGLLightingState lighting;
+	FGLFogState fog;
+	FGLClipPlaneState clipPlane[FGL_MAX_CLIP_PLANES];
 	FGLFramebufferState framebuffer;
 	FGLRenderbufferBinding renderbuffer;
+	FGLDeferredDrawState deferred;
 	/* EGL state */
 	FGLEGLState egl;
 	bool finished;
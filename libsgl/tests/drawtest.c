@@ -0,0 +1,240 @@
+/*
+ * libsgl/tests/drawtest.c
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2013 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Draws simple scenes through the whole GL stack into a pbuffer and checks
+ * resulting pixels against values computed analytically.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <EGL/egl.h>
+#include <GLES/gl.h>
+
+#define W	64
+#define H	64
+
+static GLubyte pixels[4 * W * H];
+static int failures;
+
+static void readPixels(void)
+{
+	glReadPixels(0, 0, W, H, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+}
+
+static void expectPixel(const char *name, int x, int y,
+			int r, int g, int b, int a, int tol)
+{
+	const GLubyte *p = &pixels[4 * (y * W + x)];
+
+	if (abs(p[0] - r) > tol || abs(p[1] - g) > tol
+	    || abs(p[2] - b) > tol || abs(p[3] - a) > tol) {
+		printf("%s: pixel (%d, %d) is %d %d %d %d, expected %d %d %d %d\n",
+			name, x, y, p[0], p[1], p[2], p[3], r, g, b, a);
+		++failures;
+	}
+}
+
+static void testClear(void)
+{
+	glClearColor(0.0f, 0.0f, 1.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	readPixels();
+
+	expectPixel("clear", 0, 0, 0, 0, 255, 255, 0);
+	expectPixel("clear", W - 1, H - 1, 0, 0, 255, 255, 0);
+}
+
+static void testTriangle(void)
+{
+	static const GLfloat vertices[] = {
+		-1.0f, -1.0f,	1.0f, -1.0f,	-1.0f, 1.0f
+	};
+
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(2, GL_FLOAT, 0, vertices);
+	glColor4f(0.0f, 1.0f, 0.0f, 1.0f);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	readPixels();
+
+	/* Lower left half is covered, upper right is not */
+	expectPixel("triangle", 4, 4, 0, 255, 0, 255, 0);
+	expectPixel("triangle", W - 4, H - 4, 0, 0, 0, 255, 0);
+}
+
+static void testSmooth(void)
+{
+	static const GLfloat vertices[] = {
+		-1.0f, -1.0f,	1.0f, -1.0f,	-1.0f, 1.0f,	1.0f, 1.0f
+	};
+	static const GLubyte colors[] = {
+		0, 0, 0, 255,	255, 0, 0, 255,	0, 255, 0, 255,	255, 255, 0, 255
+	};
+
+	glEnableClientState(GL_COLOR_ARRAY);
+	glColorPointer(4, GL_UNSIGNED_BYTE, 0, colors);
+	glVertexPointer(2, GL_FLOAT, 0, vertices);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	glDisableClientState(GL_COLOR_ARRAY);
+	readPixels();
+
+	/* Red grows along x, green along y, sampled at pixel centers */
+	expectPixel("smooth", 0, 0, 2, 2, 0, 255, 2);
+	expectPixel("smooth", 48, 16, 195, 66, 0, 255, 3);
+	expectPixel("smooth", W - 1, H - 1, 253, 253, 0, 255, 2);
+}
+
+static void testDepth(void)
+{
+	static const GLfloat near[] = {
+		-1.0f, -1.0f, 0.0f,	0.0f, -1.0f, 0.0f,
+		-1.0f, 1.0f, 0.0f,	0.0f, 1.0f, 0.0f
+	};
+	static const GLfloat far[] = {
+		-1.0f, -1.0f, 0.5f,	1.0f, -1.0f, 0.5f,
+		-1.0f, 1.0f, 0.5f,	1.0f, 1.0f, 0.5f
+	};
+
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+
+	glColor4f(1.0f, 0.0f, 0.0f, 1.0f);
+	glVertexPointer(3, GL_FLOAT, 0, near);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+	glColor4f(0.0f, 0.0f, 1.0f, 1.0f);
+	glVertexPointer(3, GL_FLOAT, 0, far);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+	glDisable(GL_DEPTH_TEST);
+	readPixels();
+
+	/* Far quad drawn later is hidden only in the left half */
+	expectPixel("depth", 8, 32, 255, 0, 0, 255, 0);
+	expectPixel("depth", W - 8, 32, 0, 0, 255, 255, 0);
+}
+
+static void testTexture(void)
+{
+	static const GLfloat vertices[] = {
+		-1.0f, -1.0f,	1.0f, -1.0f,	-1.0f, 1.0f,	1.0f, 1.0f
+	};
+	static const GLfloat texcoords[] = {
+		0.0f, 0.0f,	1.0f, 0.0f,	0.0f, 1.0f,	1.0f, 1.0f
+	};
+	static const GLubyte texels[] = {
+		255, 255, 255, 255,	0, 0, 0, 255,
+		0, 0, 0, 255,		255, 255, 255, 255
+	};
+	GLuint tex;
+
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 2, 2, 0,
+					GL_RGBA, GL_UNSIGNED_BYTE, texels);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glEnable(GL_TEXTURE_2D);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glTexCoordPointer(2, GL_FLOAT, 0, texcoords);
+	glVertexPointer(2, GL_FLOAT, 0, vertices);
+	glColor4f(1.0f, 1.0f, 0.0f, 1.0f);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisable(GL_TEXTURE_2D);
+	glDeleteTextures(1, &tex);
+	readPixels();
+
+	/* 2x2 checkerboard modulated by yellow */
+	expectPixel("texture", 8, 8, 255, 255, 0, 255, 0);
+	expectPixel("texture", W - 8, 8, 0, 0, 0, 255, 0);
+	expectPixel("texture", 8, H - 8, 0, 0, 0, 255, 0);
+	expectPixel("texture", W - 8, H - 8, 255, 255, 0, 255, 0);
+}
+
+int main(void)
+{
+	EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_DEPTH_SIZE, 16,
+		EGL_NONE
+	};
+	EGLint surfaceAttribs[] = {
+		EGL_WIDTH, W,
+		EGL_HEIGHT, H,
+		EGL_NONE
+	};
+	EGLDisplay dpy;
+	EGLConfig config;
+	EGLSurface surface;
+	EGLContext context;
+	EGLint num;
+
+	dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (!eglInitialize(dpy, NULL, NULL)
+	    || !eglChooseConfig(dpy, configAttribs, &config, 1, &num) || !num) {
+		fprintf(stderr, "Failed to initialize EGL (%#x).\n",
+							eglGetError());
+		return 1;
+	}
+
+	surface = eglCreatePbufferSurface(dpy, config, surfaceAttribs);
+	context = eglCreateContext(dpy, config, EGL_NO_CONTEXT, NULL);
+	if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT
+	    || !eglMakeCurrent(dpy, surface, surface, context)) {
+		fprintf(stderr, "Failed to create context (%#x).\n",
+							eglGetError());
+		return 1;
+	}
+
+	/* Every test is a frame in traces recorded for fglreplay */
+	testClear();
+	eglSwapBuffers(dpy, surface);
+	testTriangle();
+	eglSwapBuffers(dpy, surface);
+	testSmooth();
+	eglSwapBuffers(dpy, surface);
+	testDepth();
+	eglSwapBuffers(dpy, surface);
+	testTexture();
+	eglSwapBuffers(dpy, surface);
+
+	eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(dpy, context);
+	eglDestroySurface(dpy, surface);
+	eglTerminate(dpy);
+
+	if (failures)
+		printf("%d checks failed\n", failures);
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * libsgl/tests/etc1bench.c
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2013 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * ETC1 texture upload benchmark
+ *
+ * Replaces the whole image of an ETC1 texture over and over and reports
+ * how fast blocks are transcoded to the format sampled by the texture unit
+ * (DXT1, or RGB565 if FGL_ETC1_TO_DXT1 is not defined). Blocks are random,
+ * which costs the same as real content.
+ *
+ * Usage: etc1bench [size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <EGL/egl.h>
+#include <GLES/gl.h>
+#include <GLES/glext.h>
+
+static inline uint64_t getTime(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+	EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_NONE
+	};
+	EGLint surfaceAttribs[] = {
+		EGL_WIDTH, 16,
+		EGL_HEIGHT, 16,
+		EGL_NONE
+	};
+	unsigned int size = 512, i, loops = 0;
+	uint64_t start, time;
+	EGLDisplay dpy;
+	EGLConfig config;
+	EGLSurface surface;
+	EGLContext context;
+	EGLint num;
+	uint8_t *blocks;
+	size_t len;
+	GLuint tex;
+
+	if (argc > 1)
+		size = atoi(argv[1]);
+	size &= ~3;
+	len = 8 * (size / 4) * (size / 4);
+
+	blocks = malloc(len);
+	if (!size || !blocks) {
+		fprintf(stderr, "Initialization failed.\n");
+		return 1;
+	}
+
+	for (i = 0; i < len; ++i)
+		blocks[i] = rand();
+
+	dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (!eglInitialize(dpy, NULL, NULL)
+	    || !eglChooseConfig(dpy, configAttribs, &config, 1, &num) || !num) {
+		fprintf(stderr, "Failed to initialize EGL (%#x).\n",
+							eglGetError());
+		return 1;
+	}
+
+	surface = eglCreatePbufferSurface(dpy, config, surfaceAttribs);
+	context = eglCreateContext(dpy, config, EGL_NO_CONTEXT, NULL);
+	if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT
+	    || !eglMakeCurrent(dpy, surface, surface, context)) {
+		fprintf(stderr, "Failed to create context (%#x).\n",
+							eglGetError());
+		return 1;
+	}
+
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glCompressedTexImage2D(GL_TEXTURE_2D, 0, GL_ETC1_RGB8_OES,
+					size, size, 0, len, blocks);
+	if (glGetError() != GL_NO_ERROR) {
+		fprintf(stderr, "ETC1 textures not supported.\n");
+		return 1;
+	}
+
+	start = getTime();
+	do {
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size,
+					GL_ETC1_RGB8_OES, len, blocks);
+		++loops;
+		time = getTime() - start;
+	} while (time < 500000000ULL);
+
+	printf("%ux%u ETC1 texture: %.2f ms per upload, %.1f Mtexel/s\n",
+		size, size, 1e-6 * time / loops,
+		1e3 * loops * size * size / time);
+
+	glDeleteTextures(1, &tex);
+	eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(dpy, context);
+	eglDestroySurface(dpy, surface);
+	eglTerminate(dpy);
+	free(blocks);
+
+	return 0;
+}
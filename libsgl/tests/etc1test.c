@@ -0,0 +1,363 @@
+/*
+ * libsgl/tests/etc1test.c
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2013 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Uploads ETC1 textures through the whole GL stack, draws them texel by
+ * texel into a pbuffer and checks quality of the result, measured as PSNR
+ * against ETC1 decoding written from the extension spec. The texture unit
+ * has no ETC1 support, so blocks are transcoded when uploaded, which loses
+ * some quality (most with DXT1, least with RGB565).
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <EGL/egl.h>
+#include <GLES/gl.h>
+#include <GLES/glext.h>
+
+#define W	128
+#define H	128
+#define BLOCKS	((W / 4) * (H / 4))
+
+/*
+ * Lowest accepted PSNR of transcoded textures, in dB. Subblocks of random
+ * blocks are unrelated, so their colors rarely fit the single line of DXT1.
+ */
+#define MIN_PSNR_IMAGE	34.0
+#define MIN_PSNR_RANDOM	18.0
+
+static GLubyte pixels[4 * W * H];
+static int failures;
+
+static const int modifiers[8][2] = {
+	{ 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 },
+	{ 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+};
+
+static int clamp(int v)
+{
+	return (v < 0) ? 0 : ((v > 255) ? 255 : v);
+}
+
+static uint64_t loadBlock(const uint8_t *block)
+{
+	uint64_t v = 0;
+	int i;
+
+	for (i = 0; i < 8; ++i)
+		v = (v << 8) | block[i];
+
+	return v;
+}
+
+/* Decodes texel (x, y) of ETC1 block as described by the extension spec */
+static void decodeTexel(const uint8_t *block, int x, int y, int *rgb)
+{
+	uint64_t v = loadBlock(block);
+	int diff = (v >> 33) & 1, flip = (v >> 32) & 1;
+	int sub = flip ? (y >= 2) : (x >= 2);
+	int base[3], c, d, q, table, i, m;
+
+	for (c = 0; c < 3; ++c) {
+		if (diff) {
+			q = (v >> (59 - 8*c)) & 31;
+			d = (v >> (56 - 8*c)) & 7;
+			if (sub)
+				q = (q + ((d >= 4) ? d - 8 : d)) & 31;
+			base[c] = (q << 3) | (q >> 2);
+		} else {
+			q = (v >> ((sub ? 56 : 60) - 8*c)) & 15;
+			base[c] = q * 17;
+		}
+	}
+
+	table = (v >> (sub ? 34 : 37)) & 7;
+	i = 4*x + y;
+	m = modifiers[table][(v >> i) & 1];
+	if ((v >> (16 + i)) & 1)
+		m = -m;
+
+	for (c = 0; c < 3; ++c)
+		rgb[c] = clamp(base[c] + m);
+}
+
+/*
+ * Brute force ETC1 encoder, only to get blocks looking like real content.
+ * Subblock colors are averages of their texels, the best of all modes and
+ * modifier tables is picked.
+ */
+static void encodeBlock(const int texels[16][3], uint8_t *block)
+{
+	uint64_t best = 0, v;
+	long bestErr = -1, err, subErr, texelErr, e;
+	int flip, diff, sub, c, i, x, y, sum, table, sel, bestSel, m, t, d;
+	int q[2][3], base[2][3], bestTable;
+	uint32_t idx, bestIdx;
+
+	for (flip = 0; flip < 2; ++flip) for (diff = 0; diff < 2; ++diff) {
+		for (sub = 0; sub < 2; ++sub) for (c = 0; c < 3; ++c) {
+			sum = 0;
+			for (i = 0; i < 16; ++i)
+				if ((flip ? i / 4 >= 2 : i % 4 >= 2) == sub)
+					sum += texels[i][c];
+			sum = (sum + 4) / 8;
+			if (diff) {
+				q[sub][c] = (sum * 31 + 127) / 255;
+				base[sub][c] = (q[sub][c] << 3) | (q[sub][c] >> 2);
+			} else {
+				q[sub][c] = (sum * 15 + 127) / 255;
+				base[sub][c] = q[sub][c] * 17;
+			}
+		}
+
+		v = ((uint64_t)diff << 33) | ((uint64_t)flip << 32);
+		for (c = 0; c < 3; ++c) {
+			if (diff) {
+				d = q[1][c] - q[0][c];
+				if (d < -4 || d > 3)
+					break;
+				v |= (uint64_t)q[0][c] << (59 - 8*c);
+				v |= (uint64_t)(d & 7) << (56 - 8*c);
+			} else {
+				v |= (uint64_t)q[0][c] << (60 - 8*c);
+				v |= (uint64_t)q[1][c] << (56 - 8*c);
+			}
+		}
+		if (c < 3)
+			continue;
+
+		err = 0;
+		for (sub = 0; sub < 2; ++sub) {
+			subErr = -1;
+			bestTable = 0;
+			bestIdx = 0;
+			for (table = 0; table < 8; ++table) {
+				e = 0;
+				idx = 0;
+				for (i = 0; i < 16; ++i) {
+					x = i % 4;
+					y = i / 4;
+					if ((flip ? y >= 2 : x >= 2) != sub)
+						continue;
+
+					texelErr = -1;
+					bestSel = 0;
+					for (sel = 0; sel < 4; ++sel) {
+						long se = 0;
+
+						m = modifiers[table][sel & 1];
+						if (sel & 2)
+							m = -m;
+						for (c = 0; c < 3; ++c) {
+							t = clamp(base[sub][c] + m)
+								- texels[i][c];
+							se += t * t;
+						}
+						if (texelErr < 0 || se < texelErr) {
+							texelErr = se;
+							bestSel = sel;
+						}
+					}
+
+					e += texelErr;
+					idx |= ((uint32_t)(bestSel >> 1) << (16 + 4*x + y))
+						| ((uint32_t)(bestSel & 1) << (4*x + y));
+				}
+				if (subErr < 0 || e < subErr) {
+					subErr = e;
+					bestTable = table;
+					bestIdx = idx;
+				}
+			}
+			err += subErr;
+			v |= (uint64_t)bestTable << (sub ? 34 : 37);
+			v |= bestIdx;
+		}
+
+		if (bestErr < 0 || err < bestErr) {
+			bestErr = err;
+			best = v;
+		}
+	}
+
+	for (i = 0; i < 8; ++i)
+		block[i] = best >> (56 - 8*i);
+}
+
+/* Smooth gradients, a sharp edged disc and some noise */
+static void makeImage(uint8_t *blocks)
+{
+	int texels[16][3], bx, by, i, x, y, dx, dy, noise;
+
+	for (by = 0; by < H / 4; ++by) {
+		for (bx = 0; bx < W / 4; ++bx) {
+			for (i = 0; i < 16; ++i) {
+				x = 4*bx + i % 4;
+				y = 4*by + i / 4;
+				dx = x - W / 2;
+				dy = y - H / 3;
+				noise = rand() % 17 - 8;
+
+				texels[i][0] = clamp(128 + noise + 100
+					* sin(x / 9.0) * cos(y / 13.0));
+				texels[i][1] = clamp(noise + (x + 2*y) * 255
+							/ (W + 2*H));
+				texels[i][2] = clamp(noise
+					+ ((dx*dx + dy*dy < 30*30) ? 200 : 40));
+			}
+			encodeBlock(texels, &blocks[8 * (by * (W / 4) + bx)]);
+		}
+	}
+}
+
+static void makeRandom(uint8_t *blocks)
+{
+	int i;
+
+	for (i = 0; i < 8 * BLOCKS; ++i)
+		blocks[i] = rand();
+}
+
+/* Draws the texture texel by texel and returns PSNR of the result */
+static double drawTexture(const uint8_t *blocks)
+{
+	static const GLfloat vertices[] = {
+		-1.0f, -1.0f,	1.0f, -1.0f,	-1.0f, 1.0f,	1.0f, 1.0f
+	};
+	static const GLfloat texcoords[] = {
+		0.0f, 0.0f,	1.0f, 0.0f,	0.0f, 1.0f,	1.0f, 1.0f
+	};
+	double se = 0.0;
+	int x, y, c, rgb[3], d;
+	GLuint tex;
+
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glCompressedTexImage2D(GL_TEXTURE_2D, 0, GL_ETC1_RGB8_OES, W, H, 0,
+							8 * BLOCKS, blocks);
+	if (glGetError() != GL_NO_ERROR) {
+		printf("ETC1 texture upload failed\n");
+		++failures;
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+	glEnable(GL_TEXTURE_2D);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glVertexPointer(2, GL_FLOAT, 0, vertices);
+	glTexCoordPointer(2, GL_FLOAT, 0, texcoords);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	glReadPixels(0, 0, W, H, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+	glDisable(GL_TEXTURE_2D);
+	glDeleteTextures(1, &tex);
+
+	/* Rows of texture image go from bottom to top, as rows of pixels */
+	for (y = 0; y < H; ++y) {
+		for (x = 0; x < W; ++x) {
+			decodeTexel(&blocks[8 * ((y / 4) * (W / 4) + x / 4)],
+							x % 4, y % 4, rgb);
+			for (c = 0; c < 3; ++c) {
+				d = pixels[4 * (y * W + x) + c] - rgb[c];
+				se += d * d;
+			}
+		}
+	}
+
+	if (se == 0.0)
+		return 99.0;
+
+	return 10.0 * log10(255.0 * 255.0 * 3 * W * H / se);
+}
+
+static void check(const char *name, double psnr, double min)
+{
+	printf("%s: %.2f dB PSNR\n", name, psnr);
+	if (psnr < min) {
+		printf("%s: PSNR below %.1f dB\n", name, min);
+		++failures;
+	}
+}
+
+int main(void)
+{
+	EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_NONE
+	};
+	EGLint surfaceAttribs[] = {
+		EGL_WIDTH, W,
+		EGL_HEIGHT, H,
+		EGL_NONE
+	};
+	static uint8_t blocks[8 * BLOCKS];
+	EGLDisplay dpy;
+	EGLConfig config;
+	EGLSurface surface;
+	EGLContext context;
+	EGLint num;
+
+	dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (!eglInitialize(dpy, NULL, NULL)
+	    || !eglChooseConfig(dpy, configAttribs, &config, 1, &num) || !num) {
+		fprintf(stderr, "Failed to initialize EGL (%#x).\n",
+							eglGetError());
+		return 1;
+	}
+
+	surface = eglCreatePbufferSurface(dpy, config, surfaceAttribs);
+	context = eglCreateContext(dpy, config, EGL_NO_CONTEXT, NULL);
+	if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT
+	    || !eglMakeCurrent(dpy, surface, surface, context)) {
+		fprintf(stderr, "Failed to create context (%#x).\n",
+							eglGetError());
+		return 1;
+	}
+
+	srand(1);
+
+	makeImage(blocks);
+	check("image", drawTexture(blocks), MIN_PSNR_IMAGE);
+
+	/* Any bit pattern is valid, so all modes and clamping are used */
+	makeRandom(blocks);
+	check("random blocks", drawTexture(blocks), MIN_PSNR_RANDOM);
+
+	eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(dpy, context);
+	eglDestroySurface(dpy, surface);
+	eglTerminate(dpy);
+
+	if (failures)
+		printf("%d checks failed\n", failures);
+
+	return failures ? 1 : 0;
+}
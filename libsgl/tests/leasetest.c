@@ -0,0 +1,103 @@
+/*
+ * libsgl/tests/leasetest.c
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2013 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Checks that a context holding a hardware lease keeps the hardware between
+ * draws, gives it up in its own thread once the lease slice expires and
+ * releases it immediately when the lease is ended.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include "fimg_private.h"
+
+/* Lease slice in microseconds */
+#define SLICE	50000
+
+static int failures;
+
+static void check(const char *name, int cond)
+{
+	if (!cond) {
+		printf("%s: failed\n", name);
+		++failures;
+	}
+}
+
+static void draw(fimgContext *ctx)
+{
+	fimgGetHardware(ctx);
+	fimgPutHardware(ctx);
+}
+
+int main(void)
+{
+	fimgContext *holder;
+	fimgStats stats;
+	unsigned int i;
+
+	holder = fimgCreateContext();
+	if (!holder) {
+		fprintf(stderr, "Failed to create context.\n");
+		return 1;
+	}
+
+	fimgSetHardwareLease(holder, SLICE);
+
+	/* Lease is kept across draws within the slice */
+	for (i = 0; i < FIMG_LEASE_CHECK_INTERVAL; ++i)
+		draw(holder);
+	check("lease kept", holder->locked);
+
+	/* Expiry is noticed by the holder on one of its next draws */
+	usleep(2 * SLICE);
+	for (i = 0; i < FIMG_LEASE_CHECK_INTERVAL && holder->locked; ++i)
+		draw(holder);
+	check("expired lease released", !holder->locked);
+
+	fimgGetStats(holder, &stats);
+	check("lease expiry counted", stats.leaseExpiries == 1);
+
+	/* Ending the lease releases the hardware immediately */
+	draw(holder);
+	check("lease taken again", holder->locked);
+	fimgEndHardwareLease(holder);
+	check("lease ended", !holder->locked);
+
+	/* Finish ends the lease too */
+	draw(holder);
+	fimgFinish(holder);
+	check("lease ended by finish", !holder->locked);
+
+	/* Disabling the lease releases the hardware as well */
+	draw(holder);
+	fimgSetHardwareLease(holder, 0);
+	check("lease disabled", !holder->locked);
+	draw(holder);
+	check("no lease", !holder->locked);
+
+	fimgDestroyContext(holder);
+
+	if (failures)
+		printf("%d checks failed\n", failures);
+
+	return failures ? 1 : 0;
+}
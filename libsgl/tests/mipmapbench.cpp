@@ -0,0 +1,227 @@
+/*
+ * libsgl/tests/mipmapbench.cpp
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2013 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * CPU mipmap generation benchmark
+ *
+ * Checks the box filters of fglmipmap.h against a scalar reference,
+ * averaging every component separately with rounding, then reports how
+ * fast they filter whole mipmap chains. The GPU draws large levels of
+ * formats it can render to, so this is the speed of the rest.
+ *
+ * Usage: mipmapbench [size]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include "fglmipmap.h"
+
+struct component {
+	unsigned shift;
+	unsigned bits;
+};
+
+static const component rgb565[] = { { 11, 5 }, { 5, 6 }, { 0, 5 } };
+static const component rgba5551[] = {
+	{ 11, 5 }, { 6, 5 }, { 1, 5 }, { 0, 1 }
+};
+static const component rgba4444[] = {
+	{ 12, 4 }, { 8, 4 }, { 4, 4 }, { 0, 4 }
+};
+static const component al88[] = { { 8, 8 }, { 0, 8 } };
+static const component argb8888[] = {
+	{ 24, 8 }, { 16, 8 }, { 8, 8 }, { 0, 8 }
+};
+static const component l8[] = { { 0, 8 } };
+
+#define NELEM(a)	(sizeof(a) / sizeof(*(a)))
+
+static inline uint64_t getTime(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t average(const component *comps, unsigned count,
+			uint32_t p00, uint32_t p01, uint32_t p10, uint32_t p11)
+{
+	uint32_t out = 0;
+
+	for (unsigned i = 0; i < count; ++i) {
+		uint32_t mask = (1U << comps[i].bits) - 1;
+		uint32_t sum = ((p00 >> comps[i].shift) & mask)
+				+ ((p01 >> comps[i].shift) & mask)
+				+ ((p10 >> comps[i].shift) & mask)
+				+ ((p11 >> comps[i].shift) & mask);
+
+		out |= ((sum + 2) >> 2) << comps[i].shift;
+	}
+
+	return out;
+}
+
+/* Filters one level with given filter and counts wrong texels */
+template<typename T>
+static unsigned check(void (*filter)(const T *, T *, unsigned, unsigned),
+			const component *comps, unsigned count,
+			unsigned width, unsigned height, unsigned misalign)
+{
+	T *buf = new T[width * height + 1];
+	T *src = buf + misalign;
+	T *dst = new T[width * height];
+	unsigned dstW = (width >> 1) ? : 1;
+	unsigned dstH = (height >> 1) ? : 1;
+	unsigned dx = (width > 1);
+	unsigned dy = (height > 1) ? width : 0;
+	unsigned bad = 0;
+
+	for (unsigned i = 0; i < width * height; ++i)
+		src[i] = rand() ^ ((unsigned)rand() << 16);
+
+	filter(src, dst, width, height);
+
+	for (unsigned y = 0; y < dstH; ++y) {
+		for (unsigned x = 0; x < dstW; ++x) {
+			const T *row0 = src + 2 * y * width + 2 * x;
+			const T *row1 = row0 + dy;
+
+			if (dst[y * dstW + x] != (T)average(comps, count,
+					row0[0], row0[dx], row1[0], row1[dx]))
+				++bad;
+		}
+	}
+
+	delete[] dst;
+	delete[] buf;
+
+	return bad;
+}
+
+/* Filters whole mipmap chains for some time, returns texels per second */
+template<typename T>
+static double benchmark(void (*filter)(const T *, T *, unsigned, unsigned),
+							unsigned size)
+{
+	T *levels = new T[2 * size * size];
+	uint64_t start, time;
+	unsigned loops = 0;
+
+	for (unsigned i = 0; i < 2 * size * size; ++i)
+		levels[i] = rand();
+
+	start = getTime();
+	do {
+		T *src = levels;
+		unsigned width = size, height = size;
+
+		while (width > 1 || height > 1) {
+			T *dst = src + width * height;
+
+			filter(src, dst, width, height);
+			src = dst;
+			width = (width >> 1) ? : 1;
+			height = (height >> 1) ? : 1;
+		}
+
+		++loops;
+		time = getTime() - start;
+	} while (time < 200000000ULL);
+
+	delete[] levels;
+
+	return 1e9 * loops * size * size / time;
+}
+
+int main(int argc, char **argv)
+{
+	static const unsigned dims[][2] = {
+		{ 64, 64 }, { 64, 1 }, { 1, 64 }, { 6, 10 },
+		{ 7, 5 }, { 2, 2 }, { 1, 1 }, { 33, 17 }
+	};
+	static const struct {
+		const char *name;
+		void (*filter16)(const uint16_t *, uint16_t *,
+						unsigned, unsigned);
+		void (*filter32)(const uint32_t *, uint32_t *,
+						unsigned, unsigned);
+		void (*filter8)(const uint8_t *, uint8_t *,
+						unsigned, unsigned);
+		const component *comps;
+		unsigned count;
+	} formats[] = {
+		{ "RGB565", fglDownsample16<FGLAverageRGB565>, 0, 0,
+					rgb565, NELEM(rgb565) },
+		{ "RGBA5551", fglDownsample16<FGLAverageRGBA5551>, 0, 0,
+					rgba5551, NELEM(rgba5551) },
+		{ "RGBA4444", fglDownsample16<FGLAverageRGBA4444>, 0, 0,
+					rgba4444, NELEM(rgba4444) },
+		{ "AL88", fglDownsample16<FGLAverageAL88>, 0, 0,
+					al88, NELEM(al88) },
+		{ "ARGB8888", 0, fglDownsample8888, 0,
+					argb8888, NELEM(argb8888) },
+		{ "L8", 0, 0, fglDownsample8, l8, NELEM(l8) },
+	};
+	unsigned size = 512, bad, total = 0;
+	double rate;
+
+	if (argc > 1)
+		size = atoi(argv[1]);
+
+	for (unsigned f = 0; f < NELEM(formats); ++f) {
+		bad = 0;
+		for (unsigned d = 0; d < NELEM(dims); ++d) {
+			for (unsigned m = 0; m < 2; ++m) {
+				unsigned w = dims[d][0], h = dims[d][1];
+
+				if (formats[f].filter16)
+					bad += check(formats[f].filter16,
+						formats[f].comps,
+						formats[f].count, w, h, m);
+				else if (formats[f].filter32)
+					bad += check(formats[f].filter32,
+						formats[f].comps,
+						formats[f].count, w, h, m);
+				else
+					bad += check(formats[f].filter8,
+						formats[f].comps,
+						formats[f].count, w, h, m);
+			}
+		}
+
+		if (formats[f].filter16)
+			rate = benchmark(formats[f].filter16, size);
+		else if (formats[f].filter32)
+			rate = benchmark(formats[f].filter32, size);
+		else
+			rate = benchmark(formats[f].filter8, size);
+
+		printf("%-9s %ux%u chain: %7.2f Mtexel/s, %u mismatches\n",
+			formats[f].name, size, size, 1e-6 * rate, bad);
+		total += bad;
+	}
+
+	return total ? 1 : 0;
+}
@@ -0,0 +1,431 @@
+/*
+ * libsgl/tests/packbench.c
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2013 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Attribute packer benchmark
+ *
+ * Compares packers selected by selectPackers() with the generic packing
+ * routines they replaced, for common attribute layouts. Output of selected
+ * packers is verified against source data before measuring.
+ *
+ * Usage: packbench [vertices]
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+/* Static functions and tables are needed */
+#include "host_new.c"
+
+/*
+ * Generic packers, as used before specialization
+ */
+
+static uint32_t genericPack(uint32_t *buf, const fimgArray *a,
+						uint32_t pos, uint32_t cnt)
+{
+	register uint32_t word;
+	uint32_t size;
+
+	/* Vertices must be word aligned */
+	size = (a->width + 3) & ~3;
+	size *= cnt;
+
+	switch(a->width % 4) {
+	/* words */
+	case 0:
+		/* Check if vertices are word aligned */
+		if ((uintptr_t)a->pointer % 4 == 0 && a->stride % 4 == 0) {
+			uint32_t len, srcpad = (a->stride - a->width) / 4;
+			const uint32_t *data =
+					BUF_ADDR_32(a->pointer, pos*a->stride);
+
+			while (cnt--) {
+				len = a->width;
+
+				while (len) {
+					*(buf++) = *(data++);
+					len -= 4;
+				}
+
+				data += srcpad;
+			}
+
+			break;
+		}
+	/* halfwords */
+	case 2:
+		/* Check if vertices are halfword aligned */
+		if ((uintptr_t)a->pointer % 2 == 0 && a->stride % 2 == 0) {
+			uint32_t len, srcpad = (a->stride - a->width) / 2;
+			const uint16_t *data =
+					BUF_ADDR_16(a->pointer, pos*a->stride);
+
+			while (cnt--) {
+				len = a->width;
+
+				while (len >= 4) {
+					word = *(data++);
+					word |= *(data++) << 16;
+					*(buf++) = word;
+					len -= 4;
+				}
+
+				/* Single halfword left */
+				if (len)
+					*(buf++) = *(data++);
+
+				data += srcpad;
+			}
+
+			break;
+		}
+	/* bytes */
+	default:
+		/* Fallback - no check required */
+		{
+			uint32_t len, srcpad = a->stride - a->width;
+			const uint8_t *data =
+					BUF_ADDR_8(a->pointer, pos*a->stride);
+
+			while (cnt--) {
+				len = a->width;
+
+				while (len >= 4) {
+					word = *(data++);
+					word |= *(data++) << 8;
+					word |= *(data++) << 16;
+					word |= *(data++) << 24;
+					*(buf++) = word;
+					len -= 4;
+				}
+
+				// Up to 3 bytes left
+				if (len) {
+					word = *(data++);
+					if (len == 2)
+						word |= *(data++) << 8;
+					if (len == 3)
+						word |= *(data++) << 16;
+
+					*(buf++) = word;
+				}
+
+				data += srcpad;
+			}
+
+			break;
+		}
+	}
+
+	return size;
+}
+
+static uint32_t genericPackIdx16(uint32_t *buf, const fimgArray *a,
+				const uint16_t *idx, uint32_t cnt)
+{
+	register uint32_t word;
+	uint32_t size;
+	uint32_t len;
+
+	if (!cnt)
+		return 0;
+
+	/* Vertices must be word aligned */
+	size = (a->width + 3) & ~3;
+	size *= cnt;
+
+	switch(a->width % 4) {
+	/* words */
+	case 0:
+		/* Check if vertices are word aligned */
+		if ((uintptr_t)a->pointer % 4 == 0 && a->stride % 4 == 0) {
+			const uint32_t *data, *next_data;
+
+			next_data = BUF_ADDR_32(a->pointer, *(idx++)*a->stride);
+			--cnt;
+
+			while (cnt--) {
+				data = next_data;
+				next_data = BUF_ADDR_32(a->pointer,
+							*(idx++)*a->stride);
+				len = a->width;
+
+				while (len) {
+					*(buf++) = *(data++);
+					len -= 4;
+				}
+			}
+
+			data = next_data;
+			len = a->width;
+
+			while (len) {
+				*(buf++) = *(data++);
+				len -= 4;
+			}
+
+			break;
+		}
+	/* halfwords */
+	case 2:
+		/* Check if vertices are halfword aligned */
+		if ((uintptr_t)a->pointer % 2 == 0 && a->stride % 2 == 0) {
+			const uint16_t *data, *next_data;
+
+			next_data = BUF_ADDR_16(a->pointer, *(idx++)*a->stride);
+			--cnt;
+
+			while (cnt--) {
+				data = next_data;
+				next_data = BUF_ADDR_16(a->pointer,
+							*(idx++)*a->stride);
+				len = a->width;
+
+				while (len >= 4) {
+					word = *(data++);
+					word |= *(data++) << 16;
+					*(buf++) = word;
+					len -= 4;
+				}
+
+				/* Single halfword left */
+				if (len)
+					*(buf++) = *(data++);
+			}
+
+			data = next_data;
+			len = a->width;
+
+			while (len >= 4) {
+				word = *(data++);
+				word |= *(data++) << 16;
+				*(buf++) = word;
+				len -= 4;
+			}
+
+			break;
+		}
+	/* bytes */
+	default:
+		/* Fallback - no check required */
+		{
+			const uint8_t *data, *next_data;
+
+			next_data = BUF_ADDR_8(a->pointer, *(idx++)*a->stride);
+			--cnt;
+
+			while (cnt--) {
+				data = next_data;
+				next_data = BUF_ADDR_8(a->pointer,
+							*(idx++)*a->stride);
+				len = a->width;
+
+				while (len >= 4) {
+					word = *(data++);
+					word |= *(data++) << 8;
+					word |= *(data++) << 16;
+					word |= *(data++) << 24;
+					*(buf++) = word;
+					len -= 4;
+				}
+
+				// Up to 3 bytes left
+				if (len) {
+					word = *(data++);
+					if (len == 2)
+						word |= *(data++) << 8;
+					if (len == 3)
+						word |= *(data++) << 16;
+
+					*(buf++) = word;
+				}
+			}
+
+			data = next_data;
+			len = a->width;
+
+			while (len >= 4) {
+				word = *(data++);
+				word |= *(data++) << 8;
+				word |= *(data++) << 16;
+				word |= *(data++) << 24;
+				*(buf++) = word;
+				len -= 4;
+			}
+
+			// Up to 3 bytes left
+			if (len) {
+				word = *(data++);
+				if (len == 2)
+					word |= *(data++) << 8;
+				if (len == 3)
+					word |= *(data++) << 16;
+
+				*(buf++) = word;
+			}
+
+			break;
+		}
+	}
+
+	return size;
+}
+
+static inline uint64_t getTime(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Checks that every vertex is copied to its own word aligned slot */
+static int verify(const fimgAttribPacker *packer, uint32_t *buf,
+		const fimgArray *a, const uint16_t *indices, uint32_t count)
+{
+	uint32_t words = (a->width + 3) / 4;
+	uint32_t size, i;
+
+	size = packer->direct(buf, a, 0, count);
+	if (size != 4 * words * count)
+		return -1;
+
+	for (i = 0; i < count; ++i)
+		if (memcmp(&buf[i * words],
+				BUF_ADDR_8(a->pointer, i * a->stride), a->width))
+			return -1;
+
+	size = packer->idx16(buf, a, indices, count);
+	if (size != 4 * words * count)
+		return -1;
+
+	for (i = 0; i < count; ++i)
+		if (memcmp(&buf[i * words], BUF_ADDR_8(a->pointer,
+					indices[i] * a->stride), a->width))
+			return -1;
+
+	return 0;
+}
+
+/* Returns packing speed in MB/s of source attribute data */
+static double measure(const fimgAttribPacker *packer, uint32_t *buf,
+		const fimgArray *a, const uint16_t *indices, uint32_t count)
+{
+	uint64_t start, time;
+	unsigned int loops = 0;
+
+	start = getTime();
+	do {
+		if (packer)
+			indices ? packer->idx16(buf, a, indices, count)
+				: packer->direct(buf, a, 0, count);
+		else
+			indices ? genericPackIdx16(buf, a, indices, count)
+				: genericPack(buf, a, 0, count);
+		++loops;
+		time = getTime() - start;
+	} while (time < 100000000ULL);
+
+	return 1e3 * loops * count * a->width / time;
+}
+
+int main(int argc, char **argv)
+{
+	static const struct {
+		const char *name;
+		uint32_t width;
+		uint32_t stride;
+	} layouts[] = {
+		{ "float3 packed", 12, 12 },
+		{ "float3 interleaved", 12, 36 },
+		{ "float2 interleaved", 8, 36 },
+		{ "ubyte4 interleaved", 4, 36 },
+		{ "short3 padded", 6, 8 },
+		{ "short2 packed", 4, 6 },
+		{ "ubyte3 packed", 3, 3 },
+	};
+	static fimgContext ctx;
+	unsigned int count = 4096, i;
+	fimgArray array;
+	uint16_t *indices;
+	uint8_t *data;
+	uint32_t *buf;
+	double generic, specialized;
+	int ret = 0;
+
+	if (argc > 1)
+		count = atoi(argv[1]);
+	if (count < 1 || count > 65536) {
+		fprintf(stderr, "Vertex count must be in range 1..65536.\n");
+		return 1;
+	}
+
+	data = malloc(count * 36);
+	buf = malloc(count * 16);
+	indices = malloc(count * sizeof(*indices));
+	if (!data || !buf || !indices) {
+		fprintf(stderr, "Initialization failed.\n");
+		return 1;
+	}
+
+	for (i = 0; i < count * 36; ++i)
+		data[i] = i * 31 + (i >> 8);
+	for (i = 0; i < count; ++i)
+		indices[i] = (i * 7919) % count;
+
+	ctx.numAttribs = 1;
+
+	printf("%u vertices, MB/s of attribute data\n\n", count);
+	printf("%-20s %-7s %10s %10s %8s\n", "layout", "access",
+					"generic", "selected", "speedup");
+
+	for (i = 0; i < sizeof(layouts) / sizeof(*layouts); ++i) {
+		array.pointer = data;
+		array.width = layouts[i].width;
+		array.stride = layouts[i].stride;
+		selectPackers(&ctx, &array);
+
+		if (verify(ctx.packer[0], buf, &array, indices, count)) {
+			printf("%-20s packed data mismatch\n",
+							layouts[i].name);
+			ret = 1;
+			continue;
+		}
+
+		generic = measure(NULL, buf, &array, NULL, count);
+		specialized = measure(ctx.packer[0], buf, &array, NULL, count);
+		printf("%-20s %-7s %10.1f %10.1f %7.2fx\n", layouts[i].name,
+			"direct", generic, specialized, specialized / generic);
+
+		generic = measure(NULL, buf, &array, indices, count);
+		specialized = measure(ctx.packer[0], buf,
+						&array, indices, count);
+		printf("%-20s %-7s %10.1f %10.1f %7.2fx\n", layouts[i].name,
+			"idx16", generic, specialized, specialized / generic);
+	}
+
+	free(indices);
+	free(buf);
+	free(data);
+
+	return ret;
+}
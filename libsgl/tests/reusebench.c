@@ -0,0 +1,216 @@
+/*
+ * libsgl/tests/reusebench.c
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2013 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Indexed vertex reuse benchmark
+ *
+ * Packs an indexed grid mesh with GL_TRIANGLES, once expanding every index
+ * into a full vertex and once sending only unique vertices of each batch
+ * with remapped indices, where that takes less space. Reports bytes transferred to the hardware per
+ * triangle and packing speed, for triangles in grid order, in random order
+ * and in random order reordered by fimgOptimizeTrianglesUShortIdx().
+ *
+ * Usage: reusebench [quads per grid side]
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+/* Static functions and tables are needed */
+#include "host_new.c"
+
+static inline uint64_t getTime(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void setupArrays(fimgContext *ctx, fimgArray *arrays,
+				const float *positions, const float *texcoords,
+				const uint8_t *colors)
+{
+	fimgSetAttribCount(ctx, 3);
+
+	arrays[0].pointer = positions;
+	arrays[0].stride = 12;
+	arrays[0].width = 12;
+	fimgSetAttribute(ctx, 0, FGHI_ATTRIB_DT_FLOAT, 3);
+
+	arrays[1].pointer = colors;
+	arrays[1].stride = 4;
+	arrays[1].width = 4;
+	fimgSetAttribute(ctx, 1, FGHI_ATTRIB_DT_NUBYTE, 4);
+
+	arrays[2].pointer = texcoords;
+	arrays[2].stride = 8;
+	arrays[2].width = 8;
+	fimgSetAttribute(ctx, 2, FGHI_ATTRIB_DT_FLOAT, 2);
+
+	selectPackers(ctx, arrays);
+}
+
+/* Packs all batches of a draw call, returning bytes sent to hardware */
+static uint64_t packDraw(fimgContext *ctx, fimgArray *arrays,
+			const uint16_t *indices, unsigned int count, int reuse)
+{
+	uint32_t pos = 0, left = count, copied;
+	uint64_t bytes = 0;
+
+	do {
+		if (reuse) {
+			copied = copyVerticesTrisReuseIdx16(ctx, arrays,
+						indices, &pos, &left);
+			if (!copied)
+				break;
+			/* Index count followed by the indices */
+			if (ctx->reuse->numIndices)
+				bytes += 4 * (ctx->reuse->numIndices + 1);
+		} else {
+			copied = primitiveHandler[FGPE_TRIANGLES].indexed_16(
+					ctx, arrays, indices, &pos, &left);
+		}
+		bytes += ctx->vertexDataSize;
+	} while (copied);
+
+	return bytes;
+}
+
+static void benchmark(fimgContext *ctx, const char *name, fimgArray *arrays,
+			const uint16_t *indices, unsigned int count, int reuse)
+{
+	uint64_t bytes = 0, start, time;
+	unsigned int loops = 0;
+
+	start = getTime();
+	do {
+		bytes = packDraw(ctx, arrays, indices, count, reuse);
+		++loops;
+		time = getTime() - start;
+	} while (time < 200000000ULL);
+
+	printf("%-20s %-8s %10.1f %10.2f\n", name,
+		reuse ? "reuse" : "expanded", (double)bytes / (count / 3),
+		1e3 * loops * (count / 3) / time);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int size = 100, vertices, count, x, y, i;
+	float *positions, *texcoords;
+	uint8_t *colors;
+	uint16_t *grid, *shuffled, *reordered, *tri;
+	fimgArray arrays[3];
+	fimgContext *ctx;
+
+	if (argc > 1)
+		size = atoi(argv[1]);
+	if (size < 1 || size > 255) {
+		fprintf(stderr, "Grid size must be in range 1..255.\n");
+		return 1;
+	}
+
+	vertices = (size + 1) * (size + 1);
+	count = 6 * size * size;
+
+	positions = malloc(vertices * 3 * sizeof(*positions));
+	texcoords = malloc(vertices * 2 * sizeof(*texcoords));
+	colors = malloc(vertices * 4);
+	grid = malloc(count * sizeof(*grid));
+	shuffled = malloc(count * sizeof(*shuffled));
+	reordered = malloc(count * sizeof(*reordered));
+	ctx = fimgCreateContext();
+	if (!positions || !texcoords || !colors || !grid || !shuffled
+	    || !reordered || !ctx) {
+		fprintf(stderr, "Initialization failed.\n");
+		return 1;
+	}
+
+	for (i = 0; i < vertices; ++i) {
+		x = i % (size + 1);
+		y = i / (size + 1);
+		positions[3*i] = x;
+		positions[3*i + 1] = y;
+		positions[3*i + 2] = 0.5f;
+		texcoords[2*i] = (float)x / size;
+		texcoords[2*i + 1] = (float)y / size;
+		colors[4*i] = x;
+		colors[4*i + 1] = y;
+		colors[4*i + 2] = 0;
+		colors[4*i + 3] = 255;
+	}
+
+	tri = grid;
+	for (y = 0; y < size; ++y) {
+		for (x = 0; x < size; ++x) {
+			i = y * (size + 1) + x;
+			*(tri++) = i;
+			*(tri++) = i + 1;
+			*(tri++) = i + size + 1;
+			*(tri++) = i + 1;
+			*(tri++) = i + size + 2;
+			*(tri++) = i + size + 1;
+		}
+	}
+
+	/* Triangles in random order, as often exported by modelling tools */
+	memcpy(shuffled, grid, count * sizeof(*grid));
+	srand(1);
+	for (i = count / 3 - 1; i > 0; --i) {
+		unsigned int j = rand() % (i + 1);
+		uint16_t t[3];
+
+		memcpy(t, &shuffled[3*i], sizeof(t));
+		memcpy(&shuffled[3*i], &shuffled[3*j], sizeof(t));
+		memcpy(&shuffled[3*j], t, sizeof(t));
+	}
+
+	memcpy(reordered, shuffled, count * sizeof(*shuffled));
+	fimgOptimizeTrianglesUShortIdx(reordered, count);
+
+	prepareVertexData(ctx);
+	prepareReuseState(ctx);
+	setupArrays(ctx, arrays, positions, texcoords, colors);
+
+	printf("%ux%u grid, %u vertices, %u triangles of float3 position, "
+		"ubyte4 color, float2 texcoord\n\n",
+		size, size, vertices, count / 3);
+	printf("%-20s %-8s %10s %10s\n", "order", "path",
+					"bytes/tri", "Mtris/s");
+
+	benchmark(ctx, "grid", arrays, grid, count, 0);
+	benchmark(ctx, "grid", arrays, grid, count, 1);
+	benchmark(ctx, "shuffled", arrays, shuffled, count, 0);
+	benchmark(ctx, "shuffled", arrays, shuffled, count, 1);
+	benchmark(ctx, "shuffled+reordered", arrays, reordered, count, 0);
+	benchmark(ctx, "shuffled+reordered", arrays, reordered, count, 1);
+
+	fimgDestroyContext(ctx);
+	free(reordered);
+	free(shuffled);
+	free(grid);
+	free(colors);
+	free(texcoords);
+	free(positions);
+
+	return 0;
+}
@@ -0,0 +1,443 @@
+/*
+ * libsgl/tests/shadertest.c
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2013 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Checks the shader optimizer by drawing with optimized and unoptimized
+ * programs on the emulated hardware and comparing the resulting pixels.
+ *
+ * Small hand written programs check that copy propagation and dead code
+ * elimination do their job, then programs generated for random texture
+ * environment, lighting and fog setups check that nothing is broken.
+ *
+ * Usage: shadertest [setups]
+ */
+
+#include <stdio.h>
+
+/* Static functions and tables are needed */
+#include "compat.c"
+
+#define W	16
+#define H	16
+
+static uint32_t *colorBuf;
+static uint32_t reference[W * H];
+static fimgArray arrays[6];
+static int failures;
+
+static uint32_t seed = 12345;
+
+static uint32_t rnd(uint32_t n)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) % n;
+}
+
+static void check(const char *name, int cond)
+{
+	if (!cond) {
+		printf("%s: failed\n", name);
+		++failures;
+	}
+}
+
+static void setupContext(fimgContext *ctx)
+{
+	static const float identity[16] = {
+		1.0f, 0.0f, 0.0f, 0.0f,	0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,	0.0f, 0.0f, 0.0f, 1.0f
+	};
+	static const float constant[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	static const float positions[] = {
+		-1.0f, -1.0f, 0.0f,	1.0f, -1.0f, 0.5f,
+		-1.0f, 1.0f, 0.5f,	1.0f, 1.0f, 1.0f
+	};
+	static const float normals[] = {
+		0.0f, 0.0f, 1.0f,	0.6f, 0.0f, 0.8f,
+		0.0f, -0.6f, 0.8f,	0.36f, 0.48f, 0.8f
+	};
+	static const float colors[] = {
+		1.0f, 0.2f, 0.7f, 0.3f,		0.1f, 1.0f, 0.4f, 0.9f,
+		0.5f, 0.3f, 1.0f, 0.6f,		0.8f, 0.9f, 0.2f, 1.0f
+	};
+	static const float texcoords[] = {
+		0.0f, 0.0f,	1.0f, 0.0f,	0.0f, 1.0f,	1.0f, 1.0f
+	};
+	static const float fogColor[4] = { 0.3f, 0.6f, 0.9f, 0.5f };
+	static const float light[][4] = {
+		{ 0.2f, 0.1f, 0.3f, 1.0f },
+		{ 0.7f, 0.8f, 0.5f, 1.0f },
+		{ 0.5f, 0.5f, 0.9f, 1.0f },
+		{ 0.0f, 0.0f, 1.0f, 0.0f },
+		{ 1.0f, 1.0f, 1.0f, 1.0f },
+	};
+	unsigned long colorAddr, depthAddr, texAddr;
+	uint32_t *texels;
+	fimgTexture *tex;
+	unsigned int i, unit;
+
+	colorBuf = fimgSoftAlloc(W * H * 4, &colorAddr);
+	fimgSoftAlloc(W * H * 4, &depthAddr);
+
+	fimgSetFrameBufSize(ctx, W, H, 1);
+	fimgSetFrameBufParams(ctx, 0, FGPF_COLOR_MODE_8888);
+	fimgSetColorBufBaseAddr(ctx, colorAddr);
+	fimgSetZBufBaseAddr(ctx, depthAddr);
+	fimgSetXClip(ctx, 0, W);
+	fimgSetYClip(ctx, 0, H);
+	fimgSetViewportParams(ctx, 0, 0, W, H);
+	fimgSetDepthRange(ctx, 0, 1);
+	fimgLoadMatrix(ctx, FGFP_MATRIX_TRANSFORM, identity);
+	fimgLoadMatrix(ctx, FGFP_MATRIX_LIGHTING, identity);
+
+	fimgSetAttribCount(ctx, 6);
+	for (i = 0; i < 6; ++i) {
+		arrays[i].pointer = constant;
+		arrays[i].stride = 0;
+		arrays[i].width = 16;
+		fimgSetAttribute(ctx, i, FGHI_ATTRIB_DT_FLOAT, 4);
+	}
+
+	arrays[0].pointer = positions;
+	arrays[0].stride = arrays[0].width = 12;
+	fimgSetAttribute(ctx, 0, FGHI_ATTRIB_DT_FLOAT, 3);
+	arrays[1].pointer = normals;
+	arrays[1].stride = arrays[1].width = 12;
+	fimgSetAttribute(ctx, 1, FGHI_ATTRIB_DT_FLOAT, 3);
+	arrays[2].pointer = colors;
+	arrays[2].stride = 16;
+	for (unit = 0; unit < FIMG_NUM_TEXTURE_UNITS; ++unit) {
+		arrays[4 + unit].pointer = texcoords;
+		arrays[4 + unit].stride = arrays[4 + unit].width = 8;
+		fimgSetAttribute(ctx, 4 + unit, FGHI_ATTRIB_DT_FLOAT, 2);
+	}
+
+	fimgSetVertexContext(ctx, FGPE_TRIANGLE_STRIP);
+
+	/* Random 4x4 textures, the first one with varying alpha */
+	for (unit = 0; unit < FIMG_NUM_TEXTURE_UNITS; ++unit) {
+		texels = fimgSoftAlloc(4 * 4 * 4, &texAddr);
+		for (i = 0; i < 4 * 4; ++i)
+			texels[i] = (i * 0x3b1d5a7 + unit * 0x55aa33)
+						| (unit ? 0 : 0x40000000);
+
+		tex = fimgCreateTexture();
+		fimgInitTexture(tex, 0, FGTU_TSTA_TEXTURE_FORMAT_8888,
+								texAddr);
+		fimgSetTex2DSize(tex, 4, 4, 0);
+		fimgSetTexMipmap(tex, FGTU_TSTA_MIPMAP_DISABLED);
+		fimgSetTexMagFilter(tex, FGTU_TSTA_FILTER_NEAREST);
+		fimgCompatSetupTexture(ctx, tex, unit);
+		fimgLoadMatrix(ctx, FGFP_MATRIX_TEXTURE(unit), identity);
+	}
+
+	fimgCompatSetEnvColor(ctx, 0, 0.25f, 0.5f, 0.75f, 0.6f);
+	fimgCompatSetEnvColor(ctx, 1, 0.9f, 0.1f, 0.3f, 0.2f);
+
+	fimgCompatSetFogParams(ctx, 1.5f, 0.1f, 0.9f);
+	fimgCompatSetFogColor(ctx, fogColor);
+
+	for (i = 0; i < 2; ++i) {
+		fimgCompatSetLightColor(ctx, i, FGFP_LIGHT_AMBIENT, light[i]);
+		fimgCompatSetLightColor(ctx, i, FGFP_LIGHT_DIFFUSE,
+								light[i + 1]);
+		fimgCompatSetLightColor(ctx, i, FGFP_LIGHT_SPECULAR,
+								light[i + 2]);
+	}
+	fimgCompatSetLightPosition(ctx, 0, light[3]);
+	fimgCompatSetLightPosition(ctx, 1, light[4]);
+	fimgCompatSetLightAttenuation(ctx, 1, 1.0f, 0.5f, 0.25f);
+	fimgCompatSetMaterialColor(ctx, FGFP_LIGHT_AMBIENT, light[2]);
+	fimgCompatSetMaterialColor(ctx, FGFP_LIGHT_SPECULAR, light[1]);
+	fimgCompatSetMaterialShininess(ctx, 8.0f);
+}
+
+static void draw(fimgContext *ctx)
+{
+	memset(colorBuf, 0, W * H * 4);
+	fimgDrawArrays(ctx, FGPE_TRIANGLE_STRIP, arrays, 4);
+	fimgFinish(ctx);
+}
+
+/*
+ * Draws with given program in place of the current one of the cache,
+ * restoring the cache entry afterwards.
+ */
+static void drawWith(fimgContext *ctx, fimgShaderCache *cache,
+				int *loaded, uint32_t *code, uint32_t count)
+{
+	fimgShaderCacheEntry *e = cache->current;
+	uint32_t *oldCode = e->code;
+	uint32_t oldCount = e->instrCount;
+
+	e->code = code;
+	e->instrCount = count;
+	*loaded = 0;
+	draw(ctx);
+
+	e->code = oldCode;
+	e->instrCount = oldCount;
+	*loaded = 0;
+}
+
+/* Returns the largest difference of color components from the reference */
+static int compareImage(void)
+{
+	int i, shift, diff, maxDiff = 0;
+
+	for (i = 0; i < W * H; ++i) {
+		for (shift = 0; shift < 32; shift += 8) {
+			diff = (int)((colorBuf[i] >> shift) & 0xff)
+				- (int)((reference[i] >> shift) & 0xff);
+			if (abs(diff) > maxDiff)
+				maxDiff = abs(diff);
+		}
+	}
+
+	return maxDiff;
+}
+
+/*
+ * Hand written pixel shaders
+ */
+
+static fimgShaderSrc src(unsigned int type, unsigned int num,
+				unsigned int swizzle, unsigned int modifier)
+{
+	fimgShaderSrc s = { type, num, swizzle, modifier };
+
+	return s;
+}
+
+static void emit(fimgShaderInstruction *instr, unsigned int opcode,
+		unsigned int dstType, unsigned int dstNum, unsigned int mask,
+		const fimgShaderSrc *s, unsigned int count)
+{
+	memset(instr, 0, sizeof(*instr));
+	setOpcode(instr, opcode, s, count);
+	instr->dest_regtype = dstType;
+	instr->dest_regnum = dstNum;
+	instr->dest_mask = mask;
+}
+
+/* Saturated move of a temporary to color output */
+static void emitOutput(fimgShaderInstruction *instr, unsigned int num)
+{
+	fimgShaderSrc s = src(REG_SRC_R, num, SWIZZLE_IDENTITY, 0);
+
+	emit(instr, OP_MOV, REG_DST_O, 16, 0xf, &s, 1);
+	instr->dest_modifier = 1;
+}
+
+/*
+ * Optimizes given program and draws with both versions, returning number
+ * of instructions left after optimization.
+ */
+static uint32_t testProgram(fimgContext *ctx, const char *name,
+					uint32_t *code, uint32_t count)
+{
+	uint32_t opt[4 * MAX_PS_INSTR];
+	uint32_t optCount;
+	int diff;
+
+	memcpy(opt, code, 4 * count * sizeof(*code));
+	markThreeSourceOps((fimgShaderInstruction *)code, count, MAX_PS_INSTR);
+	optCount = optimizeShader(opt, opt + 4 * count,
+					MAX_PS_INSTR, &pixelConstFloat);
+
+	drawWith(ctx, &ctx->compat.psCache, &ctx->compat.pshaderLoaded,
+								code, count);
+	memcpy(reference, colorBuf, sizeof(reference));
+	drawWith(ctx, &ctx->compat.psCache, &ctx->compat.pshaderLoaded,
+								opt, optCount);
+
+	diff = compareImage();
+	if (diff) {
+		printf("%s: optimized program differs by %d\n", name, diff);
+		++failures;
+	}
+
+	return optCount;
+}
+
+static void testCopyPropagation(fimgContext *ctx)
+{
+	uint32_t buf[4 * 4];
+	fimgShaderInstruction *code = (fimgShaderInstruction *)buf;
+	fimgShaderSrc s[2];
+
+	/* Chain of swizzled and negated copies used by an ADD */
+	s[0] = src(REG_SRC_V, 0, SWIZZLE(3, 2, 1, 0), 0);
+	emit(&code[0], OP_MOV, REG_DST_R, 1, 0xf, s, 1);
+	s[0] = src(REG_SRC_R, 1, SWIZZLE(1, 0, 3, 2), SRC_MOD_NEG);
+	emit(&code[1], OP_MOV, REG_DST_R, 2, 0xf, s, 1);
+	s[0] = src(REG_SRC_R, 2, SWIZZLE_IDENTITY, 0);
+	s[1] = src(REG_SRC_C, 1, SWIZZLE_IDENTITY, 0);
+	emit(&code[2], OP_ADD, REG_DST_R, 3, 0xf, s, 2);
+	emitOutput(&code[3], 3);
+
+	/* The ADD reads -v0.zwxy, the copies are gone */
+	check("copy propagation",
+			testProgram(ctx, "copy propagation", buf, 4) == 2);
+}
+
+static void testDeadCode(fimgContext *ctx)
+{
+	uint32_t buf[4 * 8];
+	fimgShaderInstruction *code = (fimgShaderInstruction *)buf;
+	fimgShaderSrc s[3];
+
+	/* Result overwritten before being read */
+	s[0] = src(REG_SRC_V, 0, SWIZZLE_IDENTITY, 0);
+	s[1] = src(REG_SRC_C, 3, SWIZZLE_IDENTITY, 0);
+	emit(&code[0], OP_MUL, REG_DST_R, 1, 0xf, s, 2);
+	/* Result never read */
+	s[1] = src(REG_SRC_V, 0, SWIZZLE_IDENTITY, 0);
+	s[2] = src(REG_SRC_C, 2, SWIZZLE_IDENTITY, 0);
+	emit(&code[1], OP_MAD, REG_DST_R, 2, 0xf, s, 3);
+	s[1] = src(REG_SRC_C, 2, SWIZZLE_IDENTITY, 0);
+	emit(&code[2], OP_ADD, REG_DST_R, 1, 0xf, s, 2);
+	/* Only two components read */
+	s[0] = src(REG_SRC_R, 1, SWIZZLE_IDENTITY, 0);
+	s[1] = src(REG_SRC_V, 0, SWIZZLE(1, 1, 0, 0), 0);
+	emit(&code[3], OP_MUL, REG_DST_R, 3, 0xf, s, 2);
+	s[0] = src(REG_SRC_R, 3, SWIZZLE_IDENTITY, 0);
+	emit(&code[4], OP_MOV, REG_DST_R, 1, 0x3, s, 1);
+	/* Identity move and NOP */
+	s[0] = src(REG_SRC_R, 1, SWIZZLE_IDENTITY, 0);
+	emit(&code[5], OP_MOV, REG_DST_R, 1, 0xf, s, 1);
+	emit(&code[6], OP_NOP, REG_DST_R, 0, 0, s, 0);
+	emitOutput(&code[7], 1);
+
+	check("dead code elimination",
+			testProgram(ctx, "dead code", buf, 8) == 4);
+}
+
+/*
+ * Generated programs
+ */
+
+static void randomSetup(fimgContext *ctx)
+{
+	unsigned int unit, arg;
+
+	for (unit = 0; unit < FIMG_NUM_TEXTURE_UNITS; ++unit) {
+		fimgCompatSetTextureFunc(ctx, unit, rnd(7));
+		fimgCompatSetColorCombiner(ctx, unit, rnd(8));
+		fimgCompatSetAlphaCombiner(ctx, unit, rnd(6));
+		for (arg = 0; arg < 3; ++arg) {
+			fimgCompatSetColorCombineArgSrc(ctx, unit, arg, rnd(4));
+			fimgCompatSetColorCombineArgMod(ctx, unit, arg, rnd(4));
+			fimgCompatSetAlphaCombineArgSrc(ctx, unit, arg, rnd(4));
+			fimgCompatSetAlphaCombineArgMod(ctx, unit, arg,
+								2 * rnd(2));
+		}
+		fimgCompatSetColorScale(ctx, unit, rnd(2) ? 1.0f : 2.0f);
+		fimgCompatSetAlphaScale(ctx, unit, rnd(2) ? 1.0f : 4.0f);
+	}
+
+	fimgCompatSetLightingEnable(ctx, rnd(2));
+	fimgCompatSetLightEnable(ctx, 0, rnd(2));
+	fimgCompatSetLightEnable(ctx, 1, rnd(2));
+	fimgCompatSetColorMaterialEnable(ctx, rnd(2));
+	fimgCompatSetNormalizeEnable(ctx, rnd(2));
+	fimgCompatSetFogMode(ctx, rnd(4));
+}
+
+static void testGenerated(fimgContext *ctx, unsigned int setups)
+{
+	uint32_t code[4 * MAX_INSTR];
+	unsigned long optPS = 0, origPS = 0, optVS = 0, origVS = 0;
+	unsigned int n, count, mismatches = 0;
+	int diff;
+
+	for (n = 0; n < setups; ++n) {
+		randomSetup(ctx);
+		draw(ctx);
+		memcpy(reference, colorBuf, sizeof(reference));
+
+		count = buildPixelShader(ctx, code) / 4;
+		drawWith(ctx, &ctx->compat.psCache,
+				&ctx->compat.pshaderLoaded, code, count);
+		optPS += ctx->compat.psCache.current->instrCount;
+		origPS += count;
+
+		diff = compareImage();
+		if (diff && mismatches++ < 10)
+			printf("setup %u: optimized pixel shader differs by %d\n",
+								n, diff);
+
+		count = buildVertexShader(ctx, code) / 4;
+		drawWith(ctx, &ctx->compat.vsCache,
+				&ctx->compat.vshaderLoaded, code, count);
+		optVS += ctx->compat.vsCache.current->instrCount;
+		origVS += count;
+
+		diff = compareImage();
+		if (diff && mismatches++ < 10)
+			printf("setup %u: optimized vertex shader differs by %d\n",
+								n, diff);
+	}
+
+	printf("%u setups, average pixel shader %.1f instructions "
+		"(%.1f unoptimized), vertex shader %.1f (%.1f)\n", setups,
+		(double)optPS / setups, (double)origPS / setups,
+		(double)optVS / setups, (double)origVS / setups);
+
+	if (mismatches) {
+		printf("%u programs rendered differently\n", mismatches);
+		++failures;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int setups = 1000;
+	fimgContext *ctx;
+
+	if (argc > 1)
+		setups = atoi(argv[1]);
+
+	ctx = fimgCreateContext();
+	if (!ctx) {
+		fprintf(stderr, "Failed to create context.\n");
+		return 1;
+	}
+
+	setupContext(ctx);
+
+	/* Plain color with textures disabled */
+	fimgCompatSetTextureFunc(ctx, 0, FGFP_TEXFUNC_NONE);
+	fimgCompatSetTextureFunc(ctx, 1, FGFP_TEXFUNC_NONE);
+	draw(ctx);
+	testCopyPropagation(ctx);
+	testDeadCode(ctx);
+
+	testGenerated(ctx, setups);
+
+	fimgDestroyContext(ctx);
+
+	if (failures)
+		printf("%d checks failed\n", failures);
+
+	return failures ? 1 : 0;
+}
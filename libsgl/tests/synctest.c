@@ -0,0 +1,166 @@
+/*
+ * libsgl/tests/synctest.c
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2013 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Checks that fences of a context that stopped drawing, without finishing
+ * its work, can be waited for by threads with and without current context.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES/gl.h>
+
+static EGLDisplay dpy;
+static EGLConfig config;
+static int failures;
+
+static void check(const char *name, int cond)
+{
+	if (!cond) {
+		printf("%s: failed\n", name);
+		++failures;
+	}
+}
+
+static EGLSyncKHR drawAndFence(void)
+{
+	static const GLfloat vertices[] = {
+		-1.0f, -1.0f,	1.0f, -1.0f,	-1.0f, 1.0f
+	};
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(2, GL_FLOAT, 0, vertices);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	return eglCreateSyncKHR(dpy, EGL_SYNC_FENCE_KHR, NULL);
+}
+
+static void *clientWait(void *arg)
+{
+	EGLSyncKHR sync = arg;
+
+	check("client wait without context",
+		eglClientWaitSyncKHR(dpy, sync, 0, EGL_FOREVER_KHR)
+					== EGL_CONDITION_SATISFIED_KHR);
+
+	return NULL;
+}
+
+static void *serverWait(void *arg)
+{
+	static const EGLint surfaceAttribs[] = {
+		EGL_WIDTH, 16,
+		EGL_HEIGHT, 16,
+		EGL_NONE
+	};
+	EGLSyncKHR sync = arg;
+	EGLSurface surface;
+	EGLContext context;
+	EGLint status = 0;
+
+	surface = eglCreatePbufferSurface(dpy, config, surfaceAttribs);
+	context = eglCreateContext(dpy, config, EGL_NO_CONTEXT, NULL);
+	if (!eglMakeCurrent(dpy, surface, surface, context)) {
+		check("second context", 0);
+		return NULL;
+	}
+
+	check("wait in other context", eglWaitSyncKHR(dpy, sync, 0));
+	eglGetSyncAttribKHR(dpy, sync, EGL_SYNC_STATUS_KHR, &status);
+	check("signaled after wait", status == EGL_SIGNALED_KHR);
+
+	eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(dpy, context);
+	eglDestroySurface(dpy, surface);
+
+	return NULL;
+}
+
+int main(void)
+{
+	static const EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_NONE
+	};
+	static const EGLint surfaceAttribs[] = {
+		EGL_WIDTH, 64,
+		EGL_HEIGHT, 64,
+		EGL_NONE
+	};
+	EGLSurface surface;
+	EGLContext context;
+	EGLSyncKHR sync;
+	pthread_t thread;
+	EGLint num;
+
+	/* Hanging means the fence was never seen signaled */
+	alarm(10);
+
+	dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (!eglInitialize(dpy, NULL, NULL)
+	    || !eglChooseConfig(dpy, configAttribs, &config, 1, &num) || !num) {
+		fprintf(stderr, "Failed to initialize EGL (%#x).\n",
+							eglGetError());
+		return 1;
+	}
+
+	surface = eglCreatePbufferSurface(dpy, config, surfaceAttribs);
+	context = eglCreateContext(dpy, config, EGL_NO_CONTEXT, NULL);
+	if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT
+	    || !eglMakeCurrent(dpy, surface, surface, context)) {
+		fprintf(stderr, "Failed to create context (%#x).\n",
+							eglGetError());
+		return 1;
+	}
+
+	/* This thread keeps the context current, but stops drawing */
+	sync = drawAndFence();
+	pthread_create(&thread, NULL, clientWait, sync);
+	pthread_join(thread, NULL);
+	eglDestroySyncKHR(dpy, sync);
+
+	sync = drawAndFence();
+	pthread_create(&thread, NULL, serverWait, sync);
+	pthread_join(thread, NULL);
+	eglDestroySyncKHR(dpy, sync);
+
+	/* Polling with timeout of a destroyed fence must fail */
+	sync = drawAndFence();
+	eglDestroySyncKHR(dpy, sync);
+	check("destroyed fence", eglClientWaitSyncKHR(dpy, sync, 0, 0)
+							== EGL_FALSE);
+
+	eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(dpy, context);
+	eglDestroySurface(dpy, surface);
+	eglTerminate(dpy);
+
+	if (failures)
+		printf("%d checks failed\n", failures);
+
+	return failures ? 1 : 0;
+}
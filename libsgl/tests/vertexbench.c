@@ -0,0 +1,202 @@
+/*
+ * libsgl/tests/vertexbench.c
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2013 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Vertex batch packing benchmark
+ *
+ * Drives the primitiveHandler table of host_new.c with synthetic arrays
+ * and reports how fast batches are packed by CPU. This is the work done
+ * in draw loops while the hardware processes previous batch.
+ *
+ * Usage: vertexbench [vertices]
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+/* Static functions and tables are needed */
+#include "host_new.c"
+
+struct vertex {
+	float position[3];
+	float texcoord[2];
+	uint8_t color[4];
+};
+
+static inline uint64_t getTime(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void setupArrays(fimgContext *ctx, fimgArray *arrays,
+				const struct vertex *vertices, int interleaved,
+				const float *positions, const float *texcoords,
+				const uint8_t *colors)
+{
+	static const float constant[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	unsigned int i;
+
+	fimgSetAttribCount(ctx, 4);
+
+	for (i = 0; i < 4; ++i) {
+		arrays[i].pointer = constant;
+		arrays[i].stride = 0;
+		arrays[i].width = 16;
+		fimgSetAttribute(ctx, i, FGHI_ATTRIB_DT_FLOAT, 4);
+	}
+
+	arrays[0].pointer = interleaved ? vertices->position : positions;
+	arrays[0].stride = interleaved ? sizeof(*vertices) : 12;
+	arrays[0].width = 12;
+	fimgSetAttribute(ctx, 0, FGHI_ATTRIB_DT_FLOAT, 3);
+
+	arrays[2].pointer = interleaved ? (const void *)vertices->color
+							: (const void *)colors;
+	arrays[2].stride = interleaved ? sizeof(*vertices) : 4;
+	arrays[2].width = 4;
+	fimgSetAttribute(ctx, 2, FGHI_ATTRIB_DT_NUBYTE, 4);
+
+	arrays[3].pointer = interleaved ? vertices->texcoord : texcoords;
+	arrays[3].stride = interleaved ? sizeof(*vertices) : 8;
+	arrays[3].width = 8;
+	fimgSetAttribute(ctx, 3, FGHI_ATTRIB_DT_FLOAT, 2);
+
+	selectPackers(ctx, arrays);
+}
+
+/* Packs all batches of a draw call, returning packed bytes */
+static uint64_t packDraw(fimgContext *ctx, unsigned int mode,
+		fimgArray *arrays, const uint16_t *indices, unsigned int count)
+{
+	uint32_t pos = 0, left = count, copied;
+	uint64_t bytes = 0;
+
+	do {
+		if (indices)
+			copied = primitiveHandler[mode].indexed_16(ctx,
+						arrays, indices, &pos, &left);
+		else
+			copied = primitiveHandler[mode].direct(ctx,
+						arrays, &pos, &left);
+		bytes += ctx->vertexDataSize;
+	} while (copied);
+
+	return bytes;
+}
+
+static void benchmark(fimgContext *ctx, const char *name, unsigned int mode,
+		fimgArray *arrays, const uint16_t *indices, unsigned int count)
+{
+	uint64_t bytes = 0, start, time;
+	unsigned int loops = 0;
+
+	start = getTime();
+	do {
+		bytes += packDraw(ctx, mode, arrays, indices, count);
+		++loops;
+		time = getTime() - start;
+	} while (time < 200000000ULL);
+
+	printf("%-16s %-7s %8.2f Mvertices/s %8.2f MB/s\n", name,
+		indices ? "idx16" : "direct",
+		1e3 * loops * count / time, 1e3 * bytes / time);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct {
+		const char *name;
+		unsigned int mode;
+	} modes[] = {
+		{ "points", FGPE_POINTS },
+		{ "lines", FGPE_LINES },
+		{ "line strip", FGPE_LINE_STRIP },
+		{ "triangles", FGPE_TRIANGLES },
+		{ "triangle strip", FGPE_TRIANGLE_STRIP },
+		{ "triangle fan", FGPE_TRIANGLE_FAN },
+	};
+	unsigned int count = 30000, i, layout;
+	struct vertex *vertices;
+	float *positions, *texcoords;
+	uint8_t *colors;
+	uint16_t *indices;
+	fimgArray arrays[4];
+	fimgContext *ctx;
+
+	if (argc > 1)
+		count = atoi(argv[1]);
+	count -= count % 6;
+
+	vertices = malloc(count * sizeof(*vertices));
+	positions = malloc(count * 3 * sizeof(*positions));
+	texcoords = malloc(count * 2 * sizeof(*texcoords));
+	colors = malloc(count * 4);
+	indices = malloc(count * sizeof(*indices));
+	ctx = fimgCreateContext();
+	if (!vertices || !positions || !texcoords || !colors || !indices
+	    || !ctx) {
+		fprintf(stderr, "Initialization failed.\n");
+		return 1;
+	}
+
+	for (i = 0; i < count; ++i) {
+		vertices[i].position[0] = positions[3*i] = i;
+		vertices[i].position[1] = positions[3*i + 1] = i & 1;
+		vertices[i].position[2] = positions[3*i + 2] = 0.5f;
+		vertices[i].texcoord[0] = texcoords[2*i] = i & 1;
+		vertices[i].texcoord[1] = texcoords[2*i + 1] = i >> 1;
+		vertices[i].color[0] = colors[4*i] = i;
+		vertices[i].color[1] = colors[4*i + 1] = i >> 8;
+		vertices[i].color[2] = colors[4*i + 2] = 0;
+		vertices[i].color[3] = colors[4*i + 3] = 255;
+		indices[i] = (i * 7919) % count;
+	}
+
+	prepareVertexData(ctx);
+
+	printf("%u vertices of float3 position, ubyte4 color, "
+						"float2 texcoord\n", count);
+
+	for (layout = 0; layout < 2; ++layout) {
+		printf("\n%s arrays:\n", layout ? "Interleaved" : "Separate");
+		setupArrays(ctx, arrays, vertices, layout,
+					positions, texcoords, colors);
+
+		for (i = 0; i < sizeof(modes) / sizeof(*modes); ++i) {
+			benchmark(ctx, modes[i].name, modes[i].mode,
+							arrays, NULL, count);
+			benchmark(ctx, modes[i].name, modes[i].mode,
+							arrays, indices, count);
+		}
+	}
+
+	fimgDestroyContext(ctx);
+	free(indices);
+	free(colors);
+	free(texcoords);
+	free(positions);
+	free(vertices);
+
+	return 0;
+}